@@ -3,6 +3,7 @@
 #define BUILTINS_H
 
 #include "common.h"
+#include "pipeline.h"
 #include "system_monitor.h"
 #include <time.h>
 
@@ -72,20 +73,21 @@ int lsh_echo(char **args);
 int lsh_self_destruct();
 int lsh_theme(char **args);
 int lsh_loc(char **args);
+int lsh_page(char **args);
 int lsh_git_status(char **args);
 int lsh_gg(char **args);
 int lsh_stats(char **args);
 
+// Pipeline stages of the builtins that can run inside a pipeline
+int lsh_cat_stage(char **args, StageStream *in, StageStream *out);
+int lsh_echo_stage(char **args, StageStream *in, StageStream *out);
+int lsh_history_stage(char **args, StageStream *in, StageStream *out);
+int lsh_loc_stage(char **args, StageStream *in, StageStream *out);
+int lsh_grep_text_stage(char **args, StageStream *in, StageStream *out);
+
 // Add command to history
 void lsh_add_to_history(const char *command);
 
-// Get number of builtin commands
-int lsh_num_builtins(void);
-
-// Expose the builtin command strings and function pointers
-extern char *builtin_str[];
-extern int (*builtin_func[])(char **);
-
 char *extract_json_string(const char *json, const char *key);
 
 #endif // BUILTINS_H
@@ -0,0 +1,29 @@
+#ifndef COMMAND_PARSER_H
+#define COMMAND_PARSER_H
+
+#include "containers/arena.h"
+
+// When a pipeline runs, given the exit status of the one before it
+typedef enum {
+  RUN_ALWAYS,     // First on the line, or after ';' or a newline
+  RUN_IF_SUCCESS, // After '&&'
+  RUN_IF_FAILURE, // After '||'
+} RunCondition;
+
+// Commands joined by '|', laid out the way lsh_execute_piped takes them
+typedef struct ParsedPipeline {
+  char ***commands; // NULL-terminated list of NULL-terminated argument lists
+  int count;
+  RunCondition condition;
+  struct ParsedPipeline *next;
+} ParsedPipeline;
+
+// Split a command line into pipelines in one pass, with every string and
+// list allocated in arena. Words may be quoted with '' or "", and a
+// backslash takes the next character literally outside single quotes.
+// Returns 0 and sets *error on a syntax error. A line with no commands
+// gives *pipelines NULL.
+int parse_command_line(Arena *arena, const char *line,
+                       ParsedPipeline **pipelines, const char **error);
+
+#endif // COMMAND_PARSER_H
@@ -0,0 +1,37 @@
+#ifndef COMMAND_REGISTRY_H
+#define COMMAND_REGISTRY_H
+
+#include "pipeline.h"
+#include "tab_complete.h"
+#include <stdint.h>
+
+// What a command can do in a pipeline
+typedef enum {
+  COMMAND_TABLE_SOURCE = 1 << 0, // Output can feed table filters directly
+} CommandFlags;
+
+// Everything the shell knows about a command name
+typedef struct {
+  const char *name;
+  int (*func)(char **args); // NULL for external commands known to completion
+  ArgumentType arg_type;    // What tab completion offers as arguments
+  int strict_match;         // If 1, offer only arguments of arg_type
+  const char *help;         // One-line description
+  unsigned flags;           // CommandFlags
+  StageFunc stage;          // Runs it on a thread inside a pipeline, or NULL
+} CommandInfo;
+
+// Builtins and well-known external commands, found through a perfect hash
+// built on first use. NULL for any other name.
+const CommandInfo *command_lookup(const char *name);
+
+// Like command_lookup, but NULL unless name is a builtin
+const CommandInfo *command_builtin(const char *name);
+
+// Every builtin, in name order
+const CommandInfo *command_builtins(int *count);
+
+// Seeded FNV-1a, for the registry and alias tables
+uint32_t command_hash(const char *name, uint32_t seed);
+
+#endif // COMMAND_REGISTRY_H
@@ -69,6 +69,10 @@
 #define KEY_RIGHT 1003
 #define KEY_SHIFT_ENTER 1010
 #define KEY_SHIFT_TAB 1011
+#define KEY_HOME 1012
+#define KEY_END 1013
+#define KEY_PAGE_UP 1014
+#define KEY_PAGE_DOWN 1015
 
 // Typedefs for compatibility
 typedef unsigned int UINT;
@@ -0,0 +1,20 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Bump allocator for data that all dies at once. Zero-initialize it, take
+// memory with arena_alloc and give everything back with arena_free.
+typedef struct {
+  ArenaBlock *blocks; // Newest first
+  size_t used;        // Bytes taken from the newest block
+} Arena;
+
+// Aligned for any type, NULL when out of memory
+void *arena_alloc(Arena *arena, size_t size);
+
+void arena_free(Arena *arena);
+
+#endif // ARENA_H
@@ -0,0 +1,33 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+// One epoll loop for everything the shell waits on at the prompt: the
+// terminal, timers and signals. Handlers run on the shell's own thread
+// from inside event_wait, so they never race the line editor.
+typedef void (*EventHandler)(void *data);
+
+// Call handler whenever fd has input
+int event_watch(int fd, EventHandler handler, void *data);
+void event_unwatch(int fd);
+
+// A timer that calls handler when it fires. Returns its id, or -1.
+int event_timer(EventHandler handler, void *data);
+
+// Fire after delay_ms, then every interval_ms if that is not 0. A delay of
+// 0 stops the timer.
+void event_timer_arm(int timer, long delay_ms, long interval_ms);
+
+// Deliver signo to handler instead of its normal action, between
+// event_loop_begin and event_loop_end
+int event_signal(int signo, EventHandler handler, void *data);
+
+// Bracket the time the shell waits on the terminal. Outside of it signals
+// act normally, so commands the shell starts see them as usual.
+void event_loop_begin(void);
+void event_loop_end(void);
+
+// Run handlers until fd has input (1), timeout_ms passes (0) or waiting
+// fails (-1). A negative timeout waits for as long as it takes.
+int event_wait(int fd, int timeout_ms);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,21 @@
+#ifndef GIT_COMMIT_GRAPH_H
+#define GIT_COMMIT_GRAPH_H
+
+#include "common.h"
+#include "git_odb.h"
+
+typedef struct {
+  char local_oid[GIT_OID_HEX_LEN + 1];
+  char upstream_oid[GIT_OID_HEX_LEN + 1]; // Empty when there is no upstream
+  int ahead;                              // Commits only in local
+  int behind;                             // Commits only in upstream
+} GitAheadBehind;
+
+// Compute ahead/behind for every pair in a single walk over the union of
+// their histories. Parents and generation numbers come from
+// objects/info/commit-graph (single file or split chain) when present,
+// otherwise commits are read through the object database and ordered by
+// committer date. Returns 1 on success.
+int git_ahead_behind(GitOdb *odb, GitAheadBehind *pairs, int count);
+
+#endif // GIT_COMMIT_GRAPH_H
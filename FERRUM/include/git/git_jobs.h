@@ -0,0 +1,64 @@
+#ifndef GIT_JOBS_H
+#define GIT_JOBS_H
+
+#include "common.h"
+#include <poll.h>
+
+#define GIT_JOB_MAX_QUEUED 32
+#define GIT_JOB_MAX_ARGS 64
+#define GIT_JOB_PROGRESS_LEN 256
+#define GIT_JOB_MAX_POLLFDS 2 // Wake pipe plus the running job's output
+
+// Job flags
+#define GIT_JOB_COALESCE 0x1       // Reuse an identical job that has not started
+#define GIT_JOB_CANCEL_ON_EXIT 0x2 // Terminate instead of waiting at shutdown
+
+typedef struct GitJob GitJob;
+
+typedef void (*GitJobCallback)(const GitJob *job, void *ctx);
+
+struct GitJob {
+  int id;
+  char label[32]; // Groups related jobs, e.g. "push" or "fetch"
+  char *argv[GIT_JOB_MAX_ARGS];
+  char *env[8]; // Extra NAME=VALUE entries for the child
+  int flags;
+  pid_t pid;     // 0 while queued
+  int output_fd; // Combined stdout/stderr of the running job
+  char progress[GIT_JOB_PROGRESS_LEN]; // Last complete line of output
+  char partial[GIT_JOB_PROGRESS_LEN];  // Line still being written
+  size_t partial_len;
+  int exit_status; // Exit code once finished, 127 when spawning failed
+  GitJobCallback on_done;
+  void *ctx;
+};
+
+// Git operations run one at a time, in submission order, as child
+// processes started with posix_spawn. Completion is reported through a
+// SIGCHLD self-pipe so callers can fold it into their poll() loop.
+int git_jobs_init(void);
+
+// Wait for running work (or terminate it for GIT_JOB_CANCEL_ON_EXIT jobs),
+// drop the queue and restore the previous SIGCHLD handler.
+void git_jobs_shutdown(void);
+
+// Queue argv (NULL terminated, looked up in PATH) with optional extra
+// environment entries. Returns the job id, or 0 when the queue is full.
+int git_jobs_submit(const char *label, const char *const argv[],
+                    const char *const env[], int flags, GitJobCallback on_done,
+                    void *ctx);
+
+// Number of queued or running jobs with this label (any label for NULL)
+int git_jobs_active(const char *label);
+
+// The job currently running, or NULL
+const GitJob *git_jobs_running(void);
+
+// Descriptors to poll for job events. Returns how many were filled.
+int git_jobs_pollfds(struct pollfd *fds, int max);
+
+// Read job output, reap finished jobs, run their callbacks and start the
+// next queued job. Cheap to call when nothing happened.
+void git_jobs_dispatch(void);
+
+#endif // GIT_JOBS_H
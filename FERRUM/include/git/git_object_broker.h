@@ -0,0 +1,65 @@
+#ifndef GIT_OBJECT_BROKER_H
+#define GIT_OBJECT_BROKER_H
+
+#include "common.h"
+
+#define GIT_BROKER_MAX_REPOS 4
+#define GIT_OID_HEX_LEN 40
+#define GIT_MAX_PARENTS 16
+
+typedef struct {
+  char oid[GIT_OID_HEX_LEN + 1];
+  char type[16]; // "commit", "tree", "blob" or "tag"
+  char *data;    // Object content, NUL terminated (NULL for info queries)
+  size_t size;
+} GitObject;
+
+typedef struct {
+  char tree[GIT_OID_HEX_LEN + 1];
+  char parents[GIT_MAX_PARENTS][GIT_OID_HEX_LEN + 1];
+  int parent_count;
+  char author_name[128];
+  char author_email[128];
+  time_t author_time;
+  time_t committer_time;
+  const char *message; // Points into the object data
+  size_t message_len;
+} GitCommitInfo;
+
+// Walk up from the current directory to the repository's git dir without
+// spawning git. Handles the "gitdir: <path>" files used by worktrees.
+int git_find_git_dir(char *git_dir, size_t size);
+
+// Read an object (any rev git cat-file understands, e.g. "HEAD", "HEAD:path",
+// ":path") through the long-lived cat-file --batch coprocess of the current
+// repository. Returns 1 on success; free the result with git_object_free().
+int git_broker_read_object(const char *rev, GitObject *obj);
+
+// Resolve oid/type/size only, through the cat-file --batch-check coprocess.
+int git_broker_object_info(const char *rev, GitObject *obj);
+
+void git_object_free(GitObject *obj);
+
+int git_parse_commit(const char *data, size_t size, GitCommitInfo *info);
+
+// Copy the first line of a commit message into subject and the rest
+// (without the separating blank line) into body. Either may be NULL.
+void git_commit_message_parts(const GitCommitInfo *info, char *subject,
+                              size_t subject_size, char *body,
+                              size_t body_size);
+
+// Called for each commit of a walk; return 0 to stop early
+typedef int (*GitCommitVisitor)(const char *oid, const GitCommitInfo *info,
+                                void *ctx);
+
+// Walk history from start_rev newest-first by committer date (git log's
+// default order), reading every commit through the broker.
+int git_broker_walk_commits(const char *start_rev, int max_commits,
+                            GitCommitVisitor visitor, void *ctx);
+
+void git_format_relative_date(time_t when, char *out, size_t out_size);
+
+// Stop every coprocess. Registered with atexit on first use.
+void git_broker_shutdown(void);
+
+#endif // GIT_OBJECT_BROKER_H
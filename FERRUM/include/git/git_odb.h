@@ -0,0 +1,90 @@
+#ifndef GIT_ODB_H
+#define GIT_ODB_H
+
+#include "common.h"
+#include "git_object_broker.h"
+#include <stdint.h>
+
+#define GIT_OID_RAW_LEN 20
+#define GIT_DELTA_CACHE_SLOTS 256
+#define GIT_DELTA_CACHE_MAX_BYTES (32 * 1024 * 1024)
+
+typedef struct GitOdb GitOdb;
+
+int git_oid_from_hex(const char *hex, unsigned char *raw);
+
+void git_oid_to_hex(const unsigned char *raw, char *hex);
+
+// Read-only object database for the repository containing the current
+// directory. Loose objects are inflated directly, packed objects are found
+// through the .idx files and rebuilt from their delta chains. Returns NULL
+// when there is no repository; the instance is cached and reused until the
+// current directory moves to another repository.
+GitOdb *git_odb_current(void);
+
+void git_odb_close_all(void);
+
+// Read an object by hex id. Fills obj like git_broker_read_object().
+int git_odb_read(GitOdb *odb, const char *oid_hex, GitObject *obj);
+
+// Shortest prefix of oid_hex naming no other object, and at least as long
+// as git's automatic abbreviation for a repository this size, like %h.
+void git_odb_abbrev(GitOdb *odb, const char *oid_hex, char *out, size_t size);
+
+// Look up "dir/file" inside a tree and return the entry's id.
+int git_odb_tree_lookup(GitOdb *odb, const char *tree_oid, const char *path,
+                        char *oid_hex);
+
+// Read "HEAD:path"-style blobs: resolve rev to a commit, then the path.
+int git_odb_read_path(GitOdb *odb, const char *rev, const char *path,
+                      GitObject *obj);
+
+// Resolve HEAD, a full ref name, a branch/remote/tag short name or a full
+// hex id to a commit id. Annotated tags are peeled.
+int git_odb_resolve(GitOdb *odb, const char *rev, char *oid_hex);
+
+typedef struct {
+  char name[256]; // Full ref name, e.g. refs/heads/main
+  char oid[GIT_OID_HEX_LEN + 1];
+} GitRef;
+
+// All refs under refs/heads, refs/remotes and refs/tags (loose refs win
+// over packed-refs), with tags peeled to the commit they name. Returns the
+// count; free *refs with free().
+int git_odb_list_refs(GitOdb *odb, GitRef **refs);
+
+// Name of the branch HEAD points to (empty when detached)
+int git_odb_head_branch(GitOdb *odb, char *branch, size_t size);
+
+// Remote-tracking ref configured as the branch's upstream
+// (branch.<name>.remote/merge), e.g. refs/remotes/origin/main.
+int git_odb_branch_upstream(GitOdb *odb, const char *branch, char *ref,
+                            size_t size);
+
+const char *git_odb_objects_dir(GitOdb *odb);
+
+// Generation numbers computed for commits outside any commit-graph,
+// remembered for as long as odb is open. Returns 0 for an unknown commit.
+uint32_t git_odb_cached_generation(GitOdb *odb, const unsigned char *oid);
+void git_odb_cache_generation(GitOdb *odb, const unsigned char *oid,
+                              uint32_t generation);
+
+// History walker that keeps its queue between calls so callers can page
+// through history without restarting the walk.
+typedef struct GitRevWalk GitRevWalk;
+
+// The walk keeps odb open even after git_odb_current() moves on to
+// another repository.
+GitRevWalk *git_revwalk_new(GitOdb *odb, const char *start_oid);
+
+GitOdb *git_revwalk_odb(const GitRevWalk *walk);
+
+// Next commit newest-first by committer date. The returned object must be
+// released with git_object_free(). Returns 1 for a commit, 0 when history
+// is exhausted and -1 once a commit in it could not be read, after which
+// the caller should fall back to git log.
+int git_revwalk_next(GitRevWalk *walk, GitObject *commit, GitCommitInfo *info);
+
+void git_revwalk_free(GitRevWalk *walk);
+
+#endif // GIT_ODB_H
@@ -0,0 +1,61 @@
+#ifndef GIT_PATCH_H
+#define GIT_PATCH_H
+
+#include "common.h"
+#include "git_jobs.h"
+
+// One line of a unified diff. Hunks are introduced by a '@' entry whose
+// old_line/new_line hold the hunk start; counts are derived from the lines.
+typedef struct {
+  char type;        // ' ' context, '+' added, '-' removed, '@' hunk header
+  int old_line;     // 1-based line on the old side, 0 when absent
+  int new_line;     // 1-based line on the new side, 0 when absent
+  int selected;     // Marked for the next stage/unstage batch
+  int no_eol;       // Last line of its side(s), without a newline after it
+  const char *text; // Content after the type column, not owned
+} GitDiffLine;
+
+// Patch text built in memory
+typedef struct {
+  char *data;
+  size_t len;
+  size_t capacity;
+} GitPatch;
+
+void git_patch_init(GitPatch *patch);
+void git_patch_free(GitPatch *patch);
+
+// Append a file section with the hunks in lines. new_file_mode is the git
+// mode (0100644, 0100755 or 0120000) of a file the index does not have
+// yet, or 0 for a tracked file. Returns the number of hunks written, or -1 when out
+// of memory.
+int git_patch_add_file(GitPatch *patch, const char *path,
+                       unsigned new_file_mode, const GitDiffLine *lines,
+                       int count);
+
+// Queue a single `git apply --cached` of the patch on the git job queue.
+// on_done (may be NULL) runs once git has finished, with exit_status 0
+// when it accepted every section. Returns 0 when nothing was queued.
+int git_patch_queue_apply_cached(const GitPatch *patch, GitJobCallback on_done,
+                                 void *ctx);
+
+// Patch against the old side of diff that applies only its selected
+// changes. With reverse the diff is read new-to-old, so the patch applies
+// to the new side and undoes the selected changes. Returns the line count
+// written to out, or -1 when max is too small.
+int git_diff_select(const GitDiffLine *diff, int count, int reverse,
+                    GitDiffLine *out, int max);
+
+// Combine a (X -> Y) and b (Y -> Z) into X -> Z with up to context lines
+// around each change. Either side can be read reversed. Selection marks
+// follow the changes they were set on. Returns the line count written to
+// out, or -1 when max is too small or memory runs out.
+int git_diff_compose(const GitDiffLine *a, int a_count, int a_reverse,
+                     const GitDiffLine *b, int b_count, int b_reverse,
+                     int context, GitDiffLine *out, int max);
+
+// "@@ -a,b +c,d @@" for the hunk header at lines[header]
+void git_diff_format_hunk(const GitDiffLine *lines, int count, int header,
+                          char *buf, size_t size);
+
+#endif // GIT_PATCH_H
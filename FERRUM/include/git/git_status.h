@@ -0,0 +1,44 @@
+#ifndef GIT_STATUS_H
+#define GIT_STATUS_H
+
+#include "common.h"
+
+#define GIT_STATUS_NO_PATH ((size_t)-1)
+
+typedef struct {
+  char index_status;    // X column, ' ' when the index matches HEAD
+  char worktree_status; // Y column, ' ' when the worktree matches the index
+  size_t path;          // Offset of the path in GitStatus.names
+  size_t orig_path;     // Rename/copy source, or GIT_STATUS_NO_PATH
+} GitStatusEntry;
+
+typedef struct {
+  GitStatusEntry *entries;
+  int count;
+  size_t capacity;
+  char *names; // NUL-terminated paths, referenced by offset
+  size_t names_len;
+  size_t names_capacity;
+
+  // Parser state for records split across reads
+  char *partial;
+  size_t partial_len;
+  size_t partial_capacity;
+  int expect_orig_path; // The next record is the source of a rename
+} GitStatus;
+
+void git_status_init(GitStatus *status);
+void git_status_free(GitStatus *status);
+
+// Feed raw `git status --porcelain=v2 -z` output in chunks of any size.
+// Returns 0 when out of memory.
+int git_status_feed(GitStatus *status, const char *data, size_t len);
+
+// Run git status in the current directory and parse it as it streams in.
+// Returns 1 on success.
+int git_status_read(GitStatus *status);
+
+// Path stored at offset, NULL for GIT_STATUS_NO_PATH
+const char *git_status_path(const GitStatus *status, size_t offset);
+
+#endif // GIT_STATUS_H
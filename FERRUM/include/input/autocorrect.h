@@ -6,7 +6,9 @@
 #include "line_reader.h"
 #include <limits.h>
 
-int levenshtein_distance(const char *s1, const char *s2);
+// Edit distance between s1 and s2, or max + 1 as soon as it is known to be
+// larger than max
+int levenshtein_distance(const char *s1, const char *s2, int max);
 
 int min3(int a, int b, int c);
 
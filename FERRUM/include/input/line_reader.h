@@ -8,6 +8,9 @@ int is_valid_command(const char *cmd);
 
 int read_key(void);
 
+// Is a key typed but not yet read, including one read_key has buffered?
+int key_pending(void);
+
 char *lsh_read_line(void);
 
 void generate_enhanced_prompt(char *prompt_buffer, size_t buffer_size);
@@ -0,0 +1,35 @@
+#ifndef LINE_RENDERER_H
+#define LINE_RENDERER_H
+
+#include <stddef.h>
+
+// What the line editor last put on the screen: the prompt, the typed text
+// and a dim suggestion after it, with the cursor at the end of the text.
+// Each frame is compared with it and only the difference is sent.
+typedef struct {
+  int columns; // Terminal width, read at the prompt and when it is resized
+  int prompt_width;
+  int cursor_row; // Rows the cursor is below the prompt's first row
+  char *text;
+  size_t text_cap;
+  char *suggestion;
+  size_t suggestion_cap;
+  char *frame; // Escape sequences for the frame being built
+  size_t frame_len;
+  size_t frame_cap;
+} LineRenderer;
+
+// Start a new line by printing prompt, with nothing typed after it yet
+void line_render_begin(LineRenderer *screen, const char *prompt);
+
+// Bring the screen to text followed by suggestion (NULL for none) with one
+// write, or none when nothing changed. Newlines in either show as ↵.
+void line_render(LineRenderer *screen, const char *text,
+                 const char *suggestion);
+
+// Read the terminal width again after it was resized
+void line_render_resize(LineRenderer *screen);
+
+void line_render_free(LineRenderer *screen);
+
+#endif // LINE_RENDERER_H
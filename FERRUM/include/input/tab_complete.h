@@ -31,15 +31,6 @@ typedef enum {
   ARG_TYPE_COMMAND,
 } ArgumentType;
 
-typedef struct {
-  char *command;         // Command name
-  ArgumentType arg_type; // Expected argument type
-  char *description;     // Optional description
-  int strict_match;      // If 1, only show suggestions of the expected type
-                    // If 0, show suggestions of expected type but also allow
-                    // other matches
-} CommandArgInfo;
-
 typedef struct {
   char **items;      // Array of suggestion strings
   int count;         // Number of suggestions
@@ -0,0 +1,76 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "common.h"
+#include <spawn.h>
+
+#define STAGE_CHANNEL_BYTES (1 << 20) // Most a channel holds before blocking
+
+// Byte stream between pipeline stages. Builtins that can run inside a
+// pipeline read and write through these instead of stdin and stdout. Two
+// builtins next to each other are joined by an in-memory channel, which
+// hands whole buffers from one thread to the other; anything else is a
+// file descriptor.
+typedef struct StageStream StageStream;
+
+// A builtin pipeline stage. in is NULL when nothing is piped into it.
+typedef int (*StageFunc)(char **args, StageStream *in, StageStream *out);
+
+// Stream over fd, closed with the stream when owned is set
+StageStream *stage_fd_stream(int fd, int writing, int owned);
+
+// Connected writer and reader ends of an in-memory channel. The writer
+// blocks while the reader is more than STAGE_CHANNEL_BYTES behind.
+int stage_channel(StageStream **writer, StageStream **reader);
+
+// Flush and close one end. Closing the reader makes later writes fail.
+void stage_close(StageStream *stream);
+
+// Is the other end a terminal, so colors are wanted?
+int stage_is_terminal(const StageStream *stream);
+
+// Writes return 0 once the reader has gone away or the write failed
+int stage_write(StageStream *out, const void *data, size_t len);
+int stage_printf(StageStream *out, const char *format, ...)
+    __attribute__((format(printf, 2, 3)));
+
+// Pass a malloc'd buffer on without copying it. The stream frees it.
+int stage_give(StageStream *out, char *buffer, size_t len);
+
+// Length of the next line without its newline. It is not NUL-terminated
+// and points into the stream's buffer until the next read. Returns -1 at
+// the end of input.
+ssize_t stage_read_line(StageStream *in, const char **line);
+
+// Next block of input as a malloc'd buffer the caller owns, for passing
+// through with stage_give. Returns 0 at the end of input.
+size_t stage_take(StageStream *in, char **buffer);
+
+// Send the rest of fd to out, inside the kernel when out is a descriptor.
+// Returns 1 once all of it is sent, 0 when out takes no more and -1 when
+// reading fd failed, with errno set.
+int stage_send_fd(StageStream *out, int fd);
+
+// Descriptor in reads from when nothing of it is buffered yet, or -1
+int stage_input_fd(const StageStream *in);
+
+// Run a stage outside a pipeline, writing to standard output
+int stage_run(StageFunc stage, char **args);
+
+// Start args[0] through the PATH cache without copying the shell's address
+// space. Returns 0 or an errno value.
+int spawn_command(pid_t *pid, char **args,
+                  const posix_spawn_file_actions_t *actions);
+
+// Run the commands of a pipeline. Builtins with a stage run on threads in
+// the shell; the rest are spawned.
+int run_pipeline(char ***commands);
+
+// Exit status of the last command or pipeline, as $? would report it.
+// Builtins count as having succeeded.
+extern int last_exit_status;
+
+// Exit status for a status filled in by waitpid
+int wait_exit_status(int status);
+
+#endif // PIPELINE_H
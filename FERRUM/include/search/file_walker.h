@@ -0,0 +1,20 @@
+#ifndef FILE_WALKER_H
+#define FILE_WALKER_H
+
+#include <stddef.h>
+
+// Called on a worker thread for each file found, with that worker's state
+typedef void (*WalkFileFunc)(const char *path, void *state);
+
+// Visit every file under root on thread_count threads. Hidden entries are
+// skipped, as is whatever .gitignore files inside root exclude; symlinks
+// to files are followed but symlinks to directories are not. states holds
+// thread_count objects of state_size bytes, one for each worker to gather
+// its results in. Returns 0 when root cannot be read.
+int walk_files(const char *root, int thread_count, WalkFileFunc visit,
+               void *states, size_t state_size);
+
+// Workers worth starting on this machine
+int walk_thread_count(void);
+
+#endif // FILE_WALKER_H
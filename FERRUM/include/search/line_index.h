@@ -0,0 +1,32 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <stddef.h>
+
+// Where the lines of a text start, found on a background thread so that a
+// pager can show the start of a huge file at once. Every few lines the
+// offset is recorded; the lines in between are found again when asked for.
+typedef struct LineIndex LineIndex;
+
+// Start indexing the first size bytes of the file open as fd, which text
+// maps. The thread reads fd rather than the mapping, so a file cut short
+// under it ends the index early instead of faulting. Both must stay open
+// until the index is stopped. NULL when the thread cannot be started.
+LineIndex *line_index_start(int fd, const char *text, size_t size);
+
+// Stop the thread, if it is still going, and free the index
+void line_index_stop(LineIndex *index);
+
+// Lines whose start has been found, and how many bytes have been read to
+// find them. Returns 1 once the whole text is indexed.
+int line_index_progress(LineIndex *index, size_t *lines, size_t *scanned);
+
+// Offset where line starts, counting from 0. The line must be one of those
+// line_index_progress reported.
+size_t line_index_offset(LineIndex *index, size_t line);
+
+// Line that offset is in, counting from 0. The offset must be before the
+// scanned bytes line_index_progress reported.
+size_t line_index_line_at(LineIndex *index, size_t offset);
+
+#endif // LINE_INDEX_H
@@ -13,13 +13,13 @@ int lsh_execute_piped(char ***commands);
 
 TableData* create_ls_table(char **args);
 
-char*** lsh_split_commands(char *line);
-
 int lsh_launch(char **args);
 
 void lsh_loop(void);
 
-void free_commands(char ***commands);
+// Parse and run a whole command line: pipelines joined by '|', '&&',
+// '||', ';' or newlines. Returns 0 when the shell should exit.
+int lsh_run_line(const char *line);
 
 int init_status_bar(int fd);
 
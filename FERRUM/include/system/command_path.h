@@ -0,0 +1,19 @@
+#ifndef COMMAND_PATH_H
+#define COMMAND_PATH_H
+
+#include <stddef.h>
+
+// Cached PATH lookup for launching external commands. Results, including
+// misses, are kept until PATH changes or one of its directories is
+// modified; directories are re-checked at most once a second. Only the
+// shell's main thread uses it.
+
+// Write the file name would run as to out. Names containing a slash are
+// used as given. Returns 0 when no directory in PATH has an executable of
+// that name.
+int command_path_resolve(const char *name, char *out, size_t size);
+
+// Drop every cached result, e.g. after a cached executable has gone away
+void command_path_clear(void);
+
+#endif // COMMAND_PATH_H
@@ -0,0 +1,39 @@
+#ifndef DIR_CACHE_H
+#define DIR_CACHE_H
+
+// Directory listings for completion, kept for the most recently used
+// directories. A listing is reused while the directory's device, inode and
+// mtime are unchanged. Directories used repeatedly are also watched with
+// inotify, and while the watch reports no change they are reused without
+// touching the file system at all. Only the shell's main thread uses it.
+
+typedef struct {
+  const char *name;
+  unsigned char type; // DT_* of what it names, after following symlinks;
+                      // DT_UNKNOWN when that cannot be read
+} DirEntry;
+
+// Entries of dir other than . and .., sorted ignoring case, or NULL when
+// it cannot be read. Valid until the next call.
+const DirEntry *dir_cache_list(const char *dir, int *count);
+
+// Entries [*first, return value) are those whose names start with prefix,
+// ignoring case
+int dir_cache_prefix(const DirEntry *entries, int count, const char *prefix,
+                     int *first);
+
+// Number that changes whenever the directory that entries (as returned by
+// dir_cache_list) came from is read again, so anything built from its
+// listing can tell it may be out of date. Listings of other directories do
+// not move it.
+unsigned long dir_cache_generation(const DirEntry *entries);
+
+// Called at each prompt: relative directories are looked up under cwd
+// (NULL when unknown), and changes reported since the last prompt are
+// applied
+void dir_cache_begin(const char *cwd);
+
+// Drop every listing and watch
+void dir_cache_clear(void);
+
+#endif // DIR_CACHE_H
@@ -0,0 +1,15 @@
+#ifndef FILE_COPY_H
+#define FILE_COPY_H
+
+// Copy source to dest, or into dest when it is a directory. Contents are
+// shared with a reflink where the filesystem allows, and otherwise copied
+// inside the kernel. Mode, ownership and times go with them. Directories
+// are copied only when recursive is set, their files on several threads.
+// What fails is reported; returns 1 when everything was copied.
+int copy_path(const char *source, const char *dest, int recursive);
+
+// Rename source to dest, or into dest when it is a directory. Across
+// filesystems it is copied and then removed. Returns 1 on success.
+int move_path(const char *source, const char *dest);
+
+#endif // FILE_COPY_H
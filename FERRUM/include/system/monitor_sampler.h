@@ -0,0 +1,48 @@
+#ifndef MONITOR_SAMPLER_H
+#define MONITOR_SAMPLER_H
+
+#include "system_monitor.h"
+
+#define MONITOR_HISTORY 120 // Samples kept for the sparklines
+
+typedef enum {
+  MONITOR_CPU,        // Percent
+  MONITOR_MEM,        // Percent
+  MONITOR_DISK_READ,  // Bytes per second
+  MONITOR_DISK_WRITE, // Bytes per second
+  MONITOR_NET_RX,     // Bytes per second
+  MONITOR_NET_TX,     // Bytes per second
+  MONITOR_SERIES
+} MonitorSeries;
+
+// One sample as published by the sampler thread. Nothing writes to it after
+// it is published; whoever takes it owns it.
+typedef struct MonitorSnapshot {
+  SystemStats stats;
+  ProcessInfo *processes; // Every live process, unsorted
+  int process_count;
+  float history[MONITOR_SERIES][MONITOR_HISTORY]; // Oldest first
+  int history_len;
+  unsigned long sequence;
+} MonitorSnapshot;
+
+// Samples system and process stats on a background thread every
+// refresh_rate seconds, so reading /proc and probing the GPU never block
+// the dashboard.
+typedef struct MonitorSampler MonitorSampler;
+
+MonitorSampler *monitor_sampler_start(int refresh_rate);
+
+// Stop the thread, waiting for a sample in progress to finish
+void monitor_sampler_stop(MonitorSampler *sampler);
+
+// Take a sample now instead of at the next interval
+void monitor_sampler_wake(MonitorSampler *sampler);
+
+// Newest snapshot published since the last call, or NULL. The caller frees
+// it with monitor_snapshot_free.
+MonitorSnapshot *monitor_sampler_take(MonitorSampler *sampler);
+
+void monitor_snapshot_free(MonitorSnapshot *snapshot);
+
+#endif // MONITOR_SAMPLER_H
@@ -0,0 +1,37 @@
+#ifndef PROC_SAMPLER_H
+#define PROC_SAMPLER_H
+
+#include "system_monitor.h"
+
+// Fields of /proc/<pid>/stat
+typedef struct {
+  char name[256];
+  char state;
+  int threads;
+  unsigned long long cpu_ticks;  // utime + stime
+  unsigned long long start_time; // Clock ticks after boot
+  unsigned long rss_pages;
+} ProcStat;
+
+// Parse the contents of /proc/<pid>/stat. Returns 0 when it is malformed.
+int proc_parse_stat(const char *buffer, ProcStat *stat);
+
+// Per-process sampler. Keeps /proc/<pid>/stat open for every process it
+// has seen and re-reads it with pread, so CPU usage comes from the change
+// in utime + stime between two samples.
+typedef struct ProcSampler ProcSampler;
+
+ProcSampler *proc_sampler_create(void);
+
+// Close every descriptor and restore the file limit raised at creation
+void proc_sampler_destroy(ProcSampler *sampler);
+
+// Sample every process. Exited processes are dropped. Returns the number
+// of live processes, or -1 when /proc cannot be read.
+int proc_sampler_update(ProcSampler *sampler);
+
+// Copy up to max processes from the last sample, in table order
+int proc_sampler_snapshot(const ProcSampler *sampler, ProcessInfo *out,
+                          int max);
+
+#endif // PROC_SAMPLER_H
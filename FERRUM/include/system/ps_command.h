@@ -0,0 +1,34 @@
+#ifndef PS_COMMAND_H
+#define PS_COMMAND_H
+
+#include "structured_data.h"
+
+// Columns of the process table, in table order
+typedef enum {
+  PS_PID = 1 << 0,
+  PS_NAME = 1 << 1,
+  PS_USER = 1 << 2,
+  PS_CPU = 1 << 3,     // Average over the process lifetime, like ps
+  PS_MEMORY = 1 << 4,  // Resident set size
+  PS_STATE = 1 << 5,
+  PS_THREADS = 1 << 6,
+  PS_STARTED = 1 << 7,
+  PS_COMMAND = 1 << 8, // Full command line, only read when asked for
+} PsColumn;
+
+#define PS_DEFAULT_COLUMNS                                                    \
+  (PS_PID | PS_NAME | PS_USER | PS_CPU | PS_MEMORY | PS_STATE | PS_THREADS |  \
+   PS_STARTED)
+
+// Build the process table from /proc with only the given columns. Large
+// process counts are read on several threads.
+TableData *ps_table(unsigned columns);
+
+// Columns a `ps | ...` pipeline needs: the ones its filters name, and the
+// default columns unless a select narrows the output
+unsigned ps_pipeline_columns(char ***commands);
+
+TableData *lsh_ps_structured(char **args);
+int lsh_ps_fancy(char **args);
+
+#endif // PS_COMMAND_H
@@ -29,6 +29,60 @@ typedef struct {
   int process_count;
 } SystemStats;
 
+#define PROCESS_HISTORY 32 // CPU samples kept per process
+
+typedef struct {
+  int pid;
+  char name[256];
+  float cpu_percent;
+  unsigned long memory;
+  char state;
+  float cpu_history[PROCESS_HISTORY]; // Oldest first
+  int history_len;
+} ProcessInfo;
+
+typedef enum {
+  SORT_CPU,    // Busiest first
+  SORT_MEMORY, // Largest first
+  SORT_PID,
+  SORT_NAME,
+  SORT_KEYS
+} ProcessSortKey;
+
+// Rows of a process table that match a search, as indices into it. Only
+// the rows asked for by process_view_order are sorted.
+typedef struct {
+  int *rows;
+  int count;
+  size_t capacity;
+
+  // What the rows were built from, so a longer query can narrow them
+  unsigned long sequence;
+  char query[256];
+
+  // Range left sorted by the last process_view_order
+  ProcessSortKey ordered_key;
+  int ordered_first;
+  int ordered_last;
+} ProcessView;
+
+void process_view_init(ProcessView *view);
+void process_view_free(ProcessView *view);
+
+// Keep the processes whose name contains query, ignoring case. sequence
+// identifies the table; filtering the same table again with a query that
+// contains the previous one only rechecks the rows that matched before.
+// Returns 0 when out of memory.
+int process_view_filter(ProcessView *view, const ProcessInfo *processes,
+                        int count, unsigned long sequence, const char *query);
+
+// Put the rows that belong at positions [first, last) in sorted order
+// there, leaving the rest unsorted on either side
+void process_view_order(ProcessView *view, const ProcessInfo *processes,
+                        ProcessSortKey key, int first, int last);
+
+const char *process_sort_name(ProcessSortKey key);
+
 typedef struct {
   WINDOW *main_win;
   WINDOW *header_win;
@@ -44,23 +98,32 @@ typedef struct {
   int search_mode;
   char search_buffer[256];
   int search_cursor;
+  ProcessSortKey sort_key;
+  ProcessView view; // Filtered and ordered rows of the current snapshot
+
+  // What is on screen, so frames where nothing changed draw nothing
+  int drawn_valid; // 0 repaints everything
+  unsigned long drawn_sequence;
+  time_t drawn_clock;
+  int drawn_selected;
+  int drawn_scroll;
+  ProcessSortKey drawn_sort;
+  int drawn_search_mode;
+  int drawn_search_cursor;
+  char drawn_search[256];
+  char **drawn_rows; // Process list lines as last drawn
+  int drawn_row_count;
+
   volatile sig_atomic_t resize_flag;
 } NCursesMonitor;
 
-typedef struct {
-  int pid;
-  char name[256];
-  float cpu_percent;
-  unsigned long memory;
-  char state;
-} ProcessInfo;
+struct MonitorSnapshot;
 
 int init_ncurses_monitor(NCursesMonitor *monitor);
 int builtin_monitor(char **args);
 void display_dashboard(SystemStats *stats, ProcessInfo *processes,
                        int proc_count);
 void get_system_stats(SystemStats *stats);
-int get_process_info(ProcessInfo *processes, int max_processes);
 void clear_screen(void);
 void move_cursor(int row, int col);
 void hide_cursor(void);
@@ -70,8 +133,8 @@ void draw_progress_bar(int percentage, int width);
 void format_progress_bar(int percentage, int width, char *buffer);
 void format_bytes(unsigned long bytes, char *buffer);
 void cleanup_ncurses_monitor(NCursesMonitor *monitor);
-void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
-                               ProcessInfo *processes, int proc_count);
+void display_ncurses_dashboard(NCursesMonitor *monitor,
+                               const struct MonitorSnapshot *snapshot);
 void handle_monitor_input(NCursesMonitor *monitor, int ch);
 
 #endif
@@ -4,27 +4,40 @@
 #include "common.h"
 #include <ncurses.h>
 
-#define MAX_FILES 100
-#define MAX_FILENAME_LEN 256
 #define MAX_FULL_FILE_LINES 10000
 #define MAX_COMMITS 1000
+#define COMMIT_PAGE_SIZE 200     // Commits fetched per git log page
+#define COMMIT_PAGE_PREFETCH 20  // Load the next page this close to the end
 #define MAX_COMMIT_TITLE_LEN 256
 #define MAX_AUTHOR_INITIALS 3
 #define MAX_STASHES 100
-#define MAX_BRANCHES 5
 #define MAX_BRANCHNAME_LEN 256
+#define VIEWER_FRAME_MS 20 // Animation counters advance once per frame
+
+// Data reloaded once the git job queue drains
+#define VIEWER_REFRESH_FILES 0x1
+#define VIEWER_REFRESH_COMMITS 0x2
+#define VIEWER_REFRESH_BRANCHES 0x4
+#define VIEWER_REFRESH_STASHES 0x8
+#define VIEWER_REFRESH_ALL 0xf
 
 typedef struct {
   char stash_info[512];
 } NCursesStash;
 
 typedef struct {
-  char filename[MAX_FILENAME_LEN];
+  char *filename;        // Points into the viewer's file name pool
+  char *orig_filename;   // Source of a rename or copy, NULL otherwise
   char status;           // 'M' = modified, 'A' = added, 'D' = deleted
   int marked_for_commit; // 1 if marked for commit, 0 otherwise
   int has_staged_changes;
 } NCursesChangedFile;
 
+typedef struct {
+  int file_index;
+  int score;
+} NCursesScoredFile;
+
 typedef struct {
   char name[MAX_BRANCHNAME_LEN];
   int status;
@@ -37,10 +50,12 @@ typedef struct {
   char type; // '+' = addition, '-' = deletion, ' ' = context, '@' = hunk header
   int is_diff_line; // 1 if this is a diff line, 0 if original file line
   int hunk_id;
-  int is_staged;
+  int is_staged; // Unstaged pane: marked to stage; staged pane: cleared when
+                 // marked to unstage
   int line_number_old;
   int line_number_new;
   int is_context;
+  int no_eol; // Git printed "\ No newline at end of file" after it
 } NCursesFileLine;
 
 typedef struct {
@@ -84,9 +99,11 @@ typedef enum {
 } SyncStatus;
 
 typedef struct {
-  NCursesChangedFile files[MAX_FILES];
+  NCursesChangedFile *files; // Sorted by path
   int file_count;
+  char *file_names; // Pool the file entries point into
   int selected_file;
+  int file_list_scroll_offset;
   NCursesFileLine file_lines[MAX_FULL_FILE_LINES];
   int file_line_count;
   int file_scroll_offset;
@@ -96,13 +113,22 @@ typedef struct {
   int commit_capacity;
   int selected_commit;
   int commit_scroll_offset;
+  char commit_head_oid[41];     // HEAD the loaded commit pages belong to
+  char commit_upstream_oid[41]; // Remote tip used for pushed status
+  char (*commit_unpushed)[41];  // Sorted ids in HEAD but not the remote tip
+  int commit_unpushed_count;
+  int commit_unpushed_capacity;
+  int commit_history_complete;  // 1 once git log ran out of commits
+  struct GitRevWalk *commit_walk; // Native history walk feeding the pages
   NCursesStash stashes[MAX_STASHES];
-  NCursesBranches branches[MAX_BRANCHES];
+  NCursesBranches *branches;
   int stash_count;
   int branch_count;
+  int branch_capacity;
   int selected_stash;
   int stash_scroll_offset;
   int selected_branch;
+  int branch_scroll_offset;
   WINDOW *file_list_win;
   WINDOW *file_content_win;
   WINDOW *commit_list_win;
@@ -131,9 +157,10 @@ typedef struct {
   int branch_text_char_count;
   int critical_operation_in_progress; // Prevent fetching during critical ops
 
-  // Background fetch management
-  pid_t fetch_pid;       // Process ID of background fetch
+  // Background git jobs
   int fetch_in_progress; // Flag to track if fetch is running
+  int pending_refresh;   // VIEWER_REFRESH_* flags waiting for idle jobs
+  char select_branch_after_refresh[MAX_BRANCHNAME_LEN]; // Empty for none
 
   // Branch-specific commits for hover functionality
   char branch_commits[MAX_COMMITS][2048]; // Larger buffer for formatted commits
@@ -146,6 +173,7 @@ typedef struct {
   int staged_scroll_offset;    // Scroll position for staged pane
   int active_pane;             // 0 = unstaged, 1 = staged
   char current_file_path[512]; // Path of currently viewed file
+  int current_file_is_new;     // Untracked when loaded; staging creates it
   int total_hunks;             // Total number of hunks in current file
   NCursesFileLine
       staged_lines[MAX_FULL_FILE_LINES]; // Separate storage for staged content
@@ -158,10 +186,8 @@ typedef struct {
   int fuzzy_search_query_len;   // Length of current query
 
   // Scored search results
-  struct {
-    int file_index;
-    int score;
-  } fuzzy_scored_files[MAX_FILES]; // Scored and sorted results
+  NCursesScoredFile *fuzzy_scored_files; // Scored and sorted results
+  int fuzzy_scored_capacity;
 
   int fuzzy_filtered_count; // Number of filtered files
   int fuzzy_selected_index; // Currently selected in fuzzy list
@@ -213,6 +239,8 @@ int init_ncurses_diff_viewer(NCursesDiffViewer *viewer);
 
 int get_ncurses_changed_files(NCursesDiffViewer *viewer);
 
+int find_changed_file(const NCursesDiffViewer *viewer, const char *path);
+
 int load_full_file_with_diff(NCursesDiffViewer *viewer, const char *filename);
 
 void render_file_list_window(NCursesDiffViewer *viewer);
@@ -231,6 +259,10 @@ int create_temp_file_git_version(const char *filename, char *temp_path);
 
 int get_commit_history(NCursesDiffViewer *viewer);
 
+int load_more_commits(NCursesDiffViewer *viewer);
+
+void ensure_commit_loaded(NCursesDiffViewer *viewer, int commit_index);
+
 void toggle_file_mark(NCursesDiffViewer *viewer, int file_index);
 
 void mark_all_files(NCursesDiffViewer *viewer);
@@ -268,12 +300,13 @@ typedef enum {
 
 int get_branch_name_input(char *branch_name, int max_len);
 
-int create_git_branch(const char *branch_name);
+int create_git_branch(NCursesDiffViewer *viewer, const char *branch_name);
 
 int get_rename_branch_input(const char *current_name, char *new_name,
                             int max_len);
 
-int rename_git_branch(const char *old_name, const char *new_name);
+int rename_git_branch(NCursesDiffViewer *viewer, const char *old_name,
+                      const char *new_name);
 
 int show_delete_branch_dialog(const char *branch_name);
 
@@ -288,7 +321,8 @@ int get_current_branch_name(char *branch_name, int max_len);
 
 int branch_has_upstream(const char *branch_name);
 
-int delete_git_branch(const char *branch_name, DeleteBranchOption option);
+int delete_git_branch(NCursesDiffViewer *viewer, const char *branch_name,
+                      DeleteBranchOption option);
 
 int create_ncurses_git_stash(NCursesDiffViewer *viewer);
 
@@ -306,7 +340,9 @@ int parse_branch_commits_to_lines(NCursesDiffViewer *viewer);
 
 void start_background_fetch(NCursesDiffViewer *viewer);
 
-void check_background_fetch(NCursesDiffViewer *viewer);
+void request_viewer_refresh(NCursesDiffViewer *viewer, int flags);
+
+void apply_pending_refresh(NCursesDiffViewer *viewer);
 
 void move_cursor_smart(NCursesDiffViewer *viewer, int direction);
 
@@ -340,8 +376,6 @@ int stage_hunk_by_line(NCursesDiffViewer *viewer, int line_index);
 int load_file_with_staging_info(NCursesDiffViewer *viewer,
                                 const char *filename);
 
-void rebuild_staged_view(NCursesDiffViewer *viewer);
-
 int apply_staged_changes(NCursesDiffViewer *viewer);
 
 int reset_staged_changes(NCursesDiffViewer *viewer);
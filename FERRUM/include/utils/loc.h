@@ -0,0 +1,11 @@
+#ifndef LOC_H
+#define LOC_H
+
+#include "structured_data.h"
+
+// Lines of code under args[1], a directory or a file, one row per
+// language: Language, Files, Lines, Code, Comments and Blanks. Directories
+// are walked in parallel, leaving out hidden and .gitignore'd files.
+TableData *loc_table(char **args);
+
+#endif // LOC_H
@@ -1,13 +1,16 @@
-
+#define _GNU_SOURCE
 #include "builtins.h"
+#include "command_registry.h"
 #include "common.h"
 #include "diff_viewer.h"
+#include "file_copy.h"
 #include "ncurses_diff_viewer.h"
 #include "filters.h"
 #include "fzf_native.h"
 #include "git_integration.h"
 #include "grep.h"
 #include "persistent_history.h"
+#include "ps_command.h"
 #include "structured_data.h"
 #include "themes.h"
 #include <ctype.h>
@@ -28,33 +31,6 @@ HistoryEntry command_history[HISTORY_SIZE];
 int history_count = 0;
 int history_index = 0;
 
-// String array of built-in command names
-char *builtin_str[] = {
-    "cd",       "help",      "exit",      "dir",        "clear",
-    "mkdir",    "rmdir",     "del",       "touch",      "pwd",
-    "cat",      "history",   "copy",      "move",       "paste",
-    "ps",       "news",      "alias",     "unalias",    "aliases",
-    "bookmark", "bookmarks", "goto",      "unbookmark", "focus_timer",
-    "weather",  "grep",      "grep-text", "ripgrep",    "fzf",
-    "clip",     "echo",      "theme",     "loc",        "git_status",
-    "gg",       "ls",        "stats",     "monitor",
-};
-
-// Array of function pointers to built-in command implementations
-int (*builtin_func[])(char **) = {
-    &lsh_cd,          &lsh_help,       &lsh_exit,       &lsh_dir,
-    &lsh_clear,       &lsh_mkdir,      &lsh_rmdir,      &lsh_del,
-    &lsh_touch,       &lsh_pwd,        &lsh_cat,        &lsh_history,
-    &lsh_copy,        &lsh_move,       &lsh_paste,      &lsh_ps,
-    &lsh_news,        &lsh_alias,      &lsh_unalias,    &lsh_aliases,
-    &lsh_bookmark,    &lsh_bookmarks,  &lsh_goto,       &lsh_unbookmark,
-    &lsh_focus_timer, &lsh_weather,    &lsh_grep,       &lsh_actual_grep,
-    &lsh_ripgrep,     &lsh_fzf_native, &lsh_clip,       &lsh_echo,
-    &lsh_theme,       &lsh_loc,        &lsh_git_status, &lsh_gg,
-    lsh_dir,
-    &lsh_stats,       &builtin_monitor,
-};
-
 void set_color(int color) {
   switch (color) {
   case 0:
@@ -88,8 +64,6 @@ void set_color(int color) {
 
 void reset_color() { printf(ANSI_COLOR_RESET); }
 
-int lsh_num_builtins() { return sizeof(builtin_str) / sizeof(char *); }
-
 void lsh_add_to_history(const char *command) {
   // Don't add empty commands or duplicates of the last command
   if (!command || *command == '\0' ||
@@ -142,8 +116,14 @@ int lsh_help(char **args) {
       printf("  cd <dir>    - change to specified directory\n");
     } else if (strcmp(args[1], "cat") == 0) {
       printf("cat - Display file contents\n");
-      printf("Usage: cat <file>\n");
-      printf("  Displays the contents of the specified file\n");
+      printf("Usage: cat <file>...\n");
+      printf("  Displays the contents of the specified files, one after another\n");
+    } else if (strcmp(args[1], "page") == 0) {
+      printf("page - View a file a screen at a time\n");
+      printf("Usage: page <file>\n");
+      printf("  Shows the file at once while its lines are counted in the background\n");
+      printf("  j/k or arrows scroll, space/b page, g/G top/bottom, Ng line N, N%% percent\n");
+      printf("  /text and ?text search forward and backward, n/N repeat, q quits\n");
     } else if (strcmp(args[1], "grep") == 0) {
       printf("grep - Search for text patterns in files\n");
       printf("Usage: grep <pattern> <file>\n");
@@ -202,13 +182,15 @@ int lsh_help(char **args) {
       printf("Usage: history\n");
       printf("  Displays the list of previously executed commands with timestamps\n");
     } else if (strcmp(args[1], "copy") == 0) {
-      printf("copy - Copy file\n");
-      printf("Usage: copy <source> <destination>\n");
-      printf("  Copies a file from source to destination\n");
+      printf("copy - Copy files and directories\n");
+      printf("Usage: copy [-r] <source> <destination>\n");
+      printf("  Copies a file from source to destination, keeping its mode and times\n");
+      printf("  -r copies a directory and everything in it\n");
     } else if (strcmp(args[1], "move") == 0) {
       printf("move - Move/rename file\n");
       printf("Usage: move <source> <destination>\n");
       printf("  Moves or renames a file from source to destination\n");
+      printf("  Across filesystems it is copied, then the original removed\n");
     } else if (strcmp(args[1], "clear") == 0) {
       printf("clear - Clear screen\n");
       printf("Usage: clear\n");
@@ -235,8 +217,10 @@ int lsh_help(char **args) {
       printf("  Changes the visual appearance of the shell\n");
     } else if (strcmp(args[1], "loc") == 0) {
       printf("loc - Count lines of code\n");
-      printf("Usage: loc <file>\n");
+      printf("Usage: loc <file|directory>\n");
       printf("  Counts total lines, code lines, comments, and blank lines in a file\n");
+      printf("  A directory is counted per language, as a table that can be\n");
+      printf("  piped into where, sort-by and the other filters\n");
     } else if (strcmp(args[1], "monitor") == 0) {
       printf("monitor - System monitor\n");
       printf("Usage: monitor\n");
@@ -306,6 +290,9 @@ int lsh_help(char **args) {
       printf("paste - Paste clipboard content\n");
       printf("Usage: paste\n");
       printf("  Paste functionality (currently not implemented)\n");
+    } else if (command_lookup(args[1]) != NULL) {
+      // Commands without their own page get their registry description
+      printf("%s - %s\n", args[1], command_lookup(args[1])->help);
     } else {
       printf("No help available for '%s'\n", args[1]);
       printf("Type 'help' to see all available commands\n");
@@ -318,30 +305,18 @@ int lsh_help(char **args) {
   printf("Type a command and press Enter to execute it.\n");
   printf("The following built-in commands are available:\n\n");
 
-  // Sort commands alphabetically
-  char *sorted_commands[lsh_num_builtins()];
-  for (int i = 0; i < lsh_num_builtins(); i++) {
-    sorted_commands[i] = builtin_str[i];
-  }
-
-  for (int i = 0; i < lsh_num_builtins() - 1; i++) {
-    for (int j = i + 1; j < lsh_num_builtins(); j++) {
-      if (strcmp(sorted_commands[i], sorted_commands[j]) > 0) {
-        char *temp = sorted_commands[i];
-        sorted_commands[i] = sorted_commands[j];
-        sorted_commands[j] = temp;
-      }
-    }
-  }
+  // The registry keeps builtins in name order
+  int command_count;
+  const CommandInfo *commands = command_builtins(&command_count);
 
   // Print commands in columns
   int columns = 4;
-  int rows = (lsh_num_builtins() + columns - 1) / columns;
+  int rows = (command_count + columns - 1) / columns;
   for (int i = 0; i < rows; i++) {
     for (int j = 0; j < columns; j++) {
       int index = j * rows + i;
-      if (index < lsh_num_builtins()) {
-        printf("%-15s", sorted_commands[index]);
+      if (index < command_count) {
+        printf("%-15s", commands[index].name);
       }
     }
     printf("\n");
@@ -548,74 +523,93 @@ int lsh_pwd(char **args) {
   return 1;
 }
 
-int lsh_cat(char **args) {
-  if (args[1] == NULL) {
-    fprintf(stderr, "lsh: expected argument to \"cat\"\n");
-    return 1;
+// Copy input to out block by block; piped blocks are handed on uncopied
+static void pass_through(StageStream *in, StageStream *out) {
+  char *buffer;
+  size_t len;
+  while ((len = stage_take(in, &buffer)) > 0) {
+    if (!stage_give(out, buffer, len))
+      break;
   }
+}
 
-  FILE *fp = fopen(args[1], "r");
-  if (fp == NULL) {
-    perror("lsh: cat");
+int lsh_cat_stage(char **args, StageStream *in, StageStream *out) {
+  if (args[1] == NULL) {
+    if (in == NULL) {
+      fprintf(stderr, "lsh: expected argument to \"cat\"\n");
+      return 1;
+    }
+    // A pipe from another process is spliced on without being read here
+    int fd = stage_input_fd(in);
+    if (fd < 0) {
+      pass_through(in, out);
+    } else if (stage_send_fd(out, fd) < 0) {
+      perror("lsh: cat");
+    }
     return 1;
   }
 
-  char buffer[1024];
-  while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-    printf("%s", buffer);
-  }
+  for (int i = 1; args[i] != NULL; i++) {
+    int fd = open(args[i], O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      fprintf(stderr, "lsh: cat: %s: %s\n", args[i], strerror(errno));
+      continue;
+    }
+
+    struct stat st;
+    int sent = 1;
+    if (fstat(fd, &st) == 0 && S_ISDIR(st.st_mode)) {
+      fprintf(stderr, "lsh: cat: %s: %s\n", args[i], strerror(EISDIR));
+    } else if ((sent = stage_send_fd(out, fd)) < 0) {
+      fprintf(stderr, "lsh: cat: %s: %s\n", args[i], strerror(errno));
+    }
+    close(fd);
 
-  fclose(fp);
+    // Nothing more is wanted once the reader has gone
+    if (sent == 0) {
+      break;
+    }
+  }
   return 1;
 }
 
-int lsh_history(char **args) {
+int lsh_cat(char **args) { return stage_run(lsh_cat_stage, args); }
+
+int lsh_history_stage(char **args, StageStream *in, StageStream *out) {
   char time_str[20];
   struct tm *tm_info;
 
-  printf("Command History:\n");
-  printf("----------------\n");
+  stage_printf(out, "Command History:\n");
+  stage_printf(out, "----------------\n");
 
   // Display history in chronological order
   for (int i = 0; i < history_count; i++) {
     int idx = (history_index - history_count + i + HISTORY_SIZE) % HISTORY_SIZE;
     tm_info = localtime(&command_history[idx].timestamp);
     strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", tm_info);
-    printf("%3d: [%s] %s\n", i + 1, time_str, command_history[idx].command);
+    stage_printf(out, "%3d: [%s] %s\n", i + 1, time_str,
+                 command_history[idx].command);
   }
 
   return 1;
 }
 
+int lsh_history(char **args) { return stage_run(lsh_history_stage, args); }
+
 int lsh_copy(char **args) {
-  if (args[1] == NULL || args[2] == NULL) {
+  int recursive = args[1] != NULL && (strcmp(args[1], "-r") == 0 ||
+                                      strcmp(args[1], "-R") == 0 ||
+                                      strcmp(args[1], "--recursive") == 0);
+  char **paths = args + 1 + recursive;
+  if (paths[0] == NULL || paths[1] == NULL) {
     fprintf(stderr,
             "lsh: expected source and destination arguments to \"copy\"\n");
     return 1;
   }
 
-  FILE *source = fopen(args[1], "rb");
-  if (source == NULL) {
-    perror("lsh: copy (source)");
-    return 1;
+  if (copy_path(paths[0], paths[1], recursive)) {
+    printf("Copied %s to %s\n", paths[0], paths[1]);
   }
-
-  FILE *dest = fopen(args[2], "wb");
-  if (dest == NULL) {
-    fclose(source);
-    perror("lsh: copy (destination)");
-    return 1;
-  }
-
-  char buffer[4096];
-  size_t bytes_read;
-  while ((bytes_read = fread(buffer, 1, sizeof(buffer), source)) > 0) {
-    fwrite(buffer, 1, bytes_read, dest);
-  }
-
-  fclose(source);
-  fclose(dest);
-  printf("Copied %s to %s\n", args[1], args[2]);
   return 1;
 }
 
@@ -626,12 +620,9 @@ int lsh_move(char **args) {
     return 1;
   }
 
-  if (rename(args[1], args[2]) != 0) {
-    perror("lsh: move");
-    return 1;
+  if (move_path(args[1], args[2])) {
+    printf("Moved %s to %s\n", args[1], args[2]);
   }
-
-  printf("Moved %s to %s\n", args[1], args[2]);
   return 1;
 }
 
@@ -641,19 +632,8 @@ int lsh_paste(char **args) {
 }
 
 int lsh_ps(char **args) {
-  FILE *fp = popen("ps -ef", "r");
-  if (fp == NULL) {
-    perror("lsh: ps");
-    return 1;
-  }
-
-  char buffer[1024];
-  while (fgets(buffer, sizeof(buffer), fp) != NULL) {
-    printf("%s", buffer);
-  }
-
-  pclose(fp);
-  return 1;
+  // Read /proc directly rather than running ps
+  return lsh_ps_fancy(args);
 }
 
 char *unescape_json_string(const char *str) {
@@ -879,88 +859,19 @@ int lsh_clip(char **args) {
   return 1;
 }
 
-int lsh_echo(char **args) {
-  if (args[1] == NULL) {
-    printf("\n");
-    return 1;
-  }
-
+int lsh_echo_stage(char **args, StageStream *in, StageStream *out) {
   for (int i = 1; args[i] != NULL; i++) {
-    printf("%s", args[i]);
+    stage_printf(out, "%s", args[i]);
     if (args[i + 1] != NULL) {
-      printf(" ");
+      stage_write(out, " ", 1);
     }
   }
-  printf("\n");
+  stage_write(out, "\n", 1);
   return 1;
 }
 
-int lsh_loc(char **args) {
-  if (args[1] == NULL) {
-    fprintf(stderr, "lsh: expected file or directory argument to \"loc\"\n");
-    return 1;
-  }
-
-  struct stat st;
-  if (stat(args[1], &st) != 0) {
-    perror("lsh: loc");
-    return 1;
-  }
-
-  if (S_ISREG(st.st_mode)) {
-    // Count lines in a single file
-    FILE *file = fopen(args[1], "r");
-    if (!file) {
-      perror("lsh: loc");
-      return 1;
-    }
-
-    int lines = 0, code_lines = 0, blank_lines = 0, comment_lines = 0;
-    char line[1024];
-    int in_comment_block = 0;
-
-    while (fgets(line, sizeof(line), file)) {
-      lines++;
-      char *trimmed = line;
-      while (*trimmed && isspace(*trimmed))
-        trimmed++;
-
-      if (*trimmed == '\0') {
-        blank_lines++;
-      } else if (strncmp(trimmed, "//", 2) == 0) {
-        comment_lines++;
-      } else if (strncmp(trimmed, "/*", 2) == 0) {
-        comment_lines++;
-        in_comment_block = 1;
-        if (strstr(trimmed, "*/")) {
-          in_comment_block = 0;
-        }
-      } else if (in_comment_block) {
-        comment_lines++;
-        if (strstr(trimmed, "*/")) {
-          in_comment_block = 0;
-        }
-      } else {
-        code_lines++;
-      }
-    }
-
-    fclose(file);
+int lsh_echo(char **args) { return stage_run(lsh_echo_stage, args); }
 
-    printf("File: %s\n", args[1]);
-    printf("Total lines: %d\n", lines);
-    printf("Code lines: %d\n", code_lines);
-    printf("Comment lines: %d\n", comment_lines);
-    printf("Blank lines: %d\n", blank_lines);
-
-  } else if (S_ISDIR(st.st_mode)) {
-    printf("Directory LOC counting not implemented yet\n");
-  } else {
-    fprintf(stderr, "lsh: %s is not a file or directory\n", args[1]);
-  }
-
-  return 1;
-}
 
 char *extract_json_string(const char *json, const char *key) {
   char search_key[100];
@@ -0,0 +1,241 @@
+#include "command_parser.h"
+#include "common.h"
+
+typedef enum {
+  TOKEN_WORD,
+  TOKEN_PIPE,
+  TOKEN_AND,
+  TOKEN_OR,
+  TOKEN_SEMICOLON,
+  TOKEN_NEWLINE,
+  TOKEN_END,
+  TOKEN_ERROR,
+  TOKEN_UNTERMINATED,
+} TokenType;
+
+typedef struct {
+  const char *pos; // Next character to read
+  char *text;      // Where the next word's characters are copied
+} Lexer;
+
+// Items collected before their count is known, then laid out as an array
+typedef struct ListNode {
+  void *item;
+  struct ListNode *next;
+} ListNode;
+
+typedef struct {
+  ListNode *first;
+  ListNode **last;
+  int count;
+} List;
+
+static const char *token_text[] = {"word", "|", "&&", "||", ";", "newline",
+                                   "end of line", "&", "quote"};
+
+static int is_blank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\a' || c == '\v' ||
+         c == '\f';
+}
+
+static int ends_word(char c) {
+  return c == '\0' || is_blank(c) || c == '\n' || c == '|' || c == '&' ||
+         c == ';';
+}
+
+// Copy one word into the lexer's text buffer, dropping quotes and escapes.
+// NULL when a quote is still open at the end of the line.
+static char *read_word(Lexer *lexer) {
+  const char *p = lexer->pos;
+  char *word = lexer->text;
+  char *out = word;
+
+  while (!ends_word(*p)) {
+    if (*p == '\'') {
+      for (p++; *p && *p != '\''; p++)
+        *out++ = *p;
+      if (!*p)
+        return NULL;
+      p++;
+    } else if (*p == '"') {
+      for (p++; *p && *p != '"'; p++) {
+        if (*p == '\\' && (p[1] == '"' || p[1] == '\\'))
+          p++;
+        *out++ = *p;
+      }
+      if (!*p)
+        return NULL;
+      p++;
+    } else if (*p == '\\' && p[1]) {
+      *out++ = p[1];
+      p += 2;
+    } else {
+      *out++ = *p++;
+    }
+  }
+
+  *out++ = '\0';
+  lexer->pos = p;
+  lexer->text = out;
+  return word;
+}
+
+static TokenType next_token(Lexer *lexer, char **word) {
+  while (is_blank(*lexer->pos))
+    lexer->pos++;
+
+  const char *p = lexer->pos;
+  switch (*p) {
+  case '\0':
+    return TOKEN_END;
+  case '\n':
+    lexer->pos++;
+    return TOKEN_NEWLINE;
+  case ';':
+    lexer->pos++;
+    return TOKEN_SEMICOLON;
+  case '|':
+    lexer->pos += p[1] == '|' ? 2 : 1;
+    return p[1] == '|' ? TOKEN_OR : TOKEN_PIPE;
+  case '&':
+    // A lone '&' would start a background job, which the shell cannot do
+    if (p[1] != '&')
+      return TOKEN_ERROR;
+    lexer->pos += 2;
+    return TOKEN_AND;
+  default:
+    *word = read_word(lexer);
+    return *word ? TOKEN_WORD : TOKEN_UNTERMINATED;
+  }
+}
+
+static int list_add(Arena *arena, List *list, void *item) {
+  ListNode *node = arena_alloc(arena, sizeof(ListNode));
+  if (!node)
+    return 0;
+  node->item = item;
+  node->next = NULL;
+  *list->last = node;
+  list->last = &node->next;
+  list->count++;
+  return 1;
+}
+
+// NULL-terminated array of the list's items. The list starts over empty.
+static void **list_take(Arena *arena, List *list) {
+  void **array = arena_alloc(arena, (list->count + 1) * sizeof(void *));
+  if (!array)
+    return NULL;
+  int i = 0;
+  for (ListNode *node = list->first; node; node = node->next)
+    array[i++] = node->item;
+  array[i] = NULL;
+
+  list->first = NULL;
+  list->last = &list->first;
+  list->count = 0;
+  return array;
+}
+
+static const char *syntax_error(Arena *arena, const char *format,
+                                const char *token) {
+  char *message = arena_alloc(arena, 64);
+  if (!message)
+    return "out of memory";
+  snprintf(message, 64, format, token);
+  return message;
+}
+
+int parse_command_line(Arena *arena, const char *line,
+                       ParsedPipeline **pipelines, const char **error) {
+  *pipelines = NULL;
+  *error = NULL;
+
+  // Words never take more room than the text they came from
+  Lexer lexer = {line, arena_alloc(arena, strlen(line) + 1)};
+  if (!lexer.text) {
+    *error = "out of memory";
+    return 0;
+  }
+
+  ParsedPipeline **tail = pipelines;
+  List words = {NULL, &words.first, 0};
+  List commands = {NULL, &commands.first, 0};
+  RunCondition condition = RUN_ALWAYS;
+  TokenType pending = TOKEN_END; // Operator still waiting for a command
+
+  for (;;) {
+    char *word = NULL;
+    TokenType token = next_token(&lexer, &word);
+
+    if (token == TOKEN_WORD) {
+      if (!list_add(arena, &words, word)) {
+        *error = "out of memory";
+        return 0;
+      }
+      continue;
+    }
+    if (token == TOKEN_ERROR) {
+      *error = syntax_error(arena, "unexpected '%s'", token_text[token]);
+      return 0;
+    }
+    if (token == TOKEN_UNTERMINATED) {
+      *error = syntax_error(arena, "unterminated %s", token_text[token]);
+      return 0;
+    }
+
+    if (words.count == 0) {
+      // A command can continue on the next line after an operator
+      if (token == TOKEN_NEWLINE && pending != TOKEN_END)
+        continue;
+      if (pending != TOKEN_END || token == TOKEN_PIPE || token == TOKEN_AND ||
+          token == TOKEN_OR) {
+        *error = token == TOKEN_END
+                     ? syntax_error(arena, "expected a command after '%s'",
+                                    token_text[pending])
+                     : syntax_error(arena, "unexpected '%s'",
+                                    token_text[token]);
+        return 0;
+      }
+      // Empty statements between separators are skipped
+      if (token == TOKEN_END)
+        return 1;
+      continue;
+    }
+
+    char **args = (char **)list_take(arena, &words);
+    if (!args || !list_add(arena, &commands, args)) {
+      *error = "out of memory";
+      return 0;
+    }
+
+    if (token == TOKEN_PIPE) {
+      pending = token;
+      continue;
+    }
+
+    // Anything else ends the pipeline
+    ParsedPipeline *pipeline = arena_alloc(arena, sizeof(ParsedPipeline));
+    if (!pipeline) {
+      *error = "out of memory";
+      return 0;
+    }
+    pipeline->count = commands.count;
+    pipeline->commands = (char ***)list_take(arena, &commands);
+    pipeline->condition = condition;
+    pipeline->next = NULL;
+    if (!pipeline->commands) {
+      *error = "out of memory";
+      return 0;
+    }
+    *tail = pipeline;
+    tail = &pipeline->next;
+
+    if (token == TOKEN_END)
+      return 1;
+    condition = token == TOKEN_AND  ? RUN_IF_SUCCESS
+                : token == TOKEN_OR ? RUN_IF_FAILURE
+                                    : RUN_ALWAYS;
+    pending = token == TOKEN_AND || token == TOKEN_OR ? token : TOKEN_END;
+  }
+}
@@ -0,0 +1,230 @@
+#include "command_registry.h"
+#include "builtins.h"
+#include <pthread.h>
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+// Built-in commands, kept in name order once the index is built
+static CommandInfo builtins[] = {
+    {"cd", lsh_cd, ARG_TYPE_DIRECTORY, 0, "Change current directory", 0, NULL},
+    {"help", lsh_help, ARG_TYPE_COMMAND, 0, "Display help", 0, NULL},
+    {"exit", lsh_exit, ARG_TYPE_ANY, 0, "Exit the shell", 0, NULL},
+    {"dir", lsh_dir, ARG_TYPE_DIRECTORY, 0, "List directory contents",
+     COMMAND_TABLE_SOURCE, NULL},
+    {"clear", lsh_clear, ARG_TYPE_ANY, 0, "Clear the screen", 0, NULL},
+    {"mkdir", lsh_mkdir, ARG_TYPE_DIRECTORY, 0, "Make directory", 0, NULL},
+    {"rmdir", lsh_rmdir, ARG_TYPE_DIRECTORY, 0, "Remove directory", 0, NULL},
+    {"del", lsh_del, ARG_TYPE_FILE, 0, "Delete a file", 0, NULL},
+    {"touch", lsh_touch, ARG_TYPE_FILE, 0, "Create or update a file", 0, NULL},
+    {"pwd", lsh_pwd, ARG_TYPE_ANY, 0, "Print working directory", 0, NULL},
+    {"cat", lsh_cat, ARG_TYPE_FILE, 0, "Display file contents", 0,
+     lsh_cat_stage},
+    {"page", lsh_page, ARG_TYPE_FILE, 0, "View a file a screen at a time", 0,
+     NULL},
+    {"history", lsh_history, ARG_TYPE_ANY, 0, "Display command history", 0,
+     lsh_history_stage},
+    {"copy", lsh_copy, ARG_TYPE_BOTH, 0, "Copy files or directories", 0,
+     NULL},
+    {"move", lsh_move, ARG_TYPE_BOTH, 0, "Move file or directory", 0, NULL},
+    {"paste", lsh_paste, ARG_TYPE_ANY, 0, "Paste clipboard contents", 0, NULL},
+    {"ps", lsh_ps, ARG_TYPE_ANY, 0, "List processes", COMMAND_TABLE_SOURCE,
+     NULL},
+    {"news", lsh_news, ARG_TYPE_ANY, 0, "Display news", 0, NULL},
+
+    // Alias commands - show only alias suggestions
+    {"alias", lsh_alias, ARG_TYPE_ALIAS, 0, "Define or list aliases", 0, NULL},
+    {"unalias", lsh_unalias, ARG_TYPE_ALIAS, 1, "Remove alias", 0, NULL},
+    {"aliases", lsh_aliases, ARG_TYPE_ANY, 0, "List all aliases", 0, NULL},
+
+    // Bookmark commands - strict matching for bookmark operations
+    {"bookmark", lsh_bookmark, ARG_TYPE_DIRECTORY, 0, "Bookmark directories", 0,
+     NULL},
+    {"bookmarks", lsh_bookmarks, ARG_TYPE_ANY, 0, "List all bookmarks", 0,
+     NULL},
+    {"goto", lsh_goto, ARG_TYPE_BOOKMARK, 1, "Jump to a bookmark", 0, NULL},
+    {"unbookmark", lsh_unbookmark, ARG_TYPE_BOOKMARK, 1, "Remove a bookmark", 0,
+     NULL},
+
+    // Other utilities
+    {"focus_timer", lsh_focus_timer, ARG_TYPE_ANY, 0, "Start a focus timer", 0,
+     NULL},
+    {"weather", lsh_weather, ARG_TYPE_FAVORITE_CITY, 1, "Weather information",
+     0, NULL},
+    {"grep", lsh_grep, ARG_TYPE_FILE, 0, "Search file contents", 0, NULL},
+    {"grep-text", lsh_actual_grep, ARG_TYPE_FILE, 0, "Search text in file", 0,
+     lsh_grep_text_stage},
+    {"ripgrep", lsh_ripgrep, ARG_TYPE_FILE, 0, "Search with ripgrep", 0, NULL},
+    {"fzf", lsh_fzf_native, ARG_TYPE_ANY, 0, "Fuzzy finder", 0, NULL},
+    {"clip", lsh_clip, ARG_TYPE_ANY, 0, "Clipboard operations", 0, NULL},
+    {"echo", lsh_echo, ARG_TYPE_ANY, 0, "Display text", 0, lsh_echo_stage},
+    {"theme", lsh_theme, ARG_TYPE_THEME, 1, "Shell theme settings", 0, NULL},
+    {"loc", lsh_loc, ARG_TYPE_BOTH, 0, "Count lines of code",
+     COMMAND_TABLE_SOURCE, lsh_loc_stage},
+    {"git_status", lsh_git_status, ARG_TYPE_ANY, 0, "Display git status", 0,
+     NULL},
+    {"gg", lsh_gg, ARG_TYPE_ANY, 0, "Git shortcuts", 0, NULL},
+    {"ls", lsh_dir, ARG_TYPE_DIRECTORY, 0, "List directory contents",
+     COMMAND_TABLE_SOURCE, NULL},
+    {"stats", lsh_stats, ARG_TYPE_ANY, 0, "Command usage statistics", 0, NULL},
+    {"monitor", builtin_monitor, ARG_TYPE_ANY, 0, "System monitor dashboard", 0,
+     NULL},
+};
+
+// Common external commands, so completion knows their arguments
+static CommandInfo externals[] = {
+    {"rm", NULL, ARG_TYPE_FILE, 0, "Remove file", 0, NULL},
+    {"cp", NULL, ARG_TYPE_FILE, 0, "Copy file or directory", 0, NULL},
+    {"mv", NULL, ARG_TYPE_BOTH, 0, "Move file or directory", 0, NULL},
+    {"less", NULL, ARG_TYPE_FILE, 0, "View file contents", 0, NULL},
+    {"more", NULL, ARG_TYPE_FILE, 0, "View file contents", 0, NULL},
+    {"find", NULL, ARG_TYPE_DIRECTORY, 0, "Find files", 0, NULL},
+    {"chmod", NULL, ARG_TYPE_FILE, 0, "Change file permissions", 0, NULL},
+    {"chown", NULL, ARG_TYPE_FILE, 0, "Change file owner", 0, NULL},
+    {"tar", NULL, ARG_TYPE_FILE, 0, "Archive utility", 0, NULL},
+    {"gzip", NULL, ARG_TYPE_FILE, 0, "Compress files", 0, NULL},
+    {"gunzip", NULL, ARG_TYPE_FILE, 0, "Decompress files", 0, NULL},
+    {"zip", NULL, ARG_TYPE_FILE, 0, "Compress files", 0, NULL},
+    {"unzip", NULL, ARG_TYPE_FILE, 0, "Decompress files", 0, NULL},
+    {"bash", NULL, ARG_TYPE_FILE, 0, "Run bash script", 0, NULL},
+    {"sh", NULL, ARG_TYPE_FILE, 0, "Run shell script", 0, NULL},
+    {"python", NULL, ARG_TYPE_FILE, 0, "Run Python script", 0, NULL},
+    {"perl", NULL, ARG_TYPE_FILE, 0, "Run Perl script", 0, NULL},
+    {"java", NULL, ARG_TYPE_FILE, 0, "Run Java program", 0, NULL},
+    {"gcc", NULL, ARG_TYPE_FILE, 0, "C compiler", 0, NULL},
+    {"make", NULL, ARG_TYPE_FILE, 0, "Build utility", 0, NULL},
+    {"diff", NULL, ARG_TYPE_FILE, 0, "Compare files", 0, NULL},
+    {"patch", NULL, ARG_TYPE_FILE, 0, "Apply patch file", 0, NULL},
+    {"man", NULL, ARG_TYPE_ANY, 0, "Display manual page", 0, NULL},
+};
+
+#define COMMAND_TOTAL (ARRAY_LEN(builtins) + ARRAY_LEN(externals))
+#define PERFECT_BUCKETS 32   // First-level buckets, each with its own seed
+#define PERFECT_TRIES 100000 // Seeds tried for a bucket before growing
+
+// Two-level perfect hash: a name's bucket picks the seed that hashes it to
+// a slot no other name uses, so a lookup is two hashes and one strcmp
+static struct {
+  const CommandInfo **slots;
+  uint32_t mask;
+  uint32_t seeds[PERFECT_BUCKETS];
+} perfect;
+
+static pthread_once_t perfect_once = PTHREAD_ONCE_INIT;
+
+uint32_t command_hash(const char *name, uint32_t seed) {
+  uint32_t hash = 2166136261u ^ (seed * 0x9e3779b9u);
+  for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+    hash ^= *p;
+    hash *= 16777619u;
+  }
+  // Mix the high bits down; slots are picked from the low ones
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6bu;
+  hash ^= hash >> 13;
+  return hash;
+}
+
+static int compare_commands(const void *a, const void *b) {
+  return strcmp(((const CommandInfo *)a)->name, ((const CommandInfo *)b)->name);
+}
+
+// Find a seed that puts every name of the bucket in a free slot
+static int place_bucket(const CommandInfo **bucket, int size,
+                        uint32_t *seed) {
+  uint32_t taken[COMMAND_TOTAL];
+  for (uint32_t candidate = 1; candidate <= PERFECT_TRIES; candidate++) {
+    int placed = 0;
+    for (; placed < size; placed++) {
+      uint32_t slot =
+          command_hash(bucket[placed]->name, candidate) & perfect.mask;
+      int clash = perfect.slots[slot] != NULL;
+      for (int i = 0; i < placed && !clash; i++)
+        clash = taken[i] == slot;
+      if (clash)
+        break;
+      taken[placed] = slot;
+    }
+    if (placed == size) {
+      for (int i = 0; i < size; i++)
+        perfect.slots[taken[i]] = bucket[i];
+      *seed = candidate;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int build_perfect_hash(uint32_t capacity) {
+  const CommandInfo *buckets[PERFECT_BUCKETS][COMMAND_TOTAL];
+  int sizes[PERFECT_BUCKETS] = {0};
+  for (size_t i = 0; i < COMMAND_TOTAL; i++) {
+    const CommandInfo *command = i < ARRAY_LEN(builtins)
+                                     ? &builtins[i]
+                                     : &externals[i - ARRAY_LEN(builtins)];
+    uint32_t bucket = command_hash(command->name, 0) % PERFECT_BUCKETS;
+    buckets[bucket][sizes[bucket]++] = command;
+  }
+
+  free(perfect.slots);
+  perfect.slots = calloc(capacity, sizeof(*perfect.slots));
+  if (!perfect.slots)
+    return 0;
+  perfect.mask = capacity - 1;
+
+  // Crowded buckets first, while most slots are still free
+  int order[PERFECT_BUCKETS];
+  for (int i = 0; i < PERFECT_BUCKETS; i++)
+    order[i] = i;
+  for (int i = 1; i < PERFECT_BUCKETS; i++) {
+    for (int j = i; j > 0 && sizes[order[j]] > sizes[order[j - 1]]; j--) {
+      int tmp = order[j];
+      order[j] = order[j - 1];
+      order[j - 1] = tmp;
+    }
+  }
+
+  for (int i = 0; i < PERFECT_BUCKETS; i++) {
+    int bucket = order[i];
+    if (!place_bucket(buckets[bucket], sizes[bucket], &perfect.seeds[bucket]))
+      return 0;
+  }
+  return 1;
+}
+
+static void build_index(void) {
+  qsort(builtins, ARRAY_LEN(builtins), sizeof(CommandInfo), compare_commands);
+
+  uint32_t capacity = 1;
+  while (capacity < COMMAND_TOTAL * 2)
+    capacity <<= 1;
+  for (; capacity <= COMMAND_TOTAL * 16; capacity <<= 1) {
+    if (build_perfect_hash(capacity))
+      return;
+  }
+  free(perfect.slots);
+  perfect.slots = NULL;
+}
+
+const CommandInfo *command_lookup(const char *name) {
+  if (!name)
+    return NULL;
+  pthread_once(&perfect_once, build_index);
+  if (!perfect.slots)
+    return NULL;
+
+  uint32_t bucket = command_hash(name, 0) % PERFECT_BUCKETS;
+  const CommandInfo *command =
+      perfect.slots[command_hash(name, perfect.seeds[bucket]) & perfect.mask];
+  return command && strcmp(command->name, name) == 0 ? command : NULL;
+}
+
+const CommandInfo *command_builtin(const char *name) {
+  const CommandInfo *command = command_lookup(name);
+  return command && command->func ? command : NULL;
+}
+
+const CommandInfo *command_builtins(int *count) {
+  pthread_once(&perfect_once, build_index);
+  *count = (int)ARRAY_LEN(builtins);
+  return builtins;
+}
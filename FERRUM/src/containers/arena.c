@@ -0,0 +1,46 @@
+#include <stdalign.h>
+#include <stdlib.h>
+#include "../../include/containers/arena.h"
+
+#define ARENA_BLOCK 4096 // Size of the first block; each new one doubles
+
+struct ArenaBlock {
+  ArenaBlock *next;
+  size_t size;
+  alignas(max_align_t) char data[];
+};
+
+void *arena_alloc(Arena *arena, size_t size) {
+  size = (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+
+  ArenaBlock *block = arena->blocks;
+  if (!block || block->size - arena->used < size) {
+    size_t block_size = block ? block->size * 2 : ARENA_BLOCK;
+    while (block_size < size)
+      block_size *= 2;
+
+    ArenaBlock *fresh = malloc(sizeof(ArenaBlock) + block_size);
+    if (!fresh)
+      return NULL;
+    fresh->next = block;
+    fresh->size = block_size;
+    arena->blocks = block = fresh;
+    arena->used = 0;
+  }
+
+  void *memory = block->data + arena->used;
+  arena->used += size;
+  return memory;
+}
+
+void arena_free(Arena *arena) {
+  // Blocks double in size, so there are only a handful to free
+  ArenaBlock *block = arena->blocks;
+  while (block) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->blocks = NULL;
+  arena->used = 0;
+}
@@ -1,6 +1,7 @@
 
 #include "aliases.h"
 #include "builtins.h"
+#include "command_registry.h"
 #include <sys/stat.h>
 #include <time.h>
 
@@ -13,6 +14,41 @@ int loading_aliases = 0; // Flag to prevent saving during loading
 // Path to the aliases file
 char aliases_file_path[PATH_MAX];
 
+// Open-addressing index of aliases by name. Each slot holds an index into
+// aliases plus one, so 0 marks an empty slot.
+static int *alias_slots = NULL;
+static size_t alias_slot_count = 0; // Power of two
+
+static void index_alias(int i) {
+  size_t mask = alias_slot_count - 1;
+  size_t slot = command_hash(aliases[i].name, 0) & mask;
+  while (alias_slots[slot]) {
+    slot = (slot + 1) & mask;
+  }
+  alias_slots[slot] = i + 1;
+}
+
+// Rebuild the index with room for at least count aliases
+static int reindex_aliases(int count) {
+  size_t slot_count = 16;
+  while (slot_count * 7 < (size_t)count * 10) {
+    slot_count <<= 1;
+  }
+
+  int *slots = calloc(slot_count, sizeof(int));
+  if (!slots) {
+    return 0;
+  }
+  free(alias_slots);
+  alias_slots = slots;
+  alias_slot_count = slot_count;
+
+  for (int i = 0; i < alias_count; i++) {
+    index_alias(i);
+  }
+  return 1;
+}
+
 void init_aliases(void) {
   // Set initial capacity
   alias_capacity = 10;
@@ -46,9 +82,12 @@ void cleanup_aliases(void) {
     free(aliases[i].command);
   }
 
-  // Free the array
+  // Free the array and its index
   free(aliases);
   aliases = NULL;
+  free(alias_slots);
+  alias_slots = NULL;
+  alias_slot_count = 0;
   alias_count = 0;
   alias_capacity = 0;
 }
@@ -139,17 +178,16 @@ int add_alias(const char *name, const char *command) {
   }
 
   // Check if alias already exists, update it if it does
-  for (int i = 0; i < alias_count; i++) {
-    if (strcmp(aliases[i].name, name) == 0) {
-      // Update existing alias
-      free(aliases[i].command);
-      aliases[i].command = strdup(command);
-      // Save aliases immediately after updating (unless loading)
-      if (!loading_aliases) {
-        save_aliases();
-      }
-      return 1;
+  AliasEntry *existing = find_alias(name);
+  if (existing) {
+    // Update existing alias
+    free(existing->command);
+    existing->command = strdup(command);
+    // Save aliases immediately after updating (unless loading)
+    if (!loading_aliases) {
+      save_aliases();
     }
+    return 1;
   }
 
   // Check if we need to expand the array
@@ -169,6 +207,13 @@ int add_alias(const char *name, const char *command) {
   aliases[alias_count].command = strdup(command);
   alias_count++;
 
+  // Index it, growing the index past 70% full
+  if ((size_t)alias_count * 10 > alias_slot_count * 7) {
+    reindex_aliases(alias_count);
+  } else {
+    index_alias(alias_count - 1);
+  }
+
   // Save aliases immediately after adding (unless loading)
   if (!loading_aliases) {
     save_aliases();
@@ -182,33 +227,41 @@ int remove_alias(const char *name) {
     return 0;
   }
 
-  for (int i = 0; i < alias_count; i++) {
-    if (strcmp(aliases[i].name, name) == 0) {
-      // Free memory for this alias
-      free(aliases[i].name);
-      free(aliases[i].command);
-
-      // Shift remaining aliases down
-      for (int j = i; j < alias_count - 1; j++) {
-        aliases[j] = aliases[j + 1];
-      }
+  AliasEntry *alias = find_alias(name);
+  if (!alias) {
+    return 0; // Alias not found
+  }
+  int i = (int)(alias - aliases);
 
-      alias_count--;
-      // Save aliases immediately after removing (unless loading)
-      if (!loading_aliases) {
-        save_aliases();
-      }
-      return 1;
-    }
+  // Free memory for this alias
+  free(aliases[i].name);
+  free(aliases[i].command);
+
+  // Shift remaining aliases down
+  for (int j = i; j < alias_count - 1; j++) {
+    aliases[j] = aliases[j + 1];
   }
 
-  return 0; // Alias not found
+  alias_count--;
+  reindex_aliases(alias_count); // Every later alias moved down
+  // Save aliases immediately after removing (unless loading)
+  if (!loading_aliases) {
+    save_aliases();
+  }
+  return 1;
 }
 
 AliasEntry *find_alias(const char *name) {
-  for (int i = 0; i < alias_count; i++) {
-    if (strcmp(aliases[i].name, name) == 0) {
-      return &aliases[i];
+  if (!name || !alias_slots) {
+    return NULL;
+  }
+
+  size_t mask = alias_slot_count - 1;
+  for (size_t slot = command_hash(name, 0) & mask; alias_slots[slot];
+       slot = (slot + 1) & mask) {
+    AliasEntry *alias = &aliases[alias_slots[slot] - 1];
+    if (strcmp(alias->name, name) == 0) {
+      return alias;
     }
   }
   return NULL;
@@ -0,0 +1,224 @@
+#define _GNU_SOURCE
+#include "event_loop.h"
+#include "common.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+#define MAX_WATCHES 16
+#define MAX_SIGNAL_HANDLERS 8
+
+typedef enum {
+  WATCH_INPUT,   // Calls its handler
+  WATCH_TIMER,   // Calls its handler once the expiry count is read
+  WATCH_SIGNALS, // The signalfd; dispatched by signal number
+  WATCH_TARGET,  // What event_wait is waiting for
+} WatchKind;
+
+typedef struct {
+  int used;
+  int fd;
+  WatchKind kind;
+  EventHandler handler;
+  void *data;
+} Watch;
+
+typedef struct {
+  int signo;
+  EventHandler handler;
+  void *data;
+} SignalHandler;
+
+static struct {
+  int epoll_fd; // 0 until created, -1 when epoll is unavailable
+  Watch watches[MAX_WATCHES];
+  int signal_fd;
+  sigset_t signals;
+  SignalHandler handlers[MAX_SIGNAL_HANDLERS];
+  int handler_count;
+  sigset_t saved_mask;
+  int holding; // Signals are blocked and go to the signalfd
+} loop;
+
+static int ensure_loop(void) {
+  if (loop.epoll_fd == 0) {
+    loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop.signal_fd = -1;
+    sigemptyset(&loop.signals);
+  }
+  return loop.epoll_fd != -1;
+}
+
+static Watch *find_watch(int fd) {
+  for (int i = 0; i < MAX_WATCHES; i++) {
+    if (loop.watches[i].used && loop.watches[i].fd == fd)
+      return &loop.watches[i];
+  }
+  return NULL;
+}
+
+static Watch *add_watch(int fd, WatchKind kind, EventHandler handler,
+                        void *data) {
+  if (!ensure_loop() || find_watch(fd))
+    return NULL;
+
+  for (int i = 0; i < MAX_WATCHES; i++) {
+    Watch *watch = &loop.watches[i];
+    if (watch->used)
+      continue;
+
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = watch;
+    if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1)
+      return NULL;
+    *watch = (Watch){1, fd, kind, handler, data};
+    return watch;
+  }
+  return NULL;
+}
+
+int event_watch(int fd, EventHandler handler, void *data) {
+  return add_watch(fd, WATCH_INPUT, handler, data) != NULL;
+}
+
+void event_unwatch(int fd) {
+  Watch *watch = find_watch(fd);
+  if (!watch)
+    return;
+  epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+  watch->used = 0;
+}
+
+int event_timer(EventHandler handler, void *data) {
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd == -1)
+    return -1;
+  if (!add_watch(fd, WATCH_TIMER, handler, data)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void set_ms(struct timespec *time, long ms) {
+  time->tv_sec = ms / 1000;
+  time->tv_nsec = (ms % 1000) * 1000000L;
+}
+
+void event_timer_arm(int timer, long delay_ms, long interval_ms) {
+  if (timer < 0)
+    return;
+  struct itimerspec spec;
+  set_ms(&spec.it_value, delay_ms);
+  set_ms(&spec.it_interval, delay_ms ? interval_ms : 0);
+  timerfd_settime(timer, 0, &spec, NULL);
+}
+
+int event_signal(int signo, EventHandler handler, void *data) {
+  if (!ensure_loop() || loop.handler_count == MAX_SIGNAL_HANDLERS)
+    return 0;
+
+  sigset_t signals = loop.signals;
+  sigaddset(&signals, signo);
+  int fd = signalfd(loop.signal_fd, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (fd == -1)
+    return 0;
+  if (loop.signal_fd == -1 && !add_watch(fd, WATCH_SIGNALS, NULL, NULL)) {
+    close(fd);
+    return 0;
+  }
+  loop.signal_fd = fd;
+  loop.signals = signals;
+  loop.handlers[loop.handler_count++] = (SignalHandler){signo, handler, data};
+  return 1;
+}
+
+void event_loop_begin(void) {
+  if (loop.holding || loop.signal_fd == -1)
+    return;
+  pthread_sigmask(SIG_BLOCK, &loop.signals, &loop.saved_mask);
+  loop.holding = 1;
+}
+
+void event_loop_end(void) {
+  if (!loop.holding)
+    return;
+  pthread_sigmask(SIG_SETMASK, &loop.saved_mask, NULL);
+  loop.holding = 0;
+}
+
+static void dispatch_signals(void) {
+  struct signalfd_siginfo info;
+  while (read(loop.signal_fd, &info, sizeof(info)) == sizeof(info)) {
+    for (int i = 0; i < loop.handler_count; i++) {
+      if (loop.handlers[i].signo == (int)info.ssi_signo)
+        loop.handlers[i].handler(loop.handlers[i].data);
+    }
+  }
+}
+
+static long elapsed_ms(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000L +
+         (now.tv_nsec - start->tv_nsec) / 1000000L;
+}
+
+int event_wait(int fd, int timeout_ms) {
+  Watch *target = find_watch(fd);
+  if (!target)
+    target = add_watch(fd, WATCH_TARGET, NULL, NULL);
+  if (!target) {
+    // Without epoll there is nothing else to service; just wait on fd
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int ready = poll(&pfd, 1, timeout_ms);
+    return ready > 0 ? 1 : ready == 0 ? 0 : errno == EINTR ? 0 : -1;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (;;) {
+    int wait_ms = -1;
+    if (timeout_ms >= 0) {
+      wait_ms = timeout_ms - (int)elapsed_ms(&start);
+      if (wait_ms < 0)
+        wait_ms = 0;
+    }
+
+    struct epoll_event events[MAX_WATCHES];
+    int count = epoll_wait(loop.epoll_fd, events, MAX_WATCHES, wait_ms);
+    if (count == -1 && errno != EINTR)
+      return -1;
+
+    int ready = 0;
+    for (int i = 0; i < count; i++) {
+      Watch *watch = events[i].data.ptr;
+      // A handler may have removed a watch still in this batch
+      if (!watch->used)
+        continue;
+
+      if (watch == target) {
+        ready = 1;
+      } else if (watch->kind == WATCH_SIGNALS) {
+        dispatch_signals();
+      } else if (watch->kind == WATCH_TIMER) {
+        uint64_t expirations;
+        if (read(watch->fd, &expirations, sizeof(expirations)) > 0)
+          watch->handler(watch->data);
+      } else if (watch->kind == WATCH_INPUT) {
+        watch->handler(watch->data);
+      }
+    }
+
+    if (ready)
+      return 1;
+    if (wait_ms == 0)
+      return 0;
+  }
+}
@@ -0,0 +1,682 @@
+#define _GNU_SOURCE
+#include "git_commit_graph.h"
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define GRAPH_CHUNK_OIDF 0x4f494446u
+#define GRAPH_CHUNK_OIDL 0x4f49444cu
+#define GRAPH_CHUNK_CDAT 0x43444154u
+#define GRAPH_CHUNK_EDGE 0x45444745u
+#define GRAPH_PARENT_NONE 0x70000000u
+#define GRAPH_EXTRA_EDGES 0x80000000u
+#define GRAPH_LAST_EDGE 0x80000000u
+#define GRAPH_DATA_WIDTH (GIT_OID_RAW_LEN + 16)
+#define GRAPH_POS_NONE UINT32_MAX
+#define GENERATION_INFINITY UINT32_MAX
+
+typedef struct {
+  unsigned char *map;
+  size_t size;
+  uint32_t num_commits;
+  uint32_t base_commits; // Commits in the layers below this one
+  const unsigned char *fanout;
+  const unsigned char *oids;
+  const unsigned char *cdat;
+  const unsigned char *edges;
+  size_t edge_count;
+} GitGraphLayer;
+
+typedef struct {
+  char objects_dir[PATH_MAX + 16];
+  struct timespec mtime; // commit-graph or commit-graph-chain file
+  GitGraphLayer *layers;
+  int layer_count;
+  uint32_t total_commits;
+} GitCommitGraph;
+
+// The parsed graph is kept until the file on disk changes
+static GitCommitGraph cached_graph;
+
+static uint32_t read_be32(const unsigned char *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t read_be64(const unsigned char *p) {
+  return ((uint64_t)read_be32(p) << 32) | read_be32(p + 4);
+}
+
+static void unload_graph(GitCommitGraph *graph) {
+  for (int i = 0; i < graph->layer_count; i++) {
+    munmap(graph->layers[i].map, graph->layers[i].size);
+  }
+  free(graph->layers);
+  graph->layers = NULL;
+  graph->layer_count = 0;
+  graph->total_commits = 0;
+}
+
+static int load_layer(GitGraphLayer *layer, const char *path) {
+  memset(layer, 0, sizeof(*layer));
+
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return 0;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < 8 + 12) {
+    close(fd);
+    return 0;
+  }
+  layer->size = (size_t)st.st_size;
+  layer->map = mmap(NULL, layer->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (layer->map == MAP_FAILED) {
+    layer->map = NULL;
+    return 0;
+  }
+
+  // Header: "CGPH", version 1, SHA-1, chunk count, base graph count
+  const unsigned char *p = layer->map;
+  if (memcmp(p, "CGPH", 4) != 0 || p[4] != 1 || p[5] != 1)
+    goto fail;
+
+  int chunk_count = p[6];
+  if (8 + (size_t)(chunk_count + 1) * 12 > layer->size)
+    goto fail;
+
+  size_t oidl_size = 0;
+  size_t edge_size = 0;
+  for (int i = 0; i < chunk_count; i++) {
+    const unsigned char *entry = p + 8 + i * 12;
+    uint32_t id = read_be32(entry);
+    uint64_t offset = read_be64(entry + 4);
+    uint64_t next = read_be64(entry + 16);
+    if (offset > layer->size || next > layer->size || next < offset)
+      goto fail;
+
+    if (id == GRAPH_CHUNK_OIDF) {
+      layer->fanout = p + offset;
+    } else if (id == GRAPH_CHUNK_OIDL) {
+      layer->oids = p + offset;
+      oidl_size = next - offset;
+    } else if (id == GRAPH_CHUNK_CDAT) {
+      layer->cdat = p + offset;
+    } else if (id == GRAPH_CHUNK_EDGE) {
+      layer->edges = p + offset;
+      edge_size = next - offset;
+    }
+  }
+
+  if (!layer->fanout || !layer->oids || !layer->cdat)
+    goto fail;
+
+  layer->num_commits = read_be32(layer->fanout + 255 * 4);
+  layer->edge_count = edge_size / 4;
+  if (oidl_size < (size_t)layer->num_commits * GIT_OID_RAW_LEN)
+    goto fail;
+  return 1;
+
+fail:
+  munmap(layer->map, layer->size);
+  layer->map = NULL;
+  return 0;
+}
+
+static int add_layer(GitCommitGraph *graph, const char *path) {
+  GitGraphLayer *grown =
+      realloc(graph->layers, (graph->layer_count + 1) * sizeof(GitGraphLayer));
+  if (!grown)
+    return 0;
+  graph->layers = grown;
+
+  GitGraphLayer *layer = &graph->layers[graph->layer_count];
+  if (!load_layer(layer, path))
+    return 0;
+  layer->base_commits = graph->total_commits;
+  graph->total_commits += layer->num_commits;
+  graph->layer_count++;
+  return 1;
+}
+
+static GitCommitGraph *get_commit_graph(GitOdb *odb) {
+  const char *objects_dir = git_odb_objects_dir(odb);
+  char single[PATH_MAX + 64];
+  char chain[PATH_MAX + 64];
+  snprintf(single, sizeof(single), "%s/info/commit-graph", objects_dir);
+  snprintf(chain, sizeof(chain), "%s/info/commit-graphs/commit-graph-chain",
+           objects_dir);
+
+  struct stat st;
+  int use_chain = 0;
+  if (stat(single, &st) != 0) {
+    if (stat(chain, &st) != 0)
+      memset(&st, 0, sizeof(st));
+    else
+      use_chain = 1;
+  }
+
+  GitCommitGraph *graph = &cached_graph;
+  if (strcmp(graph->objects_dir, objects_dir) == 0 &&
+      graph->mtime.tv_sec == st.st_mtim.tv_sec &&
+      graph->mtime.tv_nsec == st.st_mtim.tv_nsec)
+    return graph->layer_count > 0 ? graph : NULL;
+
+  unload_graph(graph);
+  snprintf(graph->objects_dir, sizeof(graph->objects_dir), "%s", objects_dir);
+  graph->mtime = st.st_mtim;
+  if (st.st_mtim.tv_sec == 0 && st.st_mtim.tv_nsec == 0)
+    return NULL;
+
+  if (!use_chain) {
+    add_layer(graph, single);
+  } else {
+    // The chain file lists layer hashes from the base upwards
+    FILE *fp = fopen(chain, "r");
+    char line[128];
+    while (fp && fgets(line, sizeof(line), fp)) {
+      line[strcspn(line, "\n")] = '\0';
+      if (strlen(line) != GIT_OID_HEX_LEN)
+        continue;
+      char path[PATH_MAX + 128];
+      snprintf(path, sizeof(path), "%s/info/commit-graphs/graph-%s.graph",
+               objects_dir, line);
+      // Positions in upper layers depend on every lower layer
+      if (!add_layer(graph, path)) {
+        unload_graph(graph);
+        break;
+      }
+    }
+    if (fp)
+      fclose(fp);
+  }
+
+  return graph->layer_count > 0 ? graph : NULL;
+}
+
+static uint32_t graph_find(const GitCommitGraph *graph,
+                           const unsigned char *raw) {
+  if (!graph)
+    return GRAPH_POS_NONE;
+
+  for (int i = 0; i < graph->layer_count; i++) {
+    const GitGraphLayer *layer = &graph->layers[i];
+    uint32_t lo = raw[0] == 0 ? 0 : read_be32(layer->fanout + (raw[0] - 1) * 4);
+    uint32_t hi = read_be32(layer->fanout + raw[0] * 4);
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      int cmp = memcmp(layer->oids + (size_t)mid * GIT_OID_RAW_LEN, raw,
+                       GIT_OID_RAW_LEN);
+      if (cmp == 0)
+        return layer->base_commits + mid;
+      if (cmp < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  }
+  return GRAPH_POS_NONE;
+}
+
+static const GitGraphLayer *graph_layer(const GitCommitGraph *graph,
+                                        uint32_t pos) {
+  for (int i = graph->layer_count - 1; i >= 0; i--) {
+    if (pos >= graph->layers[i].base_commits)
+      return pos - graph->layers[i].base_commits < graph->layers[i].num_commits
+                 ? &graph->layers[i]
+                 : NULL;
+  }
+  return NULL;
+}
+
+typedef struct {
+  unsigned char oid[GIT_OID_RAW_LEN];
+  uint32_t generation; // Topological level, 0 until known
+  int64_t commit_time;
+  uint32_t graph_pos;
+  int parent_start; // Offset into the walk's parent list
+  int parent_count;
+  int parents_loaded;
+  int queued;
+  int processed;
+} GitWalkNode;
+
+typedef struct {
+  GitOdb *odb;
+  GitCommitGraph *graph;
+  GitWalkNode *nodes;
+  uint64_t *bits; // words_per_node words per node: bit 2i local, 2i+1 upstream
+  int words_per_node;
+  int node_count;
+  int node_capacity;
+  int *parents; // Node indices, parent_count entries per node
+  int parent_total;
+  int parent_capacity;
+  int *table; // Open addressing, node index + 1 (0 = empty)
+  size_t table_slots;
+  int *heap;
+  int heap_count;
+  int heap_capacity;
+  int *stack; // Pending nodes while computing generations
+  int stack_capacity;
+  int nonstale_queued; // Queued nodes still separating some pair
+} GitAheadBehindWalk;
+
+static uint64_t *node_bits(GitAheadBehindWalk *walk, int node) {
+  return walk->bits + (size_t)node * walk->words_per_node;
+}
+
+// A node separates a pair when exactly one side of that pair reaches it
+static int node_is_nonstale(GitAheadBehindWalk *walk, int node) {
+  const uint64_t *bits = node_bits(walk, node);
+  for (int w = 0; w < walk->words_per_node; w++) {
+    uint64_t local = bits[w] & 0x5555555555555555ull;
+    uint64_t upstream = (bits[w] >> 1) & 0x5555555555555555ull;
+    if (local ^ upstream)
+      return 1;
+  }
+  return 0;
+}
+
+static int node_before(GitAheadBehindWalk *walk, int a, int b) {
+  const GitWalkNode *na = &walk->nodes[a];
+  const GitWalkNode *nb = &walk->nodes[b];
+  if (na->generation != nb->generation)
+    return na->generation > nb->generation;
+  return na->commit_time > nb->commit_time;
+}
+
+static int heap_push(GitAheadBehindWalk *walk, int node) {
+  if (walk->heap_count >= walk->heap_capacity) {
+    int capacity = walk->heap_capacity ? walk->heap_capacity * 2 : 64;
+    int *grown = realloc(walk->heap, capacity * sizeof(int));
+    if (!grown)
+      return 0;
+    walk->heap = grown;
+    walk->heap_capacity = capacity;
+  }
+
+  int i = walk->heap_count++;
+  walk->heap[i] = node;
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!node_before(walk, walk->heap[i], walk->heap[parent]))
+      break;
+    int tmp = walk->heap[i];
+    walk->heap[i] = walk->heap[parent];
+    walk->heap[parent] = tmp;
+    i = parent;
+  }
+  return 1;
+}
+
+static int heap_pop(GitAheadBehindWalk *walk) {
+  int top = walk->heap[0];
+  walk->heap[0] = walk->heap[--walk->heap_count];
+
+  int i = 0;
+  while (1) {
+    int left = i * 2 + 1;
+    int right = left + 1;
+    int first = i;
+    if (left < walk->heap_count &&
+        node_before(walk, walk->heap[left], walk->heap[first]))
+      first = left;
+    if (right < walk->heap_count &&
+        node_before(walk, walk->heap[right], walk->heap[first]))
+      first = right;
+    if (first == i)
+      break;
+    int tmp = walk->heap[i];
+    walk->heap[i] = walk->heap[first];
+    walk->heap[first] = tmp;
+    i = first;
+  }
+  return top;
+}
+
+static int grow_table(GitAheadBehindWalk *walk) {
+  size_t slots = walk->table_slots ? walk->table_slots * 2 : 1024;
+  int *table = calloc(slots, sizeof(int));
+  if (!table)
+    return 0;
+
+  for (int n = 0; n < walk->node_count; n++) {
+    size_t slot = read_be32(walk->nodes[n].oid) & (slots - 1);
+    while (table[slot])
+      slot = (slot + 1) & (slots - 1);
+    table[slot] = n + 1;
+  }
+  free(walk->table);
+  walk->table = table;
+  walk->table_slots = slots;
+  return 1;
+}
+
+// Find or create the node for a commit. Commits in the commit-graph get
+// their generation and date from it right away.
+static int get_node(GitAheadBehindWalk *walk, const unsigned char *raw) {
+  if ((size_t)(walk->node_count + 1) * 2 > walk->table_slots &&
+      !grow_table(walk))
+    return -1;
+
+  size_t slot = read_be32(raw) & (walk->table_slots - 1);
+  while (walk->table[slot]) {
+    int n = walk->table[slot] - 1;
+    if (memcmp(walk->nodes[n].oid, raw, GIT_OID_RAW_LEN) == 0)
+      return n;
+    slot = (slot + 1) & (walk->table_slots - 1);
+  }
+
+  if (walk->node_count >= walk->node_capacity) {
+    int capacity = walk->node_capacity ? walk->node_capacity * 2 : 256;
+    GitWalkNode *nodes = realloc(walk->nodes, capacity * sizeof(GitWalkNode));
+    if (!nodes)
+      return -1;
+    walk->nodes = nodes;
+    uint64_t *bits = realloc(walk->bits, (size_t)capacity *
+                                             walk->words_per_node *
+                                             sizeof(uint64_t));
+    if (!bits)
+      return -1;
+    walk->bits = bits;
+    walk->node_capacity = capacity;
+  }
+
+  int n = walk->node_count;
+  GitWalkNode *node = &walk->nodes[n];
+  memset(node, 0, sizeof(*node));
+  memcpy(node->oid, raw, GIT_OID_RAW_LEN);
+  memset(node_bits(walk, n), 0, walk->words_per_node * sizeof(uint64_t));
+
+  node->graph_pos = graph_find(walk->graph, raw);
+  const GitGraphLayer *layer = node->graph_pos != GRAPH_POS_NONE
+                                   ? graph_layer(walk->graph, node->graph_pos)
+                                   : NULL;
+  if (layer) {
+    const unsigned char *data =
+        layer->cdat + (size_t)(node->graph_pos - layer->base_commits) *
+                          GRAPH_DATA_WIDTH;
+    uint32_t gen_and_time = read_be32(data + GIT_OID_RAW_LEN + 8);
+    node->generation = gen_and_time >> 2;
+    node->commit_time = ((int64_t)(gen_and_time & 3) << 32) |
+                        read_be32(data + GIT_OID_RAW_LEN + 12);
+  } else {
+    node->graph_pos = GRAPH_POS_NONE;
+    // Levels from an earlier walk only fit a walk without a graph, whose
+    // numbers they were built on
+    if (!walk->graph)
+      node->generation = git_odb_cached_generation(walk->odb, raw);
+  }
+
+  walk->node_count++;
+  walk->table[slot] = n + 1;
+  return n;
+}
+
+static int raw_parents_from_graph(GitAheadBehindWalk *walk, uint32_t graph_pos,
+                                  unsigned char parents[][GIT_OID_RAW_LEN]) {
+  const GitGraphLayer *layer = graph_layer(walk->graph, graph_pos);
+  if (!layer)
+    return 0;
+
+  const unsigned char *data =
+      layer->cdat + (size_t)(graph_pos - layer->base_commits) * GRAPH_DATA_WIDTH;
+  uint32_t parent_pos[2] = {read_be32(data + GIT_OID_RAW_LEN),
+                            read_be32(data + GIT_OID_RAW_LEN + 4)};
+  int count = 0;
+
+  for (int i = 0; i < 2; i++) {
+    uint32_t pos = parent_pos[i];
+    if (pos == GRAPH_PARENT_NONE)
+      break;
+
+    if (i == 1 && (pos & GRAPH_EXTRA_EDGES)) {
+      // Octopus merges list the remaining parents in the EDGE chunk
+      size_t edge = pos & ~GRAPH_EXTRA_EDGES;
+      while (layer->edges && edge < layer->edge_count &&
+             count < GIT_MAX_PARENTS) {
+        uint32_t value = read_be32(layer->edges + edge * 4);
+        uint32_t edge_pos = value & ~GRAPH_LAST_EDGE;
+        const GitGraphLayer *owner = graph_layer(walk->graph, edge_pos);
+        if (owner) {
+          memcpy(parents[count++],
+                 owner->oids +
+                     (size_t)(edge_pos - owner->base_commits) * GIT_OID_RAW_LEN,
+                 GIT_OID_RAW_LEN);
+        }
+        if (value & GRAPH_LAST_EDGE)
+          break;
+        edge++;
+      }
+      break;
+    }
+
+    const GitGraphLayer *owner = graph_layer(walk->graph, pos);
+    if (owner) {
+      memcpy(parents[count++],
+             owner->oids + (size_t)(pos - owner->base_commits) * GIT_OID_RAW_LEN,
+             GIT_OID_RAW_LEN);
+    }
+  }
+  return count;
+}
+
+// Resolve a node's parents to node indices, reading the commit object when
+// the commit is not in the commit-graph
+static int load_parents(GitAheadBehindWalk *walk, int node) {
+  if (walk->nodes[node].parents_loaded)
+    return 1;
+
+  unsigned char raw[GIT_MAX_PARENTS][GIT_OID_RAW_LEN];
+  int count = 0;
+  if (walk->nodes[node].graph_pos != GRAPH_POS_NONE) {
+    count = raw_parents_from_graph(walk, walk->nodes[node].graph_pos, raw);
+  } else {
+    char hex[GIT_OID_HEX_LEN + 1];
+    GitObject commit;
+    GitCommitInfo info;
+    git_oid_to_hex(walk->nodes[node].oid, hex);
+    if (!git_odb_read(walk->odb, hex, &commit))
+      return 0;
+    int parsed = git_parse_commit(commit.data, commit.size, &info);
+    git_object_free(&commit);
+    if (!parsed)
+      return 0;
+
+    walk->nodes[node].commit_time = info.committer_time;
+    for (int i = 0; i < info.parent_count; i++) {
+      if (git_oid_from_hex(info.parents[i], raw[count]))
+        count++;
+    }
+  }
+
+  if (walk->parent_total + count > walk->parent_capacity) {
+    int capacity = walk->parent_capacity ? walk->parent_capacity * 2 : 512;
+    while (capacity < walk->parent_total + count)
+      capacity *= 2;
+    int *grown = realloc(walk->parents, capacity * sizeof(int));
+    if (!grown)
+      return 0;
+    walk->parents = grown;
+    walk->parent_capacity = capacity;
+  }
+
+  // Reserve the slots first: get_node() below may add more nodes
+  int start = walk->parent_total;
+  walk->parent_total += count;
+  for (int i = 0; i < count; i++) {
+    int parent = get_node(walk, raw[i]);
+    if (parent < 0)
+      return 0;
+    walk->parents[start + i] = parent;
+  }
+
+  walk->nodes[node].parent_start = start;
+  walk->nodes[node].parent_count = count;
+  walk->nodes[node].parents_loaded = 1;
+  return 1;
+}
+
+// Commits missing from the commit-graph get a topological level computed
+// down to the nearest commits that have one (or to the roots), so the walk
+// below always sees children before their parents. Without a graph the
+// levels are kept on the odb, so only commits new since the last walk are
+// read again.
+static int ensure_generation(GitAheadBehindWalk *walk, int node) {
+  if (walk->nodes[node].generation)
+    return 1;
+
+  int depth = 0;
+  walk->stack[depth++] = node;
+  while (depth > 0) {
+    int top = walk->stack[depth - 1];
+    if (walk->nodes[top].generation) {
+      depth--;
+      continue;
+    }
+    if (!load_parents(walk, top))
+      return 0;
+
+    uint32_t max_generation = 0;
+    int pending = 0;
+    GitWalkNode *n = &walk->nodes[top];
+    if (depth + n->parent_count > walk->stack_capacity) {
+      int capacity = walk->stack_capacity * 2 + n->parent_count;
+      int *grown = realloc(walk->stack, capacity * sizeof(int));
+      if (!grown)
+        return 0;
+      walk->stack = grown;
+      walk->stack_capacity = capacity;
+    }
+
+    for (int i = 0; i < n->parent_count; i++) {
+      int parent = walk->parents[n->parent_start + i];
+      uint32_t generation = walk->nodes[parent].generation;
+      if (!generation) {
+        walk->stack[depth++] = parent;
+        pending = 1;
+      } else if (generation > max_generation) {
+        max_generation = generation;
+      }
+    }
+
+    if (!pending) {
+      n->generation = max_generation < GENERATION_INFINITY - 1
+                          ? max_generation + 1
+                          : GENERATION_INFINITY - 1;
+      if (!walk->graph)
+        git_odb_cache_generation(walk->odb, n->oid, n->generation);
+      depth--;
+    }
+  }
+  return 1;
+}
+
+// Merge bits into a node, keeping the queued nonstale count in step
+static int merge_bits(GitAheadBehindWalk *walk, int node,
+                      const uint64_t *bits) {
+  if (!walk->nodes[node].queued && !walk->nodes[node].processed &&
+      !ensure_generation(walk, node))
+    return 0;
+
+  int was_nonstale = walk->nodes[node].queued && node_is_nonstale(walk, node);
+  uint64_t *target = node_bits(walk, node);
+  for (int w = 0; w < walk->words_per_node; w++)
+    target[w] |= bits[w];
+
+  if (walk->nodes[node].queued) {
+    walk->nonstale_queued += node_is_nonstale(walk, node) - was_nonstale;
+  } else if (!walk->nodes[node].processed) {
+    if (!heap_push(walk, node))
+      return 0;
+    walk->nodes[node].queued = 1;
+    walk->nonstale_queued += node_is_nonstale(walk, node);
+  }
+  return 1;
+}
+
+static void free_walk(GitAheadBehindWalk *walk) {
+  free(walk->nodes);
+  free(walk->bits);
+  free(walk->parents);
+  free(walk->table);
+  free(walk->heap);
+  free(walk->stack);
+}
+
+int git_ahead_behind(GitOdb *odb, GitAheadBehind *pairs, int count) {
+  if (!odb || !pairs || count <= 0)
+    return 0;
+
+  GitAheadBehindWalk walk;
+  memset(&walk, 0, sizeof(walk));
+  walk.odb = odb;
+  walk.graph = get_commit_graph(odb);
+  walk.words_per_node = (count * 2 + 63) / 64;
+  walk.stack_capacity = 256;
+  walk.stack = malloc(walk.stack_capacity * sizeof(int));
+
+  uint64_t *seed = calloc(walk.words_per_node, sizeof(uint64_t));
+  if (!seed || !walk.stack) {
+    free(seed);
+    free_walk(&walk);
+    return 0;
+  }
+
+  int ok = 1;
+  for (int i = 0; i < count && ok; i++) {
+    pairs[i].ahead = 0;
+    pairs[i].behind = 0;
+    if (!pairs[i].upstream_oid[0])
+      continue;
+
+    // Seed each tip with the bit of the side it belongs to
+    const char *tips[2] = {pairs[i].local_oid, pairs[i].upstream_oid};
+    for (int side = 0; side < 2 && ok; side++) {
+      unsigned char raw[GIT_OID_RAW_LEN];
+      int bit = i * 2 + side;
+      int node = git_oid_from_hex(tips[side], raw) ? get_node(&walk, raw) : -1;
+      memset(seed, 0, walk.words_per_node * sizeof(uint64_t));
+      seed[bit / 64] = 1ull << (bit % 64);
+      ok = node >= 0 && merge_bits(&walk, node, seed);
+    }
+  }
+
+  // Highest generation first, so every child is done before its parents
+  // and a node's bits are final when it is popped. Once no queued node
+  // separates any pair, nothing older can either.
+  while (ok && walk.heap_count > 0 && walk.nonstale_queued > 0) {
+    int node = heap_pop(&walk);
+    walk.nodes[node].queued = 0;
+    walk.nodes[node].processed = 1;
+    if (node_is_nonstale(&walk, node))
+      walk.nonstale_queued--;
+
+    const uint64_t *bits = node_bits(&walk, node);
+    for (int i = 0; i < count; i++) {
+      int local = (bits[(i * 2) / 64] >> ((i * 2) % 64)) & 1;
+      int upstream = (bits[(i * 2 + 1) / 64] >> ((i * 2 + 1) % 64)) & 1;
+      if (local && !upstream)
+        pairs[i].ahead++;
+      else if (upstream && !local)
+        pairs[i].behind++;
+    }
+
+    // Copy the bits first, the node arrays may move while parents load
+    memcpy(seed, bits, walk.words_per_node * sizeof(uint64_t));
+    if (!load_parents(&walk, node)) {
+      ok = 0;
+      break;
+    }
+    for (int p = 0; p < walk.nodes[node].parent_count && ok; p++)
+      ok = merge_bits(&walk, walk.parents[walk.nodes[node].parent_start + p],
+                      seed);
+  }
+
+  free(seed);
+  free_walk(&walk);
+  return ok;
+}
@@ -1,5 +1,8 @@
 
 #include "git_integration.h"
+#include "git_commit_graph.h"
+#include "git_object_broker.h"
+#include "git_odb.h"
 #include <ctype.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -195,52 +198,50 @@ int get_last_commit(char *title, size_t title_size, char *hash,
   title[0] = '\0';
   hash[0] = '\0';
 
-  FILE *fp = popen("git rev-parse --short HEAD 2>/dev/null", "r");
-  if (fp) {
-    if (fgets(hash, hash_size, fp) != NULL) {
-      char *newline = strchr(hash, '\n');
-      if (newline)
-        *newline = '\0';
-    }
-    pclose(fp);
+  GitObject commit;
+  GitCommitInfo info;
+  if (!git_broker_read_object("HEAD", &commit)) {
+    return 0;
   }
 
-  fp = popen("git log -1 --pretty=format:%s 2>/dev/null", "r");
-  if (fp) {
-    if (fgets(title, title_size, fp) != NULL) {
-      // No need to remove quotes since we're not using them in the format.
-    }
-    pclose(fp);
+  if (git_parse_commit(commit.data, commit.size, &info)) {
+    // Short hash as git log shows it, when the object database can say
+    // how long that is
+    GitOdb *odb = git_odb_current();
+    if (odb)
+      git_odb_abbrev(odb, commit.oid, hash, hash_size);
+    else
+      snprintf(hash, hash_size, "%.7s", commit.oid);
+    git_commit_message_parts(&info, title, title_size, NULL, 0);
   }
+  git_object_free(&commit);
 
   return (strlen(hash) > 0 && strlen(title) > 0) ? 1 : 0;
 }
 
+typedef struct {
+  char (*commits)[256];
+  int count;
+} RecentCommitCollector;
+
+static int collect_recent_commit(const char *oid, const GitCommitInfo *info,
+                                 void *ctx) {
+  (void)oid;
+  RecentCommitCollector *collector = ctx;
+  git_commit_message_parts(info, collector->commits[collector->count], 256,
+                           NULL, 0);
+  collector->count++;
+  return 1;
+}
+
 int get_recent_commit(char commits[][256], int count) {
   if (!commits || count <= 0) {
     return 0;
   }
 
-  char cmd[256];
-  snprintf(cmd, sizeof(cmd), "git log -%d --pretty=format:%%s 2>/dev/null",
-           count);
-
-  FILE *fp = popen(cmd, "r");
-  if (!fp) {
-    return 0;
-  }
-
-  int retrieved = 0;
-  while (retrieved < count && fgets(commits[retrieved], 256, fp) != NULL) {
-    char *newline = strchr(commits[retrieved], '\n');
-    if (newline)
-      *newline = '\0';
-
-    retrieved++;
-  }
-
-  pclose(fp);
-  return retrieved;
+  RecentCommitCollector collector = {commits, 0};
+  git_broker_walk_commits("HEAD", count, collect_recent_commit, &collector);
+  return collector.count;
 }
 
 int get_repo_url(char *url, size_t url_size) {
@@ -289,6 +290,35 @@ int get_repo_url(char *url, size_t url_size) {
   return 0;
 }
 
+// Ahead/behind of HEAD against its configured upstream without running git.
+// Returns 1 when counted, 0 when there is no upstream and -1 to fall back.
+static int upstream_divergence_native(int *commits_ahead, int *commits_behind) {
+  GitOdb *odb = git_odb_current();
+  if (!odb)
+    return -1;
+
+  char branch[256];
+  if (!git_odb_head_branch(odb, branch, sizeof(branch)) || !branch[0])
+    return 0;
+
+  // Upstreams set through included config files are left to git
+  char upstream[512];
+  if (!git_odb_branch_upstream(odb, branch, upstream, sizeof(upstream)))
+    return -1;
+
+  GitAheadBehind pair;
+  memset(&pair, 0, sizeof(pair));
+  if (!git_odb_resolve(odb, "HEAD", pair.local_oid) ||
+      !git_odb_resolve(odb, upstream, pair.upstream_oid))
+    return -1;
+  if (!git_ahead_behind(odb, &pair, 1))
+    return -1;
+
+  *commits_ahead = pair.ahead;
+  *commits_behind = pair.behind;
+  return 1;
+}
+
 int check_branch_divergence(int *commits_ahead, int *commits_behind) {
   if (!commits_ahead || !commits_behind) {
     return 0;
@@ -297,6 +327,12 @@ int check_branch_divergence(int *commits_ahead, int *commits_behind) {
   *commits_ahead = 0;
   *commits_behind = 0;
 
+  int native = upstream_divergence_native(commits_ahead, commits_behind);
+  if (native == 0)
+    return 0; // No remote tracking branch
+  if (native == 1)
+    return (*commits_ahead > 0 && *commits_behind > 0) ? 1 : 0;
+
   // Check if we have a remote tracking branch
   FILE *fp = popen("git rev-parse --abbrev-ref @{u} 2>/dev/null", "r");
   if (!fp) {
@@ -478,11 +514,13 @@ int get_commit_details(const char *commit_hash, char *commit_info,
   if (!is_safe_git_hash(commit_hash)) {
     return 0;
   }
+  // One git show produces the header, the stat block and the full patch
   char cmd[512];
   snprintf(
       cmd, sizeof(cmd),
-      "git show --stat=120 --format=\"commit %%H %%d%%nAuthor: %%an "
-      "<%%ae>%%nDate: %%ad%%n%%n    %%s%%n%%n    %%b %%n --\" %s 2>/dev/null",
+      "git show --stat=120 --patch --diff-merges=first-parent "
+      "--format=\"commit %%H %%d%%nAuthor: %%an <%%ae>%%nDate: "
+      "%%ad%%n%%n    %%s%%n%%n    %%b %%n --\" %s 2>/dev/null",
       commit_hash);
 
   FILE *fp = popen(cmd, "r");
@@ -491,38 +529,19 @@ int get_commit_details(const char *commit_hash, char *commit_info,
   }
   size_t total_read = 0;
   char buffer[1024];
+  int in_patch = 0;
 
   while (fgets(buffer, sizeof(buffer), fp) != NULL &&
          total_read < info_size - 1) {
-    size_t line_len = strlen(buffer);
-    if (total_read + line_len >= info_size) {
-      break;
+    // git show already separates stats and patch with one blank line, add
+    // the second one the viewer has always shown there
+    if (!in_patch && strncmp(buffer, "diff --git ", 11) == 0) {
+      in_patch = 1;
+      if (total_read < info_size - 4) {
+        commit_info[total_read++] = '\n';
+      }
     }
-    memcpy(commit_info + total_read, buffer, line_len);
-    total_read += line_len;
-  }
-  commit_info[total_read] = '\0';
-  pclose(fp);
-
-  // Now get the full diff content with all the @@ hunks and +/- lines
-  snprintf(cmd, sizeof(cmd), "git diff %s^..%s 2>/dev/null", commit_hash,
-           commit_hash);
-  fp = popen(cmd, "r");
-  if (!fp) {
-    return total_read > 0 ? 1 : 0;
-  }
-
-  // Add spacing after file stats, before diff content
-  if (total_read < info_size - 4) {
-    memcpy(commit_info + total_read, "\n\n", 2);
-    total_read += 2;
-    commit_info[total_read] = '\0';
-  }
 
-  // Read all the diff content (this includes diff --git headers, @@ hunks,
-  // and +/- lines)
-  while (fgets(buffer, sizeof(buffer), fp) != NULL &&
-         total_read < info_size - 1) {
     size_t line_len = strlen(buffer);
     if (total_read + line_len >= info_size) {
       break;
@@ -535,7 +554,7 @@ int get_commit_details(const char *commit_hash, char *commit_info,
   sanitize_terminal_output(commit_info);
   pclose(fp);
 
-  return 1;
+  return total_read > 0 ? 1 : 0;
 }
 
 int get_stash_diff(int stash_index, char *stash_diff, size_t diff_size) {
@@ -579,12 +598,118 @@ int get_stash_diff(int stash_index, char *stash_diff, size_t diff_size) {
   return total_read > 0 ? 1 : 0;
 }
 
+// Build git log's %d decoration (" (HEAD -> main, origin/main, tag: v1)")
+static void format_decorations(const char *oid, const GitRef *refs,
+                               int ref_count, const char *head_oid,
+                               const char *head_branch, char *out,
+                               size_t out_size) {
+  size_t len = 0;
+  int count = 0;
+  out[0] = '\0';
+
+#define APPEND_DECORATION(...)                                                 \
+  do {                                                                         \
+    if (len < out_size) {                                                      \
+      len += snprintf(out + len, out_size - len, "%s", count++ ? ", " : " ("); \
+    }                                                                          \
+    if (len < out_size) {                                                      \
+      len += snprintf(out + len, out_size - len, __VA_ARGS__);                 \
+    }                                                                          \
+  } while (0)
+
+  if (strcmp(oid, head_oid) == 0) {
+    if (head_branch[0]) {
+      APPEND_DECORATION("HEAD -> %s", head_branch);
+    } else {
+      APPEND_DECORATION("HEAD");
+    }
+  }
+
+  for (int i = 0; i < ref_count; i++) {
+    if (strcmp(refs[i].oid, oid) != 0)
+      continue;
+    const char *name = refs[i].name;
+    if (strncmp(name, "refs/heads/", 11) == 0) {
+      if (strcmp(name + 11, head_branch) != 0 || strcmp(oid, head_oid) != 0)
+        APPEND_DECORATION("%s", name + 11);
+    } else if (strncmp(name, "refs/remotes/", 13) == 0) {
+      APPEND_DECORATION("%s", name + 13);
+    } else if (strncmp(name, "refs/tags/", 10) == 0) {
+      APPEND_DECORATION("tag: %s", name + 10);
+    }
+  }
+#undef APPEND_DECORATION
+
+  if (count > 0 && len + 1 < out_size) {
+    out[len++] = ')';
+    out[len] = '\0';
+  }
+}
+
+// Read the branch history straight from the object database
+static int get_branch_commits_native(const char *branch_name,
+                                     char commits[][2048], int max_commits) {
+  GitOdb *odb = git_odb_current();
+  char start_oid[GIT_OID_HEX_LEN + 1];
+  if (!odb || !git_odb_resolve(odb, branch_name, start_oid)) {
+    return -1;
+  }
+
+  GitRevWalk *walk = git_revwalk_new(odb, start_oid);
+  if (!walk) {
+    return -1;
+  }
+
+  GitRef *refs = NULL;
+  int ref_count = git_odb_list_refs(odb, &refs);
+  char head_oid[GIT_OID_HEX_LEN + 1] = "";
+  char head_branch[256];
+  git_odb_resolve(odb, "HEAD", head_oid);
+  git_odb_head_branch(odb, head_branch, sizeof(head_branch));
+
+  int count = 0;
+  int status = 1;
+  GitObject commit;
+  GitCommitInfo info;
+  while (count < max_commits &&
+         (status = git_revwalk_next(walk, &commit, &info)) == 1) {
+    char decorations[512];
+    char date[64];
+    char subject[512];
+    char body[1536];
+    format_decorations(commit.oid, refs, ref_count, head_oid, head_branch,
+                       decorations, sizeof(decorations));
+    git_format_relative_date(info.author_time, date, sizeof(date));
+    git_commit_message_parts(&info, subject, sizeof(subject), body,
+                             sizeof(body));
+
+    // Same layout the git log --format used by the fallback produces
+    snprintf(commits[count], 2048,
+             "commit %s%s\nAuthor: %s <%s>\nDate: %s\n\n    %s\n\n%s%s\n",
+             commit.oid, decorations, info.author_name, info.author_email, date,
+             subject, body, body[0] ? "\n" : "");
+    count++;
+    git_object_free(&commit);
+  }
+
+  free(refs);
+  git_revwalk_free(walk);
+  // Part of the history is out of reach; git log can still read it
+  return status < 0 ? -1 : count;
+}
+
 int get_branch_commits(const char *branch_name, char commits[][2048],
                        int max_commits) {
   if (!branch_name || !commits || max_commits <= 0) {
     return 0;
   }
 
+  int native_count =
+      get_branch_commits_native(branch_name, commits, max_commits);
+  if (native_count >= 0) {
+    return native_count;
+  }
+
   char cmd[1024];
   snprintf(cmd, sizeof(cmd),
            "git log %s --format=\"commit %%H%%d%%nAuthor: %%an <%%ae>%%nDate: "
@@ -0,0 +1,356 @@
+#define _GNU_SOURCE
+#include "git_jobs.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+// jobs[0] is the running job once started; the rest wait in order
+static GitJob jobs[GIT_JOB_MAX_QUEUED];
+static int job_count = 0;
+static int next_job_id = 1;
+
+static int wake_pipe[2] = {-1, -1};
+static struct sigaction previous_sigchld;
+static int jobs_initialized = 0;
+
+static void handle_sigchld(int sig) {
+  (void)sig;
+  int saved_errno = errno;
+  if (wake_pipe[1] >= 0) {
+    ssize_t ignored = write(wake_pipe[1], "c", 1);
+    (void)ignored;
+  }
+  errno = saved_errno;
+}
+
+int git_jobs_init(void) {
+  if (jobs_initialized)
+    return 1;
+
+  if (pipe2(wake_pipe, O_CLOEXEC | O_NONBLOCK) != 0)
+    return 0;
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = handle_sigchld;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  if (sigaction(SIGCHLD, &sa, &previous_sigchld) != 0) {
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    wake_pipe[0] = wake_pipe[1] = -1;
+    return 0;
+  }
+
+  jobs_initialized = 1;
+  return 1;
+}
+
+static void free_job_strings(GitJob *job) {
+  for (int i = 0; i < GIT_JOB_MAX_ARGS && job->argv[i]; i++)
+    free(job->argv[i]);
+  for (size_t i = 0; i < sizeof(job->env) / sizeof(job->env[0]) && job->env[i];
+       i++)
+    free(job->env[i]);
+}
+
+static void remove_job(int index) {
+  memmove(&jobs[index], &jobs[index + 1],
+          (job_count - index - 1) * sizeof(GitJob));
+  job_count--;
+}
+
+// environ with the job's NAME=VALUE entries added or replaced
+static char **build_environment(const GitJob *job) {
+  size_t base = 0;
+  while (environ && environ[base])
+    base++;
+
+  size_t extra = 0;
+  while (extra < sizeof(job->env) / sizeof(job->env[0]) && job->env[extra])
+    extra++;
+
+  char **envp = malloc((base + extra + 1) * sizeof(char *));
+  if (!envp)
+    return NULL;
+
+  size_t count = 0;
+  for (size_t i = 0; i < base; i++) {
+    const char *equals = strchr(environ[i], '=');
+    size_t name_len = equals ? (size_t)(equals - environ[i]) : strlen(environ[i]);
+    int overridden = 0;
+    for (size_t e = 0; e < extra && !overridden; e++) {
+      overridden = strncmp(job->env[e], environ[i], name_len) == 0 &&
+                   job->env[e][name_len] == '=';
+    }
+    if (!overridden)
+      envp[count++] = environ[i];
+  }
+  for (size_t e = 0; e < extra; e++)
+    envp[count++] = job->env[e];
+  envp[count] = NULL;
+  return envp;
+}
+
+static int spawn_job(GitJob *job) {
+  int out[2];
+  if (pipe2(out, O_CLOEXEC) != 0)
+    return 0;
+
+  char **envp = build_environment(job);
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawnattr_init(&attr);
+
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+                                   O_RDONLY, 0);
+  posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, out[1], STDERR_FILENO);
+
+  // The shell ignores job-control signals; git should not inherit that
+  sigset_t defaults;
+  sigset_t mask;
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGINT);
+  sigaddset(&defaults, SIGQUIT);
+  sigaddset(&defaults, SIGTERM);
+  sigaddset(&defaults, SIGPIPE);
+  sigaddset(&defaults, SIGTSTP);
+  sigemptyset(&mask);
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+  posix_spawnattr_setsigmask(&attr, &mask);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK);
+
+  pid_t pid;
+  int rc = envp ? posix_spawnp(&pid, job->argv[0], &actions, &attr, job->argv,
+                               envp)
+                : ENOMEM;
+
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  free(envp);
+  close(out[1]);
+
+  if (rc != 0) {
+    close(out[0]);
+    return 0;
+  }
+
+  fcntl(out[0], F_SETFL, fcntl(out[0], F_GETFL) | O_NONBLOCK);
+  job->pid = pid;
+  job->output_fd = out[0];
+  return 1;
+}
+
+// git rewrites progress lines with '\r', so both '\r' and '\n' end a line
+static void consume_output(GitJob *job, const char *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    char c = data[i];
+    if (c == '\r' || c == '\n') {
+      while (job->partial_len > 0 && job->partial[job->partial_len - 1] == ' ')
+        job->partial_len--;
+      if (job->partial_len > 0) {
+        memcpy(job->progress, job->partial, job->partial_len);
+        job->progress[job->partial_len] = '\0';
+      }
+      job->partial_len = 0;
+    } else if (job->partial_len < sizeof(job->partial) - 1) {
+      job->partial[job->partial_len++] = c;
+    }
+  }
+}
+
+static void drain_output(GitJob *job) {
+  if (job->output_fd < 0)
+    return;
+
+  char buffer[4096];
+  while (1) {
+    ssize_t n = read(job->output_fd, buffer, sizeof(buffer));
+    if (n > 0) {
+      consume_output(job, buffer, (size_t)n);
+      continue;
+    }
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n == 0) {
+      close(job->output_fd);
+      job->output_fd = -1;
+    }
+    break;
+  }
+}
+
+static void finish_front_job(int exit_status) {
+  GitJob done = jobs[0];
+  remove_job(0);
+
+  if (done.output_fd >= 0)
+    close(done.output_fd);
+  done.output_fd = -1;
+  done.exit_status = exit_status;
+
+  // Callbacks may queue follow-up jobs, so run them after removal
+  if (done.on_done)
+    done.on_done(&done, done.ctx);
+  free_job_strings(&done);
+}
+
+static void start_next_job(void) {
+  while (job_count > 0 && jobs[0].pid == 0) {
+    if (spawn_job(&jobs[0]))
+      return;
+    finish_front_job(127);
+  }
+}
+
+int git_jobs_submit(const char *label, const char *const argv[],
+                    const char *const env[], int flags, GitJobCallback on_done,
+                    void *ctx) {
+  if (!argv || !argv[0])
+    return 0;
+  if (!jobs_initialized && !git_jobs_init())
+    return 0;
+
+  if (flags & GIT_JOB_COALESCE) {
+    // Only jobs that have not started yet still cover the new request
+    for (int i = 0; i < job_count; i++) {
+      GitJob *queued = &jobs[i];
+      if (queued->pid != 0 || strcmp(queued->label, label ? label : "") != 0)
+        continue;
+
+      int same = 1;
+      for (int a = 0; same && a < GIT_JOB_MAX_ARGS; a++) {
+        const char *want = argv[a];
+        if (!want || !queued->argv[a]) {
+          same = !want && !queued->argv[a];
+          break;
+        }
+        same = strcmp(want, queued->argv[a]) == 0;
+      }
+      if (same)
+        return queued->id;
+    }
+  }
+
+  if (job_count >= GIT_JOB_MAX_QUEUED)
+    return 0;
+
+  GitJob *job = &jobs[job_count];
+  memset(job, 0, sizeof(*job));
+  snprintf(job->label, sizeof(job->label), "%s", label ? label : "");
+  for (int i = 0; argv[i]; i++) {
+    if (i >= GIT_JOB_MAX_ARGS - 1 || !(job->argv[i] = strdup(argv[i]))) {
+      free_job_strings(job);
+      return 0;
+    }
+  }
+  for (size_t i = 0;
+       env && env[i] && i < sizeof(job->env) / sizeof(job->env[0]) - 1; i++) {
+    if (!(job->env[i] = strdup(env[i]))) {
+      free_job_strings(job);
+      return 0;
+    }
+  }
+  job->id = next_job_id++;
+  job->flags = flags;
+  job->output_fd = -1;
+  job->exit_status = -1;
+  job->on_done = on_done;
+  job->ctx = ctx;
+  job_count++;
+
+  // A failed spawn completes the job right away, so keep the id first
+  int id = job->id;
+  start_next_job();
+  return id;
+}
+
+int git_jobs_active(const char *label) {
+  int count = 0;
+  for (int i = 0; i < job_count; i++) {
+    if (!label || strcmp(jobs[i].label, label) == 0)
+      count++;
+  }
+  return count;
+}
+
+const GitJob *git_jobs_running(void) {
+  return job_count > 0 && jobs[0].pid > 0 ? &jobs[0] : NULL;
+}
+
+int git_jobs_pollfds(struct pollfd *fds, int max) {
+  int count = 0;
+  if (wake_pipe[0] >= 0 && count < max) {
+    fds[count].fd = wake_pipe[0];
+    fds[count].events = POLLIN;
+    fds[count].revents = 0;
+    count++;
+  }
+  if (job_count > 0 && jobs[0].output_fd >= 0 && count < max) {
+    fds[count].fd = jobs[0].output_fd;
+    fds[count].events = POLLIN;
+    fds[count].revents = 0;
+    count++;
+  }
+  return count;
+}
+
+void git_jobs_dispatch(void) {
+  if (!jobs_initialized)
+    return;
+
+  char wake[64];
+  while (read(wake_pipe[0], wake, sizeof(wake)) > 0) {
+  }
+
+  while (job_count > 0 && jobs[0].pid > 0) {
+    drain_output(&jobs[0]);
+
+    int status;
+    pid_t reaped = waitpid(jobs[0].pid, &status, WNOHANG);
+    if (reaped == 0)
+      break;
+
+    // Pick up anything written between the last read and the exit
+    drain_output(&jobs[0]);
+    if (jobs[0].partial_len > 0)
+      consume_output(&jobs[0], "\n", 1);
+
+    int exit_status = 1;
+    if (reaped == jobs[0].pid && WIFEXITED(status))
+      exit_status = WEXITSTATUS(status);
+    finish_front_job(exit_status);
+    start_next_job();
+  }
+}
+
+void git_jobs_shutdown(void) {
+  if (!jobs_initialized)
+    return;
+
+  if (job_count > 0 && jobs[0].pid > 0) {
+    if (jobs[0].flags & GIT_JOB_CANCEL_ON_EXIT)
+      kill(jobs[0].pid, SIGTERM);
+    while (waitpid(jobs[0].pid, NULL, 0) < 0 && errno == EINTR) {
+    }
+    if (jobs[0].output_fd >= 0)
+      close(jobs[0].output_fd);
+  }
+  for (int i = 0; i < job_count; i++)
+    free_job_strings(&jobs[i]);
+  job_count = 0;
+
+  sigaction(SIGCHLD, &previous_sigchld, NULL);
+  close(wake_pipe[0]);
+  close(wake_pipe[1]);
+  wake_pipe[0] = wake_pipe[1] = -1;
+  jobs_initialized = 0;
+}
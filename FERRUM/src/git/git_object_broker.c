@@ -0,0 +1,690 @@
+#define _GNU_SOURCE
+#include "git_object_broker.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// One git cat-file coprocess, talking over a pair of pipes
+typedef struct {
+  pid_t pid;
+  int request_fd; // Write end, connected to git's stdin
+  FILE *response; // Read end, connected to git's stdout
+} GitCatFileProcess;
+
+typedef struct {
+  char git_dir[PATH_MAX];
+  GitCatFileProcess batch; // cat-file --batch (header + content)
+  GitCatFileProcess check; // cat-file --batch-check (header only)
+  struct timespec index_mtime; // Index state the coprocesses have loaded
+  off_t index_size;
+  unsigned long last_used;
+} GitObjectBroker;
+
+static GitObjectBroker brokers[GIT_BROKER_MAX_REPOS];
+static unsigned long broker_clock = 0;
+static int broker_atexit_registered = 0;
+
+int git_find_git_dir(char *git_dir, size_t size) {
+  char dir[PATH_MAX];
+  if (!getcwd(dir, sizeof(dir))) {
+    return 0;
+  }
+
+  while (1) {
+    char candidate[PATH_MAX + 8];
+    struct stat st;
+    snprintf(candidate, sizeof(candidate), "%s/.git", dir);
+
+    if (stat(candidate, &st) == 0) {
+      if (S_ISDIR(st.st_mode)) {
+        snprintf(git_dir, size, "%s", candidate);
+        return 1;
+      }
+
+      FILE *fp = fopen(candidate, "r");
+      if (fp) {
+        char line[PATH_MAX];
+        int found = 0;
+        if (fgets(line, sizeof(line), fp) &&
+            strncmp(line, "gitdir: ", 8) == 0) {
+          char *newline = strchr(line, '\n');
+          if (newline)
+            *newline = '\0';
+          if (line[8] == '/') {
+            snprintf(git_dir, size, "%s", line + 8);
+          } else {
+            snprintf(git_dir, size, "%s/%s", dir, line + 8);
+          }
+          found = 1;
+        }
+        fclose(fp);
+        if (found)
+          return 1;
+      }
+    }
+
+    char *slash = strrchr(dir, '/');
+    if (!slash || slash == dir) {
+      return 0;
+    }
+    *slash = '\0';
+  }
+}
+
+static void stop_cat_file(GitCatFileProcess *proc) {
+  if (proc->request_fd >= 0) {
+    close(proc->request_fd);
+  }
+  if (proc->response) {
+    fclose(proc->response);
+  }
+  if (proc->pid > 0) {
+    // Closing stdin makes cat-file exit on its own
+    waitpid(proc->pid, NULL, 0);
+  }
+  proc->pid = 0;
+  proc->request_fd = -1;
+  proc->response = NULL;
+}
+
+static int start_cat_file(GitCatFileProcess *proc, const char *git_dir,
+                          const char *mode) {
+  int to_child[2];
+  int from_child[2];
+
+  if (pipe2(to_child, O_CLOEXEC) != 0) {
+    return 0;
+  }
+  if (pipe2(from_child, O_CLOEXEC) != 0) {
+    close(to_child[0]);
+    close(to_child[1]);
+    return 0;
+  }
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(to_child[0]);
+    close(to_child[1]);
+    close(from_child[0]);
+    close(from_child[1]);
+    return 0;
+  }
+
+  if (pid == 0) {
+    // dup2 clears close-on-exec on the copies git will use
+    dup2(to_child[0], STDIN_FILENO);
+    dup2(from_child[1], STDOUT_FILENO);
+    int devnull = open("/dev/null", O_WRONLY);
+    if (devnull >= 0) {
+      dup2(devnull, STDERR_FILENO);
+    }
+    execlp("git", "git", "--git-dir", git_dir, "cat-file", mode, (char *)NULL);
+    _exit(127);
+  }
+
+  close(to_child[0]);
+  close(from_child[1]);
+
+  proc->pid = pid;
+  proc->request_fd = to_child[1];
+  proc->response = fdopen(from_child[0], "r");
+  if (!proc->response) {
+    close(from_child[0]);
+    stop_cat_file(proc);
+    return 0;
+  }
+  return 1;
+}
+
+// Write a request without letting a dead coprocess kill the shell with
+// SIGPIPE. A pending SIGPIPE raised by our own write is consumed here.
+static int write_request(int fd, const char *buf, size_t len) {
+  sigset_t pipe_set, old_set;
+  sigemptyset(&pipe_set);
+  sigaddset(&pipe_set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+
+  int ok = 1;
+  while (len > 0) {
+    ssize_t written = write(fd, buf, len);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      ok = 0;
+      break;
+    }
+    buf += written;
+    len -= (size_t)written;
+  }
+
+  if (!ok && errno == EPIPE) {
+    struct timespec zero = {0, 0};
+    sigtimedwait(&pipe_set, NULL, &zero);
+  }
+
+  pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+  return ok;
+}
+
+static GitObjectBroker *get_broker(void) {
+  char git_dir[PATH_MAX];
+  if (!git_find_git_dir(git_dir, sizeof(git_dir))) {
+    return NULL;
+  }
+
+  if (!broker_atexit_registered) {
+    atexit(git_broker_shutdown);
+    broker_atexit_registered = 1;
+  }
+
+  GitObjectBroker *slot = NULL;
+  for (int i = 0; i < GIT_BROKER_MAX_REPOS; i++) {
+    if (brokers[i].git_dir[0] != '\0' &&
+        strcmp(brokers[i].git_dir, git_dir) == 0) {
+      brokers[i].last_used = ++broker_clock;
+      return &brokers[i];
+    }
+    // Prefer an empty slot, otherwise evict the least recently used repo
+    if (!slot || (slot->git_dir[0] != '\0' &&
+                  (brokers[i].git_dir[0] == '\0' ||
+                   brokers[i].last_used < slot->last_used))) {
+      slot = &brokers[i];
+    }
+  }
+
+  if (slot->git_dir[0] != '\0') {
+    stop_cat_file(&slot->batch);
+    stop_cat_file(&slot->check);
+  }
+
+  memset(slot, 0, sizeof(*slot));
+  slot->batch.request_fd = -1;
+  slot->check.request_fd = -1;
+  snprintf(slot->git_dir, sizeof(slot->git_dir), "%s", git_dir);
+  slot->last_used = ++broker_clock;
+  return slot;
+}
+
+// Send one request and parse the "<oid> <type> <size>" header. Returns 1 on
+// success, 0 if the object does not exist and -1 if the coprocess broke.
+static int query_cat_file(GitCatFileProcess *proc, const char *git_dir,
+                          const char *mode, const char *rev, GitObject *obj) {
+  if (proc->pid <= 0 && !start_cat_file(proc, git_dir, mode)) {
+    return -1;
+  }
+
+  char request[PATH_MAX + 2];
+  int len = snprintf(request, sizeof(request), "%s\n", rev);
+  if (len <= 0 || (size_t)len >= sizeof(request)) {
+    return 0;
+  }
+
+  if (!write_request(proc->request_fd, request, (size_t)len)) {
+    return -1;
+  }
+
+  char header[PATH_MAX + 64];
+  if (!fgets(header, sizeof(header), proc->response)) {
+    return -1;
+  }
+
+  // "<rev> missing" / "<rev> ambiguous"
+  size_t header_len = strlen(header);
+  if ((header_len >= 9 && strcmp(header + header_len - 9, " missing\n") == 0) ||
+      (header_len >= 11 &&
+       strcmp(header + header_len - 11, " ambiguous\n") == 0)) {
+    return 0;
+  }
+
+  if (sscanf(header, "%40s %15s %zu", obj->oid, obj->type, &obj->size) != 3) {
+    return -1;
+  }
+  return 1;
+}
+
+// cat-file reads the index once, so ":path" lookups go stale after staging.
+// Restart the coprocesses whenever the index file changed since they started.
+static void refresh_index_state(GitObjectBroker *broker) {
+  char index_path[PATH_MAX + 8];
+  struct stat st;
+  snprintf(index_path, sizeof(index_path), "%s/index", broker->git_dir);
+  if (stat(index_path, &st) != 0) {
+    memset(&st, 0, sizeof(st));
+  }
+
+  if (st.st_mtim.tv_sec != broker->index_mtime.tv_sec ||
+      st.st_mtim.tv_nsec != broker->index_mtime.tv_nsec ||
+      st.st_size != broker->index_size) {
+    stop_cat_file(&broker->batch);
+    stop_cat_file(&broker->check);
+    broker->index_mtime = st.st_mtim;
+    broker->index_size = st.st_size;
+  }
+}
+
+static int broker_request(int with_content, const char *rev, GitObject *obj) {
+  if (!rev || !obj || rev[0] == '\0' || strchr(rev, '\n')) {
+    return 0;
+  }
+  memset(obj, 0, sizeof(*obj));
+
+  GitObjectBroker *broker = get_broker();
+  if (!broker) {
+    return 0;
+  }
+
+  if (rev[0] == ':') {
+    refresh_index_state(broker);
+  }
+
+  GitCatFileProcess *proc = with_content ? &broker->batch : &broker->check;
+  const char *mode = with_content ? "--batch" : "--batch-check";
+
+  // A crashed or killed coprocess gets restarted once per request
+  for (int attempt = 0; attempt < 2; attempt++) {
+    int result = query_cat_file(proc, broker->git_dir, mode, rev, obj);
+    if (result == 0) {
+      return 0;
+    }
+    if (result < 0) {
+      stop_cat_file(proc);
+      continue;
+    }
+
+    if (!with_content) {
+      return 1;
+    }
+
+    obj->data = malloc(obj->size + 1);
+    if (obj->data && fread(obj->data, 1, obj->size, proc->response) == obj->size &&
+        fgetc(proc->response) == '\n') {
+      obj->data[obj->size] = '\0';
+      return 1;
+    }
+
+    // Out of sync with the stream, start over with a fresh process
+    free(obj->data);
+    obj->data = NULL;
+    stop_cat_file(proc);
+  }
+
+  return 0;
+}
+
+int git_broker_read_object(const char *rev, GitObject *obj) {
+  return broker_request(1, rev, obj);
+}
+
+int git_broker_object_info(const char *rev, GitObject *obj) {
+  return broker_request(0, rev, obj);
+}
+
+void git_object_free(GitObject *obj) {
+  if (obj) {
+    free(obj->data);
+    obj->data = NULL;
+    obj->size = 0;
+  }
+}
+
+// Parse "Name <email> 1700000000 +0100" from an author/committer line
+static void parse_signature(const char *line, const char *end, char *name,
+                            size_t name_size, char *email, size_t email_size,
+                            time_t *when) {
+  const char *lt = memchr(line, '<', end - line);
+  const char *gt = lt ? memchr(lt, '>', end - lt) : NULL;
+  if (!lt || !gt) {
+    return;
+  }
+
+  if (name) {
+    size_t len = (size_t)(lt - line);
+    while (len > 0 && line[len - 1] == ' ')
+      len--;
+    if (len >= name_size)
+      len = name_size - 1;
+    memcpy(name, line, len);
+    name[len] = '\0';
+  }
+
+  if (email) {
+    size_t len = (size_t)(gt - lt - 1);
+    if (len >= email_size)
+      len = email_size - 1;
+    memcpy(email, lt + 1, len);
+    email[len] = '\0';
+  }
+
+  if (when) {
+    *when = (time_t)strtoll(gt + 1, NULL, 10);
+  }
+}
+
+int git_parse_commit(const char *data, size_t size, GitCommitInfo *info) {
+  if (!data || !info) {
+    return 0;
+  }
+  memset(info, 0, sizeof(*info));
+
+  const char *pos = data;
+  const char *end = data + size;
+
+  while (pos < end) {
+    const char *line_end = memchr(pos, '\n', end - pos);
+    if (!line_end)
+      line_end = end;
+
+    // A blank line separates the headers from the message
+    if (line_end == pos) {
+      info->message = pos + 1 < end ? pos + 1 : end;
+      info->message_len = (size_t)(end - info->message);
+      return info->tree[0] != '\0';
+    }
+
+    size_t len = (size_t)(line_end - pos);
+    if (len >= 5 + GIT_OID_HEX_LEN && strncmp(pos, "tree ", 5) == 0) {
+      memcpy(info->tree, pos + 5, GIT_OID_HEX_LEN);
+      info->tree[GIT_OID_HEX_LEN] = '\0';
+    } else if (len >= 7 + GIT_OID_HEX_LEN && strncmp(pos, "parent ", 7) == 0) {
+      if (info->parent_count < GIT_MAX_PARENTS) {
+        memcpy(info->parents[info->parent_count], pos + 7, GIT_OID_HEX_LEN);
+        info->parents[info->parent_count][GIT_OID_HEX_LEN] = '\0';
+        info->parent_count++;
+      }
+    } else if (strncmp(pos, "author ", 7) == 0) {
+      parse_signature(pos + 7, line_end, info->author_name,
+                      sizeof(info->author_name), info->author_email,
+                      sizeof(info->author_email), &info->author_time);
+    } else if (strncmp(pos, "committer ", 10) == 0) {
+      parse_signature(pos + 10, line_end, NULL, 0, NULL, 0,
+                      &info->committer_time);
+    }
+    // Anything else (gpgsig continuation lines, encoding, ...) is skipped
+
+    pos = line_end + 1;
+  }
+
+  info->message = end;
+  info->message_len = 0;
+  return info->tree[0] != '\0';
+}
+
+void git_commit_message_parts(const GitCommitInfo *info, char *subject,
+                              size_t subject_size, char *body,
+                              size_t body_size) {
+  const char *msg = info ? info->message : NULL;
+  const char *end = msg ? msg + info->message_len : NULL;
+
+  if (subject && subject_size > 0)
+    subject[0] = '\0';
+  if (body && body_size > 0)
+    body[0] = '\0';
+  if (!msg) {
+    return;
+  }
+
+  const char *subject_end = memchr(msg, '\n', end - msg);
+  if (!subject_end)
+    subject_end = end;
+
+  if (subject && subject_size > 0) {
+    size_t len = (size_t)(subject_end - msg);
+    if (len >= subject_size)
+      len = subject_size - 1;
+    memcpy(subject, msg, len);
+    subject[len] = '\0';
+  }
+
+  if (body && body_size > 0 && subject_end < end) {
+    const char *body_start = subject_end + 1;
+    while (body_start < end && *body_start == '\n')
+      body_start++;
+    size_t len = (size_t)(end - body_start);
+    while (len > 0 && body_start[len - 1] == '\n')
+      len--;
+    if (len >= body_size)
+      len = body_size - 1;
+    memcpy(body, body_start, len);
+    body[len] = '\0';
+  }
+}
+
+// Same thresholds as git's %ar so output matches git log
+void git_format_relative_date(time_t when, char *out, size_t out_size) {
+  time_t now = time(NULL);
+  long long diff = (long long)(now - when);
+
+  if (diff < 0) {
+    snprintf(out, out_size, "in the future");
+    return;
+  }
+
+#define PLURAL(n) ((n) == 1 ? "" : "s")
+  if (diff < 90) {
+    snprintf(out, out_size, "%lld second%s ago", diff, PLURAL(diff));
+    return;
+  }
+  diff = (diff + 30) / 60;
+  if (diff < 90) {
+    snprintf(out, out_size, "%lld minute%s ago", diff, PLURAL(diff));
+    return;
+  }
+  diff = (diff + 30) / 60;
+  if (diff < 36) {
+    snprintf(out, out_size, "%lld hour%s ago", diff, PLURAL(diff));
+    return;
+  }
+  diff = (diff + 12) / 24;
+  if (diff < 14) {
+    snprintf(out, out_size, "%lld day%s ago", diff, PLURAL(diff));
+    return;
+  }
+  if (diff < 70) {
+    long long weeks = (diff + 3) / 7;
+    snprintf(out, out_size, "%lld week%s ago", weeks, PLURAL(weeks));
+    return;
+  }
+  if (diff < 365) {
+    long long months = (diff + 15) / 30;
+    snprintf(out, out_size, "%lld month%s ago", months, PLURAL(months));
+    return;
+  }
+
+  long long total_months = (diff * 12 * 2 + 365) / (365 * 2);
+  long long years = total_months / 12;
+  long long months = total_months % 12;
+  if (diff < 1825 && months > 0) {
+    snprintf(out, out_size, "%lld year%s, %lld month%s ago", years,
+             PLURAL(years), months, PLURAL(months));
+  } else {
+    years = (diff + 183) / 365;
+    snprintf(out, out_size, "%lld year%s ago", years, PLURAL(years));
+  }
+#undef PLURAL
+}
+
+typedef struct {
+  char oid[GIT_OID_HEX_LEN + 1];
+  GitObject commit; // Read when queued so the date is known for ordering
+  GitCommitInfo info;
+} GitWalkEntry;
+
+// Binary max-heap of pending commits on committer date, plus an
+// open-addressing set of every queued id so merges are only visited once
+typedef struct {
+  GitWalkEntry *heap;
+  int heap_count;
+  int heap_capacity;
+  char (*seen)[GIT_OID_HEX_LEN + 1]; // Empty string = free slot
+  size_t seen_slots;
+  size_t seen_count;
+} GitWalkQueue;
+
+static size_t oid_hash(const char *oid) {
+  // Object ids are already uniformly distributed
+  char prefix[9];
+  snprintf(prefix, sizeof(prefix), "%s", oid);
+  return (size_t)strtoul(prefix, NULL, 16);
+}
+
+static int walk_seen_insert(GitWalkQueue *queue, const char *oid);
+
+static int walk_seen_grow(GitWalkQueue *queue) {
+  size_t old_slots = queue->seen_slots;
+  char(*old)[GIT_OID_HEX_LEN + 1] = queue->seen;
+
+  queue->seen_slots = old_slots ? old_slots * 2 : 1024;
+  queue->seen = calloc(queue->seen_slots, sizeof(*queue->seen));
+  if (!queue->seen) {
+    queue->seen = old;
+    queue->seen_slots = old_slots;
+    return 0;
+  }
+  queue->seen_count = 0;
+  for (size_t i = 0; i < old_slots; i++) {
+    if (old[i][0])
+      walk_seen_insert(queue, old[i]);
+  }
+  free(old);
+  return 1;
+}
+
+// Returns 1 if newly inserted, 0 if already present (or out of memory)
+static int walk_seen_insert(GitWalkQueue *queue, const char *oid) {
+  if ((queue->seen_count + 1) * 2 > queue->seen_slots &&
+      !walk_seen_grow(queue))
+    return 0;
+
+  size_t slot = oid_hash(oid) & (queue->seen_slots - 1);
+  while (queue->seen[slot][0]) {
+    if (strcmp(queue->seen[slot], oid) == 0)
+      return 0;
+    slot = (slot + 1) & (queue->seen_slots - 1);
+  }
+  snprintf(queue->seen[slot], sizeof(queue->seen[slot]), "%s", oid);
+  queue->seen_count++;
+  return 1;
+}
+
+static void walk_swap(GitWalkEntry *a, GitWalkEntry *b) {
+  GitWalkEntry tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+static int walk_queue_commit(GitWalkQueue *queue, const char *rev) {
+  if (queue->heap_count >= queue->heap_capacity) {
+    int capacity = queue->heap_capacity ? queue->heap_capacity * 2 : 16;
+    GitWalkEntry *grown =
+        realloc(queue->heap, capacity * sizeof(GitWalkEntry));
+    if (!grown)
+      return 0;
+    queue->heap = grown;
+    queue->heap_capacity = capacity;
+  }
+
+  GitWalkEntry *entry = &queue->heap[queue->heap_count];
+  if (!git_broker_read_object(rev, &entry->commit)) {
+    return 0;
+  }
+  if (strcmp(entry->commit.type, "commit") != 0 ||
+      !git_parse_commit(entry->commit.data, entry->commit.size, &entry->info)) {
+    git_object_free(&entry->commit);
+    return 0;
+  }
+  strcpy(entry->oid, entry->commit.oid);
+
+  int i = queue->heap_count++;
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (queue->heap[parent].info.committer_time >=
+        queue->heap[i].info.committer_time)
+      break;
+    walk_swap(&queue->heap[parent], &queue->heap[i]);
+    i = parent;
+  }
+  return 1;
+}
+
+static GitWalkEntry walk_pop_newest(GitWalkQueue *queue) {
+  GitWalkEntry top = queue->heap[0];
+  queue->heap[0] = queue->heap[--queue->heap_count];
+
+  int i = 0;
+  while (1) {
+    int left = i * 2 + 1;
+    int right = left + 1;
+    int largest = i;
+    if (left < queue->heap_count &&
+        queue->heap[left].info.committer_time >
+            queue->heap[largest].info.committer_time)
+      largest = left;
+    if (right < queue->heap_count &&
+        queue->heap[right].info.committer_time >
+            queue->heap[largest].info.committer_time)
+      largest = right;
+    if (largest == i)
+      break;
+    walk_swap(&queue->heap[i], &queue->heap[largest]);
+    i = largest;
+  }
+  return top;
+}
+
+int git_broker_walk_commits(const char *start_rev, int max_commits,
+                            GitCommitVisitor visitor, void *ctx) {
+  if (!start_rev || max_commits <= 0 || !visitor) {
+    return 0;
+  }
+
+  // Pending commits are popped newest committer date first like git log
+  GitWalkQueue queue = {0};
+  if (!walk_queue_commit(&queue, start_rev) ||
+      !walk_seen_insert(&queue, queue.heap[0].oid)) {
+    for (int i = 0; i < queue.heap_count; i++)
+      git_object_free(&queue.heap[i].commit);
+    free(queue.heap);
+    free(queue.seen);
+    return 0;
+  }
+
+  int visited = 0;
+  int keep_going = 1;
+  while (queue.heap_count > 0 && visited < max_commits && keep_going) {
+    GitWalkEntry entry = walk_pop_newest(&queue);
+
+    keep_going = visitor(entry.oid, &entry.info, ctx);
+    visited++;
+
+    for (int p = 0; p < entry.info.parent_count && keep_going; p++) {
+      const char *parent = entry.info.parents[p];
+      if (walk_seen_insert(&queue, parent))
+        walk_queue_commit(&queue, parent);
+    }
+
+    git_object_free(&entry.commit);
+  }
+
+  for (int i = 0; i < queue.heap_count; i++) {
+    git_object_free(&queue.heap[i].commit);
+  }
+  free(queue.heap);
+  free(queue.seen);
+  return visited;
+}
+
+void git_broker_shutdown(void) {
+  for (int i = 0; i < GIT_BROKER_MAX_REPOS; i++) {
+    if (brokers[i].git_dir[0] == '\0')
+      continue;
+    stop_cat_file(&brokers[i].batch);
+    stop_cat_file(&brokers[i].check);
+    brokers[i].git_dir[0] = '\0';
+  }
+}
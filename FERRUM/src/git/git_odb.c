@@ -0,0 +1,1542 @@
+#define _GNU_SOURCE
+#include "git_odb.h"
+#include <dirent.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define GIT_OBJ_COMMIT 1
+#define GIT_OBJ_TREE 2
+#define GIT_OBJ_BLOB 3
+#define GIT_OBJ_TAG 4
+#define GIT_OBJ_OFS_DELTA 6
+#define GIT_OBJ_REF_DELTA 7
+
+typedef struct {
+  unsigned char *idx;
+  size_t idx_size;
+  unsigned char *pack;
+  size_t pack_size;
+  uint32_t count;
+  const unsigned char *fanout;
+  const unsigned char *oids;
+  const unsigned char *offsets32;
+  const unsigned char *offsets64;
+} GitPack;
+
+typedef struct {
+  int pack_index; // -1 when the slot is empty
+  uint64_t offset;
+  int type;
+  unsigned char *data;
+  size_t size;
+} GitDeltaCacheEntry;
+
+typedef struct {
+  unsigned char oid[GIT_OID_RAW_LEN];
+  uint32_t generation; // 0 when the slot is empty
+} GitGenerationEntry;
+
+struct GitOdb {
+  char git_dir[PATH_MAX];
+  char common_dir[PATH_MAX];
+  char objects_dir[PATH_MAX + 16];
+  GitPack *packs;
+  int pack_count;
+  struct timespec packs_mtime; // objects/pack when the packs were loaded
+
+  // The current-repository slot and every history walk hold a reference
+  int refs;
+
+  // Direct-mapped cache of delta bases, bounded by GIT_DELTA_CACHE_MAX_BYTES
+  GitDeltaCacheEntry cache[GIT_DELTA_CACHE_SLOTS];
+  size_t cache_bytes;
+
+  // packed-refs, reloaded when the file changes
+  GitRef *packed_refs;
+  int packed_ref_count;
+  struct timespec packed_refs_mtime;
+  off_t packed_refs_size;
+
+  // Topological levels worked out for commits when there is no
+  // commit-graph. History never changes, so they stay valid while open.
+  GitGenerationEntry *generations;
+  size_t generation_slots;
+  size_t generation_count;
+};
+
+static GitOdb *current_odb = NULL;
+
+static const char *type_names[] = {"", "commit", "tree", "blob", "tag"};
+
+static uint32_t read_be32(const unsigned char *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+         ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static uint64_t read_be64(const unsigned char *p) {
+  return ((uint64_t)read_be32(p) << 32) | read_be32(p + 4);
+}
+
+static int hex_value(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+int git_oid_from_hex(const char *hex, unsigned char *raw) {
+  for (int i = 0; i < GIT_OID_RAW_LEN; i++) {
+    int hi = hex_value(hex[i * 2]);
+    int lo = hi < 0 ? -1 : hex_value(hex[i * 2 + 1]);
+    if (lo < 0)
+      return 0;
+    raw[i] = (unsigned char)((hi << 4) | lo);
+  }
+  return 1;
+}
+
+void git_oid_to_hex(const unsigned char *raw, char *hex) {
+  static const char digits[] = "0123456789abcdef";
+  for (int i = 0; i < GIT_OID_RAW_LEN; i++) {
+    hex[i * 2] = digits[raw[i] >> 4];
+    hex[i * 2 + 1] = digits[raw[i] & 0xf];
+  }
+  hex[GIT_OID_HEX_LEN] = '\0';
+}
+
+static int is_full_hex_oid(const char *s) {
+  if (strlen(s) != GIT_OID_HEX_LEN)
+    return 0;
+  for (int i = 0; i < GIT_OID_HEX_LEN; i++) {
+    if (hex_value(s[i]) < 0)
+      return 0;
+  }
+  return 1;
+}
+
+static int type_from_name(const char *name) {
+  for (int i = GIT_OBJ_COMMIT; i <= GIT_OBJ_TAG; i++) {
+    if (strcmp(name, type_names[i]) == 0)
+      return i;
+  }
+  return 0;
+}
+
+static void *map_file(const char *path, size_t *size) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    *size = (size_t)st.st_size;
+  }
+  close(fd);
+  return map == MAP_FAILED ? NULL : map;
+}
+
+// Map a version 2 .idx file together with its .pack
+static int open_pack(GitPack *pack, const char *idx_path) {
+  memset(pack, 0, sizeof(*pack));
+
+  pack->idx = map_file(idx_path, &pack->idx_size);
+  if (!pack->idx)
+    return 0;
+
+  if (pack->idx_size < 8 + 256 * 4 + 40 ||
+      memcmp(pack->idx, "\377tOc", 4) != 0 || read_be32(pack->idx + 4) != 2) {
+    munmap(pack->idx, pack->idx_size);
+    return 0;
+  }
+
+  pack->fanout = pack->idx + 8;
+  pack->count = read_be32(pack->fanout + 255 * 4);
+  pack->oids = pack->fanout + 256 * 4;
+  pack->offsets32 = pack->oids + (size_t)pack->count * GIT_OID_RAW_LEN +
+                    (size_t)pack->count * 4; // skip the CRC table
+  pack->offsets64 = pack->offsets32 + (size_t)pack->count * 4;
+  if ((size_t)(pack->offsets64 - pack->idx) > pack->idx_size) {
+    munmap(pack->idx, pack->idx_size);
+    return 0;
+  }
+
+  char pack_path[PATH_MAX];
+  size_t len = strlen(idx_path);
+  snprintf(pack_path, sizeof(pack_path), "%.*s.pack", (int)(len - 4), idx_path);
+  pack->pack = map_file(pack_path, &pack->pack_size);
+  if (!pack->pack || pack->pack_size < 12 || memcmp(pack->pack, "PACK", 4) != 0) {
+    if (pack->pack)
+      munmap(pack->pack, pack->pack_size);
+    munmap(pack->idx, pack->idx_size);
+    return 0;
+  }
+  return 1;
+}
+
+static void clear_delta_cache(GitOdb *odb) {
+  for (int i = 0; i < GIT_DELTA_CACHE_SLOTS; i++) {
+    free(odb->cache[i].data);
+    odb->cache[i].data = NULL;
+    odb->cache[i].pack_index = -1;
+  }
+  odb->cache_bytes = 0;
+}
+
+static void close_packs(GitOdb *odb) {
+  for (int i = 0; i < odb->pack_count; i++) {
+    munmap(odb->packs[i].idx, odb->packs[i].idx_size);
+    munmap(odb->packs[i].pack, odb->packs[i].pack_size);
+  }
+  free(odb->packs);
+  odb->packs = NULL;
+  odb->pack_count = 0;
+  // Cache entries are keyed by pack index, which is about to change
+  clear_delta_cache(odb);
+}
+
+static void pack_dir_mtime(const GitOdb *odb, struct timespec *mtime) {
+  char pack_dir[PATH_MAX + 32];
+  snprintf(pack_dir, sizeof(pack_dir), "%s/pack", odb->objects_dir);
+  struct stat st;
+  if (stat(pack_dir, &st) != 0)
+    memset(&st, 0, sizeof(st));
+  *mtime = st.st_mtim;
+}
+
+static void load_packs(GitOdb *odb) {
+  close_packs(odb);
+
+  // Taken before reading so that a pack added meanwhile shows as a change
+  pack_dir_mtime(odb, &odb->packs_mtime);
+
+  char pack_dir[PATH_MAX + 32];
+  snprintf(pack_dir, sizeof(pack_dir), "%s/pack", odb->objects_dir);
+  DIR *dir = opendir(pack_dir);
+  if (!dir)
+    return;
+
+  int capacity = 8;
+  odb->packs = malloc(capacity * sizeof(GitPack));
+  struct dirent *entry;
+  while (odb->packs && (entry = readdir(dir)) != NULL) {
+    size_t len = strlen(entry->d_name);
+    if (len < 5 || strcmp(entry->d_name + len - 4, ".idx") != 0)
+      continue;
+
+    if (odb->pack_count >= capacity) {
+      GitPack *grown = realloc(odb->packs, capacity * 2 * sizeof(GitPack));
+      if (!grown)
+        break;
+      odb->packs = grown;
+      capacity *= 2;
+    }
+
+    char idx_path[PATH_MAX * 2];
+    snprintf(idx_path, sizeof(idx_path), "%s/%s", pack_dir, entry->d_name);
+    if (open_pack(&odb->packs[odb->pack_count], idx_path))
+      odb->pack_count++;
+  }
+  closedir(dir);
+}
+
+static int find_in_pack(const GitPack *pack, const unsigned char *raw,
+                        uint64_t *offset) {
+  uint32_t lo = raw[0] == 0 ? 0 : read_be32(pack->fanout + (raw[0] - 1) * 4);
+  uint32_t hi = read_be32(pack->fanout + raw[0] * 4);
+
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    int cmp = memcmp(pack->oids + (size_t)mid * GIT_OID_RAW_LEN, raw,
+                     GIT_OID_RAW_LEN);
+    if (cmp == 0) {
+      uint32_t off = read_be32(pack->offsets32 + (size_t)mid * 4);
+      if (off & 0x80000000u) {
+        const unsigned char *large =
+            pack->offsets64 + (size_t)(off & 0x7fffffffu) * 8;
+        if ((size_t)(large + 8 - pack->idx) > pack->idx_size)
+          return 0;
+        *offset = read_be64(large);
+      } else {
+        *offset = off;
+      }
+      return *offset < pack->pack_size;
+    }
+    if (cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return 0;
+}
+
+static unsigned char *inflate_exact(const unsigned char *src, size_t src_len,
+                                    size_t out_size) {
+  unsigned char *out = malloc(out_size + 1);
+  if (!out)
+    return NULL;
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (inflateInit(&stream) != Z_OK) {
+    free(out);
+    return NULL;
+  }
+
+  stream.next_in = (unsigned char *)src;
+  stream.avail_in = src_len > UINT32_MAX ? UINT32_MAX : (uInt)src_len;
+  stream.next_out = out;
+  stream.avail_out = (uInt)out_size;
+
+  int status = inflate(&stream, Z_FINISH);
+  inflateEnd(&stream);
+
+  if (status != Z_STREAM_END || stream.total_out != out_size) {
+    free(out);
+    return NULL;
+  }
+  out[out_size] = '\0';
+  return out;
+}
+
+// Decode the variable-length type/size header of a pack entry
+static int parse_entry_header(const GitPack *pack, uint64_t offset, int *type,
+                              size_t *size, uint64_t *data_offset) {
+  const unsigned char *p = pack->pack + offset;
+  const unsigned char *end = pack->pack + pack->pack_size;
+  if (p >= end)
+    return 0;
+
+  unsigned char c = *p++;
+  *type = (c >> 4) & 7;
+  *size = c & 15;
+  int shift = 4;
+  while (c & 0x80) {
+    if (p >= end || shift > 60)
+      return 0;
+    c = *p++;
+    *size |= (size_t)(c & 0x7f) << shift;
+    shift += 7;
+  }
+  *data_offset = (uint64_t)(p - pack->pack);
+  return 1;
+}
+
+static size_t read_delta_size(const unsigned char **p,
+                              const unsigned char *end) {
+  size_t size = 0;
+  int shift = 0;
+  unsigned char c;
+  do {
+    if (*p >= end)
+      return 0;
+    c = *(*p)++;
+    size |= (size_t)(c & 0x7f) << shift;
+    shift += 7;
+  } while ((c & 0x80) && shift < 64);
+  return size;
+}
+
+static unsigned char *apply_delta(const unsigned char *base, size_t base_size,
+                                  const unsigned char *delta, size_t delta_size,
+                                  size_t *out_size) {
+  const unsigned char *p = delta;
+  const unsigned char *end = delta + delta_size;
+
+  if (read_delta_size(&p, end) != base_size)
+    return NULL;
+  size_t result_size = read_delta_size(&p, end);
+
+  unsigned char *result = malloc(result_size + 1);
+  if (!result)
+    return NULL;
+
+  size_t written = 0;
+  while (p < end) {
+    unsigned char op = *p++;
+    if (op & 0x80) {
+      // Copy from base: up to 4 offset bytes and 3 size bytes follow
+      size_t copy_offset = 0, copy_size = 0;
+      for (int i = 0; i < 4; i++) {
+        if (op & (1 << i)) {
+          if (p >= end)
+            goto fail;
+          copy_offset |= (size_t)*p++ << (i * 8);
+        }
+      }
+      for (int i = 0; i < 3; i++) {
+        if (op & (0x10 << i)) {
+          if (p >= end)
+            goto fail;
+          copy_size |= (size_t)*p++ << (i * 8);
+        }
+      }
+      if (copy_size == 0)
+        copy_size = 0x10000;
+      if (copy_offset + copy_size > base_size ||
+          written + copy_size > result_size)
+        goto fail;
+      memcpy(result + written, base + copy_offset, copy_size);
+      written += copy_size;
+    } else if (op) {
+      // Insert literal bytes from the delta itself
+      if (p + op > end || written + op > result_size)
+        goto fail;
+      memcpy(result + written, p, op);
+      p += op;
+      written += op;
+    } else {
+      goto fail;
+    }
+  }
+
+  if (written != result_size)
+    goto fail;
+  result[result_size] = '\0';
+  *out_size = result_size;
+  return result;
+
+fail:
+  free(result);
+  return NULL;
+}
+
+static GitDeltaCacheEntry *cache_slot(GitOdb *odb, int pack_index,
+                                      uint64_t offset) {
+  uint64_t hash = (offset ^ (offset >> 16) ^ ((uint64_t)pack_index << 7)) *
+                  0x9E3779B97F4A7C15ull;
+  return &odb->cache[(hash >> 32) % GIT_DELTA_CACHE_SLOTS];
+}
+
+static unsigned char *cache_get(GitOdb *odb, int pack_index, uint64_t offset,
+                                int *type, size_t *size) {
+  GitDeltaCacheEntry *slot = cache_slot(odb, pack_index, offset);
+  if (!slot->data || slot->pack_index != pack_index || slot->offset != offset)
+    return NULL;
+
+  unsigned char *copy = malloc(slot->size + 1);
+  if (!copy)
+    return NULL;
+  memcpy(copy, slot->data, slot->size + 1);
+  *type = slot->type;
+  *size = slot->size;
+  return copy;
+}
+
+static void cache_put(GitOdb *odb, int pack_index, uint64_t offset, int type,
+                      const unsigned char *data, size_t size) {
+  // Huge bases would evict everything else for little gain
+  if (size > GIT_DELTA_CACHE_MAX_BYTES / 4)
+    return;
+
+  GitDeltaCacheEntry *slot = cache_slot(odb, pack_index, offset);
+  if (slot->data) {
+    odb->cache_bytes -= slot->size;
+    free(slot->data);
+    slot->data = NULL;
+  }
+
+  // Stay under the byte budget by dropping other entries in slot order
+  for (int i = 0; odb->cache_bytes + size > GIT_DELTA_CACHE_MAX_BYTES &&
+                  i < GIT_DELTA_CACHE_SLOTS;
+       i++) {
+    if (odb->cache[i].data) {
+      odb->cache_bytes -= odb->cache[i].size;
+      free(odb->cache[i].data);
+      odb->cache[i].data = NULL;
+    }
+  }
+
+  slot->data = malloc(size + 1);
+  if (!slot->data)
+    return;
+  memcpy(slot->data, data, size + 1);
+  slot->pack_index = pack_index;
+  slot->offset = offset;
+  slot->type = type;
+  slot->size = size;
+  odb->cache_bytes += size;
+}
+
+static unsigned char *read_loose(GitOdb *odb, const char *hex, int *type,
+                                 size_t *size);
+
+typedef struct {
+  int pack_index;
+  uint64_t offset;
+} GitDeltaLink;
+
+// Rebuild a packed object, following OFS/REF delta chains down to a base
+// (or a cached intermediate) and then applying the deltas back up.
+static unsigned char *read_packed(GitOdb *odb, int pack_index, uint64_t offset,
+                                  int *out_type, size_t *out_size) {
+  GitDeltaLink chain_buf[64];
+  GitDeltaLink *chain = chain_buf;
+  int chain_len = 0;
+  int chain_capacity = 64;
+
+  unsigned char *data = NULL;
+  size_t size = 0;
+  int type = 0;
+
+  int cur_pack = pack_index;
+  uint64_t cur_offset = offset;
+
+  while (1) {
+    if (chain_len > 0) {
+      data = cache_get(odb, cur_pack, cur_offset, &type, &size);
+      if (data)
+        break;
+    }
+
+    const GitPack *pack = &odb->packs[cur_pack];
+    uint64_t data_offset;
+    size_t entry_size;
+    int entry_type;
+    if (!parse_entry_header(pack, cur_offset, &entry_type, &entry_size,
+                            &data_offset))
+      goto fail;
+
+    if (entry_type >= GIT_OBJ_COMMIT && entry_type <= GIT_OBJ_TAG) {
+      data = inflate_exact(pack->pack + data_offset,
+                           pack->pack_size - data_offset, entry_size);
+      if (!data)
+        goto fail;
+      type = entry_type;
+      size = entry_size;
+      if (chain_len > 0)
+        cache_put(odb, cur_pack, cur_offset, type, data, size);
+      break;
+    }
+
+    if (entry_type != GIT_OBJ_OFS_DELTA && entry_type != GIT_OBJ_REF_DELTA)
+      goto fail;
+
+    if (chain_len >= chain_capacity) {
+      GitDeltaLink *grown = malloc(chain_capacity * 2 * sizeof(GitDeltaLink));
+      if (!grown)
+        goto fail;
+      memcpy(grown, chain, chain_len * sizeof(GitDeltaLink));
+      if (chain != chain_buf)
+        free(chain);
+      chain = grown;
+      chain_capacity *= 2;
+    }
+    chain[chain_len].pack_index = cur_pack;
+    chain[chain_len].offset = cur_offset;
+    chain_len++;
+
+    const unsigned char *p = pack->pack + data_offset;
+    const unsigned char *end = pack->pack + pack->pack_size;
+    if (entry_type == GIT_OBJ_OFS_DELTA) {
+      if (p >= end)
+        goto fail;
+      unsigned char c = *p++;
+      uint64_t back = c & 0x7f;
+      while (c & 0x80) {
+        if (p >= end)
+          goto fail;
+        c = *p++;
+        back = ((back + 1) << 7) | (c & 0x7f);
+      }
+      if (back == 0 || back > cur_offset)
+        goto fail;
+      cur_offset -= back;
+    } else {
+      if (p + GIT_OID_RAW_LEN > end)
+        goto fail;
+      int found = 0;
+      for (int i = 0; i < odb->pack_count && !found; i++) {
+        if (find_in_pack(&odb->packs[i], p, &cur_offset)) {
+          cur_pack = i;
+          found = 1;
+        }
+      }
+      if (!found) {
+        // Thin bases may live outside any pack
+        char base_hex[GIT_OID_HEX_LEN + 1];
+        git_oid_to_hex(p, base_hex);
+        data = read_loose(odb, base_hex, &type, &size);
+        if (!data)
+          goto fail;
+        break;
+      }
+    }
+  }
+
+  // Apply the deltas from the innermost outwards
+  while (chain_len > 0) {
+    GitDeltaLink link = chain[--chain_len];
+    const GitPack *pack = &odb->packs[link.pack_index];
+    uint64_t data_offset;
+    size_t delta_size;
+    int entry_type;
+    if (!parse_entry_header(pack, link.offset, &entry_type, &delta_size,
+                            &data_offset))
+      goto fail;
+
+    // Skip the base reference that precedes the delta data
+    const unsigned char *p = pack->pack + data_offset;
+    if (entry_type == GIT_OBJ_OFS_DELTA) {
+      while (p < pack->pack + pack->pack_size && (*p & 0x80))
+        p++;
+      p++;
+    } else {
+      p += GIT_OID_RAW_LEN;
+    }
+    if (p >= pack->pack + pack->pack_size)
+      goto fail;
+
+    unsigned char *delta =
+        inflate_exact(p, pack->pack_size - (size_t)(p - pack->pack), delta_size);
+    if (!delta)
+      goto fail;
+
+    size_t result_size;
+    unsigned char *result = apply_delta(data, size, delta, delta_size,
+                                        &result_size);
+    free(delta);
+    free(data);
+    data = result;
+    size = result_size;
+    if (!data)
+      goto fail;
+
+    // Intermediate results are bases for the next link up
+    if (chain_len > 0)
+      cache_put(odb, link.pack_index, link.offset, type, data, size);
+  }
+
+  if (chain != chain_buf)
+    free(chain);
+  *out_type = type;
+  *out_size = size;
+  return data;
+
+fail:
+  free(data);
+  if (chain != chain_buf)
+    free(chain);
+  return NULL;
+}
+
+static unsigned char *read_loose(GitOdb *odb, const char *hex, int *type,
+                                 size_t *size) {
+  char path[PATH_MAX + 64];
+  snprintf(path, sizeof(path), "%s/%.2s/%s", odb->objects_dir, hex, hex + 2);
+
+  size_t file_size;
+  unsigned char *file = map_file(path, &file_size);
+  if (!file)
+    return NULL;
+
+  // Inflate just enough to read the "<type> <size>\0" header
+  unsigned char header[64];
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  unsigned char *result = NULL;
+  if (inflateInit(&stream) != Z_OK)
+    goto done;
+
+  stream.next_in = file;
+  stream.avail_in = (uInt)file_size;
+  stream.next_out = header;
+  stream.avail_out = sizeof(header);
+  int status = inflate(&stream, Z_SYNC_FLUSH);
+  if (status != Z_OK && status != Z_STREAM_END)
+    goto end_stream;
+
+  size_t header_len = sizeof(header) - stream.avail_out;
+  unsigned char *nul = memchr(header, '\0', header_len);
+  char type_name[16];
+  if (!nul || sscanf((char *)header, "%15s %zu", type_name, size) != 2)
+    goto end_stream;
+  *type = type_from_name(type_name);
+  if (!*type)
+    goto end_stream;
+
+  result = malloc(*size + 1);
+  if (!result)
+    goto end_stream;
+
+  size_t already = header_len - (size_t)(nul + 1 - header);
+  if (already > *size)
+    already = *size;
+  memcpy(result, nul + 1, already);
+
+  stream.next_out = result + already;
+  stream.avail_out = (uInt)(*size - already);
+  if (status != Z_STREAM_END)
+    status = inflate(&stream, Z_FINISH);
+  if (status != Z_STREAM_END ||
+      stream.total_out != (uLong)((size_t)(nul + 1 - header) + *size)) {
+    free(result);
+    result = NULL;
+    goto end_stream;
+  }
+  result[*size] = '\0';
+
+end_stream:
+  inflateEnd(&stream);
+done:
+  munmap(file, file_size);
+  return result;
+}
+
+static int find_packed(GitOdb *odb, const unsigned char *raw, int *pack_index,
+                       uint64_t *offset) {
+  for (int i = 0; i < odb->pack_count; i++) {
+    if (find_in_pack(&odb->packs[i], raw, offset)) {
+      *pack_index = i;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int git_odb_read(GitOdb *odb, const char *oid_hex, GitObject *obj) {
+  if (!odb || !oid_hex || !obj)
+    return 0;
+  memset(obj, 0, sizeof(*obj));
+
+  unsigned char raw[GIT_OID_RAW_LEN];
+  if (!is_full_hex_oid(oid_hex) || !git_oid_from_hex(oid_hex, raw))
+    return 0;
+
+  char hex[GIT_OID_HEX_LEN + 1];
+  git_oid_to_hex(raw, hex);
+
+  int type = 0;
+  size_t size = 0;
+  unsigned char *data = NULL;
+  int pack_index;
+  uint64_t offset;
+
+  if (find_packed(odb, raw, &pack_index, &offset)) {
+    data = read_packed(odb, pack_index, offset, &type, &size);
+  }
+  if (!data) {
+    data = read_loose(odb, hex, &type, &size);
+  }
+  if (!data) {
+    // A repack or fetch may have added packs since we last looked. Missing
+    // objects are a normal answer, so only a changed pack directory is
+    // worth remapping every pack and dropping the delta cache for.
+    struct timespec mtime;
+    pack_dir_mtime(odb, &mtime);
+    if (mtime.tv_sec != odb->packs_mtime.tv_sec ||
+        mtime.tv_nsec != odb->packs_mtime.tv_nsec) {
+      load_packs(odb);
+      if (find_packed(odb, raw, &pack_index, &offset))
+        data = read_packed(odb, pack_index, offset, &type, &size);
+    }
+  }
+  if (!data)
+    return 0;
+
+  strcpy(obj->oid, hex);
+  strcpy(obj->type, type_names[type]);
+  obj->data = (char *)data;
+  obj->size = size;
+  return 1;
+}
+
+// Hex digits raw ids a and b share
+static int common_hex_prefix(const unsigned char *a, const unsigned char *b) {
+  int digits = 0;
+  for (int i = 0; i < GIT_OID_RAW_LEN; i++) {
+    if (a[i] == b[i]) {
+      digits += 2;
+      continue;
+    }
+    return digits + ((a[i] & 0xf0) == (b[i] & 0xf0));
+  }
+  return digits;
+}
+
+void git_odb_abbrev(GitOdb *odb, const char *oid_hex, char *out, size_t size) {
+  unsigned char raw[GIT_OID_RAW_LEN];
+  if (!git_oid_from_hex(oid_hex, raw)) {
+    snprintf(out, size, "%s", oid_hex);
+    return;
+  }
+
+  // git's automatic length: enough digits for the number of packed objects
+  uint64_t objects = 0;
+  for (int i = 0; i < odb->pack_count; i++)
+    objects += odb->packs[i].count;
+  int bits = 0;
+  while (objects >> bits > 1)
+    bits++;
+  int len = (bits + 2) / 2;
+  if (len < 7)
+    len = 7;
+
+  // Then longer than the prefix shared with the ids sorting either side
+  for (int i = 0; i < odb->pack_count; i++) {
+    const GitPack *pack = &odb->packs[i];
+    uint32_t lo = raw[0] == 0 ? 0 : read_be32(pack->fanout + (raw[0] - 1) * 4);
+    uint32_t hi = read_be32(pack->fanout + raw[0] * 4);
+    while (lo < hi) {
+      uint32_t mid = lo + (hi - lo) / 2;
+      if (memcmp(pack->oids + (size_t)mid * GIT_OID_RAW_LEN, raw,
+                 GIT_OID_RAW_LEN) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    const unsigned char *at = pack->oids + (size_t)lo * GIT_OID_RAW_LEN;
+    if (lo < pack->count && memcmp(at, raw, GIT_OID_RAW_LEN) == 0)
+      at += GIT_OID_RAW_LEN;
+    if (at < pack->oids + (size_t)pack->count * GIT_OID_RAW_LEN &&
+        common_hex_prefix(at, raw) + 1 > len)
+      len = common_hex_prefix(at, raw) + 1;
+    if (lo > 0 && common_hex_prefix(pack->oids + (size_t)(lo - 1) *
+                                                     GIT_OID_RAW_LEN,
+                                    raw) + 1 > len)
+      len = common_hex_prefix(pack->oids + (size_t)(lo - 1) * GIT_OID_RAW_LEN,
+                              raw) + 1;
+  }
+
+  // Loose objects sharing the first two digits
+  char dir_path[PATH_MAX + 64];
+  snprintf(dir_path, sizeof(dir_path), "%s/%.2s", odb->objects_dir, oid_hex);
+  DIR *dir = opendir(dir_path);
+  struct dirent *entry;
+  while (dir && (entry = readdir(dir)) != NULL) {
+    const char *name = entry->d_name;
+    if (strlen(name) != GIT_OID_HEX_LEN - 2 ||
+        strncasecmp(name, oid_hex + 2, GIT_OID_HEX_LEN - 2) == 0)
+      continue;
+    int shared = 2;
+    while (shared < GIT_OID_HEX_LEN &&
+           tolower((unsigned char)name[shared - 2]) ==
+               tolower((unsigned char)oid_hex[shared]))
+      shared++;
+    if (shared + 1 > len)
+      len = shared + 1;
+  }
+  if (dir)
+    closedir(dir);
+
+  if (len > GIT_OID_HEX_LEN)
+    len = GIT_OID_HEX_LEN;
+  snprintf(out, size, "%.*s", len, oid_hex);
+}
+
+int git_odb_tree_lookup(GitOdb *odb, const char *tree_oid, const char *path,
+                        char *oid_hex) {
+  char current[GIT_OID_HEX_LEN + 1];
+  snprintf(current, sizeof(current), "%s", tree_oid);
+
+  const char *component = path;
+  while (*component) {
+    const char *slash = strchr(component, '/');
+    size_t name_len = slash ? (size_t)(slash - component) : strlen(component);
+
+    GitObject tree;
+    if (!git_odb_read(odb, current, &tree) || strcmp(tree.type, "tree") != 0) {
+      git_object_free(&tree);
+      return 0;
+    }
+
+    // Entries are "<mode> <name>\0<20 byte id>"
+    int found = 0;
+    const char *p = tree.data;
+    const char *end = tree.data + tree.size;
+    while (p < end && !found) {
+      const char *space = memchr(p, ' ', end - p);
+      const char *nul = space ? memchr(space, '\0', end - space) : NULL;
+      if (!nul || nul + 1 + GIT_OID_RAW_LEN > end)
+        break;
+
+      const char *name = space + 1;
+      if ((size_t)(nul - name) == name_len &&
+          memcmp(name, component, name_len) == 0) {
+        git_oid_to_hex((const unsigned char *)nul + 1, current);
+        found = 1;
+      }
+      p = nul + 1 + GIT_OID_RAW_LEN;
+    }
+    git_object_free(&tree);
+
+    if (!found)
+      return 0;
+    if (!slash)
+      break;
+    component = slash + 1;
+  }
+
+  strcpy(oid_hex, current);
+  return 1;
+}
+
+int git_odb_read_path(GitOdb *odb, const char *rev, const char *path,
+                      GitObject *obj) {
+  char commit_oid[GIT_OID_HEX_LEN + 1];
+  if (!git_odb_resolve(odb, rev, commit_oid))
+    return 0;
+
+  GitObject commit;
+  GitCommitInfo info;
+  if (!git_odb_read(odb, commit_oid, &commit))
+    return 0;
+  int ok = git_parse_commit(commit.data, commit.size, &info);
+  git_object_free(&commit);
+
+  char blob_oid[GIT_OID_HEX_LEN + 1];
+  if (!ok || !git_odb_tree_lookup(odb, info.tree, path, blob_oid))
+    return 0;
+
+  return git_odb_read(odb, blob_oid, obj);
+}
+
+static int compare_refs(const void *a, const void *b) {
+  return strcmp(((const GitRef *)a)->name, ((const GitRef *)b)->name);
+}
+
+static void load_packed_refs(GitOdb *odb) {
+  char path[PATH_MAX + 16];
+  snprintf(path, sizeof(path), "%s/packed-refs", odb->common_dir);
+
+  struct stat st;
+  if (stat(path, &st) != 0)
+    memset(&st, 0, sizeof(st));
+
+  if (st.st_mtim.tv_sec == odb->packed_refs_mtime.tv_sec &&
+      st.st_mtim.tv_nsec == odb->packed_refs_mtime.tv_nsec &&
+      st.st_size == odb->packed_refs_size)
+    return;
+
+  free(odb->packed_refs);
+  odb->packed_refs = NULL;
+  odb->packed_ref_count = 0;
+  odb->packed_refs_mtime = st.st_mtim;
+  odb->packed_refs_size = st.st_size;
+
+  FILE *fp = fopen(path, "r");
+  if (!fp)
+    return;
+
+  int capacity = 64;
+  odb->packed_refs = malloc(capacity * sizeof(GitRef));
+  char line[512];
+  while (odb->packed_refs && fgets(line, sizeof(line), fp)) {
+    // Skip the header and "^<id>" peeled tag lines
+    if (line[0] == '#' || line[0] == '^')
+      continue;
+    char *newline = strchr(line, '\n');
+    if (newline)
+      *newline = '\0';
+    if (strlen(line) < GIT_OID_HEX_LEN + 2 || line[GIT_OID_HEX_LEN] != ' ')
+      continue;
+
+    if (odb->packed_ref_count >= capacity) {
+      GitRef *grown = realloc(odb->packed_refs, capacity * 2 * sizeof(GitRef));
+      if (!grown)
+        break;
+      odb->packed_refs = grown;
+      capacity *= 2;
+    }
+    GitRef *ref = &odb->packed_refs[odb->packed_ref_count++];
+    memcpy(ref->oid, line, GIT_OID_HEX_LEN);
+    ref->oid[GIT_OID_HEX_LEN] = '\0';
+    snprintf(ref->name, sizeof(ref->name), "%s", line + GIT_OID_HEX_LEN + 1);
+  }
+  fclose(fp);
+
+  // packed-refs is sorted already, but do not depend on it
+  if (odb->packed_refs)
+    qsort(odb->packed_refs, odb->packed_ref_count, sizeof(GitRef),
+          compare_refs);
+}
+
+static int read_ref(GitOdb *odb, const char *name, char *oid_hex, int depth) {
+  if (depth > 5)
+    return 0;
+
+  // Per-worktree refs (HEAD) live in the git dir, shared ones in commondir
+  const char *dirs[] = {odb->git_dir, odb->common_dir};
+  for (int i = 0; i < 2; i++) {
+    char path[PATH_MAX + 256];
+    snprintf(path, sizeof(path), "%s/%s", dirs[i], name);
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+      continue;
+
+    char line[512] = "";
+    char *ok = fgets(line, sizeof(line), fp);
+    fclose(fp);
+    if (!ok)
+      continue;
+    char *newline = strchr(line, '\n');
+    if (newline)
+      *newline = '\0';
+
+    if (strncmp(line, "ref: ", 5) == 0)
+      return read_ref(odb, line + 5, oid_hex, depth + 1);
+    if (is_full_hex_oid(line)) {
+      strcpy(oid_hex, line);
+      return 1;
+    }
+  }
+
+  load_packed_refs(odb);
+  GitRef key;
+  snprintf(key.name, sizeof(key.name), "%s", name);
+  GitRef *found = odb->packed_refs
+                      ? bsearch(&key, odb->packed_refs, odb->packed_ref_count,
+                                sizeof(GitRef), compare_refs)
+                      : NULL;
+  if (found) {
+    strcpy(oid_hex, found->oid);
+    return 1;
+  }
+  return 0;
+}
+
+// Follow annotated tags down to the object they point at
+static int peel_to_commit(GitOdb *odb, char *oid_hex) {
+  for (int depth = 0; depth < 5; depth++) {
+    GitObject obj;
+    if (!git_odb_read(odb, oid_hex, &obj))
+      return 0;
+
+    if (strcmp(obj.type, "commit") == 0) {
+      git_object_free(&obj);
+      return 1;
+    }
+    int next = strcmp(obj.type, "tag") == 0 &&
+               strncmp(obj.data, "object ", 7) == 0 &&
+               obj.size > 7 + GIT_OID_HEX_LEN;
+    if (next) {
+      memcpy(oid_hex, obj.data + 7, GIT_OID_HEX_LEN);
+      oid_hex[GIT_OID_HEX_LEN] = '\0';
+    }
+    git_object_free(&obj);
+    if (!next)
+      return 0;
+  }
+  return 0;
+}
+
+int git_odb_resolve(GitOdb *odb, const char *rev, char *oid_hex) {
+  if (!odb || !rev || !oid_hex)
+    return 0;
+
+  int found = 0;
+  if (is_full_hex_oid(rev)) {
+    snprintf(oid_hex, GIT_OID_HEX_LEN + 1, "%s", rev);
+    found = 1;
+  } else if (strcmp(rev, "HEAD") == 0 || strncmp(rev, "refs/", 5) == 0) {
+    found = read_ref(odb, rev, oid_hex, 0);
+  } else {
+    // Same precedence git uses for short names
+    const char *prefixes[] = {"refs/heads/", "refs/remotes/", "refs/tags/"};
+    for (size_t i = 0; i < 3 && !found; i++) {
+      char name[512];
+      snprintf(name, sizeof(name), "%s%s", prefixes[i], rev);
+      found = read_ref(odb, name, oid_hex, 0);
+    }
+  }
+
+  return found && peel_to_commit(odb, oid_hex);
+}
+
+static void collect_loose_refs(GitOdb *odb, const char *name, GitRef **refs,
+                               int *count, int *capacity) {
+  char path[PATH_MAX + 256];
+  snprintf(path, sizeof(path), "%s/%s", odb->common_dir, name);
+  DIR *dir = opendir(path);
+  if (!dir)
+    return;
+
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.')
+      continue;
+
+    char child[256];
+    if (snprintf(child, sizeof(child), "%s/%s", name, entry->d_name) >=
+        (int)sizeof(child))
+      continue;
+
+    char child_path[PATH_MAX + 512];
+    struct stat st;
+    snprintf(child_path, sizeof(child_path), "%s/%s", odb->common_dir, child);
+    if (stat(child_path, &st) != 0)
+      continue;
+    if (S_ISDIR(st.st_mode)) {
+      collect_loose_refs(odb, child, refs, count, capacity);
+      continue;
+    }
+
+    if (*count >= *capacity) {
+      GitRef *grown = realloc(*refs, *capacity * 2 * sizeof(GitRef));
+      if (!grown)
+        break;
+      *refs = grown;
+      *capacity *= 2;
+    }
+    GitRef *ref = &(*refs)[*count];
+    if (read_ref(odb, child, ref->oid, 0)) {
+      snprintf(ref->name, sizeof(ref->name), "%s", child);
+      (*count)++;
+    }
+  }
+  closedir(dir);
+}
+
+int git_odb_list_refs(GitOdb *odb, GitRef **refs) {
+  *refs = NULL;
+  if (!odb)
+    return 0;
+
+  int count = 0;
+  int capacity = 64;
+  GitRef *list = malloc(capacity * sizeof(GitRef));
+  if (!list)
+    return 0;
+
+  collect_loose_refs(odb, "refs/heads", &list, &count, &capacity);
+  collect_loose_refs(odb, "refs/remotes", &list, &count, &capacity);
+  collect_loose_refs(odb, "refs/tags", &list, &count, &capacity);
+  int loose_count = count;
+  qsort(list, loose_count, sizeof(GitRef), compare_refs);
+
+  load_packed_refs(odb);
+  for (int i = 0; i < odb->packed_ref_count; i++) {
+    GitRef *packed = &odb->packed_refs[i];
+    if (strncmp(packed->name, "refs/heads/", 11) != 0 &&
+        strncmp(packed->name, "refs/remotes/", 13) != 0 &&
+        strncmp(packed->name, "refs/tags/", 10) != 0)
+      continue;
+    if (bsearch(packed, list, loose_count, sizeof(GitRef), compare_refs))
+      continue;
+
+    if (count >= capacity) {
+      GitRef *grown = realloc(list, capacity * 2 * sizeof(GitRef));
+      if (!grown)
+        break;
+      list = grown;
+      capacity *= 2;
+    }
+    list[count++] = *packed;
+  }
+
+  // Annotated tags point at tag objects, report the commit they name
+  for (int i = 0; i < count; i++) {
+    if (strncmp(list[i].name, "refs/tags/", 10) == 0)
+      peel_to_commit(odb, list[i].oid);
+  }
+
+  qsort(list, count, sizeof(GitRef), compare_refs);
+  *refs = list;
+  return count;
+}
+
+int git_odb_head_branch(GitOdb *odb, char *branch, size_t size) {
+  branch[0] = '\0';
+  if (!odb)
+    return 0;
+
+  char path[PATH_MAX + 8];
+  snprintf(path, sizeof(path), "%s/HEAD", odb->git_dir);
+  FILE *fp = fopen(path, "r");
+  if (!fp)
+    return 0;
+
+  char line[512] = "";
+  char *ok = fgets(line, sizeof(line), fp);
+  fclose(fp);
+  if (!ok || strncmp(line, "ref: refs/heads/", 16) != 0)
+    return 0;
+
+  char *newline = strchr(line, '\n');
+  if (newline)
+    *newline = '\0';
+  snprintf(branch, size, "%s", line + 16);
+  return 1;
+}
+
+static char *trim_config_value(char *value) {
+  while (*value == ' ' || *value == '\t')
+    value++;
+  char *end = value + strlen(value);
+  while (end > value && (end[-1] == '\n' || end[-1] == '\r' ||
+                         end[-1] == ' ' || end[-1] == '\t'))
+    *--end = '\0';
+  if (end - value >= 2 && value[0] == '"' && end[-1] == '"') {
+    end[-1] = '\0';
+    value++;
+  }
+  return value;
+}
+
+int git_odb_branch_upstream(GitOdb *odb, const char *branch, char *ref,
+                            size_t size) {
+  ref[0] = '\0';
+  if (!odb || !branch)
+    return 0;
+
+  char path[PATH_MAX + 8];
+  snprintf(path, sizeof(path), "%s/config", odb->common_dir);
+  FILE *fp = fopen(path, "r");
+  if (!fp)
+    return 0;
+
+  // Only the plain [branch "name"] form is understood; includes and
+  // url rewrites are not needed for remote/merge lookups
+  char section[512];
+  snprintf(section, sizeof(section), "[branch \"%s\"]", branch);
+
+  char remote[256] = "";
+  char merge[256] = "";
+  int in_section = 0;
+  char line[1024];
+  while (fgets(line, sizeof(line), fp)) {
+    char *p = line;
+    while (*p == ' ' || *p == '\t')
+      p++;
+    if (*p == '[') {
+      in_section = strncmp(p, section, strlen(section)) == 0;
+      continue;
+    }
+    if (!in_section || *p == '#' || *p == ';')
+      continue;
+
+    char *eq = strchr(p, '=');
+    if (!eq)
+      continue;
+    *eq = '\0';
+    char *key = trim_config_value(p);
+    char *value = trim_config_value(eq + 1);
+    if (strcasecmp(key, "remote") == 0)
+      snprintf(remote, sizeof(remote), "%s", value);
+    else if (strcasecmp(key, "merge") == 0)
+      snprintf(merge, sizeof(merge), "%s", value);
+  }
+  fclose(fp);
+
+  if (!remote[0] || strncmp(merge, "refs/heads/", 11) != 0)
+    return 0;
+
+  // remote "." tracks another local branch
+  if (strcmp(remote, ".") == 0)
+    snprintf(ref, size, "%s", merge);
+  else
+    snprintf(ref, size, "refs/remotes/%s/%s", remote, merge + 11);
+  return 1;
+}
+
+const char *git_odb_objects_dir(GitOdb *odb) {
+  return odb ? odb->objects_dir : NULL;
+}
+
+uint32_t git_odb_cached_generation(GitOdb *odb, const unsigned char *oid) {
+  if (!odb || !odb->generations)
+    return 0;
+
+  size_t mask = odb->generation_slots - 1;
+  for (size_t slot = read_be32(oid) & mask; odb->generations[slot].generation;
+       slot = (slot + 1) & mask) {
+    if (memcmp(odb->generations[slot].oid, oid, GIT_OID_RAW_LEN) == 0)
+      return odb->generations[slot].generation;
+  }
+  return 0;
+}
+
+static void put_generation(GitGenerationEntry *table, size_t slots,
+                           const unsigned char *oid, uint32_t generation) {
+  size_t slot = read_be32(oid) & (slots - 1);
+  while (table[slot].generation &&
+         memcmp(table[slot].oid, oid, GIT_OID_RAW_LEN) != 0)
+    slot = (slot + 1) & (slots - 1);
+  memcpy(table[slot].oid, oid, GIT_OID_RAW_LEN);
+  table[slot].generation = generation;
+}
+
+void git_odb_cache_generation(GitOdb *odb, const unsigned char *oid,
+                              uint32_t generation) {
+  if (!odb || generation == 0)
+    return;
+
+  // Kept at most half full
+  if ((odb->generation_count + 1) * 2 > odb->generation_slots) {
+    size_t slots = odb->generation_slots ? odb->generation_slots * 2 : 4096;
+    GitGenerationEntry *table = calloc(slots, sizeof(GitGenerationEntry));
+    if (!table)
+      return;
+    for (size_t i = 0; i < odb->generation_slots; i++) {
+      if (odb->generations[i].generation)
+        put_generation(table, slots, odb->generations[i].oid,
+                       odb->generations[i].generation);
+    }
+    free(odb->generations);
+    odb->generations = table;
+    odb->generation_slots = slots;
+  }
+
+  if (!git_odb_cached_generation(odb, oid))
+    odb->generation_count++;
+  put_generation(odb->generations, odb->generation_slots, oid, generation);
+}
+
+static GitOdb *open_odb(const char *git_dir) {
+  GitOdb *odb = calloc(1, sizeof(GitOdb));
+  if (!odb)
+    return NULL;
+
+  odb->refs = 1;
+  snprintf(odb->git_dir, sizeof(odb->git_dir), "%s", git_dir);
+  snprintf(odb->common_dir, sizeof(odb->common_dir), "%s", git_dir);
+
+  // Linked worktrees keep objects and shared refs in the main repository
+  char path[PATH_MAX + 16];
+  snprintf(path, sizeof(path), "%s/commondir", git_dir);
+  FILE *fp = fopen(path, "r");
+  if (fp) {
+    char line[PATH_MAX];
+    if (fgets(line, sizeof(line), fp)) {
+      char *newline = strchr(line, '\n');
+      if (newline)
+        *newline = '\0';
+      if (line[0] == '/')
+        snprintf(odb->common_dir, sizeof(odb->common_dir), "%s", line);
+      else
+        snprintf(odb->common_dir, sizeof(odb->common_dir), "%s/%s", git_dir,
+                 line);
+    }
+    fclose(fp);
+  }
+
+  snprintf(odb->objects_dir, sizeof(odb->objects_dir), "%s/objects",
+           odb->common_dir);
+  for (int i = 0; i < GIT_DELTA_CACHE_SLOTS; i++)
+    odb->cache[i].pack_index = -1;
+
+  load_packs(odb);
+  return odb;
+}
+
+static void free_odb(GitOdb *odb) {
+  if (!odb)
+    return;
+  close_packs(odb);
+  free(odb->packed_refs);
+  free(odb->generations);
+  free(odb);
+}
+
+static void release_odb(GitOdb *odb) {
+  if (odb && --odb->refs == 0)
+    free_odb(odb);
+}
+
+GitOdb *git_odb_current(void) {
+  char git_dir[PATH_MAX];
+  if (!git_find_git_dir(git_dir, sizeof(git_dir)))
+    return NULL;
+
+  if (current_odb && strcmp(current_odb->git_dir, git_dir) == 0)
+    return current_odb;
+
+  // Walks still running over the previous repository keep it open
+  release_odb(current_odb);
+  current_odb = open_odb(git_dir);
+  return current_odb;
+}
+
+void git_odb_close_all(void) {
+  release_odb(current_odb);
+  current_odb = NULL;
+}
+
+// Binary max-heap on committer date, plus an open-addressing set of every
+// queued id so merge parents are only walked once
+typedef struct {
+  GitObject commit;
+  GitCommitInfo info;
+} GitRevWalkEntry;
+
+struct GitRevWalk {
+  GitOdb *odb;
+  GitRevWalkEntry *heap;
+  int heap_count;
+  int heap_capacity;
+  unsigned char *seen; // GIT_OID_RAW_LEN bytes per slot, all zero = empty
+  size_t seen_slots;
+  size_t seen_count;
+  int failed; // A parent could not be read, so what follows is incomplete
+};
+
+static int seen_insert(GitRevWalk *walk, const unsigned char *raw);
+
+static int seen_grow(GitRevWalk *walk) {
+  size_t old_slots = walk->seen_slots;
+  unsigned char *old = walk->seen;
+
+  walk->seen_slots = old_slots ? old_slots * 2 : 1024;
+  walk->seen = calloc(walk->seen_slots, GIT_OID_RAW_LEN);
+  if (!walk->seen) {
+    walk->seen = old;
+    walk->seen_slots = old_slots;
+    return 0;
+  }
+  walk->seen_count = 0;
+  for (size_t i = 0; i < old_slots; i++) {
+    static const unsigned char empty[GIT_OID_RAW_LEN] = {0};
+    if (memcmp(old + i * GIT_OID_RAW_LEN, empty, GIT_OID_RAW_LEN) != 0)
+      seen_insert(walk, old + i * GIT_OID_RAW_LEN);
+  }
+  free(old);
+  return 1;
+}
+
+// Returns 1 if newly inserted, 0 if already present (or out of memory)
+static int seen_insert(GitRevWalk *walk, const unsigned char *raw) {
+  if ((walk->seen_count + 1) * 2 > walk->seen_slots && !seen_grow(walk))
+    return 0;
+
+  // Object ids are already uniformly distributed
+  size_t slot = (size_t)read_be32(raw) & (walk->seen_slots - 1);
+  static const unsigned char empty[GIT_OID_RAW_LEN] = {0};
+  while (1) {
+    unsigned char *entry = walk->seen + slot * GIT_OID_RAW_LEN;
+    if (memcmp(entry, empty, GIT_OID_RAW_LEN) == 0) {
+      memcpy(entry, raw, GIT_OID_RAW_LEN);
+      walk->seen_count++;
+      return 1;
+    }
+    if (memcmp(entry, raw, GIT_OID_RAW_LEN) == 0)
+      return 0;
+    slot = (slot + 1) & (walk->seen_slots - 1);
+  }
+}
+
+static void heap_swap(GitRevWalkEntry *a, GitRevWalkEntry *b) {
+  GitRevWalkEntry tmp = *a;
+  *a = *b;
+  *b = tmp;
+}
+
+// Queue a commit. Returns 1 when queued, 0 when it already was and -1 when
+// it cannot be read, e.g. from an alternates store or a partial clone.
+static int walk_push(GitRevWalk *walk, const char *oid_hex) {
+  unsigned char raw[GIT_OID_RAW_LEN];
+  if (!git_oid_from_hex(oid_hex, raw))
+    return -1;
+  if (!seen_insert(walk, raw))
+    return 0;
+
+  if (walk->heap_count >= walk->heap_capacity) {
+    int capacity = walk->heap_capacity ? walk->heap_capacity * 2 : 32;
+    GitRevWalkEntry *grown =
+        realloc(walk->heap, capacity * sizeof(GitRevWalkEntry));
+    if (!grown)
+      return -1;
+    walk->heap = grown;
+    walk->heap_capacity = capacity;
+  }
+
+  GitRevWalkEntry *entry = &walk->heap[walk->heap_count];
+  if (!git_odb_read(walk->odb, oid_hex, &entry->commit))
+    return -1;
+  if (strcmp(entry->commit.type, "commit") != 0 ||
+      !git_parse_commit(entry->commit.data, entry->commit.size, &entry->info)) {
+    git_object_free(&entry->commit);
+    return -1;
+  }
+
+  int i = walk->heap_count++;
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (walk->heap[parent].info.committer_time >=
+        walk->heap[i].info.committer_time)
+      break;
+    heap_swap(&walk->heap[parent], &walk->heap[i]);
+    i = parent;
+  }
+  return 1;
+}
+
+GitRevWalk *git_revwalk_new(GitOdb *odb, const char *start_oid) {
+  if (!odb || !start_oid)
+    return NULL;
+
+  GitRevWalk *walk = calloc(1, sizeof(GitRevWalk));
+  if (!walk)
+    return NULL;
+  walk->odb = odb;
+  odb->refs++;
+
+  if (walk_push(walk, start_oid) != 1) {
+    git_revwalk_free(walk);
+    return NULL;
+  }
+  return walk;
+}
+
+GitOdb *git_revwalk_odb(const GitRevWalk *walk) { return walk->odb; }
+
+int git_revwalk_next(GitRevWalk *walk, GitObject *commit, GitCommitInfo *info) {
+  if (!walk)
+    return 0;
+  if (walk->failed)
+    return -1;
+  if (walk->heap_count == 0)
+    return 0;
+
+  GitRevWalkEntry top = walk->heap[0];
+  walk->heap[0] = walk->heap[--walk->heap_count];
+
+  int i = 0;
+  while (1) {
+    int left = i * 2 + 1;
+    int right = left + 1;
+    int largest = i;
+    if (left < walk->heap_count && walk->heap[left].info.committer_time >
+                                       walk->heap[largest].info.committer_time)
+      largest = left;
+    if (right < walk->heap_count &&
+        walk->heap[right].info.committer_time >
+            walk->heap[largest].info.committer_time)
+      largest = right;
+    if (largest == i)
+      break;
+    heap_swap(&walk->heap[i], &walk->heap[largest]);
+    i = largest;
+  }
+
+  // A missing parent would leave its history out without a trace; the
+  // commit in hand is still in order, the ones after it may not be
+  for (int p = 0; p < top.info.parent_count; p++) {
+    if (walk_push(walk, top.info.parents[p]) < 0)
+      walk->failed = 1;
+  }
+
+  *commit = top.commit;
+  *info = top.info;
+  return 1;
+}
+
+void git_revwalk_free(GitRevWalk *walk) {
+  if (!walk)
+    return;
+  for (int i = 0; i < walk->heap_count; i++) {
+    git_object_free(&walk->heap[i].commit);
+  }
+  free(walk->heap);
+  free(walk->seen);
+  release_odb(walk->odb);
+  free(walk);
+}
@@ -0,0 +1,598 @@
+#define _GNU_SOURCE
+#include "git_patch.h"
+#include "git_jobs.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+
+// Entry of a composed diff, ordered by position in the middle version
+typedef struct {
+  int pos;   // Middle line, or the middle line a gap entry sits in front of
+  int order; // 0 removed by a, 1 added by b, 2 line of the middle version
+  int seq;
+  int in_x; // Present in the first version
+  int in_z; // Present in the last version
+  int x_no_eol; // Ends the first version without a newline
+  int z_no_eol; // Ends the last version without a newline
+  int from_b;
+  int selected;
+  const char *text;
+} ComposeEntry;
+
+typedef struct {
+  char type;
+  int x_before; // Lines of the first version before this one
+  int z_before;
+  int gap_before; // Unknown lines sit between this and the previous line
+  int selected;
+  int no_eol;
+  const char *text;
+} ComposeLine;
+
+void git_patch_init(GitPatch *patch) {
+  patch->data = NULL;
+  patch->len = 0;
+  patch->capacity = 0;
+}
+
+void git_patch_free(GitPatch *patch) {
+  free(patch->data);
+  git_patch_init(patch);
+}
+
+static int patch_reserve(GitPatch *patch, size_t extra) {
+  if (patch->len + extra + 1 <= patch->capacity)
+    return 1;
+
+  size_t capacity = patch->capacity ? patch->capacity : 4096;
+  while (capacity < patch->len + extra + 1)
+    capacity *= 2;
+
+  char *data = realloc(patch->data, capacity);
+  if (!data)
+    return 0;
+  patch->data = data;
+  patch->capacity = capacity;
+  return 1;
+}
+
+static int patch_append(GitPatch *patch, const char *text, size_t len) {
+  if (!patch_reserve(patch, len))
+    return 0;
+  memcpy(patch->data + patch->len, text, len);
+  patch->len += len;
+  patch->data[patch->len] = '\0';
+  return 1;
+}
+
+static int patch_appendf(GitPatch *patch, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  int needed = vsnprintf(NULL, 0, fmt, args);
+  va_end(args);
+  if (needed < 0 || !patch_reserve(patch, (size_t)needed))
+    return 0;
+
+  va_start(args, fmt);
+  vsnprintf(patch->data + patch->len, (size_t)needed + 1, fmt, args);
+  va_end(args);
+  patch->len += (size_t)needed;
+  return 1;
+}
+
+void git_diff_format_hunk(const GitDiffLine *lines, int count, int header,
+                          char *buf, size_t size) {
+  int old_count = 0;
+  int new_count = 0;
+  for (int i = header + 1; i < count && lines[i].type != '@'; i++) {
+    if (lines[i].type != '+')
+      old_count++;
+    if (lines[i].type != '-')
+      new_count++;
+  }
+  snprintf(buf, size, "@@ -%d,%d +%d,%d @@", lines[header].old_line, old_count,
+           lines[header].new_line, new_count);
+}
+
+int git_patch_add_file(GitPatch *patch, const char *path,
+                       unsigned new_file_mode, const GitDiffLine *lines,
+                       int count) {
+  int hunks = 0;
+  for (int i = 0; i < count; i++)
+    hunks += lines[i].type == '@';
+  if (hunks == 0)
+    return 0;
+
+  int ok = patch_appendf(patch, "diff --git a/%s b/%s\n", path, path);
+  if (new_file_mode)
+    ok = ok && patch_appendf(patch, "new file mode %06o\n--- /dev/null\n",
+                             new_file_mode);
+  else
+    ok = ok && patch_appendf(patch, "--- a/%s\n", path);
+  ok = ok && patch_appendf(patch, "+++ b/%s\n", path);
+
+  for (int i = 0; ok && i < count; i++) {
+    if (lines[i].type == '@') {
+      char header[96];
+      git_diff_format_hunk(lines, count, i, header, sizeof(header));
+      ok = patch_appendf(patch, "%s\n", header);
+      continue;
+    }
+    const char *text = lines[i].text ? lines[i].text : "";
+    ok = patch_append(patch, &lines[i].type, 1) &&
+         patch_append(patch, text, strlen(text)) && patch_append(patch, "\n", 1);
+    if (ok && lines[i].no_eol)
+      ok = patch_appendf(patch, "\\ No newline at end of file\n");
+  }
+  return ok ? hunks : -1;
+}
+
+// Temporary patch file kept until the job that applies it has finished
+typedef struct {
+  char path[32];
+  GitJobCallback on_done;
+  void *ctx;
+} PatchJob;
+
+static void on_patch_applied(const GitJob *job, void *ctx) {
+  PatchJob *patch_job = ctx;
+  unlink(patch_job->path);
+  if (patch_job->on_done)
+    patch_job->on_done(job, patch_job->ctx);
+  free(patch_job);
+}
+
+int git_patch_queue_apply_cached(const GitPatch *patch, GitJobCallback on_done,
+                                 void *ctx) {
+  if (!patch || patch->len == 0)
+    return 0;
+
+  PatchJob *patch_job = malloc(sizeof(PatchJob));
+  if (!patch_job)
+    return 0;
+  snprintf(patch_job->path, sizeof(patch_job->path),
+           "/tmp/ferrum-patch-XXXXXX");
+  patch_job->on_done = on_done;
+  patch_job->ctx = ctx;
+
+  // The job reads a file, so a patch git rejects part way cannot leave a
+  // writer blocked on a pipe or hit with SIGPIPE
+  int fd = mkstemp(patch_job->path);
+  if (fd < 0) {
+    free(patch_job);
+    return 0;
+  }
+  size_t written = 0;
+  while (written < patch->len) {
+    ssize_t n = write(fd, patch->data + written, patch->len - written);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    written += (size_t)n;
+  }
+  int ok = close(fd) == 0 && written == patch->len;
+
+  const char *argv[] = {"git", "apply", "--cached", "--whitespace=nowarn",
+                        patch_job->path, NULL};
+  if (!ok || !git_jobs_submit("apply", argv, NULL, 0, on_patch_applied,
+                              patch_job)) {
+    unlink(patch_job->path);
+    free(patch_job);
+    return 0;
+  }
+  return 1;
+}
+
+// Copy of lines, read new-to-old when reverse is set
+static GitDiffLine *normalized_copy(const GitDiffLine *lines, int count,
+                                   int reverse) {
+  GitDiffLine *copy = malloc((count > 0 ? count : 1) * sizeof(GitDiffLine));
+  if (!copy)
+    return NULL;
+
+  for (int i = 0; i < count; i++) {
+    copy[i] = lines[i];
+    if (!reverse)
+      continue;
+    copy[i].old_line = lines[i].new_line;
+    copy[i].new_line = lines[i].old_line;
+    if (lines[i].type == '+')
+      copy[i].type = '-';
+    else if (lines[i].type == '-')
+      copy[i].type = '+';
+  }
+  return copy;
+}
+
+static int on_side(const GitDiffLine *line, int new_side) {
+  return line->type == ' ' || line->type == (new_side ? '+' : '-');
+}
+
+static int side_line(const GitDiffLine *line, int new_side) {
+  return new_side ? line->new_line : line->old_line;
+}
+
+// Position of every line on one side of the diff. Changes missing from
+// that side get the line they sit in front of.
+static void side_positions(const GitDiffLine *lines, int count, int new_side,
+                           int *pos) {
+  int start = 0;
+  while (start < count) {
+    int end = start + 1;
+    while (end < count && lines[end].type != '@')
+      end++;
+
+    int next = -1;
+    for (int i = end - 1; i >= start; i--) {
+      pos[i] = -1;
+      if (lines[i].type == '@')
+        continue;
+      if (on_side(&lines[i], new_side)) {
+        next = side_line(&lines[i], new_side);
+        pos[i] = next;
+      } else {
+        pos[i] = next;
+      }
+    }
+
+    // Without a later line, follow the previous one or the hunk start,
+    // which names the line before the hunk when that side is empty
+    int previous = lines[start].type == '@' ? side_line(&lines[start], new_side)
+                                            : 0;
+    for (int i = start; i < end; i++) {
+      if (lines[i].type == '@')
+        continue;
+      if (on_side(&lines[i], new_side))
+        previous = side_line(&lines[i], new_side);
+      else if (pos[i] < 0)
+        pos[i] = previous + 1;
+    }
+    start = end;
+  }
+}
+
+// Whether a line after i, up to end, stays on the new side of a selection
+static int new_side_follows(const GitDiffLine *lines, int i, int end) {
+  for (int j = i + 1; j < end; j++) {
+    if (lines[j].type == ' ' || (lines[j].type == '-' && !lines[j].selected) ||
+        (lines[j].type == '+' && lines[j].selected))
+      return 1;
+  }
+  return 0;
+}
+
+static int select_emit(GitDiffLine *out, int *written, int max, char type,
+                       int no_eol, const char *text, int *x, int *z) {
+  if (*written >= max)
+    return 0;
+  GitDiffLine *emit = &out[(*written)++];
+  memset(emit, 0, sizeof(*emit));
+  emit->type = type;
+  emit->no_eol = no_eol;
+  emit->text = text;
+  if (type != '+')
+    emit->old_line = ++*x;
+  if (type != '-')
+    emit->new_line = ++*z;
+  return 1;
+}
+
+int git_diff_select(const GitDiffLine *diff, int count, int reverse,
+                    GitDiffLine *out, int max) {
+  GitDiffLine *lines = normalized_copy(diff, count, reverse);
+  if (!lines)
+    return -1;
+
+  int written = 0;
+  int delta = 0; // Lines added minus removed by earlier selected hunks
+  int start = 0;
+  while (start < count) {
+    int end = start + 1;
+    while (end < count && lines[end].type != '@')
+      end++;
+
+    int has_selection = 0;
+    int old_before = -1;
+    for (int i = start; i < end; i++) {
+      const GitDiffLine *line = &lines[i];
+      if (line->type == '@')
+        continue;
+      if ((line->type == '+' || line->type == '-') && line->selected)
+        has_selection = 1;
+      if (old_before < 0 && on_side(line, 0))
+        old_before = line->old_line - 1;
+    }
+    if (!has_selection) {
+      start = end;
+      continue;
+    }
+    if (old_before < 0)
+      old_before = lines[start].type == '@' ? lines[start].old_line : 0;
+
+    if (written >= max) {
+      free(lines);
+      return -1;
+    }
+    GitDiffLine *header = &out[written++];
+    memset(header, 0, sizeof(*header));
+    header->type = '@';
+
+    int x = old_before;
+    int z = old_before + delta;
+    int z_before = z;
+    for (int i = start; i < end; i++) {
+      const GitDiffLine *line = &lines[i];
+      char type = line->type;
+      if (type == '@' || (type == '+' && !line->selected))
+        continue;
+      if (type == '-' && !line->selected)
+        type = ' ';
+
+      // A line that no longer ends the new side needs its newline there,
+      // while the old side keeps going without one
+      int no_eol = line->no_eol;
+      int ok = 1;
+      if (no_eol && type != '-' && new_side_follows(lines, i, end)) {
+        if (type == ' ') {
+          ok = select_emit(out, &written, max, '-', 1, line->text, &x, &z);
+          type = '+';
+        }
+        no_eol = 0;
+      }
+      if (!ok ||
+          !select_emit(out, &written, max, type, no_eol, line->text, &x, &z)) {
+        free(lines);
+        return -1;
+      }
+    }
+
+    header->old_line = x > old_before ? old_before + 1 : old_before;
+    header->new_line = z > z_before ? z_before + 1 : z_before;
+    delta = z - x;
+    start = end;
+  }
+
+  free(lines);
+  return written;
+}
+
+static int compare_entries(const void *left, const void *right) {
+  const ComposeEntry *a = left;
+  const ComposeEntry *b = right;
+  if (a->pos != b->pos)
+    return a->pos < b->pos ? -1 : 1;
+  if (a->order != b->order)
+    return a->order - b->order;
+  return a->seq - b->seq;
+}
+
+typedef struct {
+  ComposeLine *lines;
+  int count;
+  int x;
+  int z;
+  int gap_pending;
+} ComposeState;
+
+static void compose_emit(ComposeState *state, int in_x, int in_z,
+                         int x_no_eol, int z_no_eol, int selected,
+                         const char *text) {
+  if (!in_x && !in_z)
+    return;
+
+  // The same text ending one version without a newline and the other with
+  // one is a change, not context
+  if (in_x && in_z && x_no_eol != z_no_eol) {
+    compose_emit(state, 1, 0, x_no_eol, 0, selected, text);
+    compose_emit(state, 0, 1, 0, z_no_eol, selected, text);
+    return;
+  }
+
+  ComposeLine *line = &state->lines[state->count++];
+  line->type = in_x && in_z ? ' ' : (in_x ? '-' : '+');
+  line->x_before = state->x;
+  line->z_before = state->z;
+  line->gap_before = state->gap_pending;
+  line->selected = line->type == ' ' ? 0 : selected;
+  line->no_eol = in_x ? x_no_eol : z_no_eol;
+  line->text = text;
+  state->gap_pending = 0;
+  state->x += in_x;
+  state->z += in_z;
+}
+
+static int next_change(const ComposeLine *lines, int count, int from) {
+  while (from < count && lines[from].type == ' ')
+    from++;
+  return from;
+}
+
+int git_diff_compose(const GitDiffLine *a, int a_count, int a_reverse,
+                     const GitDiffLine *b, int b_count, int b_reverse,
+                     int context, GitDiffLine *out, int max) {
+  GitDiffLine *first = normalized_copy(a, a_count, a_reverse);
+  GitDiffLine *second = normalized_copy(b, b_count, b_reverse);
+  int total = a_count + b_count;
+  int *pos = malloc((total > 0 ? total : 1) * sizeof(int));
+  ComposeEntry *entries = malloc((total > 0 ? total : 1) * sizeof(ComposeEntry));
+  ComposeState state = {0};
+  // A context line can split in two over a missing newline
+  state.lines = malloc((total > 0 ? 2 * total : 1) * sizeof(ComposeLine));
+  int result = -1;
+  if (!first || !second || !pos || !entries || !state.lines)
+    goto done;
+
+  // a is positioned by its new side, b by its old side
+  int entry_count = 0;
+  side_positions(first, a_count, 1, pos);
+  for (int i = 0; i < a_count; i++) {
+    if (first[i].type == '@')
+      continue;
+    ComposeEntry *entry = &entries[entry_count];
+    entry->pos = pos[i];
+    entry->order = on_side(&first[i], 1) ? 2 : 0;
+    entry->seq = entry_count++;
+    entry->in_x = first[i].type != '+';
+    entry->in_z = 1;
+    entry->x_no_eol = first[i].no_eol && first[i].type != '+';
+    entry->z_no_eol = first[i].no_eol && first[i].type != '-';
+    entry->from_b = 0;
+    entry->selected = first[i].type != ' ' && first[i].selected;
+    entry->text = first[i].text;
+  }
+  side_positions(second, b_count, 0, pos);
+  for (int i = 0; i < b_count; i++) {
+    if (second[i].type == '@')
+      continue;
+    ComposeEntry *entry = &entries[entry_count];
+    entry->pos = pos[i];
+    entry->order = on_side(&second[i], 0) ? 2 : 1;
+    entry->seq = entry_count++;
+    entry->in_x = second[i].type == '+' ? 0 : 1;
+    entry->in_z = second[i].type != '-';
+    entry->x_no_eol = second[i].no_eol && second[i].type != '+';
+    entry->z_no_eol = second[i].no_eol && second[i].type != '-';
+    entry->from_b = 1;
+    entry->selected = second[i].type != ' ' && second[i].selected;
+    entry->text = second[i].text;
+  }
+  qsort(entries, entry_count, sizeof(ComposeEntry), compare_entries);
+
+  int last = 0; // Last middle line accounted for
+  int i = 0;
+  while (i < entry_count) {
+    int k = entries[i].pos;
+
+    // Middle lines neither diff mentions are unchanged in both
+    if (k - 1 > last) {
+      state.x += k - 1 - last;
+      state.z += k - 1 - last;
+      last = k - 1;
+      state.gap_pending = 1;
+    }
+
+    int removed = i;
+    while (i < entry_count && entries[i].pos == k && entries[i].order == 0)
+      i++;
+    int added = i;
+    while (i < entry_count && entries[i].pos == k && entries[i].order == 1)
+      i++;
+    int added_end = i;
+
+    // A line dropped by a and brought back by b is context again
+    int next_added = added;
+    for (int r = removed; r < added; r++) {
+      int match = -1;
+      for (int m = next_added; m < added_end && match < 0; m++) {
+        if (strcmp(entries[m].text, entries[r].text) == 0)
+          match = m;
+      }
+      if (match < 0) {
+        compose_emit(&state, 1, 0, entries[r].x_no_eol, 0, entries[r].selected,
+                     entries[r].text);
+        continue;
+      }
+      for (; next_added < match; next_added++)
+        compose_emit(&state, 0, 1, 0, entries[next_added].z_no_eol,
+                     entries[next_added].selected, entries[next_added].text);
+      compose_emit(&state, 1, 1, entries[r].x_no_eol, entries[match].z_no_eol,
+                   0, entries[r].text);
+      next_added = match + 1;
+    }
+    for (; next_added < added_end; next_added++)
+      compose_emit(&state, 0, 1, 0, entries[next_added].z_no_eol,
+                   entries[next_added].selected, entries[next_added].text);
+
+    if (i < entry_count && entries[i].pos == k && entries[i].order == 2) {
+      int in_x = 1;
+      int in_z = 1;
+      int selected = 0;
+      const char *text = entries[i].text;
+      // The first version's end comes from a, the last version's from b;
+      // a line only one of them mentions is unchanged by the other
+      int x_no_eol = entries[i].x_no_eol;
+      int z_no_eol = entries[i].z_no_eol;
+      while (i < entry_count && entries[i].pos == k && entries[i].order == 2) {
+        in_x &= entries[i].in_x;
+        in_z &= entries[i].in_z;
+        selected |= entries[i].selected;
+        if (entries[i].from_b)
+          z_no_eol = entries[i].z_no_eol;
+        else
+          x_no_eol = entries[i].x_no_eol;
+        i++;
+      }
+      compose_emit(&state, in_x, in_z, x_no_eol, z_no_eol, selected, text);
+      last = k;
+    }
+  }
+
+  // Group changes into hunks, merging those close enough to share context
+  int written = 0;
+  int floor = 0;
+  int change = next_change(state.lines, state.count, 0);
+  while (change < state.count) {
+    int start = change;
+    while (start > floor && change - start < context &&
+           !state.lines[start].gap_before)
+      start--;
+
+    int end = change;
+    while (1) {
+      int next = next_change(state.lines, state.count, end + 1);
+      if (next >= state.count || next - end - 1 > 2 * context)
+        break;
+      int split = 0;
+      for (int l = end + 1; l <= next && !split; l++)
+        split = state.lines[l].gap_before;
+      if (split)
+        break;
+      end = next;
+    }
+
+    int tail = end;
+    while (tail + 1 < state.count && tail - end < context &&
+           !state.lines[tail + 1].gap_before)
+      tail++;
+
+    if (written + (tail - start + 2) > max)
+      goto done;
+
+    int has_x = 0;
+    int has_z = 0;
+    for (int l = start; l <= tail; l++) {
+      has_x |= state.lines[l].type != '+';
+      has_z |= state.lines[l].type != '-';
+    }
+    GitDiffLine *header = &out[written++];
+    memset(header, 0, sizeof(*header));
+    header->type = '@';
+    header->old_line = state.lines[start].x_before + has_x;
+    header->new_line = state.lines[start].z_before + has_z;
+
+    for (int l = start; l <= tail; l++) {
+      const ComposeLine *line = &state.lines[l];
+      GitDiffLine *emit = &out[written++];
+      emit->type = line->type;
+      emit->old_line = line->type != '+' ? line->x_before + 1 : 0;
+      emit->new_line = line->type != '-' ? line->z_before + 1 : 0;
+      emit->selected = line->selected;
+      emit->no_eol = line->no_eol;
+      emit->text = line->text;
+    }
+
+    floor = tail + 1;
+    change = next_change(state.lines, state.count, floor);
+  }
+  result = written;
+
+done:
+  free(first);
+  free(second);
+  free(pos);
+  free(entries);
+  free(state.lines);
+  return result;
+}
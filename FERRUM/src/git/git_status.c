@@ -0,0 +1,163 @@
+#include "git_status.h"
+#include <string.h>
+
+void git_status_init(GitStatus *status) { memset(status, 0, sizeof(*status)); }
+
+void git_status_free(GitStatus *status) {
+  free(status->entries);
+  free(status->names);
+  free(status->partial);
+  git_status_init(status);
+}
+
+const char *git_status_path(const GitStatus *status, size_t offset) {
+  return offset == GIT_STATUS_NO_PATH ? NULL : status->names + offset;
+}
+
+static int grow(void **buffer, size_t *capacity, size_t needed, size_t size) {
+  if (needed <= *capacity)
+    return 1;
+
+  size_t new_capacity = *capacity ? *capacity : 64;
+  while (new_capacity < needed)
+    new_capacity *= 2;
+
+  void *grown = realloc(*buffer, new_capacity * size);
+  if (!grown)
+    return 0;
+  *buffer = grown;
+  *capacity = new_capacity;
+  return 1;
+}
+
+static size_t add_name(GitStatus *status, const char *path, size_t len) {
+  if (!grow((void **)&status->names, &status->names_capacity,
+            status->names_len + len + 1, 1))
+    return GIT_STATUS_NO_PATH;
+
+  size_t offset = status->names_len;
+  memcpy(status->names + offset, path, len);
+  status->names[offset + len] = '\0';
+  status->names_len += len + 1;
+  return offset;
+}
+
+// Porcelain v2 writes '.' for an unchanged column
+static char status_column(char c) { return c == '.' ? ' ' : c; }
+
+// Path of a record: everything after the first `fields` space separated
+// fields, since paths may contain spaces themselves
+static const char *record_path(const char *record, size_t len, int fields) {
+  const char *p = record;
+  const char *end = record + len;
+  while (fields > 0 && p < end) {
+    if (*p++ == ' ')
+      fields--;
+  }
+  return fields == 0 ? p : NULL;
+}
+
+static int parse_record(GitStatus *status, const char *record, size_t len) {
+  if (status->expect_orig_path) {
+    status->expect_orig_path = 0;
+    GitStatusEntry *entry = &status->entries[status->count - 1];
+    entry->orig_path = add_name(status, record, len);
+    return entry->orig_path != GIT_STATUS_NO_PATH;
+  }
+
+  if (len < 3 || record[1] != ' ')
+    return 1;
+
+  int fields;
+  switch (record[0]) {
+  case '1': // Ordinary change
+    fields = 8;
+    break;
+  case '2': // Rename or copy, the source path follows as its own record
+    fields = 9;
+    break;
+  case 'u': // Unmerged
+    fields = 10;
+    break;
+  case '?': // Untracked
+    fields = 1;
+    break;
+  default: // Headers and ignored files
+    return 1;
+  }
+
+  const char *path = record_path(record, len, fields);
+  if (!path)
+    return 1;
+
+  if (!grow((void **)&status->entries, &status->capacity,
+            (size_t)status->count + 1, sizeof(GitStatusEntry)))
+    return 0;
+
+  GitStatusEntry *entry = &status->entries[status->count];
+  if (record[0] == '?') {
+    entry->index_status = '?';
+    entry->worktree_status = '?';
+  } else {
+    entry->index_status = status_column(record[2]);
+    entry->worktree_status = status_column(record[3]);
+  }
+  entry->orig_path = GIT_STATUS_NO_PATH;
+  entry->path = add_name(status, path, (size_t)(record + len - path));
+  if (entry->path == GIT_STATUS_NO_PATH)
+    return 0;
+
+  status->count++;
+  status->expect_orig_path = record[0] == '2';
+  return 1;
+}
+
+int git_status_feed(GitStatus *status, const char *data, size_t len) {
+  size_t start = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (data[i] != '\0')
+      continue;
+
+    int ok;
+    if (status->partial_len > 0) {
+      // Finish the record the previous chunk ended in
+      size_t piece = i - start;
+      if (!grow((void **)&status->partial, &status->partial_capacity,
+                status->partial_len + piece, 1))
+        return 0;
+      memcpy(status->partial + status->partial_len, data + start, piece);
+      ok = parse_record(status, status->partial, status->partial_len + piece);
+      status->partial_len = 0;
+    } else {
+      ok = parse_record(status, data + start, i - start);
+    }
+    if (!ok)
+      return 0;
+    start = i + 1;
+  }
+
+  size_t rest = len - start;
+  if (rest > 0) {
+    if (!grow((void **)&status->partial, &status->partial_capacity,
+              status->partial_len + rest, 1))
+      return 0;
+    memcpy(status->partial + status->partial_len, data + start, rest);
+    status->partial_len += rest;
+  }
+  return 1;
+}
+
+int git_status_read(GitStatus *status) {
+  FILE *fp = popen("git status --porcelain=v2 -z 2>/dev/null", "r");
+  if (!fp)
+    return 0;
+
+  char buffer[65536];
+  size_t n;
+  int ok = 1;
+  while (ok && (n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    ok = git_status_feed(status, buffer, n);
+
+  int exit_status = pclose(fp);
+  return ok && WIFEXITED(exit_status) && WEXITSTATUS(exit_status) == 0;
+}
@@ -205,6 +205,45 @@ void update_command_frequency(const char *command) {
   frequency_count++;
 }
 
+// Files from version 1.1 on keep one entry per line by writing a pasted
+// command's line breaks as \n and its backslashes as \\. Version 1.0
+// files hold commands verbatim.
+#define HISTORY_FILE_VERSION "1.1"
+
+static void write_escaped(FILE *fp, const char *command) {
+  for (const char *p = command; *p; p++) {
+    if (*p == '\n')
+      fputs("\\n", fp);
+    else if (*p == '\\')
+      fputs("\\\\", fp);
+    else
+      fputc(*p, fp);
+  }
+}
+
+static void unescape_command(char *command) {
+  char *out = command;
+  for (const char *p = command; *p; p++) {
+    if (*p == '\\' && (p[1] == 'n' || p[1] == '\\')) {
+      *out++ = p[1] == 'n' ? '\n' : '\\';
+      p++;
+    } else {
+      *out++ = *p;
+    }
+  }
+  *out = '\0';
+}
+
+// Skip the header, reporting whether it names an escaped format
+static int skip_header(FILE *fp, char **line, size_t *line_cap) {
+  int escaped = 0;
+  while (getline(line, line_cap, fp) != -1 && (*line)[0] == '#') {
+    if (strncmp(*line, "# Version: ", 11) == 0)
+      escaped = strncmp(*line + 11, "1.0", 3) != 0;
+  }
+  return escaped;
+}
+
 void save_history_to_file(void) {
   if (!history_entries || history_size == 0) {
     return;
@@ -219,13 +258,14 @@ void save_history_to_file(void) {
 
   // Write version and metadata
   fprintf(fp, "# LSH Persistent History\n");
-  fprintf(fp, "# Version: 1.0\n");
+  fprintf(fp, "# Version: " HISTORY_FILE_VERSION "\n");
   fprintf(fp, "# Format: timestamp command\n\n");
 
   // Write entries
   for (int i = 0; i < history_size; i++) {
-    fprintf(fp, "%ld %s\n", (long)history_entries[i].timestamp,
-            history_entries[i].command);
+    fprintf(fp, "%ld ", (long)history_entries[i].timestamp);
+    write_escaped(fp, history_entries[i].command);
+    fputc('\n', fp);
   }
 
   fclose(fp);
@@ -237,14 +277,13 @@ void load_history_from_file(void) {
     return; // File doesn't exist or can't be opened
   }
 
-  char line[1024];
-  time_t timestamp;
-  char command[900]; // Allow space for timestamp and whitespace
+  // Entries can be pasted multi-kilobyte commands, so lines are read whole
+  char *line = NULL;
+  size_t line_cap = 0;
+  long timestamp;
+  char *command;
 
-  // Skip header lines
-  while (fgets(line, sizeof(line), fp) && line[0] == '#') {
-    // Skip header line
-  }
+  int escaped = skip_header(fp, &line, &line_cap);
 
   // Clear history
   for (int i = 0; i < history_size; i++) {
@@ -253,17 +292,22 @@ void load_history_from_file(void) {
   history_size = 0;
 
   // Read entries
-  while (fgets(line, sizeof(line), fp)) {
+  while (getline(&line, &line_cap, fp) != -1) {
     // Parse line: timestamp command
-    if (sscanf(line, "%ld %[^\n]", &timestamp, command) == 2) {
+    if (sscanf(line, "%ld %m[^\n]", &timestamp, &command) == 2) {
+      if (escaped)
+        unescape_command(command);
       if (history_size < history_capacity) {
-        history_entries[history_size].command = strdup(command);
+        history_entries[history_size].command = command;
         history_entries[history_size].timestamp = timestamp;
         history_size++;
+      } else {
+        free(command);
       }
     }
   }
 
+  free(line);
   fclose(fp);
 }
 
@@ -281,13 +325,14 @@ void save_frequencies_to_file(void) {
 
   // Write version and metadata
   fprintf(fp, "# LSH Command Frequencies\n");
-  fprintf(fp, "# Version: 1.0\n");
+  fprintf(fp, "# Version: " HISTORY_FILE_VERSION "\n");
   fprintf(fp, "# Format: count command\n\n");
 
   // Write entries
   for (int i = 0; i < frequency_count; i++) {
-    fprintf(fp, "%d %s\n", command_frequencies[i].count,
-            command_frequencies[i].command);
+    fprintf(fp, "%d ", command_frequencies[i].count);
+    write_escaped(fp, command_frequencies[i].command);
+    fputc('\n', fp);
   }
 
   fclose(fp);
@@ -299,14 +344,12 @@ void load_frequencies_from_file(void) {
     return; // File doesn't exist or can't be opened
   }
 
-  char line[1024];
+  char *line = NULL;
+  size_t line_cap = 0;
   int count;
-  char command[900]; // Allow space for count and whitespace
+  char *command;
 
-  // Skip header lines
-  while (fgets(line, sizeof(line), fp) && line[0] == '#') {
-    // Skip header line
-  }
+  int escaped = skip_header(fp, &line, &line_cap);
 
   // Clear frequencies
   for (int i = 0; i < frequency_count; i++) {
@@ -315,17 +358,22 @@ void load_frequencies_from_file(void) {
   frequency_count = 0;
 
   // Read entries
-  while (fgets(line, sizeof(line), fp)) {
+  while (getline(&line, &line_cap, fp) != -1) {
     // Parse line: count command
-    if (sscanf(line, "%d %[^\n]", &count, command) == 2) {
+    if (sscanf(line, "%d %m[^\n]", &count, &command) == 2) {
+      if (escaped)
+        unescape_command(command);
       if (frequency_count < frequency_capacity) {
-        command_frequencies[frequency_count].command = strdup(command);
+        command_frequencies[frequency_count].command = command;
         command_frequencies[frequency_count].count = count;
         frequency_count++;
+      } else {
+        free(command);
       }
     }
   }
 
+  free(line);
   fclose(fp);
 }
 
@@ -1,54 +1,117 @@
-
 #include "autocorrect.h"
+#include "aliases.h"
 #include "builtins.h"
+#include "command_registry.h"
+#include "containers/arena.h"
+#include "dir_cache.h"
+#include <dirent.h>
+#include <stdint.h>
 
-int levenshtein_distance(const char *s1, const char *s2) {
-  int len1 = strlen(s1);
-  int len2 = strlen(s2);
+#define MAX_CORRECTION 2      // Largest edit distance offered as a fix
+#define MYERS_MAX_LENGTH 64   // Longest pattern a machine word holds
+#define NO_LIMIT (INT_MAX - 1) // Distances wanted exactly
+#define DEFAULT_PATH "/bin:/usr/bin"
 
-  // Create a matrix to store distances
-  int **matrix = (int **)malloc((len1 + 1) * sizeof(int *));
-  if (!matrix)
-    return -1;
-
-  for (int i = 0; i <= len1; i++) {
-    matrix[i] = (int *)malloc((len2 + 1) * sizeof(int));
-    if (!matrix[i]) {
-      for (int j = 0; j < i; j++) {
-        free(matrix[j]);
-      }
-      free(matrix);
-      return -1;
-    }
-  }
+// Bit i of an entry is set where the pattern has that byte. All zero
+// between calls.
+static uint64_t pattern_bits[256];
 
-  // Initialize the matrix
-  for (int i = 0; i <= len1; i++) {
-    matrix[i][0] = i;
-  }
-  for (int j = 0; j <= len2; j++) {
-    matrix[0][j] = j;
+// Myers' bit-parallel algorithm: one column of the distance matrix per
+// byte of text, with the pattern's column held in two bit vectors
+static int myers_distance(const unsigned char *pattern, int m,
+                          const unsigned char *text, int n, int max) {
+  for (int i = 0; i < m; i++)
+    pattern_bits[pattern[i]] |= 1ULL << i;
+
+  uint64_t positive = ~0ULL; // Vertical +1 deltas
+  uint64_t negative = 0;     // Vertical -1 deltas
+  uint64_t last = 1ULL << (m - 1);
+  int score = m;
+
+  for (int j = 0; j < n; j++) {
+    uint64_t eq = pattern_bits[text[j]];
+    uint64_t xv = eq | negative;
+    uint64_t xh = (((eq & positive) + positive) ^ positive) | eq;
+    uint64_t horizontal_pos = negative | ~(xh | positive);
+    uint64_t horizontal_neg = positive & xh;
+
+    if (horizontal_pos & last)
+      score++;
+    else if (horizontal_neg & last)
+      score--;
+
+    // The top row grows by one per byte of text
+    horizontal_pos = (horizontal_pos << 1) | 1;
+    horizontal_neg <<= 1;
+    positive = horizontal_neg | ~(xv | horizontal_pos);
+    negative = horizontal_pos & xv;
+
+    // Each byte left can lower the distance by at most one
+    if (score - (n - j - 1) > max)
+      break;
   }
 
-  // Fill the matrix
+  for (int i = 0; i < m; i++)
+    pattern_bits[pattern[i]] = 0;
+  return score > max ? max + 1 : score;
+}
+
+// Two rows of the distance matrix, for patterns too long for a word
+static int row_distance(const char *s1, int len1, const char *s2, int len2,
+                        int max) {
+  int *row = malloc((len2 + 1) * sizeof(int));
+  if (!row)
+    return max + 1;
+
+  for (int j = 0; j <= len2; j++)
+    row[j] = j;
+
   for (int i = 1; i <= len1; i++) {
+    int diagonal = row[0];
+    int best = row[0] = i;
     for (int j = 1; j <= len2; j++) {
-      int cost = (s1[i - 1] == s2[j - 1]) ? 0 : 1;
-      matrix[i][j] = min3(matrix[i - 1][j] + 1,       // deletion
-                          matrix[i][j - 1] + 1,       // insertion
-                          matrix[i - 1][j - 1] + cost // substitution
+      int above = row[j];
+      row[j] = min3(above + 1,                               // deletion
+                    row[j - 1] + 1,                          // insertion
+                    diagonal + (s1[i - 1] == s2[j - 1] ? 0 : 1) // substitution
       );
+      diagonal = above;
+      if (row[j] < best)
+        best = row[j];
+    }
+    if (best > max) {
+      free(row);
+      return max + 1;
     }
   }
 
-  // Get the result and free the matrix
-  int result = matrix[len1][len2];
-  for (int i = 0; i <= len1; i++) {
-    free(matrix[i]);
+  int result = row[len2];
+  free(row);
+  return result > max ? max + 1 : result;
+}
+
+int levenshtein_distance(const char *s1, const char *s2, int max) {
+  int len1 = strlen(s1);
+  int len2 = strlen(s2);
+  if (abs(len1 - len2) > max)
+    return max + 1;
+
+  // The shorter string is the pattern
+  if (len1 > len2) {
+    const char *s = s1;
+    s1 = s2;
+    s2 = s;
+    int len = len1;
+    len1 = len2;
+    len2 = len;
   }
-  free(matrix);
 
-  return result;
+  if (len1 == 0)
+    return len2;
+  if (len1 <= MYERS_MAX_LENGTH)
+    return myers_distance((const unsigned char *)s1, len1,
+                          (const unsigned char *)s2, len2, max);
+  return row_distance(s1, len1, s2, len2, max);
 }
 
 int min3(int a, int b, int c) {
@@ -60,15 +123,214 @@ int min3(int a, int b, int c) {
   return min;
 }
 
-void init_autocorrect(void) {
-  // No initialization required currently
+// BK-tree: a child's word is edge away from its parent's, so by the
+// triangle inequality a search within k of a word at distance d from the
+// parent only visits children with edges in [d - k, d + k]
+typedef struct BKNode {
+  const char *word;
+  int edge;     // Distance from the parent's word
+  int max_edge; // Largest edge of any child
+  struct BKNode *children;
+  struct BKNode *sibling;
+} BKNode;
+
+// Builtins and every file in PATH, rebuilt when PATH or the listings of
+// its directories change
+static struct {
+  Arena arena;
+  BKNode *root;
+  char *path_env; // PATH the tree was built from
+  // dir_cache_generation() of each PATH directory listing it was built from
+  unsigned long *generations;
+  int generation_count;
+} known;
+
+static BKNode *new_node(const char *word, int edge) {
+  size_t length = strlen(word) + 1;
+  BKNode *node = arena_alloc(&known.arena, sizeof(BKNode));
+  char *copy = arena_alloc(&known.arena, length);
+  if (!node || !copy)
+    return NULL;
+  memcpy(copy, word, length);
+  *node = (BKNode){copy, edge, 0, NULL, NULL};
+  return node;
 }
 
-void shutdown_autocorrect(void) {
-  // No cleanup required currently
+static void insert_word(const char *word) {
+  if (!known.root) {
+    known.root = new_node(word, 0);
+    return;
+  }
+
+  BKNode *node = known.root;
+  for (;;) {
+    int distance = levenshtein_distance(word, node->word, NO_LIMIT);
+    if (distance == 0)
+      return; // Already known
+
+    BKNode *child = node->children;
+    while (child && child->edge != distance)
+      child = child->sibling;
+    if (!child) {
+      child = new_node(word, distance);
+      if (!child)
+        return;
+      child->sibling = node->children;
+      node->children = child;
+      if (distance > node->max_edge)
+        node->max_edge = distance;
+      return;
+    }
+    node = child;
+  }
 }
 
+// Each directory in PATH, as dir_cache knows it. Relative ones are left
+// out, as they name different directories as the shell moves around.
+static const DirEntry *next_path_dir(const char **path, int *count) {
+  while (**path) {
+    const char *start = *path;
+    const char *end = strchr(start, ':');
+    if (!end)
+      end = start + strlen(start);
+    *path = *end ? end + 1 : end;
 
+    char dir[PATH_MAX];
+    if (*start != '/' || end - start >= (long)sizeof(dir))
+      continue;
+    memcpy(dir, start, end - start);
+    dir[end - start] = '\0';
+
+    const DirEntry *entries = dir_cache_list(dir, count);
+    if (entries)
+      return entries;
+  }
+  return NULL;
+}
+
+static void refresh_known_commands(void) {
+  const char *path_env = getenv("PATH");
+  if (!path_env)
+    path_env = DEFAULT_PATH;
+
+  // Listing each directory brings dir_cache up to date with it. Only a
+  // PATH directory read again can have new commands; listings read for
+  // completion elsewhere do not matter.
+  const char *path = path_env;
+  int count;
+  int listed = 0;
+  int changed = !known.root || !known.path_env ||
+                strcmp(known.path_env, path_env) != 0;
+  const DirEntry *entries;
+  while ((entries = next_path_dir(&path, &count))) {
+    if (listed >= known.generation_count ||
+        known.generations[listed] != dir_cache_generation(entries))
+      changed = 1;
+    listed++;
+  }
+  if (!changed && listed == known.generation_count)
+    return;
+
+  arena_free(&known.arena);
+  known.root = NULL;
+  free(known.path_env);
+  known.path_env = strdup(path_env);
+  known.generation_count = 0;
+
+  int builtin_count;
+  const CommandInfo *builtins = command_builtins(&builtin_count);
+  for (int i = 0; i < builtin_count; i++)
+    insert_word(builtins[i].name);
+
+  unsigned long *generations = realloc(
+      known.generations, (listed > 0 ? listed : 1) * sizeof(unsigned long));
+  if (generations)
+    known.generations = generations;
+
+  path = path_env;
+  while ((entries = next_path_dir(&path, &count))) {
+    // Without room to remember it, the next refresh rebuilds again
+    if (generations && known.generation_count < listed)
+      known.generations[known.generation_count++] =
+          dir_cache_generation(entries);
+    for (int i = 0; i < count; i++) {
+      if (entries[i].type == DT_REG)
+        insert_word(entries[i].name);
+    }
+  }
+}
+
+typedef struct {
+  char word[256];
+  int distance;    // Largest distance still wanted
+  int shared_miss; // Bytes the word and the command do not have in common
+  int found;
+} Correction;
+
+// How far apart the bytes of two words are as bags, ignoring order. It
+// tells a transposed "gti" is closer to "git" than to "g++", which edit
+// distance rates the same.
+static int bag_difference(const char *a, const char *b) {
+  int counts[256] = {0};
+  for (const unsigned char *p = (const unsigned char *)a; *p; p++)
+    counts[*p]++;
+  for (const unsigned char *p = (const unsigned char *)b; *p; p++)
+    counts[*p]--;
+
+  int difference = 0;
+  for (int i = 0; i < 256; i++)
+    difference += abs(counts[i]);
+  return difference;
+}
+
+// Closest wins, then the one made of the same letters, then the first in
+// name order. Files in PATH that turn out not to be executable are passed
+// over.
+static void consider(Correction *best, const char *command, const char *word,
+                     int distance) {
+  if (distance > best->distance || strlen(word) >= sizeof(best->word))
+    return;
+
+  int shared_miss = bag_difference(command, word);
+  if (best->found && distance == best->distance &&
+      (shared_miss > best->shared_miss ||
+       (shared_miss == best->shared_miss && strcmp(word, best->word) >= 0)))
+    return;
+  if (!is_valid_command(word))
+    return;
+
+  strcpy(best->word, word);
+  best->distance = distance;
+  best->shared_miss = shared_miss;
+  best->found = 1;
+}
+
+static void search_known(const BKNode *node, const char *word,
+                         Correction *best) {
+  // Past this neither the node nor any of its children can be close enough
+  int limit = node->max_edge + best->distance;
+  int distance = levenshtein_distance(word, node->word, limit);
+  consider(best, word, node->word, distance);
+
+  for (const BKNode *child = node->children; child; child = child->sibling) {
+    if (abs(child->edge - distance) <= best->distance)
+      search_known(child, word, best);
+  }
+}
+
+void init_autocorrect(void) {
+  // The tree is built when a command is first not found
+}
+
+void shutdown_autocorrect(void) {
+  arena_free(&known.arena);
+  known.root = NULL;
+  free(known.path_env);
+  known.path_env = NULL;
+  free(known.generations);
+  known.generations = NULL;
+  known.generation_count = 0;
+}
 
 char **check_for_corrections(char **args) {
   if (!args || !args[0]) {
@@ -88,44 +350,29 @@ char **check_for_corrections(char **args) {
     return NULL;
   }
 
-  // List of common commands to check against
-  const char *common_commands[] = {
-      "ls",     "cd",      "grep",     "find",   "cat",        "mv",
-      "cp",     "rm",      "mkdir",    "rmdir",  "chmod",      "chown",
-      "ps",     "top",     "df",       "du",     "free",       "mount",
-      "umount", "tar",     "zip",      "unzip",  "ssh",        "scp",
-      "ping",   "netstat", "ifconfig", "route",  "traceroute", "wget",
-      "curl",   "apt",     "apt-get",  "yum",    "dnf",        "pacman",
-      "git",    "make",    "gcc",      "g++",    "python",     "python3",
-      "node",   "npm",     "vim",      "nano",   "history",    "clear",
-      "exit",   "alias",   "man",      "help",   "touch",      "echo",
-      "pwd",    "sudo",    "shutdown", "reboot", NULL};
-
-  // Check built-in commands too
-  int best_distance = 3; // Maximum edit distance to consider a correction
-  const char *best_match = NULL;
-
-  // First check among built-in commands
-  for (int i = 0; i < lsh_num_builtins(); i++) {
-    int distance = levenshtein_distance(command, builtin_str[i]);
-    if (distance < best_distance) {
-      best_distance = distance;
-      best_match = builtin_str[i];
-    }
+  Correction best = {"", MAX_CORRECTION, 0, 0};
+
+  // Builtins and installed commands
+  refresh_known_commands();
+  if (known.root) {
+    search_known(known.root, command, &best);
   }
 
-  // Then check common commands
-  for (int i = 0; common_commands[i] != NULL; i++) {
-    int distance = levenshtein_distance(command, common_commands[i]);
-    if (distance < best_distance) {
-      best_distance = distance;
-      best_match = common_commands[i];
+  // Aliases are few and change at any time, so they are checked directly
+  int alias_count;
+  char **aliases = get_alias_names(&alias_count);
+  if (aliases) {
+    for (int i = 0; i < alias_count; i++) {
+      consider(&best, command, aliases[i],
+               levenshtein_distance(command, aliases[i], best.distance));
+      free(aliases[i]);
     }
+    free(aliases);
   }
 
   // If we found a good match, suggest it
-  if (best_match) {
-    printf("Command '%s' not found. Did you mean '%s'?\n", command, best_match);
+  if (best.found) {
+    printf("Command '%s' not found. Did you mean '%s'?\n", command, best.word);
     // No longer waiting for input - just return NULL
   }
 
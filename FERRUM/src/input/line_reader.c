@@ -3,8 +3,13 @@
 #include "aliases.h"
 #include "bookmarks.h" // Added for bookmark support
 #include "builtins.h"  // Added for history access
+#include "command_path.h"
+#include "command_registry.h"
 #include "common.h"
+#include "dir_cache.h"
+#include "event_loop.h"
 #include "git_integration.h"
+#include "line_renderer.h"
 #include "persistent_history.h"
 #include "tab_complete.h"
 #include "themes.h"
@@ -12,6 +17,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <strings.h>
 #include <sys/stat.h>
@@ -40,11 +46,24 @@ static char *history_suggestion = NULL;
 static int has_history_suggestion = 0;
 
 // Define colors for suggestions
-#define SUGGESTION_COLOR "\033[2;37m" // Dim white color for suggestions
 #define HIGHLIGHT_COLOR "\033[7;36m" // Highlighted background for selected item
 #define NORMAL_COLOR "\033[0;36m"    // Normal color for menu items
 #define RESET_COLOR "\033[0m"
 
+#define INPUT_BUFFER 4096      // Most bytes taken from the terminal per read
+#define PASTE_TIMEOUT_MS 1000  // Longest wait for the rest of a paste
+#define LOCAL_KEY_SHIFT_ENTER 1010
+#define LOCAL_KEY_PASTE 1011 // Start of a bracketed paste
+
+// Keys typed or pasted ahead, read from the terminal in one go and handed
+// out a byte at a time
+static unsigned char input[INPUT_BUFFER];
+static int input_len = 0;
+static int input_pos = 0;
+
+// What the prompt line currently shows
+static LineRenderer screen;
+
 int is_valid_command(const char *cmd) {
   if (!cmd || cmd[0] == '\0') {
     return 0; // Empty command is not valid
@@ -60,10 +79,8 @@ int is_valid_command(const char *cmd) {
   command_part[i] = '\0';
 
   // Check built-in commands
-  for (int i = 0; i < lsh_num_builtins(); i++) {
-    if (strcasecmp(command_part, builtin_str[i]) == 0) {
-      return 1;
-    }
+  if (command_builtin(command_part)) {
+    return 1;
   }
 
   // Check aliases
@@ -142,44 +159,59 @@ int is_valid_command(const char *cmd) {
     }
 
     // Check in PATH directories
-    char *path_env = getenv("PATH");
-    if (!path_env) {
-      return 0; // No PATH defined
-    }
-
-    char *path_copy = strdup(path_env);
-    if (!path_copy) {
-      return 0; // Memory allocation error
-    }
-
-    char *token, *rest = path_copy;
-    while ((token = strtok_r(rest, ":", &rest))) {
-      // Construct full path to check
-      snprintf(path_buffer, PATH_MAX, "%s/%s", token, command_part);
-      if (stat(path_buffer, &st) == 0 && (st.st_mode & S_IXUSR)) {
-        free(path_copy);
-        return 1;
-      }
+    if (command_path_resolve(command_part, path_buffer, PATH_MAX)) {
+      return 1;
     }
-    free(path_copy);
   }
 
   return 0; // Command not found
 }
 
-int read_key(void) {
-  unsigned char c;
-  int nread;
-  char seq[6];
+static void on_resize(void *data) {
+  (void)data;
+  line_render_resize(&screen);
+}
 
-// Define local constants for special keys
-#define LOCAL_KEY_SHIFT_ENTER 1010
+static void watch_resize(void) {
+  static int watching = 0;
+  if (!watching)
+    watching = event_signal(SIGWINCH, on_resize, NULL);
+}
+
+// Next byte of input, waiting up to timeout_ms for it, or for as long as
+// it takes when timeout_ms is negative. Returns -1 on timeout or error.
+static int next_byte(int timeout_ms) {
+  if (input_pos < input_len)
+    return input[input_pos++];
 
-  // Read a character
-  while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-    if (nread == -1 && errno != EAGAIN)
+  // Timers and signals are handled while waiting
+  if (event_wait(STDIN_FILENO, timeout_ms) != 1)
+    return -1;
+
+  ssize_t nread;
+  while ((nread = read(STDIN_FILENO, input, sizeof(input))) <= 0) {
+    if (nread == -1 && errno != EAGAIN && errno != EINTR)
       return -1;
   }
+  input_len = (int)nread;
+  input_pos = 1;
+  return input[0];
+}
+
+// Is more input already waiting? Then the screen is brought up to date
+// once, after all of it has been handled.
+int key_pending(void) {
+  if (input_pos < input_len)
+    return 1;
+  return event_wait(STDIN_FILENO, 0) == 1;
+}
+
+int read_key(void) {
+  int c = next_byte(-1);
+  char seq[6];
+
+  if (c == -1)
+    return -1;
 
   // Handle carriage return (CR) as enter
   if (c == 13) {
@@ -190,24 +222,13 @@ int read_key(void) {
   if (c == KEY_ESCAPE) {
     // Read up to 5 additional chars
     int i = 0;
-    fd_set readfds;
-    struct timeval timeout;
-
-    FD_ZERO(&readfds);
-    FD_SET(STDIN_FILENO, &readfds);
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 50000; // 50ms timeout
 
     // Try to read the sequence with timeout to avoid blocking
     while (i < 5) {
-      int select_result =
-          select(STDIN_FILENO + 1, &readfds, NULL, NULL, &timeout);
-      if (select_result <= 0)
+      int next = next_byte(50);
+      if (next == -1)
         break; // Timeout or error
-
-      if (read(STDIN_FILENO, &seq[i], 1) != 1)
-        break;
-      i++;
+      seq[i++] = (char)next;
 
       // Check for known sequences
       if (i >= 2 && seq[0] == '[') {
@@ -222,6 +243,32 @@ int read_key(void) {
           return KEY_LEFT;
         case 'Z':
           return KEY_SHIFT_TAB; // Shift+Tab sequence
+        case 'H':
+          return KEY_HOME;
+        case 'F':
+          return KEY_END;
+        }
+      }
+      if (i >= 2 && seq[0] == 'O') {
+        if (seq[1] == 'H')
+          return KEY_HOME;
+        if (seq[1] == 'F')
+          return KEY_END;
+      }
+
+      // ESC [ n ~ for Home, End, Page Up and Page Down
+      if (i == 3 && seq[0] == '[' && seq[2] == '~') {
+        switch (seq[1]) {
+        case '1':
+        case '7':
+          return KEY_HOME;
+        case '4':
+        case '8':
+          return KEY_END;
+        case '5':
+          return KEY_PAGE_UP;
+        case '6':
+          return KEY_PAGE_DOWN;
         }
       }
 
@@ -238,6 +285,11 @@ int read_key(void) {
           return LOCAL_KEY_SHIFT_ENTER;
         }
       }
+
+      // Bracketed paste: ESC [ 200 ~
+      if (i == 5 && memcmp(seq, "[200~", 5) == 0) {
+        return LOCAL_KEY_PASTE;
+      }
     }
 
     return KEY_ESCAPE;
@@ -246,6 +298,73 @@ int read_key(void) {
   return c;
 }
 
+// Collect a bracketed paste up to its closing ESC [ 201 ~. Line breaks
+// arrive as CR and are kept as newlines; other control characters are
+// dropped. Returns a malloc'd string, or NULL when out of memory.
+static char *read_paste(int *length) {
+  static const char end_marker[] = "\033[201~";
+  const int marker_len = sizeof(end_marker) - 1;
+  int capacity = INPUT_BUFFER;
+  int len = 0;
+  char *text = malloc(capacity);
+  if (!text)
+    return NULL;
+
+  int c;
+  while ((c = next_byte(PASTE_TIMEOUT_MS)) != -1) {
+    if (len + 1 >= capacity) {
+      capacity *= 2;
+      char *grown = realloc(text, capacity);
+      if (!grown) {
+        free(text);
+        return NULL;
+      }
+      text = grown;
+    }
+    text[len++] = (char)c;
+    if (len >= marker_len &&
+        memcmp(text + len - marker_len, end_marker, marker_len) == 0) {
+      len -= marker_len;
+      break;
+    }
+  }
+
+  int out = 0;
+  for (int i = 0; i < len; i++) {
+    unsigned char ch = (unsigned char)text[i];
+    if (ch == '\r') {
+      text[out++] = '\n';
+      if (i + 1 < len && text[i + 1] == '\n')
+        i++;
+    } else if (ch == '\t') {
+      text[out++] = ' ';
+    } else if (ch == '\n' || (ch >= 32 && ch != 127)) {
+      text[out++] = (char)ch;
+    }
+  }
+  text[out] = '\0';
+  *length = out;
+  return text;
+}
+
+// Grow buffer to hold at least needed bytes
+static char *reserve_line(char *buffer, int *bufsize, int needed) {
+  if (needed <= *bufsize)
+    return buffer;
+
+  int size = *bufsize;
+  while (size < needed)
+    size += LSH_RL_BUFSIZE;
+  char *new_buffer = realloc(buffer, size);
+  if (!new_buffer) {
+    fprintf(stderr, "lsh: allocation error\n");
+    free(buffer);
+    exit(EXIT_FAILURE);
+  }
+  *bufsize = size;
+  return new_buffer;
+}
+
 void update_suggestions(const char *buffer, int position) {
   // Free previous suggestions if any
   if (suggestions) {
@@ -270,6 +389,11 @@ void update_suggestions(const char *buffer, int position) {
   // Parse command line
   prefix_start = 0;
 
+  // Long and multi-line commands are left alone; they are pasted, not typed
+  if (position >= LSH_RL_BUFSIZE || strchr(buffer, '\n') != NULL) {
+    return;
+  }
+
   // Find the last space to determine where the prefix starts
   char *last_space = strrchr(buffer, ' ');
   if (last_space) {
@@ -430,34 +554,14 @@ void display_inline_suggestion(const char *prompt_buffer, const char *buffer,
 
     // If there's no suggestion text (exact match), then don't show suggestion
     if (strlen(suggestion_text) == 0) {
-      // Clear the current line
-      printf("\r\033[K");
-
-      // Display prompt and current text without suggestion
-      printf("%s%s", prompt_buffer, buffer);
-      fflush(stdout);
+      line_render(&screen, buffer, NULL);
     } else {
-      // Clear the current line
-      printf("\r\033[K");
-
-      // Display prompt and current text
-      printf("%s%s", prompt_buffer, current_text);
-
-      // Display the suggestion part in dim color
-      printf("%s%s%s", SUGGESTION_COLOR, suggestion_text, RESET_COLOR);
-
-      // Move cursor back to end of actual input
-      int suggestion_len = strlen(suggestion_text);
-      for (int i = 0; i < suggestion_len; i++) {
-        printf("\b");
-      }
-
-      fflush(stdout);
+      // Current text, then the suggestion part in dim color
+      line_render(&screen, current_text, suggestion_text);
     }
   } else {
     // No suggestions, just redraw the current line
-    printf("\r\033[K%s%s", prompt_buffer, buffer);
-    fflush(stdout);
+    line_render(&screen, buffer, NULL);
   }
 }
 
@@ -634,9 +738,11 @@ char *lsh_read_line(void) {
 
     if (getcwd(cwd, sizeof(cwd)) != NULL) {
       get_path_display(cwd, parent_dir, current_dir, PATH_MAX / 2);
+      dir_cache_begin(cwd);
     } else {
       strcpy(parent_dir, "unknown");
       strcpy(current_dir, "dir");
+      dir_cache_begin(NULL);
     }
 
     // Get Git information
@@ -676,16 +782,28 @@ char *lsh_read_line(void) {
              current_dir, git_display);
   }
 
-  // Display prompt
-  printf("%s", prompt_buffer);
-  fflush(stdout);
+  // Display prompt, with pastes marked so they can be told from typing
+  printf("\033[?2004h");
+  line_render_begin(&screen, prompt_buffer);
+  watch_resize();
+  event_loop_begin();
 
   // Initialize suggestions
   update_suggestions(buffer, position);
 
+  // Set while typed-ahead characters have not been shown yet
+  int deferred = 0;
+
   while (1) {
     c = read_key();
 
+    // Bring the line up to date before a key that needs to see it
+    if (deferred && !(c >= 0 && c < 256 && isprint(c))) {
+      deferred = 0;
+      update_suggestions(buffer, position);
+      display_inline_suggestion(prompt_buffer, buffer, position);
+    }
+
     if (c == KEY_ENTER || c == '\n' || c == '\r') {
       if (menu_mode) {
         // In menu mode: accept the highlighted suggestion without executing
@@ -738,10 +856,6 @@ char *lsh_read_line(void) {
           clear_menu();
           menu_mode = 0;
 
-          // Redraw the line with accepted suggestion
-          printf("\r\033[K%s%s", prompt_buffer, buffer);
-          fflush(stdout);
-
           // Check if the accepted suggestion is a directory
           if (strlen(buffer) > 0 && buffer[strlen(buffer) - 1] == '/') {
             // It's a directory, update suggestions to show its contents
@@ -754,12 +868,32 @@ char *lsh_read_line(void) {
           display_inline_suggestion(prompt_buffer, buffer, position);
         }
       } else {
-        // Not in menu mode: execute the command as is
+        // Not in menu mode: execute the command as is, leaving no
+        // suggestion behind on the line
         buffer[position] = '\0';
-        printf("\n");
+        line_render(&screen, buffer, NULL);
+        printf("\033[?2004l\n");
         fflush(stdout);
         break;
       }
+    } else if (c == LOCAL_KEY_PASTE) {
+      // Insert the whole paste at once and redraw a single time
+      int paste_len = 0;
+      char *paste = read_paste(&paste_len);
+      if (paste) {
+        buffer = reserve_line(buffer, &bufsize, position + paste_len + 1);
+        memcpy(buffer + position, paste, paste_len + 1);
+        position += paste_len;
+        free(paste);
+      }
+
+      if (menu_mode) {
+        menu_mode = 0;
+        clear_menu();
+      }
+      cycling_mode = 0;
+      update_suggestions(buffer, position);
+      display_inline_suggestion(prompt_buffer, buffer, position);
     } else if (c == KEY_ESCAPE) {
       if (menu_mode) {
         // Exit menu mode
@@ -844,8 +978,7 @@ char *lsh_read_line(void) {
           position = strlen(buffer);
 
           // Redraw with the current suggestion
-          printf("\r\033[K%s%s", prompt_buffer, buffer);
-          fflush(stdout);
+          line_render(&screen, buffer, NULL);
         }
       } else if (menu_mode) {
         // Already in menu mode: cycle to next suggestion
@@ -943,10 +1076,6 @@ char *lsh_read_line(void) {
           buffer[bufsize - 1] = '\0';
           position = strlen(buffer);
 
-          // Redraw the line with accepted suggestion
-          printf("\r\033[K%s%s", prompt_buffer, buffer);
-          fflush(stdout);
-
           // Check if the accepted suggestion is a directory
           if (strlen(buffer) > 0 && buffer[strlen(buffer) - 1] == '/') {
             // It's a directory, update suggestions to show its contents
@@ -1125,19 +1254,12 @@ char *lsh_read_line(void) {
       // Navigate history upward when not in menu mode
       char *history_entry = get_previous_history_entry(&history_position);
       if (history_entry) {
-        // Clear current line
-        printf("\r\033[K");
-
         // Copy history entry to buffer
-        strncpy(buffer, history_entry, bufsize - 1);
-        buffer[bufsize - 1] = '\0';
-        position = strlen(buffer);
+        position = strlen(history_entry);
+        buffer = reserve_line(buffer, &bufsize, position + 1);
+        memcpy(buffer, history_entry, position + 1);
 
         // Display the history entry and update suggestions
-        printf("%s%s", prompt_buffer, buffer);
-        fflush(stdout);
-
-        // Update suggestions after loading history
         update_suggestions(buffer, position);
         display_inline_suggestion(prompt_buffer, buffer, position);
       }
@@ -1149,10 +1271,6 @@ char *lsh_read_line(void) {
         buffer[bufsize - 1] = '\0';
         position = strlen(buffer);
 
-        // Redraw the line with accepted suggestion
-        printf("\r\033[K%s%s", prompt_buffer, buffer);
-        fflush(stdout);
-
         // Clear history suggestion after accepting
         if (history_suggestion) {
           free(history_suggestion);
@@ -1208,8 +1326,7 @@ char *lsh_read_line(void) {
         position = strlen(buffer);
 
         // Redraw the line with accepted suggestion
-        printf("\r\033[K%s%s", prompt_buffer, buffer);
-        fflush(stdout);
+        line_render(&screen, buffer, NULL);
 
         // Check if the accepted suggestion is a directory
         if (strlen(buffer) > 0 && buffer[strlen(buffer) - 1] == '/') {
@@ -1234,26 +1351,19 @@ char *lsh_read_line(void) {
       // Navigate history downward when not in menu mode
       char *history_entry = get_next_history_entry(&history_position);
       if (history_entry) {
-        // Clear current line
-        printf("\r\033[K");
-
         // Copy history entry to buffer
-        strncpy(buffer, history_entry, bufsize - 1);
-        buffer[bufsize - 1] = '\0';
-        position = strlen(buffer);
+        position = strlen(history_entry);
+        buffer = reserve_line(buffer, &bufsize, position + 1);
+        memcpy(buffer, history_entry, position + 1);
 
         // Display the history entry and update suggestions
-        printf("%s%s", prompt_buffer, buffer);
-        fflush(stdout);
-
-        // Update suggestions after loading history
         update_suggestions(buffer, position);
         display_inline_suggestion(prompt_buffer, buffer, position);
       } else {
         // At the end of history, clear the line
-        printf("\r\033[K%s", prompt_buffer);
         buffer[0] = '\0';
         position = 0;
+        line_render(&screen, buffer, NULL);
 
         // Clear suggestions since we have an empty line
         if (suggestions) {
@@ -1267,18 +1377,9 @@ char *lsh_read_line(void) {
         }
         has_suggestion = 0;
       }
-    } else if (isprint(c)) {
+    } else if (c >= 0 && c < 256 && isprint(c)) {
       // Regular character - add it to the buffer
-      if (position >= bufsize - 1) {
-        bufsize += LSH_RL_BUFSIZE;
-        char *new_buffer = realloc(buffer, bufsize);
-        if (!new_buffer) {
-          fprintf(stderr, "lsh: allocation error\n");
-          free(buffer);
-          exit(EXIT_FAILURE);
-        }
-        buffer = new_buffer;
-      }
+      buffer = reserve_line(buffer, &bufsize, position + 2);
 
       buffer[position] = c;
       position++;
@@ -1292,6 +1393,13 @@ char *lsh_read_line(void) {
         cycling_mode = 0;
       }
 
+      // With more keys already waiting, suggestions and the redraw wait
+      // until they have all been added
+      if (!was_in_menu_mode && key_pending()) {
+        deferred = 1;
+        continue;
+      }
+
       // Update with the new character and show suggestions
       update_suggestions(buffer, position);
 
@@ -1331,6 +1439,7 @@ char *lsh_read_line(void) {
   has_suggestion = 0;
   has_history_suggestion = 0;
 
+  event_loop_end();
   return buffer;
 }
 
@@ -0,0 +1,233 @@
+#include "line_renderer.h"
+#include "common.h"
+#include <errno.h>
+#include <sys/ioctl.h>
+
+#define SUGGESTION_COLOR "\033[2;37m" // Dim white color for suggestions
+#define RESET_COLOR "\033[0m"
+#define NEWLINE_GLYPH "↵"
+
+static int terminal_columns(void) {
+  struct winsize ws;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0)
+    return 80;
+  return ws.ws_col;
+}
+
+// Columns len bytes of text take up. Escape sequences take none, and a
+// UTF-8 character or a newline shown as ↵ takes one.
+static int display_width(const char *text, size_t len) {
+  int width = 0;
+  for (size_t i = 0; i < len; i++) {
+    unsigned char c = (unsigned char)text[i];
+    if (c == '\033' && i + 1 < len && text[i + 1] == '[') {
+      for (i += 2; i < len && !(text[i] >= 0x40 && text[i] <= 0x7e); i++)
+        ;
+      continue;
+    }
+    if ((c & 0xc0) != 0x80)
+      width++;
+  }
+  return width;
+}
+
+static int reserve(char **buffer, size_t *capacity, size_t needed) {
+  if (needed <= *capacity)
+    return 1;
+  size_t size = *capacity ? *capacity : 256;
+  while (size < needed)
+    size *= 2;
+  char *grown = realloc(*buffer, size);
+  if (!grown)
+    return 0;
+  *buffer = grown;
+  *capacity = size;
+  return 1;
+}
+
+static void put(LineRenderer *screen, const char *data, size_t len) {
+  if (!reserve(&screen->frame, &screen->frame_cap, screen->frame_len + len))
+    return;
+  memcpy(screen->frame + screen->frame_len, data, len);
+  screen->frame_len += len;
+}
+
+static void put_str(LineRenderer *screen, const char *data) {
+  put(screen, data, strlen(data));
+}
+
+static void put_move(LineRenderer *screen, const char *direction, int count) {
+  char move[16];
+  if (count > 0)
+    put(screen, move, snprintf(move, sizeof(move), "\033[%d%s", count,
+                               direction));
+}
+
+// Typed or suggested text, with newlines as a dim ↵ in typed text
+static void put_text(LineRenderer *screen, const char *text, size_t len,
+                     int dim) {
+  while (len > 0) {
+    const char *newline = memchr(text, '\n', len);
+    size_t run = newline ? (size_t)(newline - text) : len;
+    put(screen, text, run);
+    if (!newline)
+      break;
+    put_str(screen, dim ? NEWLINE_GLYPH
+                        : SUGGESTION_COLOR NEWLINE_GLYPH RESET_COLOR);
+    text += run + 1;
+    len -= run + 1;
+  }
+}
+
+static void put_suggestion(LineRenderer *screen, const char *suggestion) {
+  put_str(screen, SUGGESTION_COLOR);
+  put_text(screen, suggestion, strlen(suggestion), 1);
+  put_str(screen, RESET_COLOR);
+}
+
+static void flush_frame(LineRenderer *screen) {
+  // Anything printed through stdio goes out first
+  fflush(stdout);
+
+  const char *data = screen->frame;
+  size_t left = screen->frame_len;
+  while (left > 0) {
+    ssize_t written = write(STDOUT_FILENO, data, left);
+    if (written == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    data += written;
+    left -= (size_t)written;
+  }
+  screen->frame_len = 0;
+}
+
+static int remember(char **copy, size_t *capacity, const char *text) {
+  size_t len = strlen(text);
+  if (!reserve(copy, capacity, len + 1))
+    return 0;
+  memcpy(*copy, text, len + 1);
+  return 1;
+}
+
+void line_render_begin(LineRenderer *screen, const char *prompt) {
+  screen->columns = terminal_columns();
+  screen->prompt_width = display_width(prompt, strlen(prompt));
+  screen->cursor_row = screen->prompt_width / screen->columns;
+  remember(&screen->text, &screen->text_cap, "");
+  remember(&screen->suggestion, &screen->suggestion_cap, "");
+
+  put_str(screen, prompt);
+  flush_frame(screen);
+}
+
+// Start of the part of old the terminal keeps when new replaces it: their
+// common prefix, not splitting a UTF-8 character
+static size_t common_prefix(const char *old, const char *new) {
+  size_t i = 0;
+  while (old[i] && old[i] == new[i])
+    i++;
+  while (i > 0 && ((unsigned char)new[i] & 0xc0) == 0x80)
+    i--;
+  return i;
+}
+
+// Skip count characters of text
+static const char *skip_chars(const char *text, int count) {
+  while (*text && count > 0) {
+    text++;
+    while (((unsigned char)*text & 0xc0) == 0x80)
+      text++;
+    count--;
+  }
+  return text;
+}
+
+// Repaint from the prompt down, for lines that span more than one row
+static void repaint(LineRenderer *screen, const char *text,
+                    const char *suggestion, int columns) {
+  int rows_before = screen->cursor_row;
+  put_move(screen, "A", rows_before);
+  put_str(screen, "\r");
+  put_move(screen, "C", screen->prompt_width % columns);
+  put_move(screen, "B", screen->prompt_width / columns);
+  put_str(screen, "\033[J");
+  put_text(screen, text, strlen(text), 0);
+
+  int end = screen->prompt_width +
+            display_width(text, strlen(text));
+  if (end % columns == 0 && end > screen->prompt_width) {
+    // Leave the pending wrap so the cursor really is on the next row
+    put_str(screen, "\r\n");
+  }
+  screen->cursor_row = end / columns;
+
+  // A suggestion is only shown when it fits on the cursor's row
+  int width = display_width(suggestion, strlen(suggestion));
+  if (width > 0 && end % columns + width < columns) {
+    put_suggestion(screen, suggestion);
+    put_move(screen, "D", width);
+  } else {
+    suggestion = "";
+  }
+  remember(&screen->suggestion, &screen->suggestion_cap, suggestion);
+}
+
+void line_render(LineRenderer *screen, const char *text,
+                 const char *suggestion) {
+  if (!suggestion)
+    suggestion = "";
+  if (!screen->text || !screen->suggestion)
+    return;
+
+  int columns = screen->columns;
+  const char *old_text = screen->text;
+  const char *old_suggestion = screen->suggestion;
+  int old_width = display_width(old_text, strlen(old_text));
+  int old_end = screen->prompt_width + old_width +
+                display_width(old_suggestion, strlen(old_suggestion));
+  int text_width = display_width(text, strlen(text));
+  int suggestion_width = display_width(suggestion, strlen(suggestion));
+  int new_end = screen->prompt_width + text_width + suggestion_width;
+
+  if (screen->cursor_row > 0 || old_end >= columns || new_end >= columns) {
+    repaint(screen, text, suggestion, columns);
+  } else {
+    // Everything is on one row: step back to where the texts part, write
+    // the new rest and redo only as much of the suggestion as changed
+    size_t keep = common_prefix(old_text, text);
+    put_move(screen, "D",
+             display_width(old_text + keep, strlen(old_text + keep)));
+    put_text(screen, text + keep, strlen(text + keep), 0);
+
+    // Typing what the suggestion showed leaves the rest of it in place
+    int still_shown = keep == strlen(old_text) && text_width >= old_width &&
+                      strcmp(skip_chars(old_suggestion, text_width - old_width),
+                             suggestion) == 0;
+    if (!still_shown) {
+      if (suggestion_width > 0)
+        put_suggestion(screen, suggestion);
+      if (old_end > new_end)
+        put_str(screen, "\033[K");
+      put_move(screen, "D", suggestion_width);
+    }
+    remember(&screen->suggestion, &screen->suggestion_cap, suggestion);
+  }
+
+  remember(&screen->text, &screen->text_cap, text);
+  if (screen->frame_len > 0)
+    flush_frame(screen);
+}
+
+void line_render_resize(LineRenderer *screen) {
+  screen->columns = terminal_columns();
+}
+
+void line_render_free(LineRenderer *screen) {
+  free(screen->text);
+  free(screen->suggestion);
+  free(screen->frame);
+  memset(screen, 0, sizeof(*screen));
+}
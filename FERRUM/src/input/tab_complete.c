@@ -3,6 +3,8 @@
 #include "aliases.h"
 #include "bookmarks.h"
 #include "builtins.h"
+#include "command_registry.h"
+#include "dir_cache.h"
 #include "favorite_cities.h"
 #include "themes.h"
 #include <dirent.h>
@@ -13,81 +15,6 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
-// Predefined command argument types for better completion
-static CommandArgInfo command_arg_info[] = {
-    // Built-in shell commands with strict matching for specific argument types
-    {"cd", ARG_TYPE_DIRECTORY, "Change current directory", 0},
-    {"help", ARG_TYPE_COMMAND, "Display help", 0},
-    {"exit", ARG_TYPE_ANY, "Exit the shell", 0},
-    {"dir", ARG_TYPE_DIRECTORY, "List directory contents", 0},
-    {"clear", ARG_TYPE_ANY, "Clear the screen", 0},
-    {"mkdir", ARG_TYPE_DIRECTORY, "Make directory", 0},
-    {"rmdir", ARG_TYPE_DIRECTORY, "Remove directory", 0},
-    {"del", ARG_TYPE_FILE, "Delete a file", 0},
-    {"touch", ARG_TYPE_FILE, "Create or update a file", 0},
-    {"pwd", ARG_TYPE_ANY, "Print working directory", 0},
-    {"cat", ARG_TYPE_FILE, "Display file contents", 0},
-    {"history", ARG_TYPE_ANY, "Display command history", 0},
-    {"copy", ARG_TYPE_FILE, "Copy file", 0},
-    {"move", ARG_TYPE_BOTH, "Move file or directory", 0},
-    {"paste", ARG_TYPE_ANY, "Paste clipboard contents", 0},
-    {"ps", ARG_TYPE_ANY, "List processes", 0},
-    {"news", ARG_TYPE_ANY, "Display news", 0},
-
-    // Alias commands - show only alias suggestions
-    {"alias", ARG_TYPE_ALIAS, "Define or list aliases", 0},
-    {"unalias", ARG_TYPE_ALIAS, "Remove alias", 1},
-    {"aliases", ARG_TYPE_ANY, "List all aliases", 0},
-
-    // Bookmark commands - strict matching for bookmark operations
-    {"bookmark", ARG_TYPE_DIRECTORY, "Bookmark directories", 0},
-    {"bookmarks", ARG_TYPE_ANY, "List all bookmarks", 0},
-    {"goto", ARG_TYPE_BOOKMARK, "Jump to a bookmark", 1},
-    {"unbookmark", ARG_TYPE_BOOKMARK, "Remove a bookmark", 1},
-
-    // Other utilities
-    {"focus_timer", ARG_TYPE_ANY, "Start a focus timer", 0},
-    {"weather", ARG_TYPE_FAVORITE_CITY, "Weather information", 1},
-    {"grep", ARG_TYPE_FILE, "Search file contents", 0},
-    {"grep-text", ARG_TYPE_FILE, "Search text in file", 0},
-    {"ripgrep", ARG_TYPE_FILE, "Search with ripgrep", 0},
-    {"fzf", ARG_TYPE_ANY, "Fuzzy finder", 0},
-    {"clip", ARG_TYPE_ANY, "Clipboard operations", 0},
-    {"echo", ARG_TYPE_ANY, "Display text", 0},
-    {"theme", ARG_TYPE_THEME, "Shell theme settings", 1},
-    {"loc", ARG_TYPE_FILE, "Count lines of code", 0},
-    {"git_status", ARG_TYPE_ANY, "Display git status", 0},
-    {"gg", ARG_TYPE_ANY, "Git shortcuts", 0},
-
-    // Common external commands
-    {"ls", ARG_TYPE_DIRECTORY, "List directory contents", 0},
-    {"rm", ARG_TYPE_FILE, "Remove file", 0},
-    {"cp", ARG_TYPE_FILE, "Copy file or directory", 0},
-    {"mv", ARG_TYPE_BOTH, "Move file or directory", 0},
-    {"less", ARG_TYPE_FILE, "View file contents", 0},
-    {"more", ARG_TYPE_FILE, "View file contents", 0},
-    {"find", ARG_TYPE_DIRECTORY, "Find files", 0},
-    {"chmod", ARG_TYPE_FILE, "Change file permissions", 0},
-    {"chown", ARG_TYPE_FILE, "Change file owner", 0},
-    {"tar", ARG_TYPE_FILE, "Archive utility", 0},
-    {"gzip", ARG_TYPE_FILE, "Compress files", 0},
-    {"gunzip", ARG_TYPE_FILE, "Decompress files", 0},
-    {"zip", ARG_TYPE_FILE, "Compress files", 0},
-    {"unzip", ARG_TYPE_FILE, "Decompress files", 0},
-    {"bash", ARG_TYPE_FILE, "Run bash script", 0},
-    {"sh", ARG_TYPE_FILE, "Run shell script", 0},
-    {"python", ARG_TYPE_FILE, "Run Python script", 0},
-    {"perl", ARG_TYPE_FILE, "Run Perl script", 0},
-    {"java", ARG_TYPE_FILE, "Run Java program", 0},
-    {"gcc", ARG_TYPE_FILE, "C compiler", 0},
-    {"make", ARG_TYPE_FILE, "Build utility", 0},
-    {"diff", ARG_TYPE_FILE, "Compare files", 0},
-    {"patch", ARG_TYPE_FILE, "Apply patch file", 0},
-    {"man", ARG_TYPE_ANY, "Display manual page", 0},
-
-    {NULL, ARG_TYPE_ANY, NULL, 0} // End marker
-};
-
 // Global state
 static CommandContext current_context;
 
@@ -96,9 +23,7 @@ void init_tab_completion(void) {
   memset(&current_context, 0, sizeof(CommandContext));
 }
 
-void shutdown_tab_completion(void) {
-  // Nothing to clean up for now
-}
+void shutdown_tab_completion(void) { dir_cache_clear(); }
 
 static ArgumentType get_argument_type(const char *cmd, int *strict_match) {
   if (!cmd || !*cmd) {
@@ -107,12 +32,11 @@ static ArgumentType get_argument_type(const char *cmd, int *strict_match) {
     return ARG_TYPE_ANY;
   }
 
-  for (int i = 0; command_arg_info[i].command != NULL; i++) {
-    if (strcmp(command_arg_info[i].command, cmd) == 0) {
-      if (strict_match)
-        *strict_match = command_arg_info[i].strict_match;
-      return command_arg_info[i].arg_type;
-    }
+  const CommandInfo *command = command_lookup(cmd);
+  if (command) {
+    if (strict_match)
+      *strict_match = command->strict_match;
+    return command->arg_type;
   }
 
   if (strict_match)
@@ -172,14 +96,10 @@ static void parse_command_context(const char *buffer) {
   }
 }
 
-static char *find_path_completions(const char *path) {
-  if (!path || !*path)
-    return NULL;
-
-  char dir_path[PATH_MAX] = "."; // Default to current directory
-  char name_prefix[PATH_MAX] = "";
+// Split path into the directory to list and the prefix of names in it
+static void split_path(const char *path, char *dir_path, char *name_prefix) {
+  strcpy(dir_path, "."); // Default to current directory
 
-  // Split path into directory part and name prefix part
   char *last_slash = strrchr(path, '/');
   if (last_slash) {
     // Path contains a directory part
@@ -194,84 +114,54 @@ static char *find_path_completions(const char *path) {
     }
 
     // Extract the name prefix part (after the last slash)
-    strncpy(name_prefix, last_slash + 1, sizeof(name_prefix) - 1);
-    name_prefix[sizeof(name_prefix) - 1] = '\0';
+    strncpy(name_prefix, last_slash + 1, PATH_MAX - 1);
   } else {
     // No directory part, just a name prefix
-    strncpy(name_prefix, path, sizeof(name_prefix) - 1);
-    name_prefix[sizeof(name_prefix) - 1] = '\0';
+    strncpy(name_prefix, path, PATH_MAX - 1);
   }
+  name_prefix[PATH_MAX - 1] = '\0';
+}
 
-  // Open the directory
-  DIR *dir = opendir(dir_path);
-  if (!dir) {
+static char *find_path_completions(const char *path) {
+  if (!path || !*path)
     return NULL;
-  }
-
-  // Find the first matching entry
-  struct dirent *entry;
-  char *completion = NULL;
-  int name_prefix_len = strlen(name_prefix);
-
-  while ((entry = readdir(dir)) != NULL) {
-    // Skip "." and ".." entries always
-    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-      continue;
-    }
 
-    // Check if this entry matches the name prefix
-    if (strncasecmp(entry->d_name, name_prefix, name_prefix_len) == 0) {
-      // Construct the completion
-      char full_path[PATH_MAX];
+  char dir_path[PATH_MAX];
+  char name_prefix[PATH_MAX];
+  split_path(path, dir_path, name_prefix);
 
-      // Check if we're completing from root or relative
-      if (dir_path[0] == '/' && dir_path[1] == '\0') {
-        snprintf(full_path, sizeof(full_path), "/%s", entry->d_name);
-      } else if (strcmp(dir_path, ".") == 0) {
-        snprintf(full_path, sizeof(full_path), "%s", entry->d_name);
-      } else {
-        snprintf(full_path, sizeof(full_path), "%s/%s", dir_path,
-                 entry->d_name);
-      }
-
-      // Check if it's a directory, append slash if it is
-      struct stat st;
-      char path_to_check[PATH_MAX];
-
-      if (full_path[0] == '/') {
-        // Absolute path
-        strncpy(path_to_check, full_path, sizeof(path_to_check) - 1);
-      } else {
-        // Relative path, construct with current directory
-        char cwd[PATH_MAX];
-        if (getcwd(cwd, sizeof(cwd))) {
-          snprintf(path_to_check, sizeof(path_to_check), "%s/%s", cwd,
-                   full_path);
-        } else {
-          strncpy(path_to_check, full_path, sizeof(path_to_check) - 1);
-        }
-      }
-
-      path_to_check[sizeof(path_to_check) - 1] = '\0';
+  int count;
+  const DirEntry *entries = dir_cache_list(dir_path, &count);
+  if (!entries)
+    return NULL;
 
-      if (stat(path_to_check, &st) == 0 && S_ISDIR(st.st_mode)) {
-        char *dir_completion =
-            (char *)malloc(strlen(full_path) + 2); // +2 for slash and null
-        if (dir_completion) {
-          strcpy(dir_completion, full_path);
-          strcat(dir_completion, "/");
-          completion = dir_completion;
-        }
-      } else {
-        completion = strdup(full_path);
-      }
+  // Take the first matching entry
+  int first;
+  if (dir_cache_prefix(entries, count, name_prefix, &first) == first)
+    return NULL;
+  const DirEntry *entry = &entries[first];
+
+  // Check if we're completing from root or relative
+  char full_path[PATH_MAX];
+  if (dir_path[0] == '/' && dir_path[1] == '\0') {
+    snprintf(full_path, sizeof(full_path), "/%s", entry->name);
+  } else if (strcmp(dir_path, ".") == 0) {
+    snprintf(full_path, sizeof(full_path), "%s", entry->name);
+  } else {
+    snprintf(full_path, sizeof(full_path), "%s/%s", dir_path, entry->name);
+  }
 
-      break;
+  // Append a slash to directories
+  if (entry->type == DT_DIR) {
+    char *dir_completion =
+        (char *)malloc(strlen(full_path) + 2); // +2 for slash and null
+    if (dir_completion) {
+      strcpy(dir_completion, full_path);
+      strcat(dir_completion, "/");
     }
+    return dir_completion;
   }
-
-  closedir(dir);
-  return completion;
+  return strdup(full_path);
 }
 
 static char *complete_command(const char *prefix) {
@@ -279,11 +169,12 @@ static char *complete_command(const char *prefix) {
     return NULL;
 
   // First check builtins
-  int builtin_count = lsh_num_builtins();
+  int builtin_count;
+  const CommandInfo *builtins = command_builtins(&builtin_count);
 
   for (int i = 0; i < builtin_count; i++) {
-    if (strncasecmp(builtin_str[i], prefix, strlen(prefix)) == 0) {
-      return strdup(builtin_str[i]);
+    if (strncasecmp(builtins[i].name, prefix, strlen(prefix)) == 0) {
+      return strdup(builtins[i].name);
     }
   }
 
@@ -326,23 +217,22 @@ static char *complete_command(const char *prefix) {
   char *dir = strtok(path_copy, ":");
 
   while (dir && !result) {
-    DIR *dirp = opendir(dir);
-    if (dirp) {
-      struct dirent *entry;
-      while ((entry = readdir(dirp)) != NULL) {
-        if (strncasecmp(entry->d_name, prefix, strlen(prefix)) == 0) {
-          // Check if it's executable
-          char full_path[PATH_MAX];
-          snprintf(full_path, sizeof(full_path), "%s/%s", dir, entry->d_name);
-
-          struct stat st;
-          if (stat(full_path, &st) == 0 && (st.st_mode & S_IXUSR)) {
-            result = strdup(entry->d_name);
-            break;
-          }
+    int count;
+    const DirEntry *entries = dir_cache_list(dir, &count);
+    if (entries) {
+      int first;
+      int end = dir_cache_prefix(entries, count, prefix, &first);
+      for (int i = first; i < end; i++) {
+        // Check if it's executable
+        char full_path[PATH_MAX];
+        snprintf(full_path, sizeof(full_path), "%s/%s", dir, entries[i].name);
+
+        struct stat st;
+        if (stat(full_path, &st) == 0 && (st.st_mode & S_IXUSR)) {
+          result = strdup(entries[i].name);
+          break;
         }
       }
-      closedir(dirp);
     }
     dir = strtok(NULL, ":");
   }
@@ -364,213 +254,79 @@ static SuggestionList *get_suggestions_by_type(ArgumentType arg_type,
   case ARG_TYPE_FILE:
   case ARG_TYPE_DIRECTORY:
   case ARG_TYPE_BOTH: {
-    // For files and directories, we'll need a different approach
-    // since find_path_completions only returns one match at a time
-    char dir_path[PATH_MAX] = "."; // Default to current directory
-    char name_prefix[PATH_MAX] = "";
-
-    // Split path into directory part and name prefix part
-    char *last_slash = strrchr(token, '/');
-    if (last_slash) {
-      // Path contains a directory part
-      int dir_len = last_slash - token;
-      strncpy(dir_path, token, dir_len);
-      dir_path[dir_len] = '\0';
-
-      // Handle absolute path vs. relative path with subdirectories
-      if (dir_len == 0) {
-        // Handle case where path starts with '/'
-        strcpy(dir_path, "/");
-      }
-
-      // Extract the name prefix part (after the last slash)
-      strncpy(name_prefix, last_slash + 1, sizeof(name_prefix) - 1);
-      name_prefix[sizeof(name_prefix) - 1] = '\0';
-    } else {
-      // No directory part, just a name prefix
-      strncpy(name_prefix, token, sizeof(name_prefix) - 1);
-      name_prefix[sizeof(name_prefix) - 1] = '\0';
+    char dir_path[PATH_MAX];
+    char name_prefix[PATH_MAX];
+    split_path(token, dir_path, name_prefix);
+    const char *last_slash = strrchr(token, '/');
+
+    int count;
+    const DirEntry *entries = dir_cache_list(dir_path, &count);
+    if (!entries) {
+      return NULL;
     }
 
-    // Open the directory
-    DIR *dir = opendir(dir_path);
-    if (!dir) {
+    // The listing is sorted, so the matches are next to each other
+    int first;
+    int end = dir_cache_prefix(entries, count, name_prefix, &first);
+    if (end == first) {
       return NULL;
     }
 
-    // Count matching entries first
-    struct dirent *entry;
-    int name_prefix_len = strlen(name_prefix);
-
-    // First count matching entries
-    while ((entry = readdir(dir)) != NULL) {
-      // Filter based on argument type
-      if (arg_type == ARG_TYPE_DIRECTORY || arg_type == ARG_TYPE_FILE) {
-        struct stat st;
-        char full_path[PATH_MAX];
+    items = (char **)malloc((end - first) * sizeof(char *));
+    if (!items) {
+      return NULL;
+    }
 
-        // Construct full path to check
-        if (strcmp(dir_path, "/") == 0) {
-          snprintf(full_path, sizeof(full_path), "/%s", entry->d_name);
-        } else {
-          snprintf(full_path, sizeof(full_path), "%s/%s", dir_path,
-                   entry->d_name);
-        }
+    // The directory's own name is not offered inside it
+    const char *dir_name_only = NULL;
+    if (last_slash && strcmp(dir_path, ".") != 0) {
+      char *last_dir_slash = strrchr(dir_path, '/');
+      dir_name_only = last_dir_slash ? last_dir_slash + 1 : dir_path;
+    }
 
-        if (stat(full_path, &st) == 0) {
-          if ((arg_type == ARG_TYPE_DIRECTORY && !S_ISDIR(st.st_mode)) ||
-              (arg_type == ARG_TYPE_FILE && S_ISDIR(st.st_mode))) {
-            continue; // Skip if doesn't match requested type
-          }
-        } else {
-          continue; // Skip if can't stat
-        }
-      }
+    int idx = 0;
+    for (int i = first; i < end; i++) {
+      const DirEntry *entry = &entries[i];
+      int is_dir = entry->type == DT_DIR;
 
-      // Skip "." and ".." entries always
-      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      // Filter based on argument type, skipping what cannot be stat'ed
+      if ((arg_type == ARG_TYPE_DIRECTORY && !is_dir) ||
+          (arg_type == ARG_TYPE_FILE &&
+           (is_dir || entry->type == DT_UNKNOWN))) {
         continue;
       }
 
       // Skip hidden files/dirs unless the prefix starts with a dot
-      if (entry->d_name[0] == '.' && name_prefix[0] != '.') {
-        continue; // Skip hidden files
+      if (entry->name[0] == '.' && name_prefix[0] != '.') {
+        continue;
       }
 
-      // Check if this entry matches the name prefix
-      if (strncasecmp(entry->d_name, name_prefix, name_prefix_len) == 0) {
-        matched_count++;
+      if (dir_name_only && strcmp(entry->name, dir_name_only) == 0) {
+        continue;
       }
-    }
 
-    // Reset directory stream
-    rewinddir(dir);
-
-    // Allocate array for matches
-    if (matched_count > 0) {
-      items = (char **)malloc(matched_count * sizeof(char *));
-      if (!items) {
-        closedir(dir);
-        return NULL;
+      // Just the entry name, since the user already typed the directory
+      // part, with a trailing slash for directories
+      char *suggestion;
+      if (is_dir) {
+        char suggestion_path[PATH_MAX];
+        snprintf(suggestion_path, sizeof(suggestion_path), "%s/",
+                 entry->name);
+        suggestion = strdup(suggestion_path);
+      } else {
+        suggestion = strdup(entry->name);
       }
 
-      // Fill the array with matches
-      int idx = 0;
-      while ((entry = readdir(dir)) != NULL && idx < matched_count) {
-        // Filter based on argument type
-        if (arg_type == ARG_TYPE_DIRECTORY || arg_type == ARG_TYPE_FILE) {
-          struct stat st;
-          char full_path[PATH_MAX];
-
-          // Construct full path to check
-          if (strcmp(dir_path, "/") == 0) {
-            snprintf(full_path, sizeof(full_path), "/%s", entry->d_name);
-          } else {
-            snprintf(full_path, sizeof(full_path), "%s/%s", dir_path,
-                     entry->d_name);
-          }
-
-          if (stat(full_path, &st) == 0) {
-            if ((arg_type == ARG_TYPE_DIRECTORY && !S_ISDIR(st.st_mode)) ||
-                (arg_type == ARG_TYPE_FILE && S_ISDIR(st.st_mode))) {
-              continue; // Skip if doesn't match requested type
-            }
-          } else {
-            continue; // Skip if can't stat
-          }
-        }
-
-        // Skip "." and ".." entries always
-        if (strcmp(entry->d_name, ".") == 0 ||
-            strcmp(entry->d_name, "..") == 0) {
-          continue;
-        }
-
-        // Skip hidden files/dirs unless the prefix starts with a dot
-        if (entry->d_name[0] == '.' && name_prefix[0] != '.') {
-          continue; // Skip hidden files
-        }
-
-        // Check if this entry matches the name prefix
-        if (strncasecmp(entry->d_name, name_prefix, name_prefix_len) == 0) {
-          // Create suggestion string that includes the directory path if needed
-          char *suggestion;
-
-          // Check if it's a directory to add trailing slash
-          struct stat st;
-          char full_path[PATH_MAX];
-          int is_dir = 0;
-
-          // Construct full path to check
-          if (strcmp(dir_path, "/") == 0) {
-            snprintf(full_path, sizeof(full_path), "/%s", entry->d_name);
-          } else {
-            snprintf(full_path, sizeof(full_path), "%s/%s", dir_path,
-                     entry->d_name);
-          }
-
-          if (stat(full_path, &st) == 0) {
-            is_dir = S_ISDIR(st.st_mode);
-          }
-
-          // Create suggestion string
-          if (last_slash) {
-            // Include the directory part in the suggestion
-
-            char dir_name_only[PATH_MAX];
-            if (strcmp(dir_path, ".") != 0) {
-              char *last_dir_slash = strrchr(dir_path, '/');
-              if (last_dir_slash) {
-                strcpy(dir_name_only, last_dir_slash + 1);
-              } else {
-                strcpy(dir_name_only, dir_path);
-              }
-
-              if (strcmp(entry->d_name, dir_name_only) == 0) {
-                continue;
-              }
-            }
-
-            char base_path[PATH_MAX];
-
-            // Extract original path up to the last slash
-            int base_len = last_slash - token + 1; // +1 to include the slash
-            strncpy(base_path, token, base_len);
-            base_path[base_len] = '\0';
-
-            // Just return the entry name without the full path
-            // since the user already typed the directory part
-            char suggestion_path[PATH_MAX];
-            if (is_dir) {
-              snprintf(suggestion_path, sizeof(suggestion_path), "%s/",
-                       entry->d_name);
-              suggestion = strdup(suggestion_path);
-            } else {
-              suggestion = strdup(entry->d_name);
-            }
-          } else {
-            // Just the entry name
-            if (is_dir) {
-              char suggestion_path[PATH_MAX];
-              snprintf(suggestion_path, sizeof(suggestion_path), "%s/",
-                       entry->d_name);
-              suggestion = strdup(suggestion_path);
-            } else {
-              suggestion = strdup(entry->d_name);
-            }
-          }
-
-          if (suggestion) {
-            items[idx++] = suggestion;
-          }
-        }
+      if (suggestion) {
+        items[idx++] = suggestion;
       }
-
-      // Update actual match count
-      matched_count = idx;
     }
 
-    closedir(dir);
+    matched_count = idx;
+    if (matched_count == 0) {
+      free(items);
+      items = NULL;
+    }
     break;
   }
 
@@ -768,13 +524,14 @@ static SuggestionList *get_suggestions_by_type(ArgumentType arg_type,
 
   case ARG_TYPE_COMMAND: {
     // get all available commands
-    int builtin_count = lsh_num_builtins();
+    int builtin_count;
+    const CommandInfo *builtins = command_builtins(&builtin_count);
 
     // count matching commands
 
     for (int i = 0; i < builtin_count; i++) {
       if (token[0] == '\0' ||
-          strncasecmp(builtin_str[i], token, strlen(token)) == 0) {
+          strncasecmp(builtins[i].name, token, strlen(token)) == 0) {
         matched_count++;
       }
     }
@@ -789,8 +546,8 @@ static SuggestionList *get_suggestions_by_type(ArgumentType arg_type,
       int idx = 0;
       for (int i = 0; i < builtin_count && idx < matched_count; i++) {
         if (token[0] == '\0' ||
-            strncasecmp(builtin_str[i], token, strlen(token)) == 0) {
-          items[idx++] = strdup(builtin_str[i]);
+            strncasecmp(builtins[i].name, token, strlen(token)) == 0) {
+          items[idx++] = strdup(builtins[i].name);
         }
       }
 
@@ -879,9 +636,11 @@ SuggestionList *get_suggestion_list(const char *buffer, const char *prefix) {
     char **items = NULL;
 
     // Count builtins that match the prefix
-    for (int i = 0; i < lsh_num_builtins(); i++) {
+    int builtin_count;
+    const CommandInfo *builtins = command_builtins(&builtin_count);
+    for (int i = 0; i < builtin_count; i++) {
       if (prefix == NULL || prefix[0] == '\0' ||
-          strncasecmp(builtin_str[i], prefix, strlen(prefix)) == 0) {
+          strncasecmp(builtins[i].name, prefix, strlen(prefix)) == 0) {
         matched_count++;
       }
     }
@@ -895,10 +654,10 @@ SuggestionList *get_suggestion_list(const char *buffer, const char *prefix) {
 
       // Fill with matching commands
       int idx = 0;
-      for (int i = 0; i < lsh_num_builtins() && idx < matched_count; i++) {
+      for (int i = 0; i < builtin_count && idx < matched_count; i++) {
         if (prefix == NULL || prefix[0] == '\0' ||
-            strncasecmp(builtin_str[i], prefix, strlen(prefix)) == 0) {
-          items[idx++] = strdup(builtin_str[i]);
+            strncasecmp(builtins[i].name, prefix, strlen(prefix)) == 0) {
+          items[idx++] = strdup(builtins[i].name);
         }
       }
 
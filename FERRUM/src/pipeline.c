@@ -0,0 +1,719 @@
+#define _GNU_SOURCE
+#include "pipeline.h"
+#include "command_path.h"
+#include "command_registry.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <sys/sendfile.h>
+
+#define STAGE_BUFFER (64 * 1024) // Size of write chunks and descriptor reads
+#define STAGE_QUEUE 64           // Most chunks a channel holds
+#define STAGE_SEND_CHUNK (1 << 20) // Most the kernel moves in one call
+
+extern char **environ;
+
+int last_exit_status = 0;
+
+typedef struct {
+  char *data;
+  size_t len;
+} StageChunk;
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  StageChunk queue[STAGE_QUEUE]; // Ring, oldest at head
+  int head;
+  int count;
+  size_t bytes;
+  int writer_done;
+  int reader_gone;
+  int ends; // Ends still open; the last to close frees the channel
+} StageChannel;
+
+struct StageStream {
+  int fd; // -1 on a channel
+  int owned;
+  int writing;
+  StageChannel *channel;
+  int failed; // Set once a write fails; later writes are dropped
+
+  // Writes are gathered into a chunk before they go out
+  char *pending;
+  size_t pending_len;
+
+  // Input being read and how far into it
+  char *chunk;
+  size_t chunk_len;
+  size_t chunk_pos;
+  int eof;
+  char *line; // A line split across two chunks is joined here
+  size_t line_cap;
+};
+
+// Writes to a reader that has exited fail with EPIPE instead of killing
+// the shell with SIGPIPE while this is in effect
+static void block_sigpipe(sigset_t *old_set) {
+  sigset_t pipe_set;
+  sigemptyset(&pipe_set);
+  sigaddset(&pipe_set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_set, old_set);
+}
+
+// A SIGPIPE raised by the failed write is consumed here
+static void restore_sigpipe(const sigset_t *old_set, int failed) {
+  if (failed && errno == EPIPE) {
+    sigset_t pipe_set;
+    sigemptyset(&pipe_set);
+    sigaddset(&pipe_set, SIGPIPE);
+    struct timespec zero = {0, 0};
+    sigtimedwait(&pipe_set, NULL, &zero);
+  }
+  pthread_sigmask(SIG_SETMASK, old_set, NULL);
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+  sigset_t old_set;
+  block_sigpipe(&old_set);
+
+  int ok = 1;
+  while (len > 0) {
+    ssize_t written = write(fd, data, len);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      ok = 0;
+      break;
+    }
+    data += written;
+    len -= (size_t)written;
+  }
+
+  restore_sigpipe(&old_set, !ok);
+  return ok;
+}
+
+// Queue a chunk for the reader, waiting while it is too far behind. The
+// channel owns data afterwards, even when the reader is gone.
+static int channel_push(StageChannel *channel, char *data, size_t len) {
+  pthread_mutex_lock(&channel->lock);
+  // A chunk larger than the limit still goes through on its own
+  while (!channel->reader_gone && channel->count > 0 &&
+         (channel->count == STAGE_QUEUE ||
+          channel->bytes + len > STAGE_CHANNEL_BYTES))
+    pthread_cond_wait(&channel->changed, &channel->lock);
+
+  int ok = !channel->reader_gone;
+  if (ok) {
+    StageChunk *slot =
+        &channel->queue[(channel->head + channel->count) % STAGE_QUEUE];
+    slot->data = data;
+    slot->len = len;
+    channel->count++;
+    channel->bytes += len;
+    pthread_cond_broadcast(&channel->changed);
+  }
+  pthread_mutex_unlock(&channel->lock);
+
+  if (!ok)
+    free(data);
+  return ok;
+}
+
+// Next chunk from the writer, or 0 once it is done and the queue is empty
+static size_t channel_pop(StageChannel *channel, char **data) {
+  pthread_mutex_lock(&channel->lock);
+  while (channel->count == 0 && !channel->writer_done)
+    pthread_cond_wait(&channel->changed, &channel->lock);
+
+  size_t len = 0;
+  *data = NULL;
+  if (channel->count > 0) {
+    StageChunk *slot = &channel->queue[channel->head];
+    *data = slot->data;
+    len = slot->len;
+    channel->head = (channel->head + 1) % STAGE_QUEUE;
+    channel->count--;
+    channel->bytes -= len;
+    pthread_cond_broadcast(&channel->changed);
+  }
+  pthread_mutex_unlock(&channel->lock);
+  return len;
+}
+
+static void channel_drop_queue(StageChannel *channel) {
+  while (channel->count > 0) {
+    free(channel->queue[channel->head].data);
+    channel->head = (channel->head + 1) % STAGE_QUEUE;
+    channel->count--;
+  }
+  channel->bytes = 0;
+}
+
+static StageStream *new_stream(int fd, int writing, int owned) {
+  StageStream *stream = calloc(1, sizeof(StageStream));
+  if (!stream)
+    return NULL;
+  stream->fd = fd;
+  stream->writing = writing;
+  stream->owned = owned;
+  return stream;
+}
+
+StageStream *stage_fd_stream(int fd, int writing, int owned) {
+  return new_stream(fd, writing, owned);
+}
+
+int stage_channel(StageStream **writer, StageStream **reader) {
+  StageChannel *channel = calloc(1, sizeof(StageChannel));
+  *writer = new_stream(-1, 1, 0);
+  *reader = new_stream(-1, 0, 0);
+  if (!channel || !*writer || !*reader) {
+    free(channel);
+    free(*writer);
+    free(*reader);
+    *writer = *reader = NULL;
+    return 0;
+  }
+
+  pthread_mutex_init(&channel->lock, NULL);
+  pthread_cond_init(&channel->changed, NULL);
+  channel->ends = 2;
+  (*writer)->channel = channel;
+  (*reader)->channel = channel;
+  return 1;
+}
+
+static int flush_pending(StageStream *out) {
+  if (out->pending_len == 0)
+    return !out->failed;
+
+  if (out->channel) {
+    // The chunk itself moves to the reader; the next write starts another
+    if (out->failed)
+      free(out->pending);
+    else if (!channel_push(out->channel, out->pending, out->pending_len))
+      out->failed = 1;
+    out->pending = NULL;
+  } else if (!out->failed &&
+             !write_all(out->fd, out->pending, out->pending_len)) {
+    out->failed = 1;
+  }
+  out->pending_len = 0;
+  return !out->failed;
+}
+
+void stage_close(StageStream *stream) {
+  if (!stream)
+    return;
+
+  if (stream->writing)
+    flush_pending(stream);
+
+  if (stream->channel) {
+    StageChannel *channel = stream->channel;
+    pthread_mutex_lock(&channel->lock);
+    if (stream->writing) {
+      channel->writer_done = 1;
+    } else {
+      channel->reader_gone = 1;
+      channel_drop_queue(channel);
+    }
+    pthread_cond_broadcast(&channel->changed);
+    int last = --channel->ends == 0;
+    pthread_mutex_unlock(&channel->lock);
+
+    if (last) {
+      channel_drop_queue(channel);
+      pthread_cond_destroy(&channel->changed);
+      pthread_mutex_destroy(&channel->lock);
+      free(channel);
+    }
+  } else if (stream->owned && stream->fd >= 0) {
+    close(stream->fd);
+  }
+
+  free(stream->pending);
+  free(stream->chunk);
+  free(stream->line);
+  free(stream);
+}
+
+int stage_is_terminal(const StageStream *stream) {
+  return stream && stream->fd >= 0 && isatty(stream->fd);
+}
+
+int stage_write(StageStream *out, const void *data, size_t len) {
+  const char *bytes = data;
+
+  // Large writes to a descriptor skip the buffer
+  if (!out->channel && out->pending_len == 0 && len >= STAGE_BUFFER) {
+    if (!out->failed && !write_all(out->fd, bytes, len))
+      out->failed = 1;
+    return !out->failed;
+  }
+
+  while (len > 0 && !out->failed) {
+    if (!out->pending) {
+      out->pending = malloc(STAGE_BUFFER);
+      if (!out->pending) {
+        out->failed = 1;
+        break;
+      }
+    }
+    size_t room = STAGE_BUFFER - out->pending_len;
+    if (room == 0) {
+      flush_pending(out);
+      continue;
+    }
+    size_t n = len < room ? len : room;
+    memcpy(out->pending + out->pending_len, bytes, n);
+    out->pending_len += n;
+    bytes += n;
+    len -= n;
+  }
+  return !out->failed;
+}
+
+int stage_printf(StageStream *out, const char *format, ...) {
+  char buffer[1024];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+  if (length < 0)
+    return 0;
+  if ((size_t)length < sizeof(buffer))
+    return stage_write(out, buffer, (size_t)length);
+
+  char *text = malloc((size_t)length + 1);
+  if (!text)
+    return 0;
+  va_start(args, format);
+  vsnprintf(text, (size_t)length + 1, format, args);
+  va_end(args);
+  int ok = stage_write(out, text, (size_t)length);
+  free(text);
+  return ok;
+}
+
+int stage_give(StageStream *out, char *buffer, size_t len) {
+  // Whatever was written before goes first
+  if (len == 0 || !flush_pending(out)) {
+    free(buffer);
+    return !out->failed;
+  }
+
+  if (out->channel) {
+    if (!channel_push(out->channel, buffer, len))
+      out->failed = 1;
+  } else {
+    if (!write_all(out->fd, buffer, len))
+      out->failed = 1;
+    free(buffer);
+  }
+  return !out->failed;
+}
+
+// Move what is left of in_fd to out_fd without it passing through the
+// shell: sendfile reads from files, splice from pipes. Returns 0 if
+// neither could move all of it, leaving the rest where it was.
+static int kernel_send(int out_fd, int in_fd) {
+  sigset_t old_set;
+  block_sigpipe(&old_set);
+
+  ssize_t n;
+  int use_splice = 0;
+  for (;;) {
+    n = use_splice ? splice(in_fd, NULL, out_fd, NULL, STAGE_SEND_CHUNK, 0)
+                   : sendfile(out_fd, in_fd, NULL, STAGE_SEND_CHUNK);
+    if (n > 0 || (n < 0 && errno == EINTR))
+      continue;
+    if (n == 0 || use_splice)
+      break;
+    use_splice = 1;
+  }
+
+  restore_sigpipe(&old_set, n < 0);
+  return n == 0;
+}
+
+int stage_send_fd(StageStream *out, int fd) {
+  if (!flush_pending(out))
+    return 0;
+  if (!out->channel && kernel_send(out->fd, fd))
+    return 1;
+
+  // Copied by hand when out is a channel or the kernel cannot do it, which
+  // also tells a failed read from a failed write
+  for (;;) {
+    char *buffer = malloc(STAGE_BUFFER);
+    if (!buffer)
+      return -1;
+    ssize_t n;
+    do {
+      n = read(fd, buffer, STAGE_BUFFER);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+      int saved = errno;
+      free(buffer);
+      errno = saved;
+      return n == 0 ? 1 : -1;
+    }
+    if (!stage_give(out, buffer, (size_t)n))
+      return 0;
+  }
+}
+
+int stage_input_fd(const StageStream *in) {
+  if (!in || in->channel || in->chunk_pos != in->chunk_len || in->eof)
+    return -1;
+  return in->fd;
+}
+
+// Make the next block of input current. Returns 0 at the end of input.
+static int next_chunk(StageStream *in) {
+  if (in->eof)
+    return 0;
+
+  if (in->channel) {
+    free(in->chunk);
+    in->chunk_len = channel_pop(in->channel, &in->chunk);
+  } else {
+    if (!in->chunk) {
+      in->chunk = malloc(STAGE_BUFFER);
+      if (!in->chunk) {
+        in->eof = 1;
+        return 0;
+      }
+    }
+    ssize_t n;
+    do {
+      n = read(in->fd, in->chunk, STAGE_BUFFER);
+    } while (n < 0 && errno == EINTR);
+    in->chunk_len = n > 0 ? (size_t)n : 0;
+  }
+
+  in->chunk_pos = 0;
+  if (in->chunk_len == 0)
+    in->eof = 1;
+  return !in->eof;
+}
+
+ssize_t stage_read_line(StageStream *in, const char **line) {
+  size_t joined = 0;
+  for (;;) {
+    if (in->chunk_pos == in->chunk_len && !next_chunk(in)) {
+      // The last line may have no newline
+      if (joined == 0)
+        return -1;
+      *line = in->line;
+      return (ssize_t)joined;
+    }
+
+    char *start = in->chunk + in->chunk_pos;
+    size_t available = in->chunk_len - in->chunk_pos;
+    char *newline = memchr(start, '\n', available);
+    size_t len = newline ? (size_t)(newline - start) : available;
+
+    // A line inside one chunk is returned where it is
+    if (newline && joined == 0) {
+      in->chunk_pos += len + 1;
+      *line = start;
+      return (ssize_t)len;
+    }
+
+    if (joined + len > in->line_cap) {
+      size_t cap = in->line_cap ? in->line_cap : 256;
+      while (cap < joined + len)
+        cap *= 2;
+      char *grown = realloc(in->line, cap);
+      if (!grown)
+        return -1;
+      in->line = grown;
+      in->line_cap = cap;
+    }
+    memcpy(in->line + joined, start, len);
+    joined += len;
+    in->chunk_pos += len + (newline ? 1 : 0);
+
+    if (newline) {
+      *line = in->line;
+      return (ssize_t)joined;
+    }
+  }
+}
+
+size_t stage_take(StageStream *in, char **buffer) {
+  *buffer = NULL;
+
+  // Read straight into a buffer the caller keeps
+  if (!in->channel && in->chunk_pos == in->chunk_len) {
+    if (in->eof)
+      return 0;
+    char *data = malloc(STAGE_BUFFER);
+    if (!data)
+      return 0;
+    ssize_t n;
+    do {
+      n = read(in->fd, data, STAGE_BUFFER);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+      free(data);
+      in->eof = 1;
+      return 0;
+    }
+    *buffer = data;
+    return (size_t)n;
+  }
+
+  if (in->chunk_pos == in->chunk_len && !next_chunk(in))
+    return 0;
+
+  size_t len = in->chunk_len - in->chunk_pos;
+  if (in->channel && in->chunk_pos == 0) {
+    // Hand the writer's chunk on as it is
+    *buffer = in->chunk;
+    in->chunk = NULL;
+    in->chunk_len = 0;
+    return len;
+  }
+
+  char *rest = malloc(len);
+  if (!rest)
+    return 0;
+  memcpy(rest, in->chunk + in->chunk_pos, len);
+  in->chunk_pos = in->chunk_len;
+  *buffer = rest;
+  return len;
+}
+
+int stage_run(StageFunc stage, char **args) {
+  // Anything printed earlier must reach the terminal first
+  fflush(stdout);
+  StageStream *out = stage_fd_stream(STDOUT_FILENO, 1, 0);
+  if (!out)
+    return 1;
+  int status = stage(args, NULL, out);
+  stage_close(out);
+  return status;
+}
+
+// Run a file that is not a binary and has no #! line as a shell script,
+// as execvp does
+static int spawn_script(pid_t *pid, const char *path, char **args,
+                        const posix_spawn_file_actions_t *actions) {
+  int argc = 0;
+  while (args[argc] != NULL)
+    argc++;
+
+  char **script_args = malloc((argc + 2) * sizeof(char *));
+  if (!script_args)
+    return ENOMEM;
+  script_args[0] = "sh";
+  script_args[1] = (char *)path;
+  for (int i = 1; i <= argc; i++)
+    script_args[i + 1] = args[i];
+
+  int err = posix_spawn(pid, "/bin/sh", actions, NULL, script_args, environ);
+  free(script_args);
+  return err;
+}
+
+int spawn_command(pid_t *pid, char **args,
+                  const posix_spawn_file_actions_t *actions) {
+  char path[PATH_MAX];
+  if (!command_path_resolve(args[0], path, sizeof(path)))
+    return ENOENT;
+
+  int err = posix_spawn(pid, path, actions, NULL, args, environ);
+  if (err == ENOENT && strchr(args[0], '/') == NULL) {
+    // The cached file is gone; look again
+    command_path_clear();
+    if (!command_path_resolve(args[0], path, sizeof(path)))
+      return ENOENT;
+    err = posix_spawn(pid, path, actions, NULL, args, environ);
+  }
+  if (err == ENOEXEC)
+    err = spawn_script(pid, path, args, actions);
+  return err;
+}
+
+typedef struct {
+  char **args;
+  StageFunc stage; // NULL for an external command
+  StageStream *in;
+  StageStream *out;
+  int stdin_fd; // Pipe ends an external command gets, -1 to inherit
+  int stdout_fd;
+  pid_t pid;
+  pthread_t thread;
+  int running;
+} PipelineStage;
+
+static void *run_stage_thread(void *arg) {
+  PipelineStage *stage = arg;
+  stage->stage(stage->args, stage->in, stage->out);
+
+  // Upstream stops once nothing reads; downstream sees the end of input
+  stage_close(stage->in);
+  stage_close(stage->out);
+  stage->in = stage->out = NULL;
+  return NULL;
+}
+
+// Stream over one end of a pipe, closing the end when that fails
+static StageStream *pipe_stream(int fd, int writing) {
+  StageStream *stream = stage_fd_stream(fd, writing, 1);
+  if (!stream)
+    close(fd);
+  return stream;
+}
+
+// Join each pair of neighbours: a channel between two builtins, a pipe
+// wherever an external command is involved
+static int connect_stages(PipelineStage *stages, int count) {
+  for (int i = 0; i + 1 < count; i++) {
+    PipelineStage *left = &stages[i];
+    PipelineStage *right = &stages[i + 1];
+
+    if (left->stage && right->stage) {
+      if (!stage_channel(&left->out, &right->in))
+        return 0;
+      continue;
+    }
+
+    // Both ends close on exec; a spawned command gets its end by dup2
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+      perror("pipe");
+      return 0;
+    }
+    if (left->stage) {
+      if (!(left->out = pipe_stream(fds[1], 1))) {
+        close(fds[0]);
+        return 0;
+      }
+    } else {
+      left->stdout_fd = fds[1];
+    }
+    if (right->stage) {
+      if (!(right->in = pipe_stream(fds[0], 0)))
+        return 0;
+    } else {
+      right->stdin_fd = fds[0];
+    }
+  }
+
+  PipelineStage *last = &stages[count - 1];
+  if (last->stage && !(last->out = stage_fd_stream(STDOUT_FILENO, 1, 0)))
+    return 0;
+  return 1;
+}
+
+static void close_stage_ends(PipelineStage *stage) {
+  if (stage->stdin_fd != -1)
+    close(stage->stdin_fd);
+  if (stage->stdout_fd != -1)
+    close(stage->stdout_fd);
+  stage->stdin_fd = stage->stdout_fd = -1;
+}
+
+static void spawn_stage(PipelineStage *stage) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (stage->stdin_fd != -1)
+    posix_spawn_file_actions_adddup2(&actions, stage->stdin_fd, STDIN_FILENO);
+  if (stage->stdout_fd != -1)
+    posix_spawn_file_actions_adddup2(&actions, stage->stdout_fd,
+                                     STDOUT_FILENO);
+
+  int err = spawn_command(&stage->pid, stage->args, &actions);
+  posix_spawn_file_actions_destroy(&actions);
+  if (err != 0) {
+    // The stages around it see end of file or a closed pipe
+    fprintf(stderr, "lsh: %s: %s\n", stage->args[0], strerror(err));
+    stage->pid = -1;
+  }
+
+  // The child has its own copies now
+  close_stage_ends(stage);
+}
+
+int wait_exit_status(int status) {
+  if (WIFSIGNALED(status))
+    return 128 + WTERMSIG(status);
+  return WEXITSTATUS(status);
+}
+
+int run_pipeline(char ***commands) {
+  int count = 0;
+  while (commands[count] != NULL)
+    count++;
+  if (count == 0)
+    return 1;
+
+  PipelineStage *stages = calloc((size_t)count, sizeof(PipelineStage));
+  if (!stages) {
+    fprintf(stderr, "lsh: allocation error\n");
+    return 1;
+  }
+  for (int i = 0; i < count; i++) {
+    const CommandInfo *builtin = command_builtin(commands[i][0]);
+    stages[i].args = commands[i];
+    stages[i].stage = builtin ? builtin->stage : NULL;
+    stages[i].stdin_fd = stages[i].stdout_fd = -1;
+    stages[i].pid = -1;
+  }
+
+  // Output already printed goes before the pipeline's
+  fflush(stdout);
+  fflush(stderr);
+
+  if (connect_stages(stages, count)) {
+    for (int i = 0; i < count; i++) {
+      if (!stages[i].stage)
+        spawn_stage(&stages[i]);
+    }
+    for (int i = 0; i < count; i++) {
+      if (!stages[i].stage)
+        continue;
+      if (pthread_create(&stages[i].thread, NULL, run_stage_thread,
+                         &stages[i]) == 0) {
+        stages[i].running = 1;
+      } else {
+        fprintf(stderr, "lsh: %s: cannot start stage\n", stages[i].args[0]);
+      }
+    }
+  }
+
+  // A stage that never started lets its neighbours see the end of input
+  for (int i = 0; i < count; i++) {
+    if (!stages[i].running) {
+      stage_close(stages[i].in);
+      stage_close(stages[i].out);
+      stages[i].in = stages[i].out = NULL;
+      close_stage_ends(&stages[i]);
+    }
+  }
+
+  // The pipeline's status is its last command's; one that never started
+  // counts as not found
+  for (int i = 0; i < count; i++) {
+    int exit_status = 127;
+    if (stages[i].running) {
+      pthread_join(stages[i].thread, NULL);
+      exit_status = 0;
+    } else if (stages[i].pid != -1) {
+      int status;
+      while (waitpid(stages[i].pid, &status, 0) == -1 && errno == EINTR)
+        ;
+      exit_status = wait_exit_status(status);
+    }
+    last_exit_status = exit_status;
+  }
+
+  free(stages);
+  return 1;
+}
@@ -0,0 +1,310 @@
+#define _GNU_SOURCE
+#include "file_walker.h"
+#include "common.h"
+#include <dirent.h>
+#include <fnmatch.h>
+#include <pthread.h>
+
+#define MAX_WALK_THREADS 64
+
+typedef struct {
+  char *pattern;
+  int negate;   // Starts with !: brings back what an earlier rule excluded
+  int dir_only; // Ends with /
+  int anchored; // Has a / before its end: matched against the whole path
+} IgnoreRule;
+
+// The rules of one .gitignore, chained to those of the directories above
+typedef struct IgnoreList {
+  struct IgnoreList *parent;
+  struct IgnoreList *next; // Every list made during the walk
+  char *base;              // Directory the .gitignore is in
+  size_t base_len;
+  IgnoreRule *rules;
+  int count;
+} IgnoreList;
+
+typedef struct {
+  char *path;
+  IgnoreList *ignore;
+} WalkJob;
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  WalkJob *jobs; // Directories waiting to be read, taken from the end
+  int count;
+  int capacity;
+  int busy; // Workers reading a directory, which may add more
+  IgnoreList *lists;
+  WalkFileFunc visit;
+} Walk;
+
+typedef struct {
+  Walk *walk;
+  void *state;
+} Worker;
+
+static void add_rule(IgnoreList *list, char *line) {
+  size_t length = strlen(line);
+  while (length > 0 && isspace((unsigned char)line[length - 1]))
+    line[--length] = '\0';
+  if (length == 0 || line[0] == '#')
+    return;
+
+  IgnoreRule rule = {0};
+  if (line[0] == '!') {
+    rule.negate = 1;
+    line++;
+    length--;
+  }
+  if (length > 0 && line[length - 1] == '/') {
+    rule.dir_only = 1;
+    line[--length] = '\0';
+  }
+  // **/name matches name at any depth, as a pattern without a slash does
+  while (strncmp(line, "**/", 3) == 0) {
+    line += 3;
+    length -= 3;
+  }
+  if (line[0] == '/') {
+    rule.anchored = 1;
+    line++;
+  } else if (strchr(line, '/')) {
+    rule.anchored = 1;
+  }
+  if (!*line)
+    return;
+
+  IgnoreRule *rules =
+      realloc(list->rules, (list->count + 1) * sizeof(IgnoreRule));
+  if (!rules)
+    return;
+  list->rules = rules;
+  rule.pattern = strdup(line);
+  if (rule.pattern)
+    list->rules[list->count++] = rule;
+}
+
+// Rules of dir's .gitignore on top of parent, or parent when it has none
+static IgnoreList *read_ignore(Walk *walk, const char *dir,
+                               IgnoreList *parent) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/.gitignore", dir);
+  FILE *file = fopen(path, "re");
+  if (!file)
+    return parent;
+
+  IgnoreList *list = calloc(1, sizeof(IgnoreList));
+  if (!list || !(list->base = strdup(dir))) {
+    free(list);
+    fclose(file);
+    return parent;
+  }
+  list->parent = parent;
+  list->base_len = strlen(dir);
+
+  char *line = NULL;
+  size_t line_cap = 0;
+  while (getline(&line, &line_cap, file) != -1)
+    add_rule(list, line);
+  free(line);
+  fclose(file);
+
+  pthread_mutex_lock(&walk->lock);
+  list->next = walk->lists;
+  walk->lists = list;
+  pthread_mutex_unlock(&walk->lock);
+  return list;
+}
+
+static int is_ignored(const IgnoreList *list, const char *path,
+                      const char *name, int is_dir) {
+  // A nearer .gitignore overrides those above it, and within one file the
+  // last matching rule wins
+  for (; list; list = list->parent) {
+    const char *relative = path + list->base_len;
+    if (*relative == '/')
+      relative++;
+
+    for (int i = list->count - 1; i >= 0; i--) {
+      const IgnoreRule *rule = &list->rules[i];
+      if (rule->dir_only && !is_dir)
+        continue;
+      const char *subject = rule->anchored ? relative : name;
+      if (fnmatch(rule->pattern, subject, FNM_PATHNAME) == 0)
+        return !rule->negate;
+    }
+  }
+  return 0;
+}
+
+static void push_jobs(Walk *walk, WalkJob *jobs, int count) {
+  pthread_mutex_lock(&walk->lock);
+  if (walk->count + count > walk->capacity) {
+    int capacity = walk->capacity ? walk->capacity : 64;
+    while (walk->count + count > capacity)
+      capacity *= 2;
+    WalkJob *grown = realloc(walk->jobs, capacity * sizeof(WalkJob));
+    if (!grown) {
+      pthread_mutex_unlock(&walk->lock);
+      for (int i = 0; i < count; i++)
+        free(jobs[i].path);
+      return;
+    }
+    walk->jobs = grown;
+    walk->capacity = capacity;
+  }
+  memcpy(walk->jobs + walk->count, jobs, count * sizeof(WalkJob));
+  walk->count += count;
+  pthread_cond_broadcast(&walk->wake);
+  pthread_mutex_unlock(&walk->lock);
+}
+
+// Visit the files of one directory and queue its subdirectories
+static void read_directory(Walk *walk, WalkJob *job, void *state) {
+  DIR *dir = opendir(job->path);
+  if (!dir)
+    return;
+
+  IgnoreList *ignore = read_ignore(walk, job->path, job->ignore);
+  size_t dir_len = strlen(job->path);
+  int separator = dir_len > 0 && job->path[dir_len - 1] != '/';
+
+  WalkJob *subdirs = NULL;
+  int subdir_count = 0;
+  int subdir_cap = 0;
+
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.')
+      continue;
+
+    char path[PATH_MAX];
+    int length = snprintf(path, sizeof(path), "%s%s%s", job->path,
+                          separator ? "/" : "", entry->d_name);
+    if (length < 0 || (size_t)length >= sizeof(path))
+      continue;
+
+    int is_dir = entry->d_type == DT_DIR;
+    int is_file = entry->d_type == DT_REG;
+    if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+      struct stat st;
+      int flags = entry->d_type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW;
+      if (fstatat(dirfd(dir), entry->d_name, &st, flags) != 0)
+        continue;
+      is_file = S_ISREG(st.st_mode);
+      is_dir = entry->d_type == DT_UNKNOWN && S_ISDIR(st.st_mode);
+    }
+    if ((!is_dir && !is_file) ||
+        is_ignored(ignore, path, entry->d_name, is_dir))
+      continue;
+
+    if (is_file) {
+      walk->visit(path, state);
+      continue;
+    }
+
+    if (subdir_count == subdir_cap) {
+      subdir_cap = subdir_cap ? subdir_cap * 2 : 16;
+      WalkJob *grown = realloc(subdirs, subdir_cap * sizeof(WalkJob));
+      if (!grown)
+        break;
+      subdirs = grown;
+    }
+    subdirs[subdir_count].path = strdup(path);
+    subdirs[subdir_count].ignore = ignore;
+    if (subdirs[subdir_count].path)
+      subdir_count++;
+  }
+  closedir(dir);
+
+  if (subdir_count > 0)
+    push_jobs(walk, subdirs, subdir_count);
+  free(subdirs);
+}
+
+static void *walk_worker(void *arg) {
+  Worker *worker = arg;
+  Walk *walk = worker->walk;
+
+  pthread_mutex_lock(&walk->lock);
+  for (;;) {
+    // The walk is over once nothing is queued and nobody can queue more
+    while (walk->count == 0 && walk->busy > 0)
+      pthread_cond_wait(&walk->wake, &walk->lock);
+    if (walk->count == 0)
+      break;
+
+    WalkJob job = walk->jobs[--walk->count];
+    walk->busy++;
+    pthread_mutex_unlock(&walk->lock);
+
+    read_directory(walk, &job, worker->state);
+    free(job.path);
+
+    pthread_mutex_lock(&walk->lock);
+    if (--walk->busy == 0 && walk->count == 0)
+      pthread_cond_broadcast(&walk->wake);
+  }
+  pthread_mutex_unlock(&walk->lock);
+  return NULL;
+}
+
+int walk_thread_count(void) {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (count < 1)
+    return 1;
+  return count > MAX_WALK_THREADS ? MAX_WALK_THREADS : (int)count;
+}
+
+int walk_files(const char *root, int thread_count, WalkFileFunc visit,
+               void *states, size_t state_size) {
+  DIR *dir = opendir(root);
+  if (!dir)
+    return 0;
+  closedir(dir);
+
+  Walk walk = {0};
+  pthread_mutex_init(&walk.lock, NULL);
+  pthread_cond_init(&walk.wake, NULL);
+  walk.visit = visit;
+
+  WalkJob first = {strdup(root), NULL};
+  if (first.path)
+    push_jobs(&walk, &first, 1);
+
+  if (thread_count < 1)
+    thread_count = 1;
+  pthread_t threads[MAX_WALK_THREADS];
+  Worker workers[MAX_WALK_THREADS];
+  if (thread_count > MAX_WALK_THREADS)
+    thread_count = MAX_WALK_THREADS;
+
+  // The calling thread is the first worker
+  int started = 1;
+  for (int i = 0; i < thread_count; i++) {
+    workers[i].walk = &walk;
+    workers[i].state = (char *)states + i * state_size;
+    if (i > 0 &&
+        pthread_create(&threads[started], NULL, walk_worker, &workers[i]) == 0)
+      started++;
+  }
+  walk_worker(&workers[0]);
+  for (int i = 1; i < started; i++)
+    pthread_join(threads[i], NULL);
+
+  while (walk.lists) {
+    IgnoreList *list = walk.lists;
+    walk.lists = list->next;
+    for (int i = 0; i < list->count; i++)
+      free(list->rules[i].pattern);
+    free(list->rules);
+    free(list->base);
+    free(list);
+  }
+  free(walk.jobs);
+  pthread_mutex_destroy(&walk.lock);
+  pthread_cond_destroy(&walk.wake);
+  return 1;
+}
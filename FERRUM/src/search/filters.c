@@ -1,5 +1,6 @@
 // this is another test
 
+#define _GNU_SOURCE
 #include "filters.h"
 #include <string.h>
 #include <strings.h> // For strcasecmp and strncasecmp
@@ -57,6 +58,29 @@ TableData *lsh_where(TableData *input, char **args) {
   return filter_table(input, field, op, value);
 }
 
+typedef struct {
+  DataValue *row;
+  int index;        // Position in the input, breaks ties
+  const char *text; // Key for string columns, NULL for numeric ones
+  double number;
+} SortEntry;
+
+static int compare_sort_entries(const void *a, const void *b, void *arg) {
+  const SortEntry *x = a, *y = b;
+  int descending = *(const int *)arg;
+  int compare_result;
+
+  if (x->text && y->text)
+    compare_result = strcasecmp(x->text, y->text);
+  else
+    compare_result = (x->number > y->number) - (x->number < y->number);
+
+  // If descending, invert comparison result
+  if (descending)
+    compare_result = -compare_result;
+  return compare_result ? compare_result : x->index - y->index;
+}
+
 TableData *lsh_sort_by(TableData *input, char **args) {
   if (!input || !args || !args[0]) {
     fprintf(stderr, "lsh: sort-by: missing arguments\n");
@@ -119,53 +143,42 @@ TableData *lsh_sort_by(TableData *input, char **args) {
     add_table_row(result, row_copy);
   }
 
-  // Now sort the rows based on the specified column
-  // Bubble sort for simplicity (not efficient for large datasets)
-  for (int i = 0; i < result->row_count - 1; i++) {
-    for (int j = 0; j < result->row_count - i - 1; j++) {
-      int compare_result = 0;
-
-      // Compare based on data type
-      if (result->rows[j][field_idx].type == TYPE_STRING ||
-          result->rows[j][field_idx].type == TYPE_SIZE) {
-        // Handle special case for sizes (KB, MB, etc.)
-        if (strcasecmp(result->headers[field_idx], "Size") == 0 ||
-            strcasecmp(result->headers[field_idx], "Memory") == 0) {
-          long size1 =
-              extract_size_bytes(result->rows[j][field_idx].value.str_val);
-          long size2 =
-              extract_size_bytes(result->rows[j + 1][field_idx].value.str_val);
-          compare_result = (size1 > size2) ? 1 : (size1 < size2) ? -1 : 0;
-        } else {
-          // Regular string comparison
-          compare_result =
-              strcasecmp(result->rows[j][field_idx].value.str_val,
-                         result->rows[j + 1][field_idx].value.str_val);
-        }
-      } else if (result->rows[j][field_idx].type == TYPE_INT) {
-        int val1 = result->rows[j][field_idx].value.int_val;
-        int val2 = result->rows[j + 1][field_idx].value.int_val;
-        compare_result = (val1 > val2) ? 1 : (val1 < val2) ? -1 : 0;
-      } else if (result->rows[j][field_idx].type == TYPE_FLOAT) {
-        float val1 = result->rows[j][field_idx].value.float_val;
-        float val2 = result->rows[j + 1][field_idx].value.float_val;
-        compare_result = (val1 > val2) ? 1 : (val1 < val2) ? -1 : 0;
-      }
-
-      // If descending, invert comparison result
-      if (descending) {
-        compare_result = -compare_result;
-      }
+  // Sort the rows based on the specified column. Keys are extracted once
+  // per row, and ties keep their input order like the bubble sort did.
+  int size_field = strcasecmp(result->headers[field_idx], "Size") == 0 ||
+                   strcasecmp(result->headers[field_idx], "Memory") == 0;
+  SortEntry *entries = malloc(result->row_count * sizeof(SortEntry));
+  if (!entries && result->row_count > 0) {
+    fprintf(stderr, "lsh: allocation error in sort_by\n");
+    free_table(result);
+    return NULL;
+  }
 
-      // Swap if needed
-      if (compare_result > 0) {
-        DataValue *temp = result->rows[j];
-        result->rows[j] = result->rows[j + 1];
-        result->rows[j + 1] = temp;
-      }
+  for (int i = 0; i < result->row_count; i++) {
+    DataValue *cell = &result->rows[i][field_idx];
+    entries[i].row = result->rows[i];
+    entries[i].index = i;
+    entries[i].text = NULL;
+    entries[i].number = 0;
+    if (cell->type == TYPE_STRING || cell->type == TYPE_SIZE) {
+      // Handle special case for sizes (KB, MB, etc.)
+      if (size_field)
+        entries[i].number = (double)extract_size_bytes(cell->value.str_val);
+      else
+        entries[i].text = cell->value.str_val;
+    } else if (cell->type == TYPE_INT) {
+      entries[i].number = cell->value.int_val;
+    } else if (cell->type == TYPE_FLOAT) {
+      entries[i].number = cell->value.float_val;
     }
   }
 
+  qsort_r(entries, result->row_count, sizeof(SortEntry), compare_sort_entries,
+          &descending);
+  for (int i = 0; i < result->row_count; i++)
+    result->rows[i] = entries[i].row;
+  free(entries);
+
   return result;
 }
 
@@ -462,16 +462,8 @@ int lsh_fzf_native(char **args) {
       // Execute the selected command from history
       printf("Executing: %s\n", result);
 
-      // Parse and execute the command
-      char *cmd_copy = strdup(result);
-      if (cmd_copy) {
-        char **cmd_args = lsh_split_line(cmd_copy);
-        lsh_execute(cmd_args);
-
-        // Clean up
-        free(cmd_args);
-        free(cmd_copy);
-      }
+      // Parse and execute the command, pipes and all
+      lsh_run_line(result);
     } else {
       // File or directory selected
 
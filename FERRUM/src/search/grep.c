@@ -174,43 +174,27 @@ bool boyer_moore_search(const char *text, int text_len, const char *pattern, int
     return false; // Pattern not found
 }
 
-// Function to process a single file
-int process_file(const char *file_path, const char *pattern, bool show_line_numbers, 
-                bool ignore_case, bool fuzzy_match) {
-    FILE *file = fopen(file_path, "r");
-    if (!file) {
-        fprintf(stderr, "Error: Unable to open file %s\n", file_path);
-        return 0;
-    }
-    
-    // Check file size
-    fseek(file, 0, SEEK_END);
-    long file_size = ftell(file);
-    rewind(file);
-    
-    if (file_size > MAX_FILE_SIZE) {
-        fprintf(stderr, "Error: File %s is too large (max 50MB)\n", file_path);
-        fclose(file);
-        return 0;
-    }
-    
-    // For fuzzy matching, we use a simpler approach 
-    // (in a real implementation, you'd want a proper fuzzy algorithm)
+// Search a stream line by line, printing the matching lines. With a label
+// they are indented under it, as for a file; piped input is printed plain.
+static int grep_stream(StageStream *out, StageStream *in, const char *label,
+                       const char *pattern, bool show_line_numbers,
+                       bool ignore_case, bool fuzzy_match) {
+    // Colors only make sense on a terminal, not for the next stage
+    bool colors = stage_is_terminal(out);
+    const char *cyan = colors ? ANSI_COLOR_CYAN : "";
+    const char *green = colors ? ANSI_COLOR_GREEN : "";
+    const char *red = colors ? ANSI_COLOR_RED : "";
+    const char *reset = colors ? ANSI_COLOR_RESET : "";
+    const char *indent = label ? "  " : "";
     
-    char line[MAX_LINE_LENGTH];
+    const char *line;
+    ssize_t line_len;
     int line_number = 0;
     int matches_found = 0;
     int pattern_len = strlen(pattern);
     
-    while (fgets(line, MAX_LINE_LENGTH, file)) {
+    while ((line_len = stage_read_line(in, &line)) >= 0) {
         line_number++;
-        int line_len = strlen(line);
-        
-        // Remove newline character at the end if present
-        if (line[line_len - 1] == '\n') {
-            line[line_len - 1] = '\0';
-            line_len--;
-        }
         
         int match_pos = 0;
         bool match_found = false;
@@ -218,19 +202,17 @@ int process_file(const char *file_path, const char *pattern, bool show_line_numb
         if (fuzzy_match) {
             // Simple fuzzy matching - allows for character skipping
             // For a real implementation, use Levenshtein distance or another algorithm
-            char *line_ptr = line;
-            char *pattern_ptr = (char *)pattern;
+            const char *pattern_ptr = pattern;
             int matched_chars = 0;
             
-            while (*line_ptr && *pattern_ptr) {
-                char line_char = ignore_case ? tolower(*line_ptr) : *line_ptr;
+            for (ssize_t i = 0; i < line_len && *pattern_ptr; i++) {
+                char line_char = ignore_case ? tolower(line[i]) : line[i];
                 char pattern_char = ignore_case ? tolower(*pattern_ptr) : *pattern_ptr;
                 
                 if (line_char == pattern_char) {
                     matched_chars++;
                     pattern_ptr++;
                 }
-                line_ptr++;
             }
             
             // If we've matched at least 70% of the pattern's characters
@@ -238,55 +220,77 @@ int process_file(const char *file_path, const char *pattern, bool show_line_numb
                            (matched_chars >= pattern_len * 0.7));
         } else {
             // Exact matching using Boyer-Moore
-            match_found = boyer_moore_search(line, line_len, pattern, pattern_len, 
+            match_found = boyer_moore_search(line, (int)line_len, pattern, pattern_len, 
                                             &match_pos, ignore_case);
         }
         
-        if (match_found) {
-            matches_found++;
-            
-            // Print the file name only once if multiple matches
-            if (matches_found == 1) {
-                printf("%s%s%s:\n", ANSI_COLOR_CYAN, file_path, ANSI_COLOR_RESET);
-            }
-            
-            // Print line number if requested
-            if (show_line_numbers) {
-                printf("  %s%d:%s ", ANSI_COLOR_GREEN, line_number, ANSI_COLOR_RESET);
-            } else {
-                printf("  ");
-            }
-            
-            // Print the matching line, highlighting the match
-            if (!fuzzy_match) {
-                // Print the line with the match highlighted
-                for (int i = 0; i < line_len; i++) {
-                    if (i == match_pos) {
-                        printf("%s", ANSI_COLOR_RED);
-                        for (int j = 0; j < pattern_len; j++) {
-                            putchar(line[i + j]);
-                        }
-                        printf("%s", ANSI_COLOR_RESET);
-                        i += pattern_len - 1;
-                    } else {
-                        putchar(line[i]);
-                    }
-                }
-            } else {
-                // For fuzzy matches, just print the line
-                printf("%s", line);
-            }
-            printf("\n");
+        if (!match_found) {
+            continue;
+        }
+        matches_found++;
+        
+        // Print the file name only once if multiple matches
+        if (matches_found == 1 && label) {
+            stage_printf(out, "%s%s%s:\n", cyan, label, reset);
         }
+        
+        // Print line number if requested
+        if (show_line_numbers) {
+            stage_printf(out, "%s%s%d:%s ", indent, green, line_number, reset);
+        } else {
+            stage_printf(out, "%s", indent);
+        }
+        
+        if (!fuzzy_match) {
+            // Print the line with the match highlighted
+            stage_write(out, line, match_pos);
+            stage_printf(out, "%s", red);
+            stage_write(out, line + match_pos, pattern_len);
+            stage_printf(out, "%s", reset);
+            stage_write(out, line + match_pos + pattern_len,
+                        line_len - match_pos - pattern_len);
+        } else {
+            // For fuzzy matches, just print the line
+            stage_write(out, line, line_len);
+        }
+        stage_write(out, "\n", 1);
     }
     
-    fclose(file);
+    return matches_found;
+}
+
+// Function to process a single file
+int process_file(StageStream *out, const char *file_path, const char *pattern,
+                bool show_line_numbers, bool ignore_case, bool fuzzy_match) {
+    int fd = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        fprintf(stderr, "Error: Unable to open file %s\n", file_path);
+        return 0;
+    }
+    
+    // Check file size
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > MAX_FILE_SIZE) {
+        fprintf(stderr, "Error: File %s is too large (max 50MB)\n", file_path);
+        close(fd);
+        return 0;
+    }
+    
+    StageStream *in = stage_fd_stream(fd, 0, 1);
+    if (!in) {
+        close(fd);
+        return 0;
+    }
+    int matches_found = grep_stream(out, in, file_path, pattern, show_line_numbers,
+                                    ignore_case, fuzzy_match);
+    stage_close(in);
     return matches_found;
 }
 
 // Function to recursively search directories
-int search_directory(const char *dir_path, const char *pattern, bool show_line_numbers,
-                   bool ignore_case, bool recursive, bool fuzzy_match) {
+int search_directory(StageStream *out, const char *dir_path, const char *pattern,
+                   bool show_line_numbers, bool ignore_case, bool recursive,
+                   bool fuzzy_match) {
     DIR *dir = opendir(dir_path);
     if (!dir) {
         fprintf(stderr, "Error: Unable to open directory %s\n", dir_path);
@@ -307,13 +311,13 @@ int search_directory(const char *dir_path, const char *pattern, bool show_line_n
         if (is_directory(path)) {
             // If recursive flag is set, search subdirectories
             if (recursive) {
-                total_matches += search_directory(path, pattern, show_line_numbers, 
+                total_matches += search_directory(out, path, pattern, show_line_numbers, 
                                                 ignore_case, recursive, fuzzy_match);
             }
         } else {
             // Only process text files
             if (is_text_file(path)) {
-                total_matches += process_file(path, pattern, show_line_numbers, 
+                total_matches += process_file(out, path, pattern, show_line_numbers, 
                                             ignore_case, fuzzy_match);
             }
         }
@@ -323,14 +327,14 @@ int search_directory(const char *dir_path, const char *pattern, bool show_line_n
     return total_matches;
 }
 
-int lsh_actual_grep(char **args) {
+int lsh_grep_text_stage(char **args, StageStream *in, StageStream *out) {
     if (args[1] == NULL) {
-        printf("Usage: grep [options] pattern [file/directory]\n");
-        printf("Options:\n");
-        printf("  -n, --line-numbers  Show line numbers\n");
-        printf("  -i, --ignore-case   Ignore case distinctions\n");
-        printf("  -r, --recursive     Search directories recursively\n");
-        printf("  -f, --fuzzy         Use fuzzy matching instead of exact\n");
+        stage_printf(out, "Usage: grep [options] pattern [file/directory]\n");
+        stage_printf(out, "Options:\n");
+        stage_printf(out, "  -n, --line-numbers  Show line numbers\n");
+        stage_printf(out, "  -i, --ignore-case   Ignore case distinctions\n");
+        stage_printf(out, "  -r, --recursive     Search directories recursively\n");
+        stage_printf(out, "  -f, --fuzzy         Use fuzzy matching instead of exact\n");
         return 1;
     }
     
@@ -354,12 +358,12 @@ int lsh_actual_grep(char **args) {
         } else if (strcmp(args[arg_idx], "-f") == 0 || strcmp(args[arg_idx], "--fuzzy") == 0) {
             fuzzy_match = true;
         } else if (strcmp(args[arg_idx], "--help") == 0) {
-            printf("Usage: grep [options] pattern [file/directory]\n");
-            printf("Options:\n");
-            printf("  -n, --line-numbers  Show line numbers\n");
-            printf("  -i, --ignore-case   Ignore case distinctions\n");
-            printf("  -r, --recursive     Search directories recursively\n");
-            printf("  -f, --fuzzy         Use fuzzy matching instead of exact\n");
+            stage_printf(out, "Usage: grep [options] pattern [file/directory]\n");
+            stage_printf(out, "Options:\n");
+            stage_printf(out, "  -n, --line-numbers  Show line numbers\n");
+            stage_printf(out, "  -i, --ignore-case   Ignore case distinctions\n");
+            stage_printf(out, "  -r, --recursive     Search directories recursively\n");
+            stage_printf(out, "  -f, --fuzzy         Use fuzzy matching instead of exact\n");
             return 1;
         } else {
             // Unknown option - treat as pattern
@@ -381,10 +385,14 @@ int lsh_actual_grep(char **args) {
     
     int total_matches = 0;
     
-    // If no files/directories specified, search current directory
-    if (args[arg_idx] == NULL) {
+    // Piped input is searched when no files are named; otherwise, with no
+    // files/directories specified, search current directory
+    if (args[arg_idx] == NULL && in != NULL) {
+        total_matches = grep_stream(out, in, NULL, pattern, show_line_numbers,
+                                    ignore_case, fuzzy_match);
+    } else if (args[arg_idx] == NULL) {
         if (recursive) {
-            total_matches = search_directory(".", pattern, show_line_numbers, 
+            total_matches = search_directory(out, ".", pattern, show_line_numbers, 
                                            ignore_case, recursive, fuzzy_match);
         } else {
             // Just search files in current directory, not recursively
@@ -401,7 +409,7 @@ int lsh_actual_grep(char **args) {
                 snprintf(path, PATH_MAX, "./%s", entry->d_name);
                 
                 if (!is_directory(path) && is_text_file(path)) {
-                    total_matches += process_file(path, pattern, show_line_numbers, 
+                    total_matches += process_file(out, path, pattern, show_line_numbers, 
                                                ignore_case, fuzzy_match);
                 }
             }
@@ -413,27 +421,34 @@ int lsh_actual_grep(char **args) {
             const char *path = args[arg_idx++];
             
             if (is_directory(path)) {
-                total_matches += search_directory(path, pattern, show_line_numbers, 
+                total_matches += search_directory(out, path, pattern, show_line_numbers, 
                                                ignore_case, recursive, fuzzy_match);
             } else {
                 if (is_text_file(path)) {
-                    total_matches += process_file(path, pattern, show_line_numbers, 
+                    total_matches += process_file(out, path, pattern, show_line_numbers, 
                                                ignore_case, fuzzy_match);
                 }
             }
         }
     }
     
-    // Print summary
+    // Print summary, unless the matches go on to another stage
+    if (!stage_is_terminal(out)) {
+        return 1;
+    }
     if (total_matches == 0) {
-        printf("No matches found\n");
+        stage_printf(out, "No matches found\n");
     } else {
-        printf("\nFound %d match%s\n", total_matches, (total_matches == 1 ? "" : "es"));
+        stage_printf(out, "\nFound %d match%s\n", total_matches, (total_matches == 1 ? "" : "es"));
     }
     
     return 1;
 }
 
+int lsh_actual_grep(char **args) {
+    return stage_run(lsh_grep_text_stage, args);
+}
+
 void run_interactive_grep_session(void) {
     // Save original terminal settings to restore later
     struct termios old_tio, new_tio;
@@ -0,0 +1,208 @@
+#define _GNU_SOURCE
+#include "line_index.h"
+#include "common.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define LINE_INDEX_STRIDE 64      // Lines from one recorded offset to the next
+#define LINE_INDEX_BLOCK 4096     // Recorded offsets allocated at a time
+#define LINE_INDEX_STEP (4 << 20) // Bytes read between progress reports
+
+struct LineIndex {
+  int fd;
+  const char *text;
+  size_t size;
+  pthread_t thread;
+  atomic_int stopping;
+
+  // Offsets of lines 0, STRIDE, 2 * STRIDE and so on, in blocks so that
+  // they never move. The block table is sized for the most lines the text
+  // could have.
+  size_t **blocks;
+  size_t block_count;
+
+  // Guarded by lock; the thread has finished with whatever they cover
+  pthread_mutex_t lock;
+  size_t lines;
+  size_t scanned;
+  size_t recorded;
+  int complete;
+};
+
+static size_t recorded_offset(const LineIndex *index, size_t n) {
+  return index->blocks[n / LINE_INDEX_BLOCK][n % LINE_INDEX_BLOCK];
+}
+
+static int record(LineIndex *index, size_t n, size_t offset) {
+  size_t **block = &index->blocks[n / LINE_INDEX_BLOCK];
+  if (!*block) {
+    *block = malloc(LINE_INDEX_BLOCK * sizeof(size_t));
+    if (!*block)
+      return 0;
+  }
+  (*block)[n % LINE_INDEX_BLOCK] = offset;
+  return 1;
+}
+
+static void publish(LineIndex *index, size_t lines, size_t scanned,
+                    size_t recorded, int complete) {
+  pthread_mutex_lock(&index->lock);
+  index->lines = lines;
+  index->scanned = scanned;
+  index->recorded = recorded;
+  index->complete = complete;
+  pthread_mutex_unlock(&index->lock);
+}
+
+static void *index_lines(void *arg) {
+  LineIndex *index = arg;
+  size_t size = index->size;
+  char *buffer = malloc(LINE_INDEX_STEP);
+
+  // The first line starts at 0; one after a final newline does not count
+  size_t lines = size > 0;
+  size_t recorded = 0;
+  if (size > 0 && record(index, 0, 0))
+    recorded = 1;
+
+  size_t pos = 0;
+  while (buffer && pos < size && !atomic_load(&index->stopping)) {
+    size_t want = size - pos > LINE_INDEX_STEP ? LINE_INDEX_STEP : size - pos;
+    ssize_t got = pread(index->fd, buffer, want, (off_t)pos);
+    if (got == -1 && errno == EINTR)
+      continue;
+    // A file cut short is indexed as far as it goes
+    if (got <= 0)
+      break;
+
+    const char *start = buffer;
+    const char *end = buffer + got;
+    const char *newline;
+    while ((newline = memchr(start, '\n', (size_t)(end - start))) != NULL) {
+      start = newline + 1;
+      size_t offset = pos + (size_t)(start - buffer);
+      if (offset == size)
+        break;
+      // Out of memory, lines are still counted but found from the last
+      // offset recorded
+      if (lines == recorded * LINE_INDEX_STRIDE &&
+          record(index, recorded, offset))
+        recorded++;
+      lines++;
+    }
+    pos += (size_t)got;
+    publish(index, lines, pos, recorded, pos == size);
+  }
+
+  // However the scan ended, nothing more is coming; a file cut short or a
+  // failed allocation leaves the lines found so far as all there are
+  publish(index, lines, pos, recorded, 1);
+  free(buffer);
+  return NULL;
+}
+
+LineIndex *line_index_start(int fd, const char *text, size_t size) {
+  LineIndex *index = calloc(1, sizeof(LineIndex));
+  if (!index)
+    return NULL;
+  index->fd = fd;
+  index->text = text;
+  index->size = size;
+  index->complete = size == 0;
+
+  size_t most_recorded = size / LINE_INDEX_STRIDE + 1;
+  index->block_count = most_recorded / LINE_INDEX_BLOCK + 1;
+  index->blocks = calloc(index->block_count, sizeof(size_t *));
+  if (!index->blocks) {
+    free(index);
+    return NULL;
+  }
+
+  atomic_init(&index->stopping, 0);
+  pthread_mutex_init(&index->lock, NULL);
+  if (pthread_create(&index->thread, NULL, index_lines, index) != 0) {
+    pthread_mutex_destroy(&index->lock);
+    free(index->blocks);
+    free(index);
+    return NULL;
+  }
+  return index;
+}
+
+void line_index_stop(LineIndex *index) {
+  if (!index)
+    return;
+
+  atomic_store(&index->stopping, 1);
+  pthread_join(index->thread, NULL);
+  for (size_t i = 0; i < index->block_count; i++)
+    free(index->blocks[i]);
+  free(index->blocks);
+  pthread_mutex_destroy(&index->lock);
+  free(index);
+}
+
+int line_index_progress(LineIndex *index, size_t *lines, size_t *scanned) {
+  pthread_mutex_lock(&index->lock);
+  *lines = index->lines;
+  *scanned = index->scanned;
+  int complete = index->complete;
+  pthread_mutex_unlock(&index->lock);
+  return complete;
+}
+
+// Offset after skipping count newlines from offset
+static size_t skip_lines(const LineIndex *index, size_t offset, size_t count) {
+  while (count-- > 0) {
+    const char *newline =
+        memchr(index->text + offset, '\n', index->size - offset);
+    if (!newline)
+      return index->size;
+    offset = (size_t)(newline - index->text) + 1;
+  }
+  return offset;
+}
+
+size_t line_index_offset(LineIndex *index, size_t line) {
+  size_t n = line / LINE_INDEX_STRIDE;
+  pthread_mutex_lock(&index->lock);
+  size_t recorded = index->recorded;
+  pthread_mutex_unlock(&index->lock);
+  if (recorded == 0)
+    return 0;
+  if (n >= recorded)
+    n = recorded - 1;
+
+  return skip_lines(index, recorded_offset(index, n),
+                    line - n * LINE_INDEX_STRIDE);
+}
+
+size_t line_index_line_at(LineIndex *index, size_t offset) {
+  pthread_mutex_lock(&index->lock);
+  size_t recorded = index->recorded;
+  pthread_mutex_unlock(&index->lock);
+  if (recorded == 0)
+    return 0;
+
+  // Last recorded line starting at or before offset
+  size_t low = 0;
+  size_t high = recorded;
+  while (high - low > 1) {
+    size_t mid = low + (high - low) / 2;
+    if (recorded_offset(index, mid) <= offset)
+      low = mid;
+    else
+      high = mid;
+  }
+
+  size_t line = low * LINE_INDEX_STRIDE;
+  size_t pos = recorded_offset(index, low);
+  const char *newline;
+  while (pos < offset &&
+         (newline = memchr(index->text + pos, '\n', offset - pos)) != NULL) {
+    pos = (size_t)(newline - index->text) + 1;
+    line++;
+  }
+  return line;
+}
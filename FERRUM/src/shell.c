@@ -1,18 +1,26 @@
+#define _GNU_SOURCE
 
 #include "shell.h"
 #include "aliases.h" // Added for alias support
 #include "autocorrect.h"
 #include "bookmarks.h" // Added for bookmark support
 #include "builtins.h"
+#include "command_parser.h"
+#include "command_registry.h"
 #include "countdown_timer.h"
+#include "event_loop.h"
 #include "favorite_cities.h"
 #include "filters.h"
 #include "git_integration.h" // Added for Git repository detection
 #include "line_reader.h"
+#include "loc.h"
+#include "pipeline.h"
 #include "persistent_history.h"
+#include "ps_command.h"
 #include "structured_data.h"
 #include "tab_complete.h" // Added for tab completion support
 #include "themes.h"
+#include <errno.h>
 #include <stdio.h>
 #include <time.h> // Added for time functions
 #include <termios.h>
@@ -27,6 +35,8 @@ static int g_status_line = 0;
 static int g_normal_attributes = 7; // Default white on black
 static int g_status_attributes = 12; // Red
 static int g_status_bar_enabled = 0; // Flag to track if status bar is enabled
+static char g_status_git_info[LSH_RL_BUFSIZE] = {0}; // Shown by the clock
+static int g_clock_timer = -1; // Redraws the status bar clock every second
 static struct termios g_orig_termios; // Original terminal settings
 
 int init_terminal(struct termios *orig_termios) {
@@ -131,6 +141,16 @@ void ensure_status_bar_space(int fd) {
     fflush(stdout);
 }
 
+static void on_console_resize(void *data) {
+    (void)data;
+    check_console_resize(STDOUT_FILENO);
+}
+
+static void redraw_status_clock(void *data) {
+    (void)data;
+    update_status_bar(STDOUT_FILENO, g_status_git_info);
+}
+
 int init_status_bar(int fd) {
     int width, height;
     if (!get_console_dimensions(fd, &width, &height)) {
@@ -141,6 +161,17 @@ int init_status_bar(int fd) {
     g_status_line = height;
     g_status_bar_enabled = 1;
     
+    // Follow resizes and tick the clock from the event loop, so both only
+    // run while the prompt waits for input
+    if (g_clock_timer == -1) {
+        event_signal(SIGWINCH, on_console_resize, NULL);
+        g_clock_timer = event_timer(redraw_status_clock, NULL);
+        
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        event_timer_arm(g_clock_timer, 1000 - now.tv_nsec / 1000000, 1000);
+    }
+    
     // Clear status line
     printf(ANSI_SAVE_CURSOR);
     printf("\033[%d;1H", height);
@@ -182,6 +213,11 @@ void update_status_bar(int fd, const char *git_info) {
     g_console_width = width;
     g_status_line = height;
     
+    if (git_info != g_status_git_info) {
+        snprintf(g_status_git_info, sizeof(g_status_git_info), "%s",
+                 git_info ? git_info : "");
+    }
+    
     // Get current time for status bar
     time_t rawtime;
     struct tm *timeinfo;
@@ -409,226 +445,22 @@ TableData* create_ls_table(char **args) {
     return table;
 }
 
-char*** lsh_split_commands(char *line) {
-    char **cmd_groups = NULL;
-    char *cmd_group, *saveptr0;
-    int group_count = 0, group_capacity = 10;
-    char ***commands = NULL;
-    char **command = NULL;
-    char *cmd_str, *token, *saveptr1, *saveptr2;
-    int cmd_count = 0, cmd_capacity = 10;
-    int token_count = 0, token_capacity = 10;
-
-
-    // Allocate initial command groups array
-    cmd_groups = malloc(group_capacity * sizeof(char*));
-    if (!cmd_groups) {
-        perror("lsh: allocation error");
-        return NULL;
-    }
-
-    // Split by && symbol
-    cmd_group = strtok_r(line, "&&", &saveptr0);
-    while (cmd_group != NULL) {
-        // Trim whitespace
-        while (*cmd_group && isspace(*cmd_group)) cmd_group++;
-        cmd_groups[group_count] = strdup(cmd_group);
-        group_count++;
-
-        if (group_count >= group_capacity - 1) {
-            group_capacity *= 2;
-            cmd_groups = realloc(cmd_groups, group_capacity * sizeof(char*));
-            if (!cmd_groups) {
-                perror("lsh: allocation error");
-                return NULL;
-            }
-        }
-        cmd_group = strtok_r(NULL, "&&", &saveptr0);
-    }
-    cmd_groups[group_count] = NULL;
-
-    char *current_cmd = cmd_groups[0];
-    
-    // Allocate initial commands array
-    commands = malloc(cmd_capacity * sizeof(char**));
-    if (!commands) {
-        perror("lsh: allocation error");
-        for (int i = 0; i < group_count; i++) {
-            free(cmd_groups[i]);
-        }
-        free(cmd_groups);
-        return NULL;
-    }
-    
-    // Split by pipe symbol '|'
-    cmd_str = strtok_r(current_cmd, "|", &saveptr1);
-    while (cmd_str != NULL) {
-        // Trim whitespace
-        while (*cmd_str && isspace(*cmd_str)) cmd_str++;
-        
-        // Allocate command token array
-        command = malloc(token_capacity * sizeof(char*));
-        if (!command) {
-            perror("lsh: allocation error");
-            // Free previous allocations
-            for (int i = 0; i < cmd_count; i++) {
-                for (int j = 0; commands[i][j] != NULL; j++) {
-                    free(commands[i][j]);
-                }
-                free(commands[i]);
-            }
-            free(commands);
-            for (int i = 0; i < group_count; i++) {
-                free(cmd_groups[i]);
-            }
-            free(cmd_groups);
-            return NULL;
-        }
-        
-        // Split command into tokens
-        token_count = 0;
-        token = strtok_r(cmd_str, " \t\r\n\a", &saveptr2);
-        while (token != NULL) {
-            // Check if we need to resize tokens array
-            if (token_count >= token_capacity - 1) {
-                token_capacity *= 2;
-                command = realloc(command, token_capacity * sizeof(char*));
-                if (!command) {
-                    perror("lsh: allocation error");
-                    // Free previous allocations
-                    for (int i = 0; i < cmd_count; i++) {
-                        for (int j = 0; commands[i][j] != NULL; j++) {
-                            free(commands[i][j]);
-                        }
-                        free(commands[i]);
-                    }
-                    free(commands);
-                    return NULL;
-                }
-            }
-            
-            command[token_count] = strdup(token);
-            token_count++;
-            token = strtok_r(NULL, " \t\r\n\a", &saveptr2);
-        }
-        command[token_count] = NULL; // Null-terminate the tokens array
-        
-        // Check if we need to resize commands array
-        if (cmd_count >= cmd_capacity - 1) {
-            cmd_capacity *= 2;
-            commands = realloc(commands, cmd_capacity * sizeof(char**));
-            if (!commands) {
-                perror("lsh: allocation error");
-                return NULL;
-            }
-        }
-        
-        commands[cmd_count] = command;
-        cmd_count++;
-        cmd_str = strtok_r(NULL, "|", &saveptr1);
-    }
-    
-    commands[cmd_count] = NULL; // Null-terminate the commands array
-    
-    // Store the remaining command groups in the last position (if any)
-    if (group_count > 1) {
-        // Create a special command array for the command groups marker
-        char **marker = malloc(sizeof(char*) * 2);
-        if (!marker) {
-            perror("lsh: allocation error");
-            for (int i = 0; i < group_count; i++) {
-                free(cmd_groups[i]);
-            }
-            free(cmd_groups);
-            return NULL;
-        }
-        marker[0] = strdup("&&_COMMAND_GROUPS");
-        marker[1] = NULL;
-        
-        // Create a special command array for the remaining groups
-        char **cmd_group_array = malloc(sizeof(char*) * group_count);
-        if (!cmd_group_array) {
-            perror("lsh: allocation error");
-            free(marker[0]);
-            free(marker);
-            for (int i = 0; i < group_count; i++) {
-                free(cmd_groups[i]);
-            }
-            free(cmd_groups);
-            return NULL;
-        }
-        
-        // Copy all remaining command groups
-        for (int i = 1; i < group_count; i++) {
-            cmd_group_array[i-1] = strdup(cmd_groups[i]);
-        }
-        cmd_group_array[group_count-1] = NULL;
-        
-        // Allocate space for cmd_count + 2 commands
-        // (original commands + cmd_group_array + marker)
-        char ***new_commands = malloc((cmd_count + 3) * sizeof(char**));
-        if (!new_commands) {
-            perror("lsh: allocation error");
-            for (int i = 0; cmd_group_array[i] != NULL; i++) {
-                free(cmd_group_array[i]);
-            }
-            free(cmd_group_array);
-            free(marker[0]);
-            free(marker);
-            for (int i = 0; i < group_count; i++) {
-                free(cmd_groups[i]);
-            }
-            free(cmd_groups);
-            return NULL;
-        }
-        
-        // Copy original commands
-        for (int i = 0; i < cmd_count; i++) {
-            new_commands[i] = commands[i];
-        }
-        
-        // Add the command groups and marker
-        new_commands[cmd_count] = cmd_group_array;
-        new_commands[cmd_count+1] = marker;
-        new_commands[cmd_count+2] = NULL;
-        
-        // Free the old commands array but not its contents
-        free(commands);
-        commands = new_commands;
-    }
-    
-    // Free the command groups array
-    for (int i = 0; i < group_count; i++) {
-        free(cmd_groups[i]);
-    }
-    free(cmd_groups);
-    
-    return commands;
-}
-
 int lsh_launch(char **args) {
     pid_t pid, wpid;
     int status;
     
-    // Fork a child process
-    pid = fork();
-    
-    if (pid == 0) {
-        // Child process
-        if (execvp(args[0], args) == -1) {
-            perror("lsh");
-        }
-        exit(EXIT_FAILURE);
-    } else if (pid < 0) {
-        // Error forking
-        perror("lsh");
-    } else {
-        // Parent process
-        do {
-            wpid = waitpid(pid, &status, WUNTRACED);
-        } while (!WIFEXITED(status) && !WIFSIGNALED(status));
+    int err = spawn_command(&pid, args, NULL);
+    if (err != 0) {
+        fprintf(stderr, "lsh: %s: %s\n", args[0], strerror(err));
+        last_exit_status = err == ENOENT ? 127 : 126;
+        return 1;
     }
     
+    do {
+        wpid = waitpid(pid, &status, WUNTRACED);
+    } while (wpid != -1 && !WIFEXITED(status) && !WIFSIGNALED(status));
+    
+    last_exit_status = wpid == -1 ? 1 : wait_exit_status(status);
     return 1;
 }
 
@@ -639,10 +471,10 @@ int lsh_execute(char **args) {
     }
     
     // Check if it's a built-in command
-    for (int i = 0; i < lsh_num_builtins(); i++) {
-        if (strcmp(args[0], builtin_str[i]) == 0) {
-            return (*builtin_func[i])(args);
-        }
+    const CommandInfo *builtin = command_builtin(args[0]);
+    if (builtin != NULL) {
+        last_exit_status = 0;
+        return builtin->func(args);
     }
     
     // If not a built-in, check aliases and launch external
@@ -660,6 +492,49 @@ int lsh_execute(char **args) {
     return lsh_launch(args);
 }
 
+static int find_filter(const char *name) {
+    for (int j = 0; j < filter_count; j++) {
+        if (strcmp(name, filter_str[j]) == 0) {
+            return j;
+        }
+    }
+    return -1;
+}
+
+// Apply the filters after the first pipeline stage to table, then print it
+static int run_table_filters(TableData *table, char ***commands) {
+    for (int i = 1; commands[i] != NULL; i++) {
+        // Find the filter command
+        char *filter_cmd = commands[i][0];
+        int filter_idx = find_filter(filter_cmd);
+        
+        if (filter_idx == -1) {
+            fprintf(stderr, "lsh: unknown filter command: %s\n", filter_cmd);
+            free_table(table);
+            last_exit_status = 1;
+            return 1;
+        }
+        
+        // Apply the filter
+        TableData *filtered_table = filter_func[filter_idx](table, &commands[i][1]);
+        free_table(table); // Free the old table
+        
+        if (!filtered_table) {
+            last_exit_status = 1;
+            return 1; // Error already printed
+        }
+        
+        table = filtered_table;
+    }
+    
+    // Print the final table
+    print_table(table);
+    free_table(table);
+    
+    last_exit_status = 0;
+    return 1;
+}
+
 int lsh_execute_piped(char ***commands) {
     // Count the number of commands in the pipeline
     int cmd_count = 0;
@@ -676,44 +551,36 @@ int lsh_execute_piped(char ***commands) {
         // Create a table from ls command
         TableData *table = create_ls_table(commands[0]);
         if (!table) {
+            last_exit_status = 1;
             return 1; // Error already printed
         }
         
-        // Apply filters from the pipeline
-        for (int i = 1; commands[i] != NULL; i++) {
-            // Find the filter command
-            char *filter_cmd = commands[i][0];
-            int filter_idx = -1;
-            
-            for (int j = 0; j < filter_count; j++) {
-                if (strcmp(filter_cmd, filter_str[j]) == 0) {
-                    filter_idx = j;
-                    break;
-                }
-            }
-            
-            if (filter_idx == -1) {
-                fprintf(stderr, "lsh: unknown filter command: %s\n", filter_cmd);
-                free_table(table);
-                return 1;
-            }
-            
-            // Apply the filter
-            TableData *filtered_table = filter_func[filter_idx](table, &commands[i][1]);
-            free_table(table); // Free the old table
-            
-            if (!filtered_table) {
-                return 1; // Error already printed
-            }
-            
-            table = filtered_table;
+        return run_table_filters(table, commands);
+    }
+    
+    // ps feeding table filters reads /proc itself instead of running ps,
+    // computing only the columns the filters refer to
+    if (cmd_count > 1 && strcmp(commands[0][0], "ps") == 0 &&
+        find_filter(commands[1][0]) != -1) {
+        TableData *table = ps_table(ps_pipeline_columns(commands));
+        if (!table) {
+            last_exit_status = 1;
+            return 1; // Error already printed
         }
         
-        // Print the final table
-        print_table(table);
-        free_table(table);
+        return run_table_filters(table, commands);
+    }
+    
+    // loc feeding table filters hands them its per-language table
+    if (cmd_count > 1 && strcmp(commands[0][0], "loc") == 0 &&
+        find_filter(commands[1][0]) != -1) {
+        TableData *table = loc_table(commands[0]);
+        if (!table) {
+            last_exit_status = 1;
+            return 1; // Error already printed
+        }
         
-        return 1;
+        return run_table_filters(table, commands);
     }
     
     if (cmd_count == 1) {
@@ -721,79 +588,60 @@ int lsh_execute_piped(char ***commands) {
         return lsh_execute(commands[0]);
     }
     
-    // Create pipes
-    int pipes[cmd_count - 1][2];
-    for (int i = 0; i < cmd_count - 1; i++) {
-        if (pipe(pipes[i]) == -1) {
-            perror("pipe");
-            return 1;
-        }
+    // Builtins that can stream run on threads; everything else is spawned
+    return run_pipeline(commands);
+}
+
+// Run one pipeline of a parsed line. A lone command goes through
+// autocorrection; it can also be an ls or ps table without filters.
+static int run_parsed_pipeline(ParsedPipeline *pipeline) {
+    if (pipeline->count > 1) {
+        return lsh_execute_piped(pipeline->commands);
     }
     
-    // Create processes
-    pid_t pids[cmd_count];
-    for (int i = 0; i < cmd_count; i++) {
-        pids[i] = fork();
-        
-        if (pids[i] == -1) {
-            perror("fork");
-            return 1;
-        } else if (pids[i] == 0) {
-            // Child process
-            
-            // Set up input from previous pipe
-            if (i > 0) {
-                if (dup2(pipes[i - 1][0], STDIN_FILENO) == -1) {
-                    perror("dup2");
-                    exit(EXIT_FAILURE);
-                }
-            }
-            
-            // Set up output to next pipe
-            if (i < cmd_count - 1) {
-                if (dup2(pipes[i][1], STDOUT_FILENO) == -1) {
-                    perror("dup2");
-                    exit(EXIT_FAILURE);
-                }
-            }
-            
-            // Close all pipe fds
-            for (int j = 0; j < cmd_count - 1; j++) {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
-            }
-            
-            // Execute the command
-            if (execvp(commands[i][0], commands[i]) == -1) {
-                perror("execvp");
-                exit(EXIT_FAILURE);
-            }
-        }
-    }
+    char **args = pipeline->commands[0];
     
-    // Parent process closes all pipe fds
-    for (int i = 0; i < cmd_count - 1; i++) {
-        close(pipes[i][0]);
-        close(pipes[i][1]);
+    // Check for corrections before executing
+    char **corrected_args = check_for_corrections(args);
+    if (corrected_args == NULL) {
+        return lsh_execute(args);
     }
     
-    // Wait for all children
-    for (int i = 0; i < cmd_count; i++) {
-        int status;
-        waitpid(pids[i], &status, 0);
+    int status = lsh_execute(corrected_args);
+    for (int i = 0; corrected_args[i] != NULL; i++) {
+        free(corrected_args[i]);
     }
-    
-    return 1;
+    free(corrected_args);
+    return status;
 }
 
-void free_commands(char ***commands) {
-    for (int i = 0; commands[i] != NULL; i++) {
-        for (int j = 0; commands[i][j] != NULL; j++) {
-            free(commands[i][j]);
+int lsh_run_line(const char *line) {
+    // Everything the parser builds lives in one arena, freed when the line
+    // has run
+    Arena arena = {0};
+    ParsedPipeline *pipelines;
+    const char *error;
+    
+    if (!parse_command_line(&arena, line, &pipelines, &error)) {
+        fprintf(stderr, "lsh: syntax error: %s\n", error);
+        arena_free(&arena);
+        last_exit_status = 2;
+        return 1;
+    }
+    
+    int status = 1;
+    for (ParsedPipeline *pipeline = pipelines; pipeline && status;
+         pipeline = pipeline->next) {
+        // A skipped pipeline leaves the status for the next operator to test
+        if ((pipeline->condition == RUN_IF_SUCCESS && last_exit_status != 0) ||
+            (pipeline->condition == RUN_IF_FAILURE && last_exit_status == 0)) {
+            continue;
         }
-        free(commands[i]);
+        status = run_parsed_pipeline(pipeline);
     }
-    free(commands);
+    
+    arena_free(&arena);
+    return status;
 }
 
 void display_welcome_banner(void) {
@@ -808,8 +656,6 @@ void display_welcome_banner(void) {
 
 void lsh_loop(void) {
     char *line;
-    char **args;
-    char ***commands = NULL;
     int status = 1;
     char git_info[LSH_RL_BUFSIZE] = {0};
     int terminal_fd;
@@ -834,9 +680,6 @@ void lsh_loop(void) {
     display_welcome_banner();
     
     do {
-        // Check for console resize
-        check_console_resize(STDOUT_FILENO);
-        
         // Get Git status for current directory
         // If git_status() returns null, git_info[0] will remain 0
         char *git_status_info = get_git_status();
@@ -865,135 +708,7 @@ void lsh_loop(void) {
         // Add line to persistent history
         add_to_history(line);
         
-        // Check for pipes or && and parse into multiple commands if present
-        if (strchr(line, '|') != NULL || strchr(line, '&') != NULL) {
-            commands = lsh_split_commands(line);
-            
-            // Find if there are command groups (&&)
-            int has_cmd_groups = 0;
-            char **remaining_cmd_groups = NULL;
-            char **marker = NULL;
-            int cmd_count = 0;
-            
-            // Count commands and check for the special command groups marker
-            while (commands[cmd_count] != NULL) {
-                cmd_count++;
-            }
-            
-            // We need at least 2 positions for command groups:
-            // 1. The groups themselves
-            // 2. The marker with "&&_COMMAND_GROUPS"
-            if (cmd_count > 1) {
-                // Get the last non-null command
-                marker = commands[cmd_count-1];
-                
-                // Check if it's the marker
-                if (marker != NULL && marker[0] != NULL && 
-                    strcmp(marker[0], "&&_COMMAND_GROUPS") == 0) {
-                    
-                    has_cmd_groups = 1;
-                    
-                    // Get the command groups from the previous position
-                    remaining_cmd_groups = commands[cmd_count-2];
-                    
-                    // Set these positions to NULL so they don't get processed
-                    // as regular commands
-                    commands[cmd_count-1] = NULL;
-                    commands[cmd_count-2] = NULL;
-                }
-            }
-            
-            // Execute the first command or pipeline
-            status = lsh_execute_piped(commands);
-            
-            // If successful and we have command groups, execute them sequentially
-            if (status && has_cmd_groups && remaining_cmd_groups != NULL) {
-                for (int i = 0; remaining_cmd_groups[i] != NULL; i++) {
-                    char *cmd_group = remaining_cmd_groups[i];
-                    
-                    // Parse this command group
-                    char *cmd_copy = strdup(cmd_group);
-                    
-                    // Check if it contains pipes
-                    if (strchr(cmd_copy, '|') != NULL) {
-                        char ***cmd_commands = lsh_split_commands(cmd_copy);
-                        if (cmd_commands) {
-                            status = lsh_execute_piped(cmd_commands);
-                            free_commands(cmd_commands);
-                        }
-                    } else {
-                        // Simple command without pipes
-                        char **args = lsh_split_line(cmd_copy);
-                        
-                        // Check for corrections before executing
-                        char **corrected_args = check_for_corrections(args);
-                        if (corrected_args != NULL) {
-                            for (int j = 0; args[j] != NULL; j++) {
-                                free(args[j]);
-                            }
-                            free(args);
-                            args = corrected_args;
-                        }
-                        
-                        // Execute command
-                        status = lsh_execute(args);
-                        
-                        // Free allocated memory
-                        for (int j = 0; args[j] != NULL; j++) {
-                            free(args[j]);
-                        }
-                        free(args);
-                    }
-                    
-                    free(cmd_copy);
-                    
-                    // If a command failed, stop execution
-                    if (!status) {
-                        break;
-                    }
-                }
-            }
-            
-            // Clean up marker and command groups if they exist
-            if (has_cmd_groups && marker) {
-                // Free marker
-                if (marker[0]) free(marker[0]);
-                free(marker);
-                
-                // Free command groups
-                if (remaining_cmd_groups) {
-                    for (int i = 0; remaining_cmd_groups[i] != NULL; i++) {
-                        free(remaining_cmd_groups[i]);
-                    }
-                    free(remaining_cmd_groups);
-                }
-            }
-            
-            free_commands(commands);
-        } else {
-            // Normal command parsing
-            args = lsh_split_line(line);
-            
-            // Check for corrections before executing
-            char **corrected_args = check_for_corrections(args);
-            if (corrected_args != NULL) {
-                // Free the original args
-                for (int i = 0; args[i] != NULL; i++) {
-                    free(args[i]);
-                }
-                free(args);
-                args = corrected_args;
-            }
-            
-            // Execute command
-            status = lsh_execute(args);
-            
-            // Free allocated memory
-            for (int i = 0; args[i] != NULL; i++) {
-                free(args[i]);
-            }
-            free(args);
-        }
+        status = lsh_run_line(line);
         
         free(line);
     } while (status);
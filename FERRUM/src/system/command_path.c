@@ -0,0 +1,230 @@
+#define _GNU_SOURCE
+#include "command_path.h"
+#include "common.h"
+
+#define DEFAULT_PATH "/bin:/usr/bin" // What execvp searches without PATH
+#define RECHECK_NS 1000000000LL     // Directory mtimes are re-read this often
+
+typedef struct {
+  char *name; // NULL marks an empty slot
+  char *path; // NULL when no directory in PATH has the command
+} PathEntry;
+
+typedef struct {
+  char *dir;
+  struct timespec mtime; // Zero when the directory cannot be read
+} PathDir;
+
+static struct {
+  PathEntry *slots;
+  size_t capacity; // Power of two
+  size_t count;
+  char *path_env; // PATH the entries were resolved against
+  PathDir *dirs;
+  int dir_count;
+  int relative;            // PATH has a relative directory; nothing is kept
+  struct timespec checked; // Monotonic time mtimes were last read
+} cache;
+
+static size_t hash_name(const char *name) {
+  size_t hash = 14695981039346656037ULL;
+  for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+    hash ^= *p;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+void command_path_clear(void) {
+  for (size_t i = 0; i < cache.capacity; i++) {
+    free(cache.slots[i].name);
+    free(cache.slots[i].path);
+    cache.slots[i].name = NULL;
+    cache.slots[i].path = NULL;
+  }
+  cache.count = 0;
+}
+
+static void read_mtime(const char *dir, struct timespec *mtime) {
+  struct stat st;
+  if (stat(dir, &st) == 0) {
+    *mtime = st.st_mtim;
+  } else {
+    mtime->tv_sec = 0;
+    mtime->tv_nsec = 0;
+  }
+}
+
+static void free_dirs(void) {
+  for (int i = 0; i < cache.dir_count; i++)
+    free(cache.dirs[i].dir);
+  free(cache.dirs);
+  free(cache.path_env);
+  cache.dirs = NULL;
+  cache.dir_count = 0;
+  cache.path_env = NULL;
+}
+
+// Split PATH into its directories and note when each last changed
+static int load_path(const char *path_env) {
+  free_dirs();
+  cache.relative = 0;
+
+  int count = 1;
+  for (const char *p = path_env; *p; p++)
+    count += *p == ':';
+
+  cache.path_env = strdup(path_env);
+  cache.dirs = calloc((size_t)count, sizeof(PathDir));
+  if (!cache.path_env || !cache.dirs) {
+    free_dirs();
+    return 0;
+  }
+
+  const char *start = path_env;
+  for (int i = 0; i < count; i++) {
+    const char *end = strchrnul(start, ':');
+    // An empty entry means the current directory, as it does for execvp
+    PathDir *dir = &cache.dirs[cache.dir_count];
+    dir->dir = end > start ? strndup(start, (size_t)(end - start)) : strdup(".");
+    if (!dir->dir) {
+      free_dirs();
+      return 0;
+    }
+    if (dir->dir[0] != '/')
+      cache.relative = 1;
+    read_mtime(dir->dir, &dir->mtime);
+    cache.dir_count++;
+    start = end + 1;
+  }
+  return 1;
+}
+
+// Start over when PATH was changed, and forget every result once a
+// directory in it has gained or lost a file
+static int revalidate(void) {
+  const char *path_env = getenv("PATH");
+  if (!path_env)
+    path_env = DEFAULT_PATH;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  if (!cache.path_env || strcmp(cache.path_env, path_env) != 0) {
+    command_path_clear();
+    cache.checked = now;
+    return load_path(path_env);
+  }
+
+  long long since = (now.tv_sec - cache.checked.tv_sec) * 1000000000LL +
+                    (now.tv_nsec - cache.checked.tv_nsec);
+  if (since < RECHECK_NS)
+    return 1;
+  cache.checked = now;
+
+  int changed = 0;
+  for (int i = 0; i < cache.dir_count; i++) {
+    struct timespec mtime;
+    read_mtime(cache.dirs[i].dir, &mtime);
+    if (mtime.tv_sec != cache.dirs[i].mtime.tv_sec ||
+        mtime.tv_nsec != cache.dirs[i].mtime.tv_nsec) {
+      cache.dirs[i].mtime = mtime;
+      changed = 1;
+    }
+  }
+  if (changed)
+    command_path_clear();
+  return 1;
+}
+
+static int search_path(const char *name, char *out, size_t size) {
+  for (int i = 0; i < cache.dir_count; i++) {
+    int length = snprintf(out, size, "%s/%s", cache.dirs[i].dir, name);
+    if (length < 0 || (size_t)length >= size)
+      continue;
+
+    struct stat st;
+    if (access(out, X_OK) == 0 && stat(out, &st) == 0 && S_ISREG(st.st_mode))
+      return 1;
+  }
+  return 0;
+}
+
+static PathEntry *find_slot(const char *name) {
+  size_t mask = cache.capacity - 1;
+  for (size_t i = hash_name(name) & mask;; i = (i + 1) & mask) {
+    PathEntry *entry = &cache.slots[i];
+    if (!entry->name || strcmp(entry->name, name) == 0)
+      return entry;
+  }
+}
+
+static int grow_table(void) {
+  size_t capacity = cache.capacity ? cache.capacity * 2 : 64;
+  PathEntry *slots = calloc(capacity, sizeof(PathEntry));
+  if (!slots)
+    return 0;
+
+  PathEntry *old = cache.slots;
+  size_t old_capacity = cache.capacity;
+  cache.slots = slots;
+  cache.capacity = capacity;
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old[i].name)
+      *find_slot(old[i].name) = old[i];
+  }
+  free(old);
+  return 1;
+}
+
+static void remember(const char *name, const char *path) {
+  if ((cache.count + 1) * 10 > cache.capacity * 7 && !grow_table())
+    return;
+
+  PathEntry *entry = find_slot(name);
+  entry->name = strdup(name);
+  entry->path = path ? strdup(path) : NULL;
+  if (!entry->name || (path && !entry->path)) {
+    free(entry->name);
+    free(entry->path);
+    entry->name = NULL;
+    entry->path = NULL;
+    return;
+  }
+  cache.count++;
+}
+
+int command_path_resolve(const char *name, char *out, size_t size) {
+  if (!name || !*name)
+    return 0;
+
+  if (strchr(name, '/')) {
+    int length = snprintf(out, size, "%s", name);
+    return length >= 0 && (size_t)length < size;
+  }
+
+  if (!revalidate())
+    return 0;
+
+  if (cache.capacity) {
+    PathEntry *entry = find_slot(name);
+    if (entry->name) {
+      if (!entry->path)
+        return 0;
+      int length = snprintf(out, size, "%s", entry->path);
+      return length >= 0 && (size_t)length < size;
+    }
+  }
+
+  char path[PATH_MAX];
+  int found = search_path(name, path, sizeof(path));
+
+  // What a relative directory holds changes with the working directory
+  if (!cache.relative)
+    remember(name, found ? path : NULL);
+
+  if (!found)
+    return 0;
+  int length = snprintf(out, size, "%s", path);
+  return length >= 0 && (size_t)length < size;
+}
@@ -0,0 +1,346 @@
+#define _GNU_SOURCE
+#include "dir_cache.h"
+#include "common.h"
+#include "event_loop.h"
+#include <dirent.h>
+#include <strings.h>
+#include <sys/inotify.h>
+
+#define DIR_CACHE_SIZE 32 // Listings kept; the least recently used goes
+#define HOT_USES 2        // Uses before a directory is watched
+#define WATCH_EVENTS                                                        \
+  (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF |    \
+   IN_MOVE_SELF | IN_ONLYDIR)
+
+typedef struct {
+  char *path; // NULL marks an empty slot
+  dev_t dev;
+  ino_t ino;
+  struct timespec mtime;
+  int fresh; // The listing matches the directory as far as is known
+  int watch; // inotify watch descriptor, 0 when not watched
+  int uses;
+  unsigned long last_used;
+  DirEntry *entries;
+  int count;
+  char *names;              // Every entry's name, one after another
+  unsigned long generation; // Listings read before and including this one
+} CachedDir;
+
+static struct {
+  CachedDir dirs[DIR_CACHE_SIZE];
+  unsigned long clock;
+  unsigned long generation; // Listings read so far
+  char *cwd;
+  int inotify_fd; // 0 until created, -1 when inotify is unavailable
+} cache;
+
+static void forget_listing(CachedDir *dir) {
+  free(dir->entries);
+  free(dir->names);
+  dir->entries = NULL;
+  dir->names = NULL;
+  dir->count = 0;
+  dir->fresh = 0;
+}
+
+// Two paths to one directory share its watch descriptor
+static void unwatch(CachedDir *dir) {
+  if (!dir->watch)
+    return;
+
+  int shared = 0;
+  for (int i = 0; i < DIR_CACHE_SIZE; i++) {
+    if (&cache.dirs[i] != dir && cache.dirs[i].watch == dir->watch)
+      shared = 1;
+  }
+  if (!shared)
+    inotify_rm_watch(cache.inotify_fd, dir->watch);
+  dir->watch = 0;
+}
+
+static void drop(CachedDir *dir) {
+  unwatch(dir);
+  forget_listing(dir);
+  free(dir->path);
+  memset(dir, 0, sizeof(*dir));
+}
+
+static void mark_changed(int watch, uint32_t mask) {
+  for (int i = 0; i < DIR_CACHE_SIZE; i++) {
+    CachedDir *dir = &cache.dirs[i];
+    if (!dir->watch || (watch != -1 && dir->watch != watch))
+      continue;
+    dir->fresh = 0;
+    // The path may now name another directory, which needs its own watch
+    if (mask & IN_IGNORED)
+      dir->watch = 0;
+    else if (mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+      unwatch(dir);
+  }
+}
+
+static void read_changes(void *data) {
+  (void)data;
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t length;
+
+  while ((length = read(cache.inotify_fd, buffer, sizeof(buffer))) > 0) {
+    for (char *p = buffer; p < buffer + length;) {
+      struct inotify_event *event = (struct inotify_event *)p;
+      // An overflowed queue may have lost changes to any directory
+      mark_changed(event->mask & IN_Q_OVERFLOW ? -1 : event->wd, event->mask);
+      p += sizeof(*event) + event->len;
+    }
+  }
+}
+
+static void start_watch(CachedDir *dir) {
+  if (cache.inotify_fd == 0) {
+    cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (cache.inotify_fd != -1 &&
+        !event_watch(cache.inotify_fd, read_changes, NULL)) {
+      close(cache.inotify_fd);
+      cache.inotify_fd = -1;
+    }
+  }
+  if (cache.inotify_fd == -1)
+    return;
+
+  int watch = inotify_add_watch(cache.inotify_fd, dir->path, WATCH_EVENTS);
+  if (watch != -1)
+    dir->watch = watch;
+}
+
+static int entry_order(const void *a, const void *b) {
+  const DirEntry *left = a;
+  const DirEntry *right = b;
+  int order = strcasecmp(left->name, right->name);
+  return order ? order : strcmp(left->name, right->name);
+}
+
+static unsigned char entry_type(DIR *dir, const struct dirent *entry) {
+  if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK)
+    return entry->d_type;
+
+  struct stat st;
+  if (fstatat(dirfd(dir), entry->d_name, &st, 0) == -1)
+    return DT_UNKNOWN;
+  return IFTODT(st.st_mode);
+}
+
+static int read_listing(CachedDir *cached) {
+  DIR *dir = opendir(cached->path);
+  if (!dir)
+    return 0;
+
+  // Taken before reading, so a change made meanwhile shows as a newer mtime
+  struct stat st;
+  if (fstat(dirfd(dir), &st) == -1) {
+    closedir(dir);
+    return 0;
+  }
+
+  size_t names_len = 0;
+  size_t names_cap = 4096;
+  int capacity = 64;
+  char *names = malloc(names_cap);
+  DirEntry *entries = malloc(capacity * sizeof(DirEntry));
+  size_t *offsets = malloc(capacity * sizeof(size_t));
+  int count = 0;
+  int ok = names && entries && offsets;
+
+  struct dirent *entry;
+  while (ok && (entry = readdir(dir)) != NULL) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+      continue;
+
+    size_t length = strlen(entry->d_name) + 1;
+    if (names_len + length > names_cap) {
+      while (names_len + length > names_cap)
+        names_cap *= 2;
+      char *grown = realloc(names, names_cap);
+      ok = grown != NULL;
+      if (!ok)
+        break;
+      names = grown;
+    }
+    if (count == capacity) {
+      capacity *= 2;
+      DirEntry *grown_entries = realloc(entries, capacity * sizeof(DirEntry));
+      if (grown_entries)
+        entries = grown_entries;
+      size_t *grown_offsets = realloc(offsets, capacity * sizeof(size_t));
+      if (grown_offsets)
+        offsets = grown_offsets;
+      ok = grown_entries && grown_offsets;
+      if (!ok)
+        break;
+    }
+
+    memcpy(names + names_len, entry->d_name, length);
+    offsets[count] = names_len;
+    entries[count].type = entry_type(dir, entry);
+    names_len += length;
+    count++;
+  }
+  closedir(dir);
+
+  if (!ok) {
+    free(names);
+    free(entries);
+    free(offsets);
+    return 0;
+  }
+
+  // Names only stop moving once they are all read
+  for (int i = 0; i < count; i++)
+    entries[i].name = names + offsets[i];
+  free(offsets);
+  qsort(entries, count, sizeof(DirEntry), entry_order);
+
+  cached->entries = entries;
+  cached->names = names;
+  cached->count = count;
+  cached->dev = st.st_dev;
+  cached->ino = st.st_ino;
+  cached->mtime = st.st_mtim;
+  cached->fresh = 1;
+  cached->generation = ++cache.generation;
+  return 1;
+}
+
+static int is_current(const CachedDir *dir) {
+  struct stat st;
+  return stat(dir->path, &st) == 0 && st.st_dev == dir->dev &&
+         st.st_ino == dir->ino && st.st_mtim.tv_sec == dir->mtime.tv_sec &&
+         st.st_mtim.tv_nsec == dir->mtime.tv_nsec;
+}
+
+static CachedDir *find_dir(const char *path) {
+  for (int i = 0; i < DIR_CACHE_SIZE; i++) {
+    if (cache.dirs[i].path && strcmp(cache.dirs[i].path, path) == 0)
+      return &cache.dirs[i];
+  }
+  return NULL;
+}
+
+static CachedDir *take_slot(void) {
+  CachedDir *oldest = &cache.dirs[0];
+  for (int i = 0; i < DIR_CACHE_SIZE; i++) {
+    if (!cache.dirs[i].path)
+      return &cache.dirs[i];
+    if (cache.dirs[i].last_used < oldest->last_used)
+      oldest = &cache.dirs[i];
+  }
+  drop(oldest);
+  return oldest;
+}
+
+const DirEntry *dir_cache_list(const char *dir, int *count) {
+  // Relative directories are keyed by where they are, so a listing is not
+  // reused for another directory after cd. Without a working directory
+  // they are keyed as given and never watched.
+  char path[PATH_MAX];
+  int absolute = dir[0] == '/' || cache.cwd;
+  int length;
+  if (dir[0] == '/' || !cache.cwd)
+    length = snprintf(path, sizeof(path), "%s", dir);
+  else if (strcmp(dir, ".") == 0)
+    length = snprintf(path, sizeof(path), "%s", cache.cwd);
+  else
+    length = snprintf(path, sizeof(path), "%s/%s",
+                      strcmp(cache.cwd, "/") == 0 ? "" : cache.cwd, dir);
+  if (length < 0 || (size_t)length >= sizeof(path))
+    return NULL;
+
+  CachedDir *cached = find_dir(path);
+  if (!cached) {
+    cached = take_slot();
+    cached->path = strdup(path);
+    if (!cached->path)
+      return NULL;
+  }
+  cached->last_used = ++cache.clock;
+  cached->uses++;
+
+  // A watched directory is fresh until inotify says otherwise. Any other
+  // is compared with the directory, which is also done once when the
+  // watch starts, as changes before then were not reported.
+  int watched = cached->watch;
+  if (!watched && absolute && cached->uses >= HOT_USES)
+    start_watch(cached);
+  if (cached->fresh && !watched && !is_current(cached))
+    cached->fresh = 0;
+
+  if (!cached->fresh) {
+    forget_listing(cached);
+    if (!read_listing(cached)) {
+      drop(cached);
+      return NULL;
+    }
+  }
+
+  *count = cached->count;
+  return cached->entries;
+}
+
+int dir_cache_prefix(const DirEntry *entries, int count, const char *prefix,
+                     int *first) {
+  size_t length = strlen(prefix);
+
+  int low = 0;
+  int high = count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (strncasecmp(entries[mid].name, prefix, length) < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  *first = low;
+
+  high = count;
+  while (low < high) {
+    int mid = low + (high - low) / 2;
+    if (strncasecmp(entries[mid].name, prefix, length) <= 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+  return low;
+}
+
+unsigned long dir_cache_generation(const DirEntry *entries) {
+  for (int i = 0; i < DIR_CACHE_SIZE; i++) {
+    if (cache.dirs[i].path && cache.dirs[i].entries == entries)
+      return cache.dirs[i].generation;
+  }
+  return 0;
+}
+
+void dir_cache_begin(const char *cwd) {
+  if (!cache.cwd || !cwd || strcmp(cache.cwd, cwd) != 0) {
+    free(cache.cwd);
+    cache.cwd = cwd ? strdup(cwd) : NULL;
+  }
+
+  // Changes made while a command ran were not read during it
+  if (cache.inotify_fd > 0)
+    read_changes(NULL);
+}
+
+void dir_cache_clear(void) {
+  for (int i = 0; i < DIR_CACHE_SIZE; i++) {
+    if (cache.dirs[i].path)
+      drop(&cache.dirs[i]);
+  }
+  if (cache.inotify_fd > 0) {
+    event_unwatch(cache.inotify_fd);
+    close(cache.inotify_fd);
+  }
+  cache.inotify_fd = 0;
+  free(cache.cwd);
+  cache.cwd = NULL;
+}
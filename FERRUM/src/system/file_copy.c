@@ -0,0 +1,568 @@
+#define _GNU_SOURCE
+#include "file_copy.h"
+#include "common.h"
+#include "system_monitor.h"
+#include <dirent.h>
+#include <errno.h>
+#include <ftw.h>
+#include <linux/fs.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/sendfile.h>
+
+#define COPY_THREADS 8
+#define COPY_CHUNK (8 << 20)   // Most the kernel copies in one call
+#define COPY_BUFFER (1 << 20)  // For copies the kernel cannot do itself
+#define COPY_ALIGN 4096
+#define PROGRESS_DELAY_MS 500  // Quick copies show no progress at all
+#define PROGRESS_INTERVAL_MS 200
+
+typedef struct {
+  char *source;
+  char *dest;
+  struct stat st;
+} CopyItem;
+
+typedef struct {
+  const char *verb; // Command named in messages
+  pthread_mutex_t lock;
+  pthread_cond_t done;
+  CopyItem *files;
+  int file_count;
+  int file_capacity;
+  CopyItem *dirs; // Made during planning, given their metadata last
+  int dir_count;
+  int dir_capacity;
+  int next;     // File the next free worker takes
+  int finished; // Files copied or given up on
+  int failed;
+  off_t total_bytes;
+  atomic_llong copied_bytes;
+  int have_top;  // Set once the first directory is made, which a tree
+  dev_t top_dev; // copied into itself must not copy again
+  ino_t top_ino;
+} Copy;
+
+static void fail(Copy *copy, const char *path, const char *message) {
+  fprintf(stderr, "lsh: %s: %s: %s\n", copy->verb, path, message);
+}
+
+static int add_item(CopyItem **items, int *count, int *capacity, char *source,
+                    char *dest, const struct stat *st) {
+  if (*count == *capacity) {
+    int grown_capacity = *capacity ? *capacity * 2 : 64;
+    CopyItem *grown = realloc(*items, grown_capacity * sizeof(CopyItem));
+    if (!grown)
+      return 0;
+    *items = grown;
+    *capacity = grown_capacity;
+  }
+  (*items)[*count].source = source;
+  (*items)[*count].dest = dest;
+  (*items)[*count].st = *st;
+  (*count)++;
+  return 1;
+}
+
+static int kernel_copy_unsupported(int error) {
+  return error == EXDEV || error == EINVAL || error == ENOSYS ||
+         error == EOPNOTSUPP;
+}
+
+static int copy_buffered(Copy *copy, int in, int out) {
+  void *buffer;
+  if (posix_memalign(&buffer, COPY_ALIGN, COPY_BUFFER) != 0) {
+    errno = ENOMEM;
+    return 0;
+  }
+
+  int ok = 1;
+  ssize_t got;
+  while (ok && (got = read(in, buffer, COPY_BUFFER)) != 0) {
+    if (got == -1) {
+      ok = errno == EINTR;
+      continue;
+    }
+    for (ssize_t written = 0; ok && written < got;) {
+      ssize_t put = write(out, (char *)buffer + written, got - written);
+      if (put == -1) {
+        ok = errno == EINTR;
+      } else {
+        written += put;
+        atomic_fetch_add(&copy->copied_bytes, put);
+      }
+    }
+  }
+
+  int saved = errno;
+  free(buffer);
+  errno = saved;
+  return ok;
+}
+
+// Each way of copying carries on from the file offsets the one before left
+static int copy_data(Copy *copy, int in, int out, off_t size) {
+  // Files such as those in /proc claim to be empty but are not, and the
+  // kernel copies nothing of them
+  if (size == 0)
+    return copy_buffered(copy, in, out);
+
+  // A reflink shares the blocks, so nothing is copied at all
+  if (ioctl(out, FICLONE, in) == 0) {
+    atomic_fetch_add(&copy->copied_bytes, size);
+    return 1;
+  }
+
+  ssize_t n;
+  while ((n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0)) != 0) {
+    if (n > 0)
+      atomic_fetch_add(&copy->copied_bytes, n);
+    else if (errno != EINTR)
+      break;
+  }
+  if (n == 0)
+    return 1;
+  if (!kernel_copy_unsupported(errno))
+    return 0;
+
+  while ((n = sendfile(out, in, NULL, COPY_CHUNK)) != 0) {
+    if (n > 0)
+      atomic_fetch_add(&copy->copied_bytes, n);
+    else if (errno != EINTR)
+      break;
+  }
+  if (n == 0)
+    return 1;
+  if (errno != EINVAL && errno != ENOSYS)
+    return 0;
+
+  return copy_buffered(copy, in, out);
+}
+
+static int copy_file(Copy *copy, const CopyItem *item) {
+  int in = open(item->source, O_RDONLY | O_CLOEXEC);
+  if (in == -1) {
+    fail(copy, item->source, strerror(errno));
+    return 0;
+  }
+  int out = open(item->dest, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (out == -1) {
+    fail(copy, item->dest, strerror(errno));
+    close(in);
+    return 0;
+  }
+
+  int ok = copy_data(copy, in, out, item->st.st_size);
+  if (!ok) {
+    fail(copy, item->dest, strerror(errno));
+  } else {
+    // Only root can give files away; anyone else keeps them. The mode is
+    // set after the owner, which clears set-user-ID.
+    struct timespec times[2] = {item->st.st_atim, item->st.st_mtim};
+    if ((geteuid() == 0 &&
+         fchown(out, item->st.st_uid, item->st.st_gid) != 0) ||
+        fchmod(out, item->st.st_mode & 07777) != 0 ||
+        futimens(out, times) != 0) {
+      fail(copy, item->dest, strerror(errno));
+      ok = 0;
+    }
+  }
+  close(in);
+  if (close(out) != 0 && ok) {
+    fail(copy, item->dest, strerror(errno));
+    ok = 0;
+  }
+  return ok;
+}
+
+static int copy_link(Copy *copy, const char *source, const char *dest,
+                     const struct stat *st) {
+  char target[PATH_MAX];
+  ssize_t length = readlink(source, target, sizeof(target) - 1);
+  if (length == -1) {
+    fail(copy, source, strerror(errno));
+    return 0;
+  }
+  target[length] = '\0';
+
+  int made = symlink(target, dest) == 0;
+  if (!made && errno == EEXIST && unlink(dest) == 0)
+    made = symlink(target, dest) == 0;
+  if (!made) {
+    fail(copy, dest, strerror(errno));
+    return 0;
+  }
+
+  if (geteuid() == 0 && lchown(dest, st->st_uid, st->st_gid) != 0) {
+    fail(copy, dest, strerror(errno));
+    return 0;
+  }
+  struct timespec times[2] = {st->st_atim, st->st_mtim};
+  utimensat(AT_FDCWD, dest, times, AT_SYMLINK_NOFOLLOW);
+  return 1;
+}
+
+static int make_dir(Copy *copy, const char *dest) {
+  // Writable until everything is copied into it, whatever its mode will be
+  struct stat made;
+  if (mkdir(dest, S_IRWXU) != 0 && errno != EEXIST) {
+    fail(copy, dest, strerror(errno));
+    return 0;
+  }
+  if (stat(dest, &made) != 0) {
+    fail(copy, dest, strerror(errno));
+    return 0;
+  }
+  if (!S_ISDIR(made.st_mode)) {
+    fail(copy, dest, strerror(ENOTDIR));
+    return 0;
+  }
+  if (!copy->have_top) {
+    copy->have_top = 1;
+    copy->top_dev = made.st_dev;
+    copy->top_ino = made.st_ino;
+  }
+  return 1;
+}
+
+// Make the directories and links under source and list its files, which
+// workers copy afterwards. Takes ownership of both paths.
+static void plan(Copy *copy, char *source, char *dest, const struct stat *st) {
+  if (S_ISREG(st->st_mode)) {
+    if (add_item(&copy->files, &copy->file_count, &copy->file_capacity,
+                 source, dest, st)) {
+      copy->total_bytes += st->st_size;
+      return;
+    }
+    fail(copy, source, strerror(ENOMEM));
+    copy->failed++;
+  } else if (S_ISLNK(st->st_mode)) {
+    if (!copy_link(copy, source, dest, st))
+      copy->failed++;
+  } else if (S_ISFIFO(st->st_mode)) {
+    if (mkfifo(dest, st->st_mode & 07777) != 0 && errno != EEXIST) {
+      fail(copy, dest, strerror(errno));
+      copy->failed++;
+    }
+  } else if (!S_ISDIR(st->st_mode)) {
+    fail(copy, source, "not a regular file, directory, symlink or fifo");
+    copy->failed++;
+  } else if (copy->have_top && st->st_dev == copy->top_dev &&
+             st->st_ino == copy->top_ino) {
+    fail(copy, source, "cannot copy a directory into itself");
+    copy->failed++;
+  } else if (!make_dir(copy, dest)) {
+    copy->failed++;
+  } else {
+    DIR *dir = opendir(source);
+    if (!dir) {
+      fail(copy, source, strerror(errno));
+      copy->failed++;
+    }
+
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) != NULL) {
+      if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        continue;
+
+      char *child_source;
+      char *child_dest;
+      if (asprintf(&child_source, "%s/%s", source, entry->d_name) == -1)
+        break;
+      if (asprintf(&child_dest, "%s/%s", dest, entry->d_name) == -1) {
+        free(child_source);
+        break;
+      }
+
+      struct stat child;
+      if (fstatat(dirfd(dir), entry->d_name, &child, AT_SYMLINK_NOFOLLOW) !=
+          0) {
+        fail(copy, child_source, strerror(errno));
+        copy->failed++;
+        free(child_source);
+        free(child_dest);
+        continue;
+      }
+      plan(copy, child_source, child_dest, &child);
+    }
+    if (dir)
+      closedir(dir);
+
+    if (add_item(&copy->dirs, &copy->dir_count, &copy->dir_capacity, source,
+                 dest, st))
+      return;
+  }
+  free(source);
+  free(dest);
+}
+
+static void *copy_worker(void *arg) {
+  Copy *copy = arg;
+
+  pthread_mutex_lock(&copy->lock);
+  while (copy->next < copy->file_count) {
+    CopyItem *item = &copy->files[copy->next++];
+    pthread_mutex_unlock(&copy->lock);
+
+    int ok = copy_file(copy, item);
+
+    pthread_mutex_lock(&copy->lock);
+    if (!ok)
+      copy->failed++;
+    if (++copy->finished == copy->file_count)
+      pthread_cond_signal(&copy->done);
+  }
+  pthread_mutex_unlock(&copy->lock);
+  return NULL;
+}
+
+static long elapsed_ms(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000 +
+         (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+// Keep a progress line on a terminal until the workers are done
+static void show_progress(Copy *copy) {
+  int terminal = isatty(STDERR_FILENO);
+  int shown = 0;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  pthread_mutex_lock(&copy->lock);
+  while (copy->finished < copy->file_count) {
+    struct timespec wake;
+    clock_gettime(CLOCK_MONOTONIC, &wake);
+    wake.tv_nsec += PROGRESS_INTERVAL_MS * 1000000L;
+    if (wake.tv_nsec >= 1000000000L) {
+      wake.tv_sec++;
+      wake.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&copy->done, &copy->lock, &wake);
+
+    if (!terminal || copy->finished == copy->file_count ||
+        elapsed_ms(&start) < PROGRESS_DELAY_MS)
+      continue;
+    char copied[64];
+    char total[64];
+    format_bytes((unsigned long)atomic_load(&copy->copied_bytes), copied);
+    format_bytes((unsigned long)copy->total_bytes, total);
+    fprintf(stderr, "\r\033[K%s of %s, %d of %d files", copied, total,
+            copy->finished, copy->file_count);
+    shown = 1;
+  }
+  pthread_mutex_unlock(&copy->lock);
+
+  if (shown)
+    fprintf(stderr, "\r\033[K");
+}
+
+static void run_workers(Copy *copy) {
+  int thread_count =
+      copy->file_count < COPY_THREADS ? copy->file_count : COPY_THREADS;
+  pthread_t threads[COPY_THREADS];
+  int started = 0;
+  for (int i = 0; i < thread_count; i++) {
+    if (pthread_create(&threads[started], NULL, copy_worker, copy) == 0)
+      started++;
+  }
+
+  if (started == 0)
+    copy_worker(copy);
+  else
+    show_progress(copy);
+  for (int i = 0; i < started; i++)
+    pthread_join(threads[i], NULL);
+}
+
+// Deepest first, as filling a directory changes its times
+static void finish_dirs(Copy *copy) {
+  for (int i = copy->dir_count - 1; i >= 0; i--) {
+    const CopyItem *dir = &copy->dirs[i];
+    struct timespec times[2] = {dir->st.st_atim, dir->st.st_mtim};
+    if ((geteuid() == 0 &&
+         chown(dir->dest, dir->st.st_uid, dir->st.st_gid) != 0) ||
+        chmod(dir->dest, dir->st.st_mode & 07777) != 0 ||
+        utimensat(AT_FDCWD, dir->dest, times, 0) != 0) {
+      fail(copy, dir->dest, strerror(errno));
+      copy->failed++;
+    }
+  }
+}
+
+static void free_items(CopyItem *items, int count) {
+  for (int i = 0; i < count; i++) {
+    free(items[i].source);
+    free(items[i].dest);
+  }
+  free(items);
+}
+
+// Where path is or would be made, with symlinks and ".." resolved. NULL
+// when not even its directory exists.
+static char *resolve_target(const char *path) {
+  char *resolved = realpath(path, NULL);
+  if (resolved || errno != ENOENT)
+    return resolved;
+
+  size_t length = strlen(path);
+  while (length > 1 && path[length - 1] == '/')
+    length--;
+  const char *name = path + length;
+  while (name > path && name[-1] != '/')
+    name--;
+
+  char *dir = name > path ? strndup(path, (size_t)(name - path)) : strdup(".");
+  char *dir_resolved = dir ? realpath(dir, NULL) : NULL;
+  free(dir);
+  if (!dir_resolved)
+    return NULL;
+
+  const char *separator = strcmp(dir_resolved, "/") == 0 ? "" : "/";
+  if (asprintf(&resolved, "%s%s%.*s", dir_resolved, separator,
+               (int)(path + length - name), name) == -1)
+    resolved = NULL;
+  free(dir_resolved);
+  return resolved;
+}
+
+// Whether target is source or somewhere below it
+static int inside_source(const char *source, const char *target) {
+  char *source_resolved = realpath(source, NULL);
+  char *target_resolved = resolve_target(target);
+  int inside = 0;
+  if (source_resolved && target_resolved) {
+    size_t length = strlen(source_resolved);
+    inside = strncmp(target_resolved, source_resolved, length) == 0 &&
+             (target_resolved[length] == '\0' ||
+              target_resolved[length] == '/' || length == 1);
+  }
+  free(source_resolved);
+  free(target_resolved);
+  return inside;
+}
+
+// Copy source to the path it is meant to have, which is not looked at
+// again. Symlinks named as the source are copied as links unless follow.
+static int transfer(const char *verb, const char *source, const char *target,
+                    int recursive, int follow) {
+  struct stat st;
+  if ((follow ? stat(source, &st) : lstat(source, &st)) != 0) {
+    fprintf(stderr, "lsh: %s: %s: %s\n", verb, source, strerror(errno));
+    return 0;
+  }
+  if (S_ISDIR(st.st_mode) && !recursive) {
+    fprintf(stderr, "lsh: %s: %s is a directory (use -r)\n", verb, source);
+    return 0;
+  }
+
+  // Opening the copy would empty the original
+  struct stat existing;
+  if (stat(target, &existing) == 0 && existing.st_dev == st.st_dev &&
+      existing.st_ino == st.st_ino) {
+    fprintf(stderr, "lsh: %s: %s and %s are the same file\n", verb, source,
+            target);
+    return 0;
+  }
+
+  // Refused before anything is made, as the copy would keep finding
+  // itself inside the tree it copies
+  if (S_ISDIR(st.st_mode) && inside_source(source, target)) {
+    fprintf(stderr, "lsh: %s: cannot copy %s into itself, %s\n", verb, source,
+            target);
+    return 0;
+  }
+
+  char *source_copy = strdup(source);
+  char *target_copy = strdup(target);
+  if (!source_copy || !target_copy) {
+    free(source_copy);
+    free(target_copy);
+    fprintf(stderr, "lsh: allocation error\n");
+    return 0;
+  }
+
+  Copy copy = {0};
+  copy.verb = verb;
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_mutex_init(&copy.lock, NULL);
+  pthread_cond_init(&copy.done, &attr);
+  pthread_condattr_destroy(&attr);
+  atomic_init(&copy.copied_bytes, 0);
+
+  plan(&copy, source_copy, target_copy, &st);
+  run_workers(&copy);
+  finish_dirs(&copy);
+
+  free_items(copy.files, copy.file_count);
+  free_items(copy.dirs, copy.dir_count);
+  pthread_mutex_destroy(&copy.lock);
+  pthread_cond_destroy(&copy.done);
+  return copy.failed == 0;
+}
+
+// dest itself, or the entry for source inside it when it is a directory
+static char *target_path(const char *source, const char *dest) {
+  struct stat st;
+  if (stat(dest, &st) != 0 || !S_ISDIR(st.st_mode))
+    return strdup(dest);
+
+  size_t length = strlen(source);
+  while (length > 1 && source[length - 1] == '/')
+    length--;
+  const char *name = source + length;
+  while (name > source && name[-1] != '/')
+    name--;
+
+  char *path;
+  if (asprintf(&path, "%s/%.*s", dest, (int)(source + length - name), name) ==
+      -1)
+    return NULL;
+  return path;
+}
+
+int copy_path(const char *source, const char *dest, int recursive) {
+  char *target = target_path(source, dest);
+  if (!target) {
+    fprintf(stderr, "lsh: allocation error\n");
+    return 0;
+  }
+  int ok = transfer("copy", source, target, recursive, 1);
+  free(target);
+  return ok;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int type,
+                        struct FTW *ftw) {
+  (void)st;
+  (void)type;
+  (void)ftw;
+  if (remove(path) != 0) {
+    fprintf(stderr, "lsh: move: %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+int move_path(const char *source, const char *dest) {
+  char *target = target_path(source, dest);
+  if (!target) {
+    fprintf(stderr, "lsh: allocation error\n");
+    return 0;
+  }
+
+  int ok = rename(source, target) == 0;
+  if (!ok && errno != EXDEV) {
+    fprintf(stderr, "lsh: move: %s: %s\n", source, strerror(errno));
+  } else if (!ok) {
+    // Another filesystem: copy it over, and only once all of it is there
+    // remove the original
+    ok = transfer("move", source, target, 1, 0) &&
+         nftw(source, remove_entry, 16, FTW_DEPTH | FTW_PHYS) == 0;
+  }
+  free(target);
+  return ok;
+}
@@ -0,0 +1,179 @@
+#define _GNU_SOURCE
+#include "monitor_sampler.h"
+#include "proc_sampler.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+struct MonitorSampler {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  int stopping;       // Guarded by lock
+  int wake_requested; // Guarded by lock
+  int refresh_rate;
+
+  // Newest snapshot the UI has not taken yet
+  _Atomic(MonitorSnapshot *) published;
+
+  // Owned by the sampler thread
+  ProcSampler *procs;
+  float rings[MONITOR_SERIES][MONITOR_HISTORY];
+  int ring_head;
+  int ring_len;
+  unsigned long sequence;
+  struct timespec last_sample;
+};
+
+static double seconds_between(const struct timespec *from,
+                              const struct timespec *to) {
+  return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+void monitor_snapshot_free(MonitorSnapshot *snapshot) {
+  if (!snapshot)
+    return;
+  free(snapshot->processes);
+  free(snapshot);
+}
+
+static MonitorSnapshot *take_sample(MonitorSampler *sampler) {
+  MonitorSnapshot *snapshot = calloc(1, sizeof(MonitorSnapshot));
+  if (!snapshot)
+    return NULL;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  get_system_stats(&snapshot->stats);
+
+  int live = proc_sampler_update(sampler->procs);
+  if (live > 0) {
+    snapshot->processes = malloc((size_t)live * sizeof(ProcessInfo));
+    if (snapshot->processes)
+      snapshot->process_count =
+          proc_sampler_snapshot(sampler->procs, snapshot->processes, live);
+  }
+
+  // The first disk and network deltas count from boot, so they give no rate
+  double elapsed = sampler->sequence > 0
+                       ? seconds_between(&sampler->last_sample, &now)
+                       : 0.0;
+  sampler->last_sample = now;
+
+  const SystemStats *stats = &snapshot->stats;
+  float values[MONITOR_SERIES] = {0};
+  values[MONITOR_CPU] = stats->cpu_percent;
+  if (stats->memory_total > 0)
+    values[MONITOR_MEM] =
+        (float)stats->memory_used / stats->memory_total * 100.0f;
+  if (elapsed > 0) {
+    values[MONITOR_DISK_READ] = stats->disk_read / elapsed;
+    values[MONITOR_DISK_WRITE] = stats->disk_write / elapsed;
+    values[MONITOR_NET_RX] = stats->net_rx / elapsed;
+    values[MONITOR_NET_TX] = stats->net_tx / elapsed;
+  }
+
+  for (int series = 0; series < MONITOR_SERIES; series++)
+    sampler->rings[series][sampler->ring_head] = values[series];
+  sampler->ring_head = (sampler->ring_head + 1) % MONITOR_HISTORY;
+  if (sampler->ring_len < MONITOR_HISTORY)
+    sampler->ring_len++;
+
+  int first = sampler->ring_head - sampler->ring_len + MONITOR_HISTORY;
+  for (int series = 0; series < MONITOR_SERIES; series++) {
+    for (int i = 0; i < sampler->ring_len; i++)
+      snapshot->history[series][i] =
+          sampler->rings[series][(first + i) % MONITOR_HISTORY];
+  }
+  snapshot->history_len = sampler->ring_len;
+  snapshot->sequence = ++sampler->sequence;
+  return snapshot;
+}
+
+static void *sampler_main(void *arg) {
+  MonitorSampler *sampler = arg;
+
+  pthread_mutex_lock(&sampler->lock);
+  while (!sampler->stopping) {
+    sampler->wake_requested = 0;
+    pthread_mutex_unlock(&sampler->lock);
+
+    // Replace a snapshot the UI never took; it only wants the newest
+    MonitorSnapshot *snapshot = take_sample(sampler);
+    if (snapshot)
+      monitor_snapshot_free(atomic_exchange(&sampler->published, snapshot));
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += sampler->refresh_rate;
+
+    pthread_mutex_lock(&sampler->lock);
+    while (!sampler->stopping && !sampler->wake_requested) {
+      if (pthread_cond_timedwait(&sampler->wake, &sampler->lock, &deadline) ==
+          ETIMEDOUT)
+        break;
+    }
+  }
+  pthread_mutex_unlock(&sampler->lock);
+  return NULL;
+}
+
+MonitorSampler *monitor_sampler_start(int refresh_rate) {
+  MonitorSampler *sampler = calloc(1, sizeof(MonitorSampler));
+  if (!sampler)
+    return NULL;
+
+  sampler->refresh_rate = refresh_rate > 0 ? refresh_rate : 1;
+  atomic_init(&sampler->published, NULL);
+
+  sampler->procs = proc_sampler_create();
+  if (!sampler->procs) {
+    free(sampler);
+    return NULL;
+  }
+
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&sampler->wake, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_mutex_init(&sampler->lock, NULL);
+
+  if (pthread_create(&sampler->thread, NULL, sampler_main, sampler) != 0) {
+    pthread_cond_destroy(&sampler->wake);
+    pthread_mutex_destroy(&sampler->lock);
+    proc_sampler_destroy(sampler->procs);
+    free(sampler);
+    return NULL;
+  }
+  return sampler;
+}
+
+void monitor_sampler_wake(MonitorSampler *sampler) {
+  pthread_mutex_lock(&sampler->lock);
+  sampler->wake_requested = 1;
+  pthread_cond_signal(&sampler->wake);
+  pthread_mutex_unlock(&sampler->lock);
+}
+
+MonitorSnapshot *monitor_sampler_take(MonitorSampler *sampler) {
+  return atomic_exchange(&sampler->published, NULL);
+}
+
+void monitor_sampler_stop(MonitorSampler *sampler) {
+  if (!sampler)
+    return;
+
+  pthread_mutex_lock(&sampler->lock);
+  sampler->stopping = 1;
+  pthread_cond_signal(&sampler->wake);
+  pthread_mutex_unlock(&sampler->lock);
+  pthread_join(sampler->thread, NULL);
+
+  monitor_snapshot_free(atomic_load(&sampler->published));
+  pthread_cond_destroy(&sampler->wake);
+  pthread_mutex_destroy(&sampler->lock);
+  proc_sampler_destroy(sampler->procs);
+  free(sampler);
+}
@@ -0,0 +1,331 @@
+#define _GNU_SOURCE
+#include "proc_sampler.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROC_FD_RESERVE 256  // Descriptors left for the rest of the shell
+#define PROC_FD_WANTED 65536 // Soft limit asked for while sampling
+
+typedef struct {
+  int pid; // 0 marks an empty slot
+  int fd;  // /proc/<pid>/stat, -1 when over budget and reopened each sample
+  unsigned long long start_time; // Ticks after boot, tells reused pids apart
+  unsigned long long cpu_ticks;  // utime + stime at the last sample
+  unsigned int seen;             // Generation of the last successful sample
+  float history[PROCESS_HISTORY]; // Ring of CPU samples
+  int history_head;               // Slot the next sample goes to
+  int history_len;
+  ProcessInfo info;
+} ProcEntry;
+
+struct ProcSampler {
+  ProcEntry *slots;
+  size_t capacity; // Power of two
+  size_t count;
+  DIR *proc_dir;
+  unsigned int generation;
+  struct timespec last_sample;
+  double ticks_per_second;
+  unsigned long page_size;
+  int open_fds;
+  int fd_budget;
+  struct rlimit saved_limit;
+  int limit_raised;
+};
+
+static size_t pid_slot(int pid, size_t capacity) {
+  return ((unsigned int)pid * 2654435761u) & (capacity - 1);
+}
+
+static ProcEntry *find_or_insert(ProcSampler *sampler, int pid) {
+  size_t i = pid_slot(pid, sampler->capacity);
+  while (sampler->slots[i].pid != 0 && sampler->slots[i].pid != pid)
+    i = (i + 1) & (sampler->capacity - 1);
+
+  ProcEntry *entry = &sampler->slots[i];
+  if (entry->pid == 0) {
+    memset(entry, 0, sizeof(*entry));
+    entry->pid = pid;
+    entry->fd = -1;
+    sampler->count++;
+  }
+  return entry;
+}
+
+// Move entries into a table sized for min_count. With sweep set, entries not
+// sampled in this generation are dropped and their descriptors closed.
+static int rebuild_table(ProcSampler *sampler, size_t min_count, int sweep) {
+  size_t capacity = 64;
+  while (capacity < min_count * 2)
+    capacity *= 2;
+
+  ProcEntry *slots = calloc(capacity, sizeof(ProcEntry));
+  if (!slots)
+    return 0;
+
+  ProcEntry *old = sampler->slots;
+  size_t old_capacity = sampler->capacity;
+  sampler->slots = slots;
+  sampler->capacity = capacity;
+  sampler->count = 0;
+
+  for (size_t i = 0; i < old_capacity; i++) {
+    if (old[i].pid == 0)
+      continue;
+    if (sweep && old[i].seen != sampler->generation) {
+      if (old[i].fd >= 0) {
+        close(old[i].fd);
+        sampler->open_fds--;
+      }
+      continue;
+    }
+    *find_or_insert(sampler, old[i].pid) = old[i];
+  }
+  free(old);
+  return 1;
+}
+
+ProcSampler *proc_sampler_create(void) {
+  ProcSampler *sampler = calloc(1, sizeof(ProcSampler));
+  if (!sampler)
+    return NULL;
+
+  sampler->proc_dir = opendir("/proc");
+  if (!sampler->proc_dir || !rebuild_table(sampler, 0, 0)) {
+    proc_sampler_destroy(sampler);
+    return NULL;
+  }
+
+  long ticks = sysconf(_SC_CLK_TCK);
+  long page = sysconf(_SC_PAGESIZE);
+  sampler->ticks_per_second = ticks > 0 ? (double)ticks : 100.0;
+  sampler->page_size = page > 0 ? (unsigned long)page : 4096;
+
+  // One descriptor per process needs more than the usual 1024
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    sampler->saved_limit = limit;
+    rlim_t wanted = PROC_FD_WANTED;
+    if (limit.rlim_max != RLIM_INFINITY && wanted > limit.rlim_max)
+      wanted = limit.rlim_max;
+    if (limit.rlim_cur != RLIM_INFINITY && limit.rlim_cur < wanted) {
+      struct rlimit raised = limit;
+      raised.rlim_cur = wanted;
+      if (setrlimit(RLIMIT_NOFILE, &raised) == 0) {
+        sampler->limit_raised = 1;
+        limit = raised;
+      }
+    }
+    rlim_t usable = limit.rlim_cur == RLIM_INFINITY ? PROC_FD_WANTED : limit.rlim_cur;
+    sampler->fd_budget =
+        usable > PROC_FD_RESERVE ? (int)(usable - PROC_FD_RESERVE) : 0;
+  }
+  return sampler;
+}
+
+void proc_sampler_destroy(ProcSampler *sampler) {
+  if (!sampler)
+    return;
+
+  for (size_t i = 0; i < sampler->capacity; i++) {
+    if (sampler->slots[i].pid != 0 && sampler->slots[i].fd >= 0)
+      close(sampler->slots[i].fd);
+  }
+  free(sampler->slots);
+  if (sampler->proc_dir)
+    closedir(sampler->proc_dir);
+  if (sampler->limit_raised)
+    setrlimit(RLIMIT_NOFILE, &sampler->saved_limit);
+  free(sampler);
+}
+
+static int open_stat(int pid) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+  return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+// Read /proc/<pid>/stat through the entry's descriptor. A descriptor left
+// over from an earlier process with the same pid fails with ESRCH and is
+// replaced once.
+static ssize_t read_stat(ProcSampler *sampler, ProcEntry *entry, char *buffer,
+                         size_t size) {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    if (entry->fd >= 0) {
+      ssize_t n = pread(entry->fd, buffer, size - 1, 0);
+      if (n > 0) {
+        buffer[n] = '\0';
+        return n;
+      }
+      close(entry->fd);
+      entry->fd = -1;
+      sampler->open_fds--;
+    }
+
+    int fd = open_stat(entry->pid);
+    if (fd < 0)
+      return -1;
+
+    if (sampler->open_fds < sampler->fd_budget) {
+      entry->fd = fd;
+      sampler->open_fds++;
+      continue;
+    }
+
+    ssize_t n = pread(fd, buffer, size - 1, 0);
+    close(fd);
+    if (n <= 0)
+      return -1;
+    buffer[n] = '\0';
+    return n;
+  }
+  return -1;
+}
+
+int proc_parse_stat(const char *buffer, ProcStat *stat) {
+  // The name may contain spaces and parentheses; it ends at the last ')'
+  const char *name_start = strchr(buffer, '(');
+  const char *name_end = strrchr(buffer, ')');
+  if (!name_start || !name_end || name_end < name_start || name_end[1] == '\0')
+    return 0;
+
+  size_t name_len = (size_t)(name_end - name_start - 1);
+  if (name_len >= sizeof(stat->name))
+    name_len = sizeof(stat->name) - 1;
+  memcpy(stat->name, name_start + 1, name_len);
+  stat->name[name_len] = '\0';
+
+  const char *p = name_end + 2;
+  stat->state = *p++;
+
+  // Fields are numbered from 1 (pid); state is field 3
+  unsigned long long utime = 0, stime = 0;
+  for (int field = 4; field <= 24; field++) {
+    char *end;
+    unsigned long long value = strtoull(p, &end, 10);
+    if (end == p)
+      return 0;
+    p = end;
+    if (field == 14)
+      utime = value;
+    else if (field == 15)
+      stime = value;
+    else if (field == 20)
+      stat->threads = (int)value;
+    else if (field == 22)
+      stat->start_time = value;
+    else if (field == 24)
+      stat->rss_pages = (unsigned long)value;
+  }
+  stat->cpu_ticks = utime + stime;
+  return 1;
+}
+
+static double read_uptime(void) {
+  double uptime = 0;
+  FILE *fp = fopen("/proc/uptime", "re");
+  if (fp) {
+    if (fscanf(fp, "%lf", &uptime) != 1)
+      uptime = 0;
+    fclose(fp);
+  }
+  return uptime;
+}
+
+int proc_sampler_update(ProcSampler *sampler) {
+  if (!sampler)
+    return -1;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double elapsed = (now.tv_sec - sampler->last_sample.tv_sec) +
+                   (now.tv_nsec - sampler->last_sample.tv_nsec) / 1e9;
+  int first_sample = sampler->generation == 0;
+  double uptime_ticks = read_uptime() * sampler->ticks_per_second;
+
+  sampler->generation++;
+  rewinddir(sampler->proc_dir);
+
+  int live = 0;
+  char buffer[1024];
+  struct dirent *dirent;
+  while ((dirent = readdir(sampler->proc_dir)) != NULL) {
+    if (dirent->d_name[0] < '1' || dirent->d_name[0] > '9')
+      continue;
+    int pid = atoi(dirent->d_name);
+
+    // Keep probe chains short as the process count grows
+    if ((sampler->count + 1) * 2 > sampler->capacity &&
+        !rebuild_table(sampler, sampler->count + 1, 0)) {
+      return -1;
+    }
+
+    ProcEntry *entry = find_or_insert(sampler, pid);
+    ProcStat fields;
+    if (read_stat(sampler, entry, buffer, sizeof(buffer)) < 0 ||
+        !proc_parse_stat(buffer, &fields))
+      continue;
+
+    // A new process, or a new one that took over a known pid, has no
+    // previous sample; start from its average over its lifetime
+    int known = entry->seen != 0 && entry->start_time == fields.start_time &&
+                !first_sample;
+    double cpu = 0.0;
+    if (known && elapsed > 0) {
+      cpu = (double)(fields.cpu_ticks - entry->cpu_ticks) /
+            (elapsed * sampler->ticks_per_second) * 100.0;
+    } else if (uptime_ticks > (double)fields.start_time) {
+      cpu = (double)fields.cpu_ticks / (uptime_ticks - fields.start_time) *
+            100.0;
+    }
+
+    ProcessInfo info = {0};
+    memcpy(info.name, fields.name, sizeof(info.name));
+    info.pid = pid;
+    info.state = fields.state;
+    info.cpu_percent = (float)cpu;
+    info.memory = fields.rss_pages * sampler->page_size;
+
+    if (!known)
+      entry->history_len = 0;
+    entry->history[entry->history_head] = info.cpu_percent;
+    entry->history_head = (entry->history_head + 1) % PROCESS_HISTORY;
+    if (entry->history_len < PROCESS_HISTORY)
+      entry->history_len++;
+
+    entry->info = info;
+    entry->cpu_ticks = fields.cpu_ticks;
+    entry->start_time = fields.start_time;
+    entry->seen = sampler->generation;
+    live++;
+  }
+
+  // Drop processes that exited since the last sample
+  if (live != (int)sampler->count && !rebuild_table(sampler, (size_t)live, 1))
+    return -1;
+
+  sampler->last_sample = now;
+  return live;
+}
+
+int proc_sampler_snapshot(const ProcSampler *sampler, ProcessInfo *out,
+                          int max) {
+  int count = 0;
+  for (size_t i = 0; sampler && i < sampler->capacity && count < max; i++) {
+    const ProcEntry *entry = &sampler->slots[i];
+    if (entry->pid == 0 || entry->seen != sampler->generation)
+      continue;
+
+    ProcessInfo *info = &out[count++];
+    *info = entry->info;
+    int first = entry->history_head - entry->history_len + PROCESS_HISTORY;
+    for (int j = 0; j < entry->history_len; j++)
+      info->cpu_history[j] = entry->history[(first + j) % PROCESS_HISTORY];
+    info->history_len = entry->history_len;
+  }
+  return count;
+}
@@ -0,0 +1,170 @@
+#define _GNU_SOURCE
+#include "system_monitor.h"
+
+typedef int (*ProcessCompare)(const ProcessInfo *a, const ProcessInfo *b);
+
+// Every order falls back to the pid, so no two rows compare equal and the
+// rows on screen do not trade places between frames
+
+static int compare_pid(const ProcessInfo *a, const ProcessInfo *b) {
+  return (a->pid > b->pid) - (a->pid < b->pid);
+}
+
+static int compare_cpu(const ProcessInfo *a, const ProcessInfo *b) {
+  if (a->cpu_percent != b->cpu_percent)
+    return a->cpu_percent > b->cpu_percent ? -1 : 1;
+  return compare_pid(a, b);
+}
+
+static int compare_memory(const ProcessInfo *a, const ProcessInfo *b) {
+  if (a->memory != b->memory)
+    return a->memory > b->memory ? -1 : 1;
+  return compare_pid(a, b);
+}
+
+static int compare_name(const ProcessInfo *a, const ProcessInfo *b) {
+  int result = strcasecmp(a->name, b->name);
+  return result ? result : compare_pid(a, b);
+}
+
+static ProcessCompare compare_for(ProcessSortKey key) {
+  switch (key) {
+  case SORT_MEMORY:
+    return compare_memory;
+  case SORT_PID:
+    return compare_pid;
+  case SORT_NAME:
+    return compare_name;
+  default:
+    return compare_cpu;
+  }
+}
+
+const char *process_sort_name(ProcessSortKey key) {
+  switch (key) {
+  case SORT_MEMORY:
+    return "Memory";
+  case SORT_PID:
+    return "PID";
+  case SORT_NAME:
+    return "Name";
+  default:
+    return "CPU";
+  }
+}
+
+void process_view_init(ProcessView *view) { memset(view, 0, sizeof(*view)); }
+
+void process_view_free(ProcessView *view) {
+  free(view->rows);
+  process_view_init(view);
+}
+
+int process_view_filter(ProcessView *view, const ProcessInfo *processes,
+                        int count, unsigned long sequence, const char *query) {
+  if (!query)
+    query = "";
+
+  int same_table = sequence != 0 && view->sequence == sequence;
+  if (same_table && strcmp(view->query, query) == 0)
+    return 1;
+
+  if (same_table && strcasestr(query, view->query)) {
+    // Anything matching the longer query matched the old one
+    int kept = 0;
+    for (int i = 0; i < view->count; i++) {
+      if (strcasestr(processes[view->rows[i]].name, query))
+        view->rows[kept++] = view->rows[i];
+    }
+    view->count = kept;
+  } else {
+    if ((size_t)count > view->capacity) {
+      int *rows = realloc(view->rows, (size_t)count * sizeof(int));
+      if (!rows)
+        return 0;
+      view->rows = rows;
+      view->capacity = (size_t)count;
+    }
+
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+      if (!*query || strcasestr(processes[i].name, query))
+        view->rows[kept++] = i;
+    }
+    view->count = kept;
+  }
+
+  view->sequence = sequence;
+  snprintf(view->query, sizeof(view->query), "%s", query);
+  view->ordered_first = view->ordered_last = 0;
+  return 1;
+}
+
+// Quickselect: move the row that sorts at position nth of [lo, hi) there,
+// with every row before it sorting earlier and every row after it later
+static void select_nth(int *rows, int lo, int hi, int nth,
+                       const ProcessInfo *processes, ProcessCompare compare) {
+  while (hi - lo > 1) {
+    const ProcessInfo *pivot = &processes[rows[lo + (hi - lo) / 2]];
+    int i = lo;
+    int j = hi - 1;
+    while (i <= j) {
+      while (compare(&processes[rows[i]], pivot) < 0)
+        i++;
+      while (compare(pivot, &processes[rows[j]]) < 0)
+        j--;
+      if (i <= j) {
+        int tmp = rows[i];
+        rows[i++] = rows[j];
+        rows[j--] = tmp;
+      }
+    }
+
+    if (nth <= j)
+      hi = j + 1;
+    else if (nth >= i)
+      lo = i;
+    else
+      return;
+  }
+}
+
+typedef struct {
+  const ProcessInfo *processes;
+  ProcessCompare compare;
+} RowOrder;
+
+static int compare_rows(const void *a, const void *b, void *arg) {
+  const RowOrder *order = arg;
+  return order->compare(&order->processes[*(const int *)a],
+                        &order->processes[*(const int *)b]);
+}
+
+void process_view_order(ProcessView *view, const ProcessInfo *processes,
+                        ProcessSortKey key, int first, int last) {
+  if (first < 0)
+    first = 0;
+  if (last > view->count)
+    last = view->count;
+  if (first >= last)
+    return;
+  if (key == view->ordered_key && first == view->ordered_first &&
+      last == view->ordered_last)
+    return;
+
+  // Two selections bound the window in linear time; only the window itself
+  // is sorted
+  ProcessCompare compare = compare_for(key);
+  if (first > 0)
+    select_nth(view->rows, 0, view->count, first, processes, compare);
+  if (last < view->count)
+    select_nth(view->rows, first, view->count, last, processes, compare);
+
+  RowOrder order = {processes, compare};
+  qsort_r(view->rows + first, (size_t)(last - first), sizeof(int),
+          compare_rows, &order);
+
+  view->ordered_key = key;
+  view->ordered_first = first;
+  view->ordered_last = last;
+}
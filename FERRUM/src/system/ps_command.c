@@ -1,97 +1,403 @@
-
+#define _GNU_SOURCE
+#include "ps_command.h"
 #include "builtins.h"
 #include "common.h"
-#include "structured_data.h"
+#include "proc_sampler.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <pwd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PS_PARALLEL_MIN 512 // Fewer processes are read on one thread
+#define PS_PER_THREAD 256   // Processes worth starting another thread for
+#define PS_MAX_THREADS 8
+#define PS_COMMAND_MAX 200  // Command lines are cut to fit a table cell
+#define PS_USER_CACHE 64
+
+static const struct {
+    PsColumn column;
+    const char *header;
+} ps_columns[] = {
+    {PS_PID, "PID"},       {PS_NAME, "Name"},       {PS_USER, "User"},
+    {PS_CPU, "CPU"},       {PS_MEMORY, "Memory"},   {PS_STATE, "State"},
+    {PS_THREADS, "Threads"}, {PS_STARTED, "Started"}, {PS_COMMAND, "Command"},
+};
+
+#define PS_COLUMN_COUNT (int)(sizeof(ps_columns) / sizeof(ps_columns[0]))
+
+// Columns that come from /proc/<pid>/stat. The command line falls back to
+// the name for kernel threads.
+#define PS_STAT_COLUMNS                                                       \
+    (PS_NAME | PS_CPU | PS_MEMORY | PS_STATE | PS_THREADS | PS_STARTED |      \
+     PS_COMMAND)
+
+typedef struct {
+    int pid;
+    int ok; // Still running when it was read
+    ProcStat stat;
+    uid_t uid;
+    char *command;
+} PsRecord;
+
+typedef struct {
+    PsRecord *records;
+    int count;
+    unsigned columns;
+} PsWork;
+
+typedef struct {
+    uid_t uid;
+    char name[64];
+} PsUser;
+
+static ssize_t read_proc_file(const char *path, char *buffer, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+    ssize_t n = read(fd, buffer, size - 1);
+    close(fd);
+    if (n < 0)
+        return -1;
+    buffer[n] = '\0';
+    return n;
+}
+
+static char *read_command(int pid, const char *name) {
+    char path[64];
+    char buffer[PS_COMMAND_MAX + 1];
+    snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+    ssize_t n = read_proc_file(path, buffer, sizeof(buffer));
+
+    // Arguments are NUL separated; kernel threads have none
+    while (n > 0 && buffer[n - 1] == '\0')
+        n--;
+    if (n <= 0) {
+        char *bracketed = malloc(strlen(name) + 3);
+        if (bracketed)
+            sprintf(bracketed, "[%s]", name);
+        return bracketed;
+    }
+    for (ssize_t i = 0; i < n; i++) {
+        if (buffer[i] == '\0')
+            buffer[i] = ' ';
+    }
+    buffer[n] = '\0';
+    return strdup(buffer);
+}
+
+// Read only what the requested columns need
+static void read_record(PsRecord *record, unsigned columns) {
+    char path[64];
+    char buffer[1024];
+
+    if (columns & PS_STAT_COLUMNS) {
+        snprintf(path, sizeof(path), "/proc/%d/stat", record->pid);
+        if (read_proc_file(path, buffer, sizeof(buffer)) <= 0 ||
+            !proc_parse_stat(buffer, &record->stat))
+            return;
+    }
+
+    if (columns & PS_USER) {
+        struct stat st;
+        snprintf(path, sizeof(path), "/proc/%d", record->pid);
+        if (stat(path, &st) != 0)
+            return;
+        record->uid = st.st_uid;
+    }
+
+    if (columns & PS_COMMAND)
+        record->command = read_command(record->pid, record->stat.name);
+
+    record->ok = 1;
+}
+
+static void *read_records(void *arg) {
+    PsWork *work = arg;
+    for (int i = 0; i < work->count; i++)
+        read_record(&work->records[i], work->columns);
+    return NULL;
+}
+
+static const char *user_name(PsUser *cache, int *cached, uid_t uid) {
+    for (int i = 0; i < *cached; i++) {
+        if (cache[i].uid == uid)
+            return cache[i].name;
+    }
+
+    PsUser *user = &cache[*cached < PS_USER_CACHE ? (*cached)++ : 0];
+    struct passwd pw, *result = NULL;
+    char buffer[1024];
+    user->uid = uid;
+    if (getpwuid_r(uid, &pw, buffer, sizeof(buffer), &result) == 0 && result)
+        snprintf(user->name, sizeof(user->name), "%s", pw.pw_name);
+    else
+        snprintf(user->name, sizeof(user->name), "%u", (unsigned)uid);
+    return user->name;
+}
+
+static void format_memory(unsigned long bytes, char *buffer, size_t size) {
+    if (bytes < 1024)
+        snprintf(buffer, size, "%lu B", bytes);
+    else if (bytes < 1024 * 1024)
+        snprintf(buffer, size, "%.1f KB", bytes / 1024.0);
+    else if (bytes < 1024UL * 1024 * 1024)
+        snprintf(buffer, size, "%.1f MB", bytes / (1024.0 * 1024.0));
+    else
+        snprintf(buffer, size, "%.1f GB", bytes / (1024.0 * 1024.0 * 1024.0));
+}
+
+static double read_uptime(void) {
+    char buffer[64];
+    if (read_proc_file("/proc/uptime", buffer, sizeof(buffer)) <= 0)
+        return 0;
+    return atof(buffer);
+}
+
+static void set_string(DataValue *cell, ValueType type, const char *text) {
+    cell->type = type;
+    cell->value.str_val = strdup(text);
+}
+
+TableData *ps_table(unsigned columns) {
+    if (!columns)
+        columns = PS_DEFAULT_COLUMNS;
+
+    char *headers[PS_COLUMN_COUNT];
+    int header_count = 0;
+    for (int i = 0; i < PS_COLUMN_COUNT; i++) {
+        if (columns & ps_columns[i].column)
+            headers[header_count++] = (char *)ps_columns[i].header;
+    }
 
-TableData* lsh_ps_structured(char **args) {
-    // Define our table headers
-    char *headers[] = {"PID", "Name", "Memory", "Threads"};
-    int header_count = 4;
-    
-    // Create our table
     TableData *table = create_table(headers, header_count);
     if (!table) {
-        fprintf(stderr, "lsh: allocation error in ps_structured\n");
+        fprintf(stderr, "lsh: allocation error in ps\n");
         return NULL;
     }
-    
-    // Use system's ps command to get process info
-    FILE *fp = popen("ps -e -o pid,comm,vsz,nlwp --no-headers", "r");
-    if (!fp) {
-        fprintf(stderr, "lsh: failed to execute ps command\n");
+
+    DIR *dir = opendir("/proc");
+    if (!dir) {
+        perror("lsh: ps: /proc");
         free_table(table);
         return NULL;
     }
-    
-    char line[1024];
-    while (fgets(line, sizeof(line), fp)) {
-        // Parse the line
-        char name[256] = {0};
-        unsigned long pid = 0, vsz = 0, threads = 0;
-        
-        sscanf(line, "%lu %255s %lu %lu", &pid, name, &vsz, &threads);
-        
-        // Create a new row for this process
-        DataValue *row = (DataValue*)malloc(header_count * sizeof(DataValue));
+
+    PsRecord *records = NULL;
+    int count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9')
+            continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 512;
+            PsRecord *grown = realloc(records, capacity * sizeof(PsRecord));
+            if (!grown) {
+                fprintf(stderr, "lsh: allocation error in ps\n");
+                closedir(dir);
+                free(records);
+                free_table(table);
+                return NULL;
+            }
+            records = grown;
+        }
+        memset(&records[count], 0, sizeof(PsRecord));
+        records[count++].pid = atoi(entry->d_name);
+    }
+    closedir(dir);
+
+    // Split the pids into contiguous slices, one per thread; this thread
+    // reads the first slice itself
+    int threads = 1;
+    if (count >= PS_PARALLEL_MIN) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = count / PS_PER_THREAD;
+        if (threads > cpus)
+            threads = (int)cpus;
+        if (threads > PS_MAX_THREADS)
+            threads = PS_MAX_THREADS;
+        if (threads < 1)
+            threads = 1;
+    }
+
+    int slice = (count + threads - 1) / threads;
+    PsWork work[PS_MAX_THREADS];
+    pthread_t ids[PS_MAX_THREADS];
+    int started[PS_MAX_THREADS] = {0};
+    for (int t = 0; t < threads; t++) {
+        int first = t * slice;
+        int last = first + slice < count ? first + slice : count;
+        work[t].records = records + first;
+        work[t].count = last > first ? last - first : 0;
+        work[t].columns = columns;
+        if (t > 0)
+            started[t] = pthread_create(&ids[t], NULL, read_records,
+                                        &work[t]) == 0;
+    }
+    read_records(&work[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t])
+            pthread_join(ids[t], NULL);
+        else
+            read_records(&work[t]);
+    }
+
+    double ticks = (double)sysconf(_SC_CLK_TCK);
+    unsigned long page_size = (unsigned long)sysconf(_SC_PAGESIZE);
+    double uptime = read_uptime();
+    time_t boot_time = time(NULL) - (time_t)uptime;
+    PsUser users[PS_USER_CACHE];
+    int cached_users = 0;
+
+    for (int i = 0; i < count; i++) {
+        PsRecord *record = &records[i];
+        if (!record->ok)
+            continue;
+
+        DataValue *row = malloc(header_count * sizeof(DataValue));
         if (!row) {
-            fprintf(stderr, "lsh: allocation error in ps_structured\n");
-            free_table(table);
-            pclose(fp);
-            return NULL;
+            fprintf(stderr, "lsh: allocation error in ps\n");
+            break;
         }
-        
-        // Set PID (as a string for compatibility)
-        char pidStr[20];
-        sprintf(pidStr, "%lu", pid);
-        row[0].type = TYPE_STRING;
-        row[0].value.str_val = strdup(pidStr);
-        
-        // Set process name
-        row[1].type = TYPE_STRING;
-        row[1].value.str_val = strdup(name);
-        
-        // Format memory usage string (important for filtering)
-        char memoryString[32];
-        if (vsz < 1024) {
-            sprintf(memoryString, "%lu B", vsz);
-        } else if (vsz < 1024 * 1024) {
-            sprintf(memoryString, "%.1f KB", vsz / 1024.0);
-        } else {
-            // Format as MB for consistency in filtering
-            sprintf(memoryString, "%.1f MB", vsz / (1024.0 * 1024.0));
+
+        int cell_index = 0;
+        for (int c = 0; c < PS_COLUMN_COUNT; c++) {
+            if (!(columns & ps_columns[c].column))
+                continue;
+
+            DataValue *cell = &row[cell_index++];
+            cell->is_highlighted = 0;
+            char text[64];
+            switch (ps_columns[c].column) {
+            case PS_PID:
+                cell->type = TYPE_INT;
+                cell->value.int_val = record->pid;
+                break;
+            case PS_NAME:
+                set_string(cell, TYPE_STRING, record->stat.name);
+                cell->is_highlighted = record->stat.state == 'R';
+                break;
+            case PS_USER:
+                set_string(cell, TYPE_STRING,
+                           user_name(users, &cached_users, record->uid));
+                break;
+            case PS_CPU: {
+                // Share of the process lifetime spent on a CPU
+                double alive = uptime - record->stat.start_time / ticks;
+                cell->type = TYPE_FLOAT;
+                cell->value.float_val =
+                    alive > 0 ? (float)(record->stat.cpu_ticks / ticks /
+                                        alive * 100.0)
+                              : 0.0f;
+                break;
+            }
+            case PS_MEMORY:
+                format_memory(record->stat.rss_pages * page_size, text,
+                              sizeof(text));
+                set_string(cell, TYPE_SIZE, text);
+                break;
+            case PS_STATE:
+                text[0] = record->stat.state;
+                text[1] = '\0';
+                set_string(cell, TYPE_STRING, text);
+                break;
+            case PS_THREADS:
+                cell->type = TYPE_INT;
+                cell->value.int_val = record->stat.threads;
+                break;
+            case PS_STARTED: {
+                time_t started_at =
+                    boot_time + (time_t)(record->stat.start_time / ticks);
+                struct tm tm_info;
+                localtime_r(&started_at, &tm_info);
+                strftime(text, sizeof(text), "%Y-%m-%d %H:%M", &tm_info);
+                set_string(cell, TYPE_STRING, text);
+                break;
+            }
+            case PS_COMMAND:
+                // The table takes the string read on the worker thread
+                cell->type = TYPE_STRING;
+                cell->value.str_val =
+                    record->command ? record->command : strdup("");
+                record->command = NULL;
+                break;
+            }
         }
-        
-        row[2].type = TYPE_SIZE;  // Use the special SIZE type for filtering
-        row[2].value.str_val = strdup(memoryString);
-        
-        // Set thread count
-        char threadStr[20];
-        sprintf(threadStr, "%lu", threads);
-        row[3].type = TYPE_STRING;
-        row[3].value.str_val = strdup(threadStr);
-        
-        // Add the row to the table
+
         add_table_row(table, row);
     }
-    
-    pclose(fp);
+
+    for (int i = 0; i < count; i++)
+        free(records[i].command);
+    free(records);
     return table;
 }
 
+static unsigned column_named(const char *name, size_t len) {
+    for (int i = 0; i < PS_COLUMN_COUNT; i++) {
+        if (strlen(ps_columns[i].header) == len &&
+            strncasecmp(ps_columns[i].header, name, len) == 0)
+            return ps_columns[i].column;
+    }
+    return 0;
+}
+
+// A select argument may hold several comma separated fields
+static unsigned columns_named(const char *arg) {
+    unsigned columns = 0;
+    while (*arg) {
+        while (*arg == ',' || isspace((unsigned char)*arg))
+            arg++;
+        size_t len = strcspn(arg, ", \t");
+        columns |= column_named(arg, len);
+        arg += len;
+    }
+    return columns;
+}
+
+unsigned ps_pipeline_columns(char ***commands) {
+    unsigned columns = 0;
+    for (int i = 1; commands[i] != NULL; i++) {
+        char **args = commands[i];
+        if (!args[0] || !args[1])
+            continue;
+
+        // Stages after a select only see what it kept
+        if (strcmp(args[0], "select") == 0) {
+            for (int j = 1; args[j] != NULL; j++)
+                columns |= columns_named(args[j]);
+            return columns;
+        }
+        if (strcmp(args[0], "where") == 0 || strcmp(args[0], "sort-by") == 0 ||
+            strcmp(args[0], "contains") == 0)
+            columns |= column_named(args[1], strlen(args[1]));
+    }
+    return columns | PS_DEFAULT_COLUMNS;
+}
+
+TableData *lsh_ps_structured(char **args) {
+    (void)args;
+    return ps_table(PS_DEFAULT_COLUMNS);
+}
+
 int lsh_ps_fancy(char **args) {
     // Create structured data table for processes
     TableData *table = lsh_ps_structured(args);
-    
+
     if (table) {
         // Print the table using our nice formatting
         print_table(table);
-        
+
         // Free the table
         free_table(table);
     }
-    
+
     return 1;
-}
\ No newline at end of file
+}
@@ -2,6 +2,8 @@
 #include "aliases.h"
 #include "common.h"
 #include "system_monitor.h"
+#include "monitor_sampler.h"
+#include "proc_sampler.h"
 #include <ncurses.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -95,14 +97,14 @@ void recreate_windows(NCursesMonitor *monitor) {
   clearok(stdscr, TRUE);
   refresh();
 
+  // The new windows are blank; repaint everything on the next frame
+  monitor->drawn_valid = 0;
+
   // reset the resize flag
   monitor->resize_flag = 0;
 }
 
 int builtin_monitor(char **args) {
-  SystemStats stats;
-  ProcessInfo processes[500]; // Increased from 50 to 500 processes
-  int proc_count;
   NCursesMonitor monitor;
   int refresh_rate = 1;
 
@@ -119,38 +121,41 @@ int builtin_monitor(char **args) {
       refresh_rate = 1;
   }
 
+  // Sampling runs on its own thread; this loop only handles input and draws
+  // the newest snapshot it has taken
+  MonitorSampler *sampler = monitor_sampler_start(refresh_rate);
+  if (!sampler) {
+    fprintf(stderr, "Failed to start the monitor sampler\n");
+    return 1;
+  }
+
   // init ncurses monitor
   if (!init_ncurses_monitor(&monitor)) {
     fprintf(stderr, "Failed to initialize ncurses monitor\n");
+    monitor_sampler_stop(sampler);
     return 1;
   }
 
   monitor.refresh_rate = refresh_rate;
   timeout(100); // Short timeout for responsive input, 100ms
 
-  time_t last_update = 0;
-
-  // Initial data load
-  get_system_stats(&stats);
-  proc_count = get_process_info(processes, 500);
-  last_update = time(NULL);
+  MonitorSnapshot *snapshot = NULL;
 
   while (1) {
     // check for terminal resize
     if (monitor.resize_flag) {
       recreate_windows(&monitor);
     }
-    time_t current_time = time(NULL);
 
-    // Only update system stats at the specified refresh interval
-    if (current_time - last_update >= refresh_rate) {
-      get_system_stats(&stats);
-      proc_count = get_process_info(processes, 500);
-      last_update = current_time;
+    MonitorSnapshot *latest = monitor_sampler_take(sampler);
+    if (latest) {
+      monitor_snapshot_free(snapshot);
+      snapshot = latest;
     }
 
     // Always update the display (for navigation highlighting)
-    display_ncurses_dashboard(&monitor, &stats, processes, proc_count);
+    if (snapshot)
+      display_ncurses_dashboard(&monitor, snapshot);
 
     int ch = getch();
 
@@ -170,10 +175,10 @@ int builtin_monitor(char **args) {
         if (ch == 'q' || ch == 'Q')
           break;
         if (ch == 'r' || ch == 'R') {
-          // Force immediate refresh
-          get_system_stats(&stats);
-          proc_count = get_process_info(processes, 500);
-          last_update = current_time;
+          // Force immediate refresh and repaint the whole screen
+          monitor_sampler_wake(sampler);
+          monitor.drawn_valid = 0;
+          clearok(curscr, TRUE);
           continue;
         }
         handle_monitor_input(&monitor, ch);
@@ -181,7 +186,10 @@ int builtin_monitor(char **args) {
     }
   }
 
+  // Leave the screen first; stopping waits for a sample in progress
   cleanup_ncurses_monitor(&monitor);
+  monitor_sampler_stop(sampler);
+  monitor_snapshot_free(snapshot);
   return 1;
 }
 
@@ -257,6 +265,11 @@ void cleanup_ncurses_monitor(NCursesMonitor *monitor) {
   if (monitor->search_win)
     delwin(monitor->search_win);
 
+  process_view_free(&monitor->view);
+  for (int i = 0; i < monitor->drawn_row_count; i++)
+    free(monitor->drawn_rows[i]);
+  free(monitor->drawn_rows);
+
   // Restore default signal handler
   signal(SIGWINCH, SIG_DFL);
   global_monitor = NULL;
@@ -341,6 +354,14 @@ void handle_monitor_input(NCursesMonitor *monitor, int ch) {
     }
     break;
 
+  case 's':
+  case 'S':
+    // Cycle the sort order and start again from the top
+    monitor->sort_key = (monitor->sort_key + 1) % SORT_KEYS;
+    monitor->selected_process = 0;
+    monitor->process_scroll_offset = 0;
+    break;
+
   case KEY_HOME:
   case 'g':
     monitor->selected_process = 0;
@@ -355,13 +376,137 @@ void handle_monitor_input(NCursesMonitor *monitor, int ch) {
   }
 }
 
-void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
-                               ProcessInfo *processes, int proc_count) {
-  if (!monitor || !stats || !processes)
+// Draw the newest samples as a one-line chart ending at x + width. With
+// scale <= 0 the chart is scaled to its largest visible value.
+static void draw_sparkline(WINDOW *win, int y, int x, int width,
+                           const float *values, int count, float scale) {
+  static const char ramp[] = " .:-=+*#%@";
+  const int levels = (int)sizeof(ramp) - 2;
+
+  if (width <= 0 || count <= 0)
+    return;
+  int first = count > width ? count - width : 0;
+
+  if (scale <= 0) {
+    for (int i = first; i < count; i++) {
+      if (values[i] > scale)
+        scale = values[i];
+    }
+    if (scale <= 0)
+      scale = 1;
+  }
+
+  wmove(win, y, x + width - (count - first));
+  for (int i = first; i < count; i++) {
+    int level = (int)(values[i] / scale * levels + 0.5f);
+    if (level > levels)
+      level = levels;
+    if (level < 1 && values[i] > 0)
+      level = 1; // Keep any activity visible
+    waddch(win, ramp[level < 0 ? 0 : level]);
+  }
+}
+
+// Size the process row cache to the window and mark every row blank, to
+// match a window that was just erased
+static int reset_drawn_rows(NCursesMonitor *monitor, int rows, int width) {
+  for (int i = 0; i < monitor->drawn_row_count; i++)
+    free(monitor->drawn_rows[i]);
+  free(monitor->drawn_rows);
+  monitor->drawn_rows = NULL;
+  monitor->drawn_row_count = 0;
+
+  if (rows <= 0)
+    return 1;
+  monitor->drawn_rows = calloc((size_t)rows, sizeof(char *));
+  if (!monitor->drawn_rows)
+    return 0;
+  for (int i = 0; i < rows; i++) {
+    monitor->drawn_rows[i] = calloc((size_t)width + 2, 1);
+    if (!monitor->drawn_rows[i])
+      return 0;
+    monitor->drawn_row_count++;
+  }
+  return 1;
+}
+
+// Has anything the process list, stats or status bar show changed since
+// the last frame?
+static int monitor_view_changed(const NCursesMonitor *monitor,
+                                const MonitorSnapshot *snapshot) {
+  return snapshot->sequence != monitor->drawn_sequence ||
+         monitor->selected_process != monitor->drawn_selected ||
+         monitor->process_scroll_offset != monitor->drawn_scroll ||
+         monitor->sort_key != monitor->drawn_sort ||
+         monitor->search_mode != monitor->drawn_search_mode ||
+         monitor->search_cursor != monitor->drawn_search_cursor ||
+         strcmp(monitor->search_buffer, monitor->drawn_search) != 0;
+}
+
+void display_ncurses_dashboard(NCursesMonitor *monitor,
+                               const MonitorSnapshot *snapshot) {
+  if (!monitor || !snapshot)
     return;
 
   time_t now = time(NULL);
-  struct tm *tm_info = localtime(&now);
+  int full = !monitor->drawn_valid;
+  int clock_changed = full || now != monitor->drawn_clock;
+  int view_changed = full || monitor_view_changed(monitor, snapshot);
+
+  // Nothing new since the last frame: leave the terminal alone
+  if (!clock_changed && !view_changed)
+    return;
+
+  int max_visible = getmaxy(monitor->process_win) - 3;
+  int row_width = getmaxx(monitor->process_win) - 2; // Inside the border
+
+  if (full) {
+    werase(monitor->header_win);
+    werase(monitor->stats_win);
+    werase(monitor->process_win);
+    werase(monitor->status_win);
+    if (!reset_drawn_rows(monitor, max_visible, row_width))
+      return;
+    box(monitor->process_win, 0, 0);
+    if (has_colors())
+      wattron(monitor->process_win, COLOR_PAIR(1));
+    mvwprintw(monitor->process_win, 1, 2,
+              "PID    Name                     State  CPU%%    Memory");
+    if (has_colors())
+      wattroff(monitor->process_win, COLOR_PAIR(1));
+  }
+
+  // The clock is the only thing that changes between samples
+  if (clock_changed) {
+    struct tm *tm_info = localtime(&now);
+    werase(monitor->header_win);
+    if (has_colors())
+      wattron(monitor->header_win, COLOR_PAIR(1));
+    box(monitor->header_win, 0, 0);
+    mvwprintw(monitor->header_win, 1, (monitor->terminal_width - 24) / 2,
+              "SYSTEM MONITOR DASHBOARD");
+    mvwprintw(monitor->header_win, 2, (monitor->terminal_width - 19) / 2,
+              "%02d:%02d:%02d %02d/%02d/%04d", tm_info->tm_hour,
+              tm_info->tm_min, tm_info->tm_sec, tm_info->tm_mday,
+              tm_info->tm_mon + 1, tm_info->tm_year + 1900);
+    if (has_colors())
+      wattroff(monitor->header_win, COLOR_PAIR(1));
+    wnoutrefresh(monitor->header_win);
+    monitor->drawn_clock = now;
+  }
+
+  if (!view_changed) {
+    doupdate();
+    return;
+  }
+
+  const SystemStats *stats = &snapshot->stats;
+  ProcessInfo *processes = snapshot->processes;
+  int proc_count = snapshot->process_count;
+  const int history_len = snapshot->history_len;
+  const int last = history_len - 1; // Every snapshot holds its own sample
+  const float(*history)[MONITOR_HISTORY] = snapshot->history;
+
   char mem_used_str[32], mem_total_str[32];
   char disk_read_str[32], disk_write_str[32];
   char net_rx_str[32], net_tx_str[32];
@@ -371,10 +516,14 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
   float mem_percent = (float)stats->memory_used / stats->memory_total * 100;
   format_bytes(stats->memory_used, mem_used_str);
   format_bytes(stats->memory_total, mem_total_str);
-  format_bytes(stats->disk_read, disk_read_str);
-  format_bytes(stats->disk_write, disk_write_str);
-  format_bytes(stats->net_rx, net_rx_str);
-  format_bytes(stats->net_tx, net_tx_str);
+  format_bytes((unsigned long)history[MONITOR_DISK_READ][last],
+               disk_read_str);
+  format_bytes((unsigned long)history[MONITOR_DISK_WRITE][last],
+               disk_write_str);
+  format_bytes((unsigned long)history[MONITOR_NET_RX][last],
+               net_rx_str);
+  format_bytes((unsigned long)history[MONITOR_NET_TX][last],
+               net_tx_str);
   
   // Format GPU memory if available
   if (stats->gpu_memory_total > 0) {
@@ -382,26 +531,8 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
     format_bytes(stats->gpu_memory_total, gpu_total_str);
   }
 
-  // Clear all windows
-  werase(monitor->header_win);
-  werase(monitor->stats_win);
-  werase(monitor->process_win);
-  werase(monitor->status_win);
-
-  // Draw header
-  if (has_colors())
-    wattron(monitor->header_win, COLOR_PAIR(1));
-  box(monitor->header_win, 0, 0);
-  mvwprintw(monitor->header_win, 1, (monitor->terminal_width - 24) / 2,
-            "SYSTEM MONITOR DASHBOARD");
-  mvwprintw(monitor->header_win, 2, (monitor->terminal_width - 19) / 2,
-            "%02d:%02d:%02d %02d/%02d/%04d", tm_info->tm_hour, tm_info->tm_min,
-            tm_info->tm_sec, tm_info->tm_mday, tm_info->tm_mon + 1,
-            tm_info->tm_year + 1900);
-  if (has_colors())
-    wattroff(monitor->header_win, COLOR_PAIR(1));
-
   // Draw system stats
+  werase(monitor->stats_win);
   box(monitor->stats_win, 0, 0);
   if (has_colors())
     wattron(monitor->stats_win, COLOR_PAIR(1));
@@ -413,9 +544,17 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
 
   int col1_width = monitor->terminal_width / 2 - 2;
   int col2_start = col1_width + 1;
+  int has_gpu = stats->gpu_percent > 0 || stats->gpu_memory_total > 0;
+
+  // Sparklines fill the space between the values and the GPU column
+  int spark_start = 40;
+  int spark_end = has_gpu ? col2_start - 2 : monitor->terminal_width - 3;
+  int spark_width = spark_end - spark_start;
 
   mvwprintw(monitor->stats_win, 1, 2, "CPU: %5.1f%%", stats->cpu_percent);
-  if (stats->gpu_percent > 0 || stats->gpu_memory_total > 0) {
+  draw_sparkline(monitor->stats_win, 1, spark_start, spark_width,
+                 history[MONITOR_CPU], history_len, 100.0f);
+  if (has_gpu) {
     mvwprintw(monitor->stats_win, 1, col2_start, "GPU: %5.1f%%",
               stats->gpu_percent);
   }
@@ -424,6 +563,8 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
 
   mvwprintw(monitor->stats_win, 2, 2, "MEM: %5.1f%% (%s/%s)", mem_percent,
             mem_used_str, mem_total_str);
+  draw_sparkline(monitor->stats_win, 2, spark_start, spark_width,
+                 history[MONITOR_MEM], history_len, 100.0f);
   if (stats->gpu_memory_total > 0) {
     float gpu_mem_percent = (float)stats->gpu_memory_used / stats->gpu_memory_total * 100;
     mvwprintw(monitor->stats_win, 2, col2_start, "GPU MEM: %5.1f%% (%s/%s)",
@@ -431,32 +572,35 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
   }
   
   // Third row: Disk I/O
-  mvwprintw(monitor->stats_win, 3, 2, "DISK: R:%s W:%s", disk_read_str, disk_write_str);
+  mvwprintw(monitor->stats_win, 3, 2, "DISK: R:%s/s W:%s/s", disk_read_str,
+            disk_write_str);
+  float disk_total[MONITOR_HISTORY];
+  for (int i = 0; i < history_len; i++)
+    disk_total[i] = history[MONITOR_DISK_READ][i] +
+                    history[MONITOR_DISK_WRITE][i];
+  draw_sparkline(monitor->stats_win, 3, spark_start, spark_width, disk_total,
+                 history_len, 0);
   
   // Fourth row: Network I/O
-  mvwprintw(monitor->stats_win, 4, 2, "NET: RX:%s TX:%s", net_rx_str, net_tx_str);
-
-  // Filter processes based on search in real-time
-  ProcessInfo *display_processes = processes;
-  int display_count = proc_count;
-  ProcessInfo *temp_processes = NULL;
-
-  // Apply filter in real-time when search buffer has content (even during
-  // typing)
-  if (strlen(monitor->search_buffer) > 0) {
-    temp_processes = malloc(proc_count * sizeof(ProcessInfo));
-    display_count = 0;
-    for (int i = 0; i < proc_count; i++) {
-      if (strcasestr(processes[i].name, monitor->search_buffer) != NULL) {
-        temp_processes[display_count] = processes[i];
-        display_count++;
-      }
-    }
-    display_processes = temp_processes;
-  }
+  mvwprintw(monitor->stats_win, 4, 2, "NET: RX:%s/s TX:%s/s", net_rx_str,
+            net_tx_str);
+  float net_total[MONITOR_HISTORY];
+  for (int i = 0; i < history_len; i++)
+    net_total[i] = history[MONITOR_NET_RX][i] +
+                   history[MONITOR_NET_TX][i];
+  draw_sparkline(monitor->stats_win, 4, spark_start, spark_width, net_total,
+                 history_len, 0);
+
+  // Filter processes based on search in real-time (even during typing).
+  // Typing more of the query only narrows the previous matches.
+  ProcessView *view = &monitor->view;
+  if (!process_view_filter(view, processes, proc_count, snapshot->sequence,
+                           monitor->search_buffer))
+    return;
+  int display_count = view->count;
 
-  // Draw process list
-  box(monitor->process_win, 0, 0);
+  // Draw the process list title over the top border it replaces
+  mvwhline(monitor->process_win, 0, 1, ACS_HLINE, row_width);
   if (has_colors())
     wattron(monitor->process_win, COLOR_PAIR(1));
 
@@ -478,20 +622,13 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
                 display_count);
     }
   } else {
-    mvwprintw(monitor->process_win, 0, 2, " All Processes (by CPU) ");
+    mvwprintw(monitor->process_win, 0, 2, " All Processes (by %s) ",
+              process_sort_name(monitor->sort_key));
   }
 
-  mvwprintw(monitor->process_win, 1, 2,
-            "PID    Name                     State  CPU%%    Memory");
   if (has_colors())
     wattroff(monitor->process_win, COLOR_PAIR(1));
 
-  int max_visible = getmaxy(monitor->process_win) - 3;
-
-  int end_index = monitor->process_scroll_offset + max_visible;
-  if (end_index > display_count)
-    end_index = display_count;
-
   // Clamp selected process to valid range
   if (monitor->selected_process >= display_count) {
     monitor->selected_process = display_count - 1;
@@ -505,16 +642,39 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
     monitor->selected_process = 0;
   }
 
-  for (int i = monitor->process_scroll_offset; i < end_index; i++) {
-    int line = i - monitor->process_scroll_offset + 2;
-    char mem_str[32];
-    format_bytes(display_processes[i].memory, mem_str);
+  int end_index = monitor->process_scroll_offset + max_visible;
+  if (end_index > display_count)
+    end_index = display_count;
 
-    // Clear the line first
-    wmove(monitor->process_win, line, 2);
-    wclrtoeol(monitor->process_win);
+  // Only the visible rows are put in order
+  process_view_order(view, processes, monitor->sort_key,
+                     monitor->process_scroll_offset, end_index);
+
+  // Repaint only the rows whose text or highlight differs from what is on
+  // screen. The first byte of each cached row records the highlight.
+  char *row_text = malloc((size_t)row_width + 2);
+  for (int line = 0; row_text && line < monitor->drawn_row_count; line++) {
+    int i = monitor->process_scroll_offset + line;
+    int selected = i == monitor->selected_process;
+
+    row_text[0] = selected ? '*' : ' ';
+    row_text[1] = '\0';
+    if (i < end_index) {
+      const ProcessInfo *process = &processes[view->rows[i]];
+      char mem_str[32];
+      format_bytes(process->memory, mem_str);
+      snprintf(row_text + 1, (size_t)row_width + 1,
+               " %-6d %-24s %-6c %6.1f%% %s", process->pid, process->name,
+               process->state, process->cpu_percent, mem_str);
+    } else {
+      row_text[0] = '\0'; // A blank line is never highlighted
+    }
 
-    if (i == monitor->selected_process) {
+    if (strcmp(row_text, monitor->drawn_rows[line]) == 0)
+      continue;
+    strcpy(monitor->drawn_rows[line], row_text);
+
+    if (selected && i < end_index) {
       if (has_colors()) {
         wattron(monitor->process_win, COLOR_PAIR(5) | A_REVERSE);
       } else {
@@ -522,12 +682,11 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
       }
     }
 
-    mvwprintw(monitor->process_win, line, 2, "%-6d %-24s %-6c %6.1f%% %s",
-              display_processes[i].pid, display_processes[i].name,
-              display_processes[i].state, display_processes[i].cpu_percent,
-              mem_str);
+    // Pad to the border so the previous text is overwritten
+    mvwprintw(monitor->process_win, line + 2, 1, "%-*.*s", row_width,
+              row_width, row_text[0] ? row_text + 1 : "");
 
-    if (i == monitor->selected_process) {
+    if (selected && i < end_index) {
       if (has_colors()) {
         wattroff(monitor->process_win, COLOR_PAIR(5) | A_REVERSE);
       } else {
@@ -535,13 +694,22 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
       }
     }
   }
-
-  // Free temporary filtered array
-  if (temp_processes) {
-    free(temp_processes);
+  free(row_text);
+
+  // Fifth row: CPU history of the selected process, when there is room
+  if (getmaxy(monitor->stats_win) > 6 &&
+      monitor->selected_process >= monitor->process_scroll_offset &&
+      monitor->selected_process < end_index) {
+    const ProcessInfo *selected =
+        &processes[view->rows[monitor->selected_process]];
+    mvwprintw(monitor->stats_win, 5, 2, "PID %-6d %-.*s", selected->pid,
+              spark_start - 14, selected->name);
+    draw_sparkline(monitor->stats_win, 5, spark_start, spark_width,
+                   selected->cpu_history, selected->history_len, 100.0f);
   }
 
   // Draw status bar
+  werase(monitor->status_win);
   if (has_colors())
     wattron(monitor->status_win, COLOR_PAIR(1));
 
@@ -570,8 +738,8 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
     }
   } else {
     mvwprintw(monitor->status_win, 0, 2,
-              "Press 'q' quit, 'r' refresh, '/' search, j/k arrows navigate, "
-              "ESC clear");
+              "Press 'q' quit, 'r' refresh, '/' search, 's' sort, j/k arrows "
+              "navigate, ESC clear");
     mvwprintw(monitor->status_win, 1, 2,
               "Refresh: %ds | Processes: %d/%d | Selected: %d | Scroll: %d",
               monitor->refresh_rate, display_count, proc_count,
@@ -581,13 +749,21 @@ void display_ncurses_dashboard(NCursesMonitor *monitor, SystemStats *stats,
   if (has_colors())
     wattroff(monitor->status_win, COLOR_PAIR(1));
 
-  // Always refresh all windows
-  wrefresh(monitor->header_win);
-  wrefresh(monitor->stats_win);
-  wrefresh(monitor->process_win);
-  wrefresh(monitor->status_win);
-
-  refresh();
+  // Queue the changed windows and write them to the terminal in one go
+  wnoutrefresh(monitor->stats_win);
+  wnoutrefresh(monitor->process_win);
+  wnoutrefresh(monitor->status_win);
+  doupdate();
+
+  monitor->drawn_valid = 1;
+  monitor->drawn_sequence = snapshot->sequence;
+  monitor->drawn_selected = monitor->selected_process;
+  monitor->drawn_scroll = monitor->process_scroll_offset;
+  monitor->drawn_sort = monitor->sort_key;
+  monitor->drawn_search_mode = monitor->search_mode;
+  monitor->drawn_search_cursor = monitor->search_cursor;
+  snprintf(monitor->drawn_search, sizeof(monitor->drawn_search), "%s",
+           monitor->search_buffer);
 }
 
 void display_dashboard(SystemStats *stats, ProcessInfo *processes,
@@ -713,18 +889,25 @@ void get_system_stats(SystemStats *stats) {
   stats->gpu_memory_used = 0;
   stats->gpu_memory_total = 0;
 
+  // Stop spawning the probe once it has shown there is no NVIDIA GPU
+  static int gpu_probe_failed = 0;
   FILE *gpu_file =
-      popen("nvidia-smi --query-gpu=utilization.gpu,memory.used,memory.total "
-            "--format=csv,noheader,nounits 2>/dev/null",
-            "r");
+      gpu_probe_failed
+          ? NULL
+          : popen("nvidia-smi "
+                  "--query-gpu=utilization.gpu,memory.used,memory.total "
+                  "--format=csv,noheader,nounits 2>/dev/null",
+                  "r");
 
   if (gpu_file) {
     char line[256];
-    if (fgets(line, sizeof(line), gpu_file)) {
-      sscanf(line, "%f, %lu, %lu", &stats->gpu_percent, &stats->gpu_memory_used,
-             &stats->gpu_memory_total);
+    if (fgets(line, sizeof(line), gpu_file) &&
+        sscanf(line, "%f, %lu, %lu", &stats->gpu_percent,
+               &stats->gpu_memory_used, &stats->gpu_memory_total) == 3) {
       stats->gpu_memory_used *= 1024 * 1024; // Convert MB to bytes
       stats->gpu_memory_total *= 1024 * 1024; // Convert MB to bytes
+    } else {
+      gpu_probe_failed = 1;
     }
     pclose(gpu_file);
   }
@@ -809,90 +992,6 @@ void get_system_stats(SystemStats *stats) {
   }
 }
 
-int get_process_info(ProcessInfo *processes, int max_processes) {
-  DIR *proc_dir;
-  struct dirent *entry;
-  FILE *fp;
-  char path[256];
-  char buffer[1024];
-  int count = 0;
-
-  proc_dir = opendir("/proc");
-  if (!proc_dir)
-    return 0;
-
-  while ((entry = readdir(proc_dir)) != NULL && count < max_processes) {
-    if (!isdigit(entry->d_name[0]))
-      continue;
-
-    int pid = atoi(entry->d_name);
-    processes[count].pid = pid;
-    processes[count].memory = 0;
-    processes[count].cpu_percent = 0.0;
-    processes[count].state = '?';
-    strcpy(processes[count].name, "unknown");
-
-    // Get process name and state from /proc/pid/stat
-    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
-    fp = fopen(path, "r");
-    if (fp) {
-      if (fgets(buffer, sizeof(buffer), fp)) {
-        char *name_start = strchr(buffer, '(');
-        char *name_end = strrchr(buffer, ')');
-        if (name_start && name_end) {
-          int name_len = name_end - name_start - 1;
-          if (name_len > 255)
-            name_len = 255;
-          if (name_len > 0) {
-            strncpy(processes[count].name, name_start + 1, name_len);
-            processes[count].name[name_len] = '\0';
-          }
-
-          // Parse state (first field after the name)
-          char *fields = name_end + 2;
-          if (fields && *fields) {
-            processes[count].state = *fields;
-          }
-        }
-      }
-      fclose(fp);
-    }
-
-    // Get memory usage from /proc/pid/statm (more reliable)
-    snprintf(path, sizeof(path), "/proc/%d/statm", pid);
-    fp = fopen(path, "r");
-    if (fp) {
-      unsigned long size, resident, shared;
-      if (fscanf(fp, "%lu %lu %lu", &size, &resident, &shared) >= 2) {
-        // resident is in pages, convert to bytes (page size is typically 4096)
-        processes[count].memory = resident * 4096;
-      }
-      fclose(fp);
-    }
-
-    // Simple CPU estimation - use a random value for demonstration
-    // In a real implementation, you'd track CPU times over intervals
-    processes[count].cpu_percent = (rand() % 100) / 10.0; // 0.0 to 9.9%
-
-    count++;
-  }
-
-  closedir(proc_dir);
-
-  // Sort by CPU usage (highest to lowest) to show most active processes first
-  for (int i = 0; i < count - 1; i++) {
-    for (int j = i + 1; j < count; j++) {
-      if (processes[i].cpu_percent < processes[j].cpu_percent) {
-        ProcessInfo temp = processes[i];
-        processes[i] = processes[j];
-        processes[j] = temp;
-      }
-    }
-  }
-
-  return count;
-}
-
 void clear_screen(void) {
   printf("\033[2J\033[H");
   fflush(stdout);
@@ -1,9 +1,16 @@
 #include "ncurses_diff_viewer.h"
+#include "git_commit_graph.h"
 #include "git_integration.h"
+#include "git_jobs.h"
+#include "git_object_broker.h"
+#include "git_odb.h"
+#include "git_patch.h"
+#include "git_status.h"
 #include <bits/types/cookie_io_functions_t.h>
 #include <ctype.h>
 #include <locale.h>
 #include <ncurses.h>
+#include <poll.h>
 #include <signal.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -137,8 +144,8 @@ int init_ncurses_diff_viewer(NCursesDiffViewer* viewer) {
     viewer->branch_commit_count = 0;
     viewer->branch_commits_scroll_offset = 0;
     viewer->branch_commits_cursor_line = 0;
-    viewer->fetch_pid = -1;
     viewer->fetch_in_progress = 0;
+    viewer->pending_refresh = 0;
     memset(viewer->current_branch_for_commits, 0, sizeof(viewer->current_branch_for_commits));
 
     // Set locale for Unicode support
@@ -222,43 +229,82 @@ int init_ncurses_diff_viewer(NCursesDiffViewer* viewer) {
     return 1;
 }
 
+static int compare_changed_files(const void* a, const void* b) {
+    const NCursesChangedFile* file_a = a;
+    const NCursesChangedFile* file_b = b;
+    return strcmp(file_a->filename, file_b->filename);
+}
+
+// Index of path in the sorted file list, or -1
+int find_changed_file(const NCursesDiffViewer* viewer, const char* path) {
+    if (!viewer || !path)
+        return -1;
+
+    int low = 0;
+    int high = viewer->file_count - 1;
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+        int cmp = strcmp(viewer->files[mid].filename, path);
+        if (cmp == 0)
+            return mid;
+        if (cmp < 0)
+            low = mid + 1;
+        else
+            high = mid - 1;
+    }
+    return -1;
+}
+
 int get_ncurses_changed_files(NCursesDiffViewer* viewer) {
     if (!viewer)
         return 0;
 
-    FILE* fp = popen("git status --porcelain 2>/dev/null", "r");
-    if (!fp)
+    // Porcelain v2 with NUL separators keeps paths with spaces, quotes and
+    // renames intact, and is parsed while git is still writing it
+    GitStatus status;
+    git_status_init(&status);
+    NCursesChangedFile* files = NULL;
+    if (git_status_read(&status))
+        files = malloc((size_t)(status.count > 0 ? status.count : 1) * sizeof(NCursesChangedFile));
+
+    if (!files) {
+        git_status_free(&status);
+        free(viewer->files);
+        free(viewer->file_names);
+        viewer->files = NULL;
+        viewer->file_names = NULL;
+        viewer->file_count = 0;
         return 0;
+    }
 
-    viewer->file_count = 0;
-    char line[512];
-
-    while (fgets(line, sizeof(line), fp) != NULL && viewer->file_count < MAX_FILES) {
-        char* newline = strchr(line, '\n');
-        if (newline)
-            *newline = '\0';
-
-        if (strlen(line) < 3)
-            continue;
-
-        char staged_status = line[0];
-        char unstaged_status = line[1];
+    for (int i = 0; i < status.count; i++) {
+        const GitStatusEntry* entry = &status.entries[i];
+        NCursesChangedFile* file = &files[i];
 
-        char* filename = line + 3;
+        file->filename = status.names + entry->path;
+        file->orig_filename =
+            entry->orig_path != GIT_STATUS_NO_PATH ? status.names + entry->orig_path : NULL;
+        file->status =
+            entry->worktree_status != ' ' ? entry->worktree_status : entry->index_status;
+        file->has_staged_changes =
+            (entry->index_status != ' ' && entry->index_status != '?') ? 1 : 0;
 
-        viewer->files[viewer->file_count].status =
-            (unstaged_status != ' ' ? unstaged_status : staged_status);
-        viewer->files[viewer->file_count].marked_for_commit = 0;
-        viewer->files[viewer->file_count].has_staged_changes =
-            (staged_status != ' ' && staged_status != '?') ? 1 : 0;
+        // Marks survive a refresh for files that are still changed
+        int previous = find_changed_file(viewer, file->filename);
+        file->marked_for_commit = previous >= 0 ? viewer->files[previous].marked_for_commit : 0;
+    }
 
-        strncpy(viewer->files[viewer->file_count].filename, filename, MAX_FILENAME_LEN - 1);
-        viewer->files[viewer->file_count].filename[MAX_FILENAME_LEN - 1] = '\0';
+    // Tracked and untracked files come as two sorted runs
+    qsort(files, status.count, sizeof(NCursesChangedFile), compare_changed_files);
 
-        viewer->file_count++;
-    }
+    free(viewer->files);
+    free(viewer->file_names);
+    viewer->files = files;
+    viewer->file_names = status.names;
+    viewer->file_count = status.count;
 
-    pclose(fp);
+    status.names = NULL;
+    git_status_free(&status);
     return viewer->file_count;
 }
 
@@ -274,25 +320,40 @@ int create_temp_file_with_changes(const char* filename, char* temp_path) {
 int create_temp_file_git_version(const char* filename, char* temp_path) {
     snprintf(temp_path, 256, "/tmp/shell_diff_git_%d", getpid());
 
-    char cmd[1024];
-    snprintf(cmd, sizeof(cmd), "git show HEAD:\"%s\" > \"%s\" 2>/dev/null", filename, temp_path);
+    char rev[1024];
+    snprintf(rev, sizeof(rev), "HEAD:%s", filename);
 
-    return (system(cmd) == 0);
+    // Read the blob natively, the broker covers what the reader cannot
+    GitObject blob;
+    GitOdb* odb = git_odb_current();
+    if (!(odb && git_odb_read_path(odb, "HEAD", filename, &blob)) &&
+        !git_broker_read_object(rev, &blob))
+        return 0;
+
+    FILE* fp = fopen(temp_path, "w");
+    int ok = fp && fwrite(blob.data, 1, blob.size, fp) == blob.size;
+    if (fp)
+        fclose(fp);
+    git_object_free(&blob);
+
+    return ok;
 }
 
 int is_ncurses_new_file(const char* filename) {
-    char cmd[1024];
-    snprintf(cmd, sizeof(cmd), "git ls-files --error-unmatch \"%s\" 2>/dev/null", filename);
-
-    FILE* fp = popen(cmd, "r");
-    if (!fp)
-        return 1; // Assume new if we can't check
+    // ":<path>" names the index entry, so this matches git ls-files
+    char rev[1024];
+    snprintf(rev, sizeof(rev), ":%s", filename);
 
-    char output[256];
-    int is_tracked = (fgets(output, sizeof(output), fp) != NULL);
-    pclose(fp);
+    GitObject entry;
+    return !git_broker_object_info(rev, &entry); // Return 1 if not tracked (new file)
+}
 
-    return !is_tracked; // Return 1 if not tracked (new file)
+// "@@ -a[,b] +c[,d] @@" start lines; git leaves out counts of 1
+static void parse_hunk_starts(const char* header, int* old_start, int* new_start) {
+    const char* minus = strchr(header, '-');
+    const char* plus = minus ? strchr(minus, '+') : NULL;
+    *old_start = minus ? atoi(minus + 1) : 0;
+    *new_start = plus ? atoi(plus + 1) : 0;
 }
 
 int load_file_with_staging_info(NCursesDiffViewer* viewer, const char* filename) {
@@ -306,12 +367,15 @@ int load_file_with_staging_info(NCursesDiffViewer* viewer, const char* filename)
     viewer->staged_line_count = 0;
     viewer->staged_cursor_line = 0;
 
-    // Store current file path
-    strncpy(viewer->current_file_path, filename, sizeof(viewer->current_file_path) - 1);
-    viewer->current_file_path[sizeof(viewer->current_file_path) - 1] = '\0';
+    // Store current file path; reloads pass the stored path itself
+    if (filename != viewer->current_file_path) {
+        strncpy(viewer->current_file_path, filename, sizeof(viewer->current_file_path) - 1);
+        viewer->current_file_path[sizeof(viewer->current_file_path) - 1] = '\0';
+    }
 
     // Check if this is a new file
-    if (is_ncurses_new_file(filename)) {
+    viewer->current_file_is_new = is_ncurses_new_file(filename);
+    if (viewer->current_file_is_new) {
         // For new files, show first 50 lines as additions
         FILE* fp = fopen(filename, "r");
         if (!fp)
@@ -331,6 +395,7 @@ int load_file_with_staging_info(NCursesDiffViewer* viewer, const char* filename)
         hunk_line->line_number_old = 0;
         hunk_line->line_number_new = 1;
         hunk_line->is_context = 0;
+        hunk_line->no_eol = 0;
         viewer->file_line_count++;
 
         while (fgets(line, sizeof(line), fp) != NULL &&
@@ -349,6 +414,7 @@ int load_file_with_staging_info(NCursesDiffViewer* viewer, const char* filename)
             file_line->line_number_old = -1;
             file_line->line_number_new = line_count + 1;
             file_line->is_context = 0;
+            file_line->no_eol = !newline_pos && feof(fp);
 
             viewer->file_line_count++;
             line_count++;
@@ -387,16 +453,24 @@ int load_file_with_staging_info(NCursesDiffViewer* viewer, const char* filename)
             continue;
         }
 
+        // "\ No newline at end of file" belongs to the line before
+        if (diff_line[0] == '\\') {
+            if (viewer->file_line_count > 0)
+                viewer->file_lines[viewer->file_line_count - 1].no_eol = 1;
+            continue;
+        }
+
         NCursesFileLine* file_line = &viewer->file_lines[viewer->file_line_count];
         strncpy(file_line->line, diff_line, sizeof(file_line->line) - 1);
         file_line->line[sizeof(file_line->line) - 1] = '\0';
         file_line->is_staged = 0;
+        file_line->no_eol = 0;
 
         // Process hunk headers and content
         if (diff_line[0] == '@' && diff_line[1] == '@') {
             // Parse hunk header: @@ -old_start,old_count +new_start,new_count @@
             current_hunk++;
-            sscanf(diff_line, "@@ -%d,%*d +%d,%*d @@", &old_line_num, &new_line_num);
+            parse_hunk_starts(diff_line, &old_line_num, &new_line_num);
 
             file_line->type = '@';
             file_line->is_diff_line = 0;
@@ -441,189 +515,151 @@ int load_file_with_staging_info(NCursesDiffViewer* viewer, const char* filename)
     return viewer->file_line_count;
 }
 
-// this is a change
-// this is another change
+// Space on a change line marks it for the next batch; on a hunk header it
+// marks or clears the whole hunk. Nothing touches git until the batch is
+// applied.
 int stage_hunk_by_line(NCursesDiffViewer* viewer, int line_index) {
     if (!viewer)
         return 0;
 
-    if (viewer->active_pane == 0) {
-        // Unstaged pane - use line_index directly from file_lines
-        if (line_index < 0 || line_index >= viewer->file_line_count)
-            return 0;
-
-        NCursesFileLine* selected_line = &viewer->file_lines[line_index];
+    int staged_pane = viewer->active_pane != 0;
+    NCursesFileLine* lines = staged_pane ? viewer->staged_lines : viewer->file_lines;
+    int count = staged_pane ? viewer->staged_line_count : viewer->file_line_count;
 
-        // Don't stage/unstage hunk headers or context lines
-        if (selected_line->type == '@' || selected_line->type == ' ')
-            return 0;
+    if (line_index < 0 || line_index >= count)
+        return 0;
 
-        // Only stage actual diff lines (+ or -)
-        if (selected_line->type != '+' && selected_line->type != '-')
-            return 0;
+    NCursesFileLine* selected_line = &lines[line_index];
 
-        // Toggle the staging state
+    if (selected_line->type == '+' || selected_line->type == '-') {
         selected_line->is_staged = !selected_line->is_staged;
-
-    } else {
-        // Staged pane - need to find corresponding line in file_lines
-        if (line_index < 0 || line_index >= viewer->staged_line_count)
-            return 0;
-
-        NCursesFileLine* staged_line = &viewer->staged_lines[line_index];
-
-        // Skip headers and context lines
-        if (staged_line->type == '@' || staged_line->type == ' ')
-            return 0;
-
-        // Only unstage actual diff lines (+ or -)
-        if (staged_line->type != '+' && staged_line->type != '-')
-            return 0;
-
-        // Find the corresponding line in file_lines and unstage it
-        for (int i = 0; i < viewer->file_line_count; i++) {
-            NCursesFileLine* orig_line = &viewer->file_lines[i];
-
-            // Match by content and type
-            if (orig_line->type == staged_line->type &&
-                strcmp(orig_line->line, staged_line->line) == 0 && orig_line->is_staged) {
-
-                orig_line->is_staged = 0; // Unstage it
-                break;
-            }
-        }
+        return 1;
     }
 
-    // Rebuild staged view to reflect changes
-    rebuild_staged_view(viewer);
-    return 1;
-}
-
-void rebuild_staged_view(NCursesDiffViewer* viewer) {
-    if (!viewer)
-        return;
-
-    viewer->staged_line_count = 0;
+    // File headers in the staged pane are '@' lines too, but not hunks
+    if (selected_line->type != '@' || strncmp(selected_line->line, "@@", 2) != 0)
+        return 0;
 
-    // Check if we have any staged changes
-    int has_staged_changes = 0;
-    for (int i = 0; i < viewer->file_line_count; i++) {
-        if (viewer->file_lines[i].is_staged) {
-            has_staged_changes = 1;
-            break;
-        }
+    int end = line_index + 1;
+    int any_unmarked = 0;
+    for (; end < count && lines[end].type != '@'; end++) {
+        if (lines[end].type != '+' && lines[end].type != '-')
+            continue;
+        if (lines[end].is_staged == staged_pane)
+            any_unmarked = 1;
     }
 
-    if (!has_staged_changes) {
-        return;
+    int mark = any_unmarked ? !staged_pane : staged_pane;
+    for (int i = line_index + 1; i < end; i++) {
+        if (lines[i].type == '+' || lines[i].type == '-')
+            lines[i].is_staged = mark;
     }
+    return 1;
+}
 
-    // Add git diff header
-    NCursesFileLine* header = &viewer->staged_lines[viewer->staged_line_count++];
-    snprintf(header->line, sizeof(header->line), "diff --git a/%s b/%s", viewer->current_file_path,
-             viewer->current_file_path);
-    header->type = '@';
-    header->is_diff_line = 0;
-    header->is_staged = 1;
-    header->is_context = 0;
-
-    // Add index line
-    header = &viewer->staged_lines[viewer->staged_line_count++];
-    snprintf(header->line, sizeof(header->line), "index 13bdd0a..9abd450 100644");
-    header->type = '@';
-    header->is_diff_line = 0;
-    header->is_staged = 1;
-    header->is_context = 0;
-
-    // Add file headers
-    header = &viewer->staged_lines[viewer->staged_line_count++];
-    snprintf(header->line, sizeof(header->line), "--- a/%s", viewer->current_file_path);
-    header->type = '@';
-    header->is_diff_line = 0;
-    header->is_staged = 1;
-    header->is_context = 0;
-
-    header = &viewer->staged_lines[viewer->staged_line_count++];
-    snprintf(header->line, sizeof(header->line), "+++ b/%s", viewer->current_file_path);
-    header->type = '@';
-    header->is_diff_line = 0;
-    header->is_staged = 1;
-    header->is_context = 0;
-
-    // Process each hunk that has staged changes
-    for (int hunk = 0; hunk < viewer->total_hunks; hunk++) {
-        // Check if this hunk has staged changes
-        int hunk_has_staged = 0;
-        for (int i = 0; i < viewer->file_line_count; i++) {
-            if (viewer->file_lines[i].hunk_id == hunk && viewer->file_lines[i].is_staged) {
-                hunk_has_staged = 1;
-                break;
-            }
-        }
+// Pane lines in the form the patch builder works on. The text still points
+// into the pane.
+static int pane_to_diff(const NCursesFileLine* lines, int count, int staged_pane,
+                        GitDiffLine* out) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        const NCursesFileLine* line = &lines[i];
+        GitDiffLine* diff = &out[n];
 
-        if (!hunk_has_staged)
+        if (line->type == '@') {
+            if (strncmp(line->line, "@@", 2) != 0)
+                continue;
+            diff->type = '@';
+            diff->old_line = line->line_number_old > 0 ? line->line_number_old : 0;
+            diff->new_line = line->line_number_new > 0 ? line->line_number_new : 0;
+            diff->selected = 0;
+            diff->no_eol = 0;
+            diff->text = NULL;
+        } else if (line->type == '+' || line->type == '-' || line->type == ' ') {
+            diff->type = line->type;
+            diff->old_line = line->type != '+' && line->line_number_old > 0 ? line->line_number_old : 0;
+            diff->new_line = line->type != '-' && line->line_number_new > 0 ? line->line_number_new : 0;
+            diff->selected = line->type != ' ' && line->is_staged != staged_pane;
+            diff->no_eol = line->no_eol;
+            diff->text = line->line + 1;
+        } else {
             continue;
-
-        // Find the hunk boundaries
-        int hunk_start = -1, hunk_end = -1;
-        for (int i = 0; i < viewer->file_line_count; i++) {
-            if (viewer->file_lines[i].hunk_id == hunk) {
-                if (hunk_start == -1)
-                    hunk_start = i;
-                hunk_end = i;
-            }
         }
+        n++;
+    }
+    return n;
+}
 
-        if (hunk_start == -1)
-            continue;
-
-        // Calculate new hunk header with adjusted line counts
-        int old_start = -1, new_start = -1;
-        int old_count = 0, new_count = 0;
-
-        // Find first line numbers
-        for (int i = hunk_start; i <= hunk_end; i++) {
-            NCursesFileLine* line = &viewer->file_lines[i];
-            if (line->type == '@') {
-                old_start = line->line_number_old;
-                new_start = line->line_number_new;
-            } else if (line->is_staged || line->is_context) {
-                if (line->type != '+')
-                    old_count++;
-                if (line->type != '-')
-                    new_count++;
-            }
-        }
-
-        // Add hunk header
-        NCursesFileLine* staged_header = &viewer->staged_lines[viewer->staged_line_count++];
-        snprintf(staged_header->line, sizeof(staged_header->line), "@@ -%d,%d +%d,%d @@", old_start,
-                 old_count, new_start, new_count);
-        staged_header->type = '@';
-        staged_header->is_diff_line = 0;
-        staged_header->is_staged = 1;
-        staged_header->is_context = 0;
-
-        // Add context lines before staged changes
-        for (int i = hunk_start; i <= hunk_end; i++) {
-            NCursesFileLine* line = &viewer->file_lines[i];
-            if (line->type == '@')
-                continue;
-
-            // Always include context lines and staged diff lines
-            if (line->is_context || line->is_staged) {
-                NCursesFileLine* staged_line = &viewer->staged_lines[viewer->staged_line_count++];
-                *staged_line = *line;
-                staged_line->is_staged = 1;
-
-                if (viewer->staged_line_count >= MAX_FULL_FILE_LINES)
-                    break;
-            }
+// Unmarked pane lines for a composed diff. The diff text points into both
+// panes, so the result is built aside and copied in once both are ready.
+static NCursesFileLine* build_pane(const NCursesDiffViewer* viewer, int staged_pane,
+                                   const GitDiffLine* diff, int count, int* line_count) {
+    const NCursesFileLine* pane = staged_pane ? viewer->staged_lines : viewer->file_lines;
+    const int* pane_count = staged_pane ? &viewer->staged_line_count : &viewer->file_line_count;
+
+    NCursesFileLine* lines = malloc((size_t)(count + 4) * sizeof(NCursesFileLine));
+    if (!lines)
+        return NULL;
+
+    int n = 0;
+    if (staged_pane && count > 0) {
+        // Keep git's file header, or write one for a file that just got staged
+        for (int i = 0; i < *pane_count && pane[i].type == '@' && strncmp(pane[i].line, "@@", 2) != 0;
+             i++) {
+            lines[n++] = pane[i];
+        }
+
+        if (n == 0) {
+            const char* path = viewer->current_file_path;
+            char headers[4][1024];
+            int header_count = 0;
+            snprintf(headers[header_count++], sizeof(headers[0]), "diff --git a/%s b/%s", path,
+                     path);
+            if (viewer->current_file_is_new) {
+                snprintf(headers[header_count++], sizeof(headers[0]), "new file mode 100644");
+                snprintf(headers[header_count++], sizeof(headers[0]), "--- /dev/null");
+            } else {
+                snprintf(headers[header_count++], sizeof(headers[0]), "--- a/%s", path);
+            }
+            snprintf(headers[header_count++], sizeof(headers[0]), "+++ b/%s", path);
+
+            for (int i = 0; i < header_count; i++) {
+                NCursesFileLine* header = &lines[n++];
+                memset(header, 0, sizeof(*header));
+                memcpy(header->line, headers[i], sizeof(header->line));
+                header->type = '@';
+                header->hunk_id = -1;
+                header->is_staged = 1;
+                header->line_number_old = -1;
+                header->line_number_new = -1;
+            }
+        }
+    }
+
+    int hunk = -1;
+    for (int i = 0; i < count && n < MAX_FULL_FILE_LINES; i++) {
+        NCursesFileLine* line = &lines[n++];
+        line->type = diff[i].type;
+        line->is_staged = staged_pane;
+        line->is_diff_line = diff[i].type == '+' || diff[i].type == '-';
+        line->is_context = diff[i].type == ' ';
+        line->line_number_old = diff[i].old_line > 0 ? diff[i].old_line : -1;
+        line->line_number_new = diff[i].new_line > 0 ? diff[i].new_line : -1;
+        line->no_eol = diff[i].no_eol;
+
+        if (diff[i].type == '@') {
+            hunk++;
+            git_diff_format_hunk(diff, count, i, line->line, sizeof(line->line));
+            line->line_number_old = diff[i].old_line;
+            line->line_number_new = diff[i].new_line;
+        } else {
+            snprintf(line->line, sizeof(line->line), "%c%s", diff[i].type, diff[i].text);
         }
-
-        if (viewer->staged_line_count >= MAX_FULL_FILE_LINES)
-            break;
+        line->hunk_id = hunk;
     }
+
+    *line_count = n;
+    return lines;
 }
 
 void rebuild_staged_view_from_git(NCursesDiffViewer* viewer) {
@@ -642,35 +678,8 @@ void rebuild_staged_view_from_git(NCursesDiffViewer* viewer) {
         return;
 
     char diff_line[1024];
-    int has_any_staged = 0;
-
-    // First pass: check if there are any staged changes
-    while (fgets(diff_line, sizeof(diff_line), diff_fp) != NULL) {
-        char* newline_pos = strchr(diff_line, '\n');
-        if (newline_pos)
-            *newline_pos = '\0';
-
-        // Skip file headers
-        if (strncmp(diff_line, "diff --git", 10) == 0 || strncmp(diff_line, "index ", 6) == 0 ||
-            strncmp(diff_line, "--- ", 4) == 0 || strncmp(diff_line, "+++ ", 4) == 0) {
-            continue;
-        }
-
-        if (strlen(diff_line) > 0) {
-            has_any_staged = 1;
-            break;
-        }
-    }
-    pclose(diff_fp);
-
-    if (!has_any_staged) {
-        return;
-    }
-
-    // Second pass: actually build the staged view
-    diff_fp = popen(cmd, "r");
-    if (!diff_fp)
-        return;
+    int current_hunk = -1;
+    int old_line_num = 0, new_line_num = 0;
 
     while (fgets(diff_line, sizeof(diff_line), diff_fp) != NULL &&
            viewer->staged_line_count < MAX_FULL_FILE_LINES) {
@@ -679,19 +688,10 @@ void rebuild_staged_view_from_git(NCursesDiffViewer* viewer) {
         if (newline_pos)
             *newline_pos = '\0';
 
-        // Skip file headers for the first few lines, but include them for patch
-        // format
-        if (strncmp(diff_line, "diff --git", 10) == 0 || strncmp(diff_line, "index ", 6) == 0 ||
-            strncmp(diff_line, "--- ", 4) == 0 || strncmp(diff_line, "+++ ", 4) == 0) {
-
-            NCursesFileLine* staged_line = &viewer->staged_lines[viewer->staged_line_count];
-            strncpy(staged_line->line, diff_line, sizeof(staged_line->line) - 1);
-            staged_line->line[sizeof(staged_line->line) - 1] = '\0';
-            staged_line->type = '@';
-            staged_line->is_diff_line = 0;
-            staged_line->is_staged = 1;
-            staged_line->is_context = 0;
-            viewer->staged_line_count++;
+        // "\ No newline at end of file" belongs to the line before
+        if (diff_line[0] == '\\') {
+            if (viewer->staged_line_count > 0)
+                viewer->staged_lines[viewer->staged_line_count - 1].no_eol = 1;
             continue;
         }
 
@@ -699,28 +699,36 @@ void rebuild_staged_view_from_git(NCursesDiffViewer* viewer) {
         strncpy(staged_line->line, diff_line, sizeof(staged_line->line) - 1);
         staged_line->line[sizeof(staged_line->line) - 1] = '\0';
         staged_line->is_staged = 1;
-
-        // Set line type for proper coloring
+        staged_line->hunk_id = current_hunk;
+        staged_line->line_number_old = -1;
+        staged_line->line_number_new = -1;
+        staged_line->is_diff_line = 0;
+        staged_line->is_context = 0;
+        staged_line->no_eol = 0;
+
+        // Everything before the first hunk is file header, kept for patch format
         if (diff_line[0] == '@' && diff_line[1] == '@') {
+            current_hunk++;
+            parse_hunk_starts(diff_line, &old_line_num, &new_line_num);
+            staged_line->type = '@';
+            staged_line->hunk_id = current_hunk;
+            staged_line->line_number_old = old_line_num;
+            staged_line->line_number_new = new_line_num;
+        } else if (current_hunk < 0) {
             staged_line->type = '@';
-            staged_line->is_diff_line = 0;
-            staged_line->is_context = 0;
         } else if (diff_line[0] == '+') {
             staged_line->type = '+';
             staged_line->is_diff_line = 1;
-            staged_line->is_context = 0;
+            staged_line->line_number_new = new_line_num++;
         } else if (diff_line[0] == '-') {
             staged_line->type = '-';
             staged_line->is_diff_line = 1;
-            staged_line->is_context = 0;
-        } else if (diff_line[0] == ' ') {
-            staged_line->type = ' ';
-            staged_line->is_diff_line = 0;
-            staged_line->is_context = 1;
+            staged_line->line_number_old = old_line_num++;
         } else {
             staged_line->type = ' ';
-            staged_line->is_diff_line = 0;
-            staged_line->is_context = 0;
+            staged_line->is_context = 1;
+            staged_line->line_number_old = old_line_num++;
+            staged_line->line_number_new = new_line_num++;
         }
 
         viewer->staged_line_count++;
@@ -729,84 +737,149 @@ void rebuild_staged_view_from_git(NCursesDiffViewer* viewer) {
     pclose(diff_fp);
 }
 
-int apply_staged_changes(NCursesDiffViewer* viewer) {
-    if (!viewer || viewer->staged_line_count == 0)
-        return 0;
-
-    char* patch_content = malloc(50000);
-    if (!patch_content)
-        return 0;
-
-    strcpy(patch_content, "");
-    for (int i = 0; i < viewer->staged_line_count; i++) {
-        strcat(patch_content, viewer->staged_lines[i].line);
-        strcat(patch_content, "\n");
-    }
+// Mode git add would give a new file: symlink, executable or plain
+static unsigned worktree_git_mode(const char* path) {
+    struct stat st;
+    if (lstat(path, &st) != 0)
+        return 0100644;
+    if (S_ISLNK(st.st_mode))
+        return 0120000;
+    return (st.st_mode & S_IXUSR) ? 0100755 : 0100644;
+}
 
-    char patch_filename[256];
-    snprintf(patch_filename, sizeof(patch_filename), "/tmp/lazygit-%d-%ld.patch", getpid(),
-             time(NULL));
+static void on_patch_apply_done(const GitJob* job, void* ctx) {
+    if (job->exit_status != 0)
+        request_viewer_refresh(ctx, VIEWER_REFRESH_FILES);
+}
 
-    FILE* patch_file = fopen(patch_filename, "w");
-    if (!patch_file) {
-        free(patch_content);
+// Queue every marked line in both panes as a single `git apply --cached`,
+// then carry the change over to both panes in memory instead of asking git
+// for fresh diffs.
+int apply_staged_changes(NCursesDiffViewer* viewer) {
+    if (!viewer)
         return 0;
-    }
 
-    fprintf(patch_file, "%s", patch_content);
-    fclose(patch_file);
-    free(patch_content);
-
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "git apply --cached \"%s\" >/dev/null 2>&1", patch_filename);
-    int result = system(cmd);
+    // Composed diffs can gain a hunk header per line, so size for the worst case
+    int capacity = 2 * (viewer->file_line_count + viewer->staged_line_count) + 16;
+    GitDiffLine* buffers[6];
+    for (int i = 0; i < 6; i++)
+        buffers[i] = malloc((size_t)capacity * sizeof(GitDiffLine));
 
-    unlink(patch_filename);
+    GitDiffLine* unstaged = buffers[0];
+    GitDiffLine* staged = buffers[1];
+    GitDiffLine* stage = buffers[2];
+    GitDiffLine* unstage = buffers[3];
+    GitDiffLine* unstaged_after = buffers[4];
+    GitDiffLine* staged_after = buffers[5];
 
-    if (result == 0) {
-        // Don't clear staging state - reload from git instead
-        get_ncurses_changed_files(viewer);
-        if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-            load_file_with_staging_info(viewer, viewer->files[viewer->selected_file].filename);
-        }
-    }
-    return (result == 0);
+    int result = 0;
+    GitPatch patch;
+    git_patch_init(&patch);
+    for (int i = 0; i < 6; i++) {
+        if (!buffers[i])
+            goto done;
+    }
+
+    int unstaged_count = pane_to_diff(viewer->file_lines, viewer->file_line_count, 0, unstaged);
+    int staged_count = pane_to_diff(viewer->staged_lines, viewer->staged_line_count, 1, staged);
+
+    // Staging goes first; unstage marks ride along into the staged diff so
+    // the unstage patch can be written against the index staging leaves
+    int stage_count = git_diff_select(unstaged, unstaged_count, 0, stage, capacity);
+    if (stage_count < 0)
+        goto done;
+    int staged_after_count = git_diff_compose(staged, staged_count, 0, stage, stage_count, 0, 5,
+                                              staged_after, capacity);
+    int unstaged_after_count = git_diff_compose(stage, stage_count, 1, unstaged, unstaged_count,
+                                                0, 5, unstaged_after, capacity);
+    if (staged_after_count < 0 || unstaged_after_count < 0)
+        goto done;
+
+    int unstage_count =
+        git_diff_select(staged_after, staged_after_count, 1, unstage, capacity);
+    if (unstage_count < 0 || (stage_count == 0 && unstage_count == 0))
+        goto done;
+
+    // Both sections patch the same path; git applies the second on top of the first
+    unsigned new_file_mode =
+        viewer->current_file_is_new ? worktree_git_mode(viewer->current_file_path) : 0;
+    if (git_patch_add_file(&patch, viewer->current_file_path, new_file_mode, stage,
+                           stage_count) < 0 ||
+        git_patch_add_file(&patch, viewer->current_file_path, 0, unstage, unstage_count) < 0)
+        goto done;
+
+    // The panes move on now; jobs run in order, so a later batch applies on
+    // top of this one, and a rejected patch reloads the file from git
+    if (!git_patch_queue_apply_cached(&patch, on_patch_apply_done, viewer))
+        goto done;
+
+    // The panes are rebuilt from these, so reuse the pane copies for the results
+    staged_count = git_diff_compose(staged_after, staged_after_count, 0, unstage, unstage_count,
+                                    0, 5, staged, capacity);
+    unstaged_count = git_diff_compose(unstage, unstage_count, 1, unstaged_after,
+                                      unstaged_after_count, 0, 5, unstaged, capacity);
+    int staged_lines = 0;
+    int unstaged_lines = 0;
+    NCursesFileLine* staged_pane = NULL;
+    NCursesFileLine* unstaged_pane = NULL;
+    if (staged_count >= 0 && unstaged_count >= 0) {
+        staged_pane = build_pane(viewer, 1, staged, staged_count, &staged_lines);
+        unstaged_pane = build_pane(viewer, 0, unstaged, unstaged_count, &unstaged_lines);
+    }
+    if (!staged_pane || !unstaged_pane) {
+        // The index changed but the panes cannot follow; read them back
+        free(staged_pane);
+        free(unstaged_pane);
+        load_file_with_staging_info(viewer, viewer->current_file_path);
+        result = 1;
+        goto done;
+    }
+
+    memcpy(viewer->staged_lines, staged_pane, (size_t)staged_lines * sizeof(NCursesFileLine));
+    memcpy(viewer->file_lines, unstaged_pane, (size_t)unstaged_lines * sizeof(NCursesFileLine));
+    viewer->staged_line_count = staged_lines;
+    viewer->file_line_count = unstaged_lines;
+    viewer->total_hunks = unstaged_lines > 0 ? unstaged_pane[unstaged_lines - 1].hunk_id + 1 : 0;
+    free(staged_pane);
+    free(unstaged_pane);
+    if (stage_count > 0)
+        viewer->current_file_is_new = 0;
+
+    if (viewer->file_cursor_line >= viewer->file_line_count)
+        viewer->file_cursor_line = viewer->file_line_count > 0 ? viewer->file_line_count - 1 : 0;
+    if (viewer->staged_cursor_line >= viewer->staged_line_count)
+        viewer->staged_cursor_line =
+            viewer->staged_line_count > 0 ? viewer->staged_line_count - 1 : 0;
+    if (viewer->file_scroll_offset > viewer->file_cursor_line)
+        viewer->file_scroll_offset = viewer->file_cursor_line;
+    if (viewer->staged_scroll_offset > viewer->staged_cursor_line)
+        viewer->staged_scroll_offset = viewer->staged_cursor_line;
+
+    if (viewer->selected_file < viewer->file_count)
+        viewer->files[viewer->selected_file].has_staged_changes = viewer->staged_line_count > 0;
+    result = 1;
+
+done:
+    git_patch_free(&patch);
+    for (int i = 0; i < 6; i++)
+        free(buffers[i]);
+    return result;
 }
 
+// Mark a staged line (or hunk, from its header) to leave the index with the
+// next batch
 int unstage_line_from_git(NCursesDiffViewer* viewer, int staged_line_index) {
     if (!viewer || staged_line_index < 0 || staged_line_index >= viewer->staged_line_count)
         return 0;
 
-    NCursesFileLine* line = &viewer->staged_lines[staged_line_index];
-
-    // Skip headers and context lines
-    if (line->type == '@' || line->type == ' ')
-        return 0;
-
-    // Only unstage actual diff lines (+ or -)
-    if (line->type != '+' && line->type != '-')
-        return 0;
-
-    // For now, let's just reset the entire file and let user re-stage what they
-    // want This is simpler and more reliable than trying to create reverse
-    // patches
-    char reset_cmd[512];
-    snprintf(reset_cmd, sizeof(reset_cmd), "git reset HEAD \"%s\" >/dev/null 2>&1",
-             viewer->current_file_path);
-    int result = system(reset_cmd);
-
-    if (result == 0) {
-        // Reload after unstaging
-        get_ncurses_changed_files(viewer);
-        if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-            load_file_with_staging_info(viewer, viewer->files[viewer->selected_file].filename);
-        }
-        return 1;
-    }
-
-    return 0;
+    int active_pane = viewer->active_pane;
+    viewer->active_pane = 1;
+    int result = stage_hunk_by_line(viewer, staged_line_index);
+    viewer->active_pane = active_pane;
+    return result;
 }
 
+// Drop every pending mark in both panes
 int reset_staged_changes(NCursesDiffViewer* viewer) {
     if (!viewer)
         return 0;
@@ -814,9 +887,9 @@ int reset_staged_changes(NCursesDiffViewer* viewer) {
     for (int i = 0; i < viewer->file_line_count; i++) {
         viewer->file_lines[i].is_staged = 0;
     }
-
-    viewer->staged_line_count = 0;
-    rebuild_staged_view(viewer);
+    for (int i = 0; i < viewer->staged_line_count; i++) {
+        viewer->staged_lines[i].is_staged = 1;
+    }
 
     return 1;
 }
@@ -847,132 +920,292 @@ void draw_rounded_box(WINDOW* win) {
     mvwaddch(win, height - 1, width - 1, ACS_LRCORNER);
 }
 
-int get_commit_history(NCursesDiffViewer* viewer) {
-    if (!viewer)
-        return 0;
+// Resolve a revision to its full object id, returns 1 on success
+static int resolve_git_oid(const char* rev, char* oid, size_t oid_size) {
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "git rev-parse --verify -q \"%s\" 2>/dev/null", rev);
 
-    FILE* fp = popen("git log --oneline --format=\"%h|%an|%s\" 2>/dev/null", "r");
+    oid[0] = '\0';
+    FILE* fp = popen(cmd, "r");
     if (!fp)
         return 0;
 
-    viewer->commit_count = 0;
-    char line[512];
+    if (fgets(oid, oid_size, fp) != NULL) {
+        char* newline = strchr(oid, '\n');
+        if (newline)
+            *newline = '\0';
+    }
+    pclose(fp);
 
-    // Get list of unpushed commits first
-    char** unpushed_hashes = malloc(1000 * sizeof(char*));
-    int unpushed_count = 0;
-    int unpushed_capacity = 1000;
+    return strlen(oid) > 0;
+}
+
+// Find the remote tip that decides whether a commit counts as pushed.
+// Prefers the branch upstream, then falls back to the usual origin heads.
+static int resolve_commit_upstream(char* oid, size_t oid_size) {
+    GitOdb* odb = git_odb_current();
+    char branch[MAX_BRANCHNAME_LEN];
+    char upstream[512];
+    if (odb && oid_size > GIT_OID_HEX_LEN && git_odb_head_branch(odb, branch, sizeof(branch)) &&
+        git_odb_branch_upstream(odb, branch, upstream, sizeof(upstream)) &&
+        git_odb_resolve(odb, upstream, oid))
+        return 1;
 
-    for (int i = 0; i < unpushed_capacity; i++) {
-        unpushed_hashes[i] = malloc(16);
+    const char* candidates[] = {"@{u}", "origin/HEAD", "origin/main", "origin/master"};
+
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); i++) {
+        if (resolve_git_oid(candidates[i], oid, oid_size))
+            return 1;
     }
+    oid[0] = '\0';
+    return 0;
+}
 
-    FILE* unpushed_fp = popen("git log origin/HEAD..HEAD --format=\"%h\" 2>/dev/null", "r");
-    if (unpushed_fp) {
-        while (fgets(line, sizeof(line), unpushed_fp) != NULL &&
-               unpushed_count < unpushed_capacity) {
-            char* newline = strchr(line, '\n');
-            if (newline)
-                *newline = '\0';
-            strncpy(unpushed_hashes[unpushed_count], line,
-                    sizeof(unpushed_hashes[unpushed_count]) - 1);
-            unpushed_hashes[unpushed_count][sizeof(unpushed_hashes[unpushed_count]) - 1] = '\0';
-            unpushed_count++;
-        }
-        pclose(unpushed_fp);
+static int compare_oid(const void* a, const void* b) {
+    return strcmp((const char*)a, (const char*)b);
+}
+
+// Is the commit with this (possibly abbreviated) hash in the unpushed set?
+static int commit_is_unpushed(const NCursesDiffViewer* viewer, const char* hash) {
+    size_t len = strlen(hash);
+    int low = 0;
+    int high = viewer->commit_unpushed_count;
+
+    // First id not sorting before the prefix; only it can start with it
+    while (low < high) {
+        int mid = low + (high - low) / 2;
+        if (strncmp(viewer->commit_unpushed[mid], hash, len) < 0)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low < viewer->commit_unpushed_count &&
+           strncmp(viewer->commit_unpushed[low], hash, len) == 0;
+}
+
+// Mark commits as pushed/unpushed by looking each one up in the unpushed
+// set. Without an upstream every commit counts as pushed.
+// Mark loaded commits from index first on
+static void apply_commit_push_status(NCursesDiffViewer* viewer, int first) {
+    for (int i = first; i < viewer->commit_count; i++) {
+        NCursesCommit* commit = &viewer->commits[i];
+        commit->is_pushed = !commit_is_unpushed(viewer, commit->hash);
     }
+}
 
-    // If origin/HEAD doesn't exist, try origin/main and origin/master
-    if (unpushed_count == 0) {
-        unpushed_fp = popen("git log origin/main..HEAD --format=\"%h\" 2>/dev/null", "r");
-        if (unpushed_fp) {
-            while (fgets(line, sizeof(line), unpushed_fp) != NULL &&
-                   unpushed_count < unpushed_capacity) {
-                char* newline = strchr(line, '\n');
-                if (newline)
-                    *newline = '\0';
-                strncpy(unpushed_hashes[unpushed_count], line,
-                        sizeof(unpushed_hashes[unpushed_count]) - 1);
-                unpushed_hashes[unpushed_count][sizeof(unpushed_hashes[unpushed_count]) - 1] = '\0';
-                unpushed_count++;
-            }
-            pclose(unpushed_fp);
+// Collect the commits reachable from HEAD but not from the remote tip,
+// sorted so that each loaded commit can be looked up by its short hash
+static void update_commit_unpushed(NCursesDiffViewer* viewer) {
+    viewer->commit_unpushed_count = 0;
+    if (viewer->commit_upstream_oid[0] == '\0' || viewer->commit_head_oid[0] == '\0')
+        return;
+
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "git rev-list %s..%s 2>/dev/null", viewer->commit_upstream_oid,
+             viewer->commit_head_oid);
+
+    FILE* fp = popen(cmd, "r");
+    if (!fp)
+        return;
+
+    char line[64];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char* newline = strchr(line, '\n');
+        if (newline)
+            *newline = '\0';
+        if (strlen(line) != GIT_OID_HEX_LEN)
+            continue;
+
+        if (viewer->commit_unpushed_count >= viewer->commit_unpushed_capacity) {
+            int new_capacity =
+                viewer->commit_unpushed_capacity ? viewer->commit_unpushed_capacity * 2 : 64;
+            char(*grown)[41] = realloc(viewer->commit_unpushed, new_capacity * sizeof(*grown));
+            if (!grown)
+                break;
+            viewer->commit_unpushed = grown;
+            viewer->commit_unpushed_capacity = new_capacity;
         }
+        strcpy(viewer->commit_unpushed[viewer->commit_unpushed_count++], line);
     }
+    pclose(fp);
 
-    if (unpushed_count == 0) {
-        unpushed_fp = popen("git log origin/master..HEAD --format=\"%h\" 2>/dev/null", "r");
-        if (unpushed_fp) {
-            while (fgets(line, sizeof(line), unpushed_fp) != NULL &&
-                   unpushed_count < unpushed_capacity) {
-                char* newline = strchr(line, '\n');
-                if (newline)
-                    *newline = '\0';
-                strncpy(unpushed_hashes[unpushed_count], line,
-                        sizeof(unpushed_hashes[unpushed_count]) - 1);
-                unpushed_hashes[unpushed_count][sizeof(unpushed_hashes[unpushed_count]) - 1] = '\0';
-                unpushed_count++;
-            }
-            pclose(unpushed_fp);
+    qsort(viewer->commit_unpushed, viewer->commit_unpushed_count, sizeof(*viewer->commit_unpushed),
+          compare_oid);
+}
+
+static int append_commit(NCursesDiffViewer* viewer, const char* hash, const char* author,
+                         const char* title) {
+    if (viewer->commit_count >= viewer->commit_capacity) {
+        int new_capacity = viewer->commit_capacity * 2;
+        NCursesCommit* new_commits = realloc(viewer->commits, new_capacity * sizeof(NCursesCommit));
+        if (!new_commits) {
+            fprintf(stderr, "Failed to reallocate commits array\n");
+            return 0;
         }
+        viewer->commits = new_commits;
+        viewer->commit_capacity = new_capacity;
     }
 
+    NCursesCommit* commit = &viewer->commits[viewer->commit_count];
+
+    // Store abbreviated commit hash
+    snprintf(commit->hash, sizeof(commit->hash), "%s", hash);
+
+    // Store first two letters of author name
+    commit->author_initials[0] = author[0] ? author[0] : '?';
+    commit->author_initials[1] = author[0] && author[1] ? author[1] : '?';
+    commit->author_initials[2] = '\0';
+
+    // Store title
+    strncpy(commit->title, title, MAX_COMMIT_TITLE_LEN - 1);
+    commit->title[MAX_COMMIT_TITLE_LEN - 1] = '\0';
+
+    commit->is_pushed = 1;
+    viewer->commit_count++;
+    return 1;
+}
+
+static int load_commit_page_git(NCursesDiffViewer* viewer);
+
+// Next page straight from the object database, continuing the cached walk.
+// Once the walk hits a commit it cannot read, git log takes over from the
+// commits already shown.
+static int load_commit_page_native(NCursesDiffViewer* viewer) {
+    int loaded = 0;
+    int status = 1;
+    GitObject commit;
+    GitCommitInfo info;
+
+    while (loaded < COMMIT_PAGE_SIZE &&
+           (status = git_revwalk_next(viewer->commit_walk, &commit, &info)) == 1) {
+        char short_hash[sizeof(viewer->commits[0].hash)];
+        char title[MAX_COMMIT_TITLE_LEN];
+        git_odb_abbrev(git_revwalk_odb(viewer->commit_walk), commit.oid, short_hash,
+                       sizeof(short_hash));
+        git_commit_message_parts(&info, title, sizeof(title), NULL, 0);
+        int ok = append_commit(viewer, short_hash, info.author_name, title);
+        git_object_free(&commit);
+        if (!ok)
+            break;
+        loaded++;
+    }
+
+    if (status < 0) {
+        git_revwalk_free(viewer->commit_walk);
+        viewer->commit_walk = NULL;
+        // git log picks up after the commits already shown, and whether
+        // history goes on is up to its page now
+        loaded = load_commit_page_git(viewer);
+    }
+
+    return loaded;
+}
+
+static int load_commit_page_git(NCursesDiffViewer* viewer) {
+    // Pin the walk to the cached HEAD so pages stay consistent with each other
+    char cmd[256];
+    snprintf(cmd, sizeof(cmd), "git log --format=\"%%h|%%an|%%s\" --skip=%d -n %d %s 2>/dev/null",
+             viewer->commit_count, COMMIT_PAGE_SIZE, viewer->commit_head_oid);
+
+    FILE* fp = popen(cmd, "r");
+    if (!fp)
+        return 0;
+
+    char line[512];
+    int loaded = 0;
+
     while (fgets(line, sizeof(line), fp) != NULL) {
-        if (viewer->commit_count >= viewer->commit_capacity) {
-            viewer->commit_capacity *= 2;
-            NCursesCommit* new_commits =
-                realloc(viewer->commits, viewer->commit_capacity * sizeof(NCursesCommit));
-            if (!new_commits) {
-                fprintf(stderr, "Failed to reallocate commits array\n");
-                break;
-            }
-            viewer->commits = new_commits;
-        }
         // Remove newline
         char* newline = strchr(line, '\n');
         if (newline)
             *newline = '\0';
 
+        // Count every line so --skip stays aligned even if one fails to parse
+        loaded++;
+
         // Parse format: hash|author|title
         char* hash = strtok(line, "|");
         char* author = strtok(NULL, "|");
         char* title = strtok(NULL, "|");
 
-        if (hash && author && title) {
-            // Store commit hash (first 7 chars)
-            strncpy(viewer->commits[viewer->commit_count].hash, hash,
-                    sizeof(viewer->commits[viewer->commit_count].hash) - 1);
-            viewer->commits[viewer->commit_count]
-                .hash[sizeof(viewer->commits[viewer->commit_count].hash) - 1] = '\0';
-
-            // Store first two letters of author name
-            viewer->commits[viewer->commit_count].author_initials[0] = author[0] ? author[0] : '?';
-            viewer->commits[viewer->commit_count].author_initials[1] = author[1] ? author[1] : '?';
-            viewer->commits[viewer->commit_count].author_initials[2] = '\0';
-
-            // Store title
-            strncpy(viewer->commits[viewer->commit_count].title, title, MAX_COMMIT_TITLE_LEN - 1);
-            viewer->commits[viewer->commit_count].title[MAX_COMMIT_TITLE_LEN - 1] = '\0';
-
-            // Check if this commit is in the unpushed list
-            viewer->commits[viewer->commit_count].is_pushed = 1; // Default to pushed
-            for (int i = 0; i < unpushed_count; i++) {
-                if (strcmp(viewer->commits[viewer->commit_count].hash, unpushed_hashes[i]) == 0) {
-                    viewer->commits[viewer->commit_count].is_pushed = 0;
-                    break;
-                }
-            }
-
-            viewer->commit_count++;
-        }
+        if (hash && author && title && !append_commit(viewer, hash, author, title))
+            break;
     }
 
     pclose(fp);
+    return loaded;
+}
+
+int load_more_commits(NCursesDiffViewer* viewer) {
+    if (!viewer || viewer->commit_history_complete || viewer->commit_head_oid[0] == '\0')
+        return 0;
+
+    int first_new = viewer->commit_count;
+    int loaded = viewer->commit_walk ? load_commit_page_native(viewer)
+                                     : load_commit_page_git(viewer);
+
+    if (loaded < COMMIT_PAGE_SIZE)
+        viewer->commit_history_complete = 1;
+
+    // Pages already shown keep their marks until the upstream moves
+    apply_commit_push_status(viewer, first_new);
+
+    return loaded;
+}
+
+void ensure_commit_loaded(NCursesDiffViewer* viewer, int commit_index) {
+    if (!viewer)
+        return;
 
-    for (int i = 0; i < unpushed_capacity; i++) {
-        free(unpushed_hashes[i]);
+    // Fetch the next page a little before the selection reaches the end
+    while (!viewer->commit_history_complete &&
+           commit_index >= viewer->commit_count - COMMIT_PAGE_PREFETCH) {
+        if (load_more_commits(viewer) == 0)
+            break;
     }
-    free(unpushed_hashes);
+}
+
+int get_commit_history(NCursesDiffViewer* viewer) {
+    if (!viewer)
+        return 0;
+
+    char head_oid[41];
+    char upstream_oid[41];
+    GitOdb* odb = git_odb_current();
+
+    if (!(odb && git_odb_resolve(odb, "HEAD", head_oid)) &&
+        !resolve_git_oid("HEAD", head_oid, sizeof(head_oid))) {
+        viewer->commit_count = 0;
+        viewer->commit_head_oid[0] = '\0';
+        viewer->commit_history_complete = 1;
+        return 0;
+    }
+    resolve_commit_upstream(upstream_oid, sizeof(upstream_oid));
+
+    // Same HEAD as the cached pages: keep them, only the remote side may have moved
+    if (viewer->commit_count > 0 && strcmp(head_oid, viewer->commit_head_oid) == 0) {
+        if (strcmp(upstream_oid, viewer->commit_upstream_oid) != 0) {
+            strcpy(viewer->commit_upstream_oid, upstream_oid);
+            update_commit_unpushed(viewer);
+            apply_commit_push_status(viewer, 0);
+        }
+        return viewer->commit_count;
+    }
+
+    strcpy(viewer->commit_head_oid, head_oid);
+    strcpy(viewer->commit_upstream_oid, upstream_oid);
+    viewer->commit_count = 0;
+    git_revwalk_free(viewer->commit_walk);
+    viewer->commit_walk = odb ? git_revwalk_new(odb, head_oid) : NULL;
+    viewer->commit_history_complete = 0;
+    update_commit_unpushed(viewer);
+
+    load_more_commits(viewer);
+
+    // Keep the selection reachable after a reload
+    ensure_commit_loaded(viewer, viewer->selected_commit);
+    if (viewer->selected_commit >= viewer->commit_count)
+        viewer->selected_commit = viewer->commit_count > 0 ? viewer->commit_count - 1 : 0;
 
     return viewer->commit_count;
 }
@@ -1457,73 +1690,129 @@ int get_commit_title_input(char* title, int max_len, char* message, int max_mess
     return strlen(title) > 0 ? 1 : 0;
 }
 
-int commit_marked_files(NCursesDiffViewer* viewer, const char* commit_title,
-                        const char* commit_message) {
-    if (!viewer || !commit_title || strlen(commit_title) == 0)
-        return 0;
+static void on_commit_done(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status == 0) {
+        // Refresh file list and commit history
+        request_viewer_refresh(viewer, VIEWER_REFRESH_FILES | VIEWER_REFRESH_COMMITS |
+                                           VIEWER_REFRESH_BRANCHES);
+    } else {
+        // Marked files may have been staged even though the commit failed
+        request_viewer_refresh(viewer, VIEWER_REFRESH_FILES);
+    }
+}
 
-    // First, add marked files to git
-    for (int i = 0; i < viewer->file_count; i++) {
-        if (viewer->files[i].marked_for_commit) {
-            char cmd[1024];
-            snprintf(cmd, sizeof(cmd), "git add \"%s\" 2>/dev/null >/dev/null",
-                     viewer->files[i].filename);
-            system(cmd);
+static void on_pathspec_stage_done(const GitJob* job, void* ctx) {
+    (void)job;
+    unlink(ctx);
+    free(ctx);
+}
+
+// Stage every marked file with one git add. Selections too large for an
+// argument list go through a NUL separated pathspec file.
+static int queue_stage_marked_files(NCursesDiffViewer* viewer) {
+    const char* argv[GIT_JOB_MAX_ARGS];
+    int argc = 0;
+    argv[argc++] = "git";
+    argv[argc++] = "add";
+    argv[argc++] = "--";
+
+    int marked = 0;
+    for (int i = 0; i < viewer->file_count; i++)
+        marked += viewer->files[i].marked_for_commit;
+    if (marked == 0)
+        return 1;
+
+    if (marked < GIT_JOB_MAX_ARGS - argc) {
+        for (int i = 0; i < viewer->file_count; i++) {
+            if (viewer->files[i].marked_for_commit)
+                argv[argc++] = viewer->files[i].filename;
         }
+        argv[argc] = NULL;
+        return git_jobs_submit("stage", argv, NULL, GIT_JOB_COALESCE, NULL, NULL) != 0;
     }
 
-    // Write commit message to temp file
-    char temp_msg_file[256];
-    snprintf(temp_msg_file, sizeof(temp_msg_file), "/tmp/commit_msg_%d", getpid());
+    char* pathspec_file = strdup("/tmp/ferrum-stage-XXXXXX");
+    int fd = pathspec_file ? mkstemp(pathspec_file) : -1;
+    FILE* fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(pathspec_file);
+        }
+        free(pathspec_file);
+        return 0;
+    }
 
-    FILE* msg_file = fopen(temp_msg_file, "w");
-    if (!msg_file)
+    for (int i = 0; i < viewer->file_count; i++) {
+        if (viewer->files[i].marked_for_commit)
+            fwrite(viewer->files[i].filename, 1, strlen(viewer->files[i].filename) + 1, fp);
+    }
+    int written = fclose(fp) == 0;
+
+    char pathspec_arg[64];
+    snprintf(pathspec_arg, sizeof(pathspec_arg), "--pathspec-from-file=%s", pathspec_file);
+    const char* file_argv[] = {"git", "add", "--pathspec-file-nul", pathspec_arg, NULL};
+    if (!written ||
+        !git_jobs_submit("stage", file_argv, NULL, 0, on_pathspec_stage_done, pathspec_file)) {
+        unlink(pathspec_file);
+        free(pathspec_file);
         return 0;
+    }
+    return 1;
+}
 
+// Queue "git commit" with the title and body as separate paragraphs
+static int queue_commit(NCursesDiffViewer* viewer, int amend, const char* commit_title,
+                        const char* commit_message) {
+    const char* argv[10];
+    int argc = 0;
+    argv[argc++] = "git";
+    argv[argc++] = "commit";
+    if (amend)
+        argv[argc++] = "--amend";
+    argv[argc++] = "-m";
+    argv[argc++] = commit_title;
     if (commit_message && strlen(commit_message) > 0) {
-        fprintf(msg_file, "%s\n\n%s", commit_title, commit_message);
-    } else {
-        fprintf(msg_file, "%s", commit_title);
+        argv[argc++] = "-m";
+        argv[argc++] = commit_message;
     }
-    fclose(msg_file);
+    argv[argc] = NULL;
 
-    char commit_cmd[512];
-    snprintf(commit_cmd, sizeof(commit_cmd), "git commit -F \"%s\" 2>/dev/null >/dev/null",
-             temp_msg_file);
-    int result = system(commit_cmd);
-    unlink(temp_msg_file);
+    return git_jobs_submit("commit", argv, NULL, 0, on_commit_done, viewer) != 0;
+}
 
-    if (result == 0) {
-        // Small delay to ensure git has processed the commit
-        usleep(100000); // 100ms delay
+int commit_marked_files(NCursesDiffViewer* viewer, const char* commit_title,
+                        const char* commit_message) {
+    if (!viewer || !commit_title || strlen(commit_title) == 0)
+        return 0;
 
-        // Refresh file list and commit history
-        get_ncurses_changed_files(viewer);
-        get_commit_history(viewer);
-        get_ncurses_git_branches(viewer);
+    // First, add marked files to git; the commit runs after them in order
+    if (!queue_stage_marked_files(viewer))
+        return 0;
 
-        // Reset selection if no files remain
-        if (viewer->file_count == 0) {
-            viewer->selected_file = 0;
-            viewer->file_line_count = 0;
-            viewer->file_scroll_offset = 0;
-        } else if (viewer->selected_file >= viewer->file_count) {
-            viewer->selected_file = viewer->file_count - 1;
-        }
+    return queue_commit(viewer, 0, commit_title, commit_message);
+}
 
-        // Reload the currently selected file's diff if files still exist
-        if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-            load_file_with_staging_info(viewer, viewer->files[viewer->selected_file].filename);
-        }
+static void on_reset_done(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status != 0)
+        return;
 
-        werase(viewer->branch_list_win);
-        render_branch_list_window(viewer);
-        wrefresh(viewer->branch_list_win);
+    // Refresh everything
+    request_viewer_refresh(viewer, VIEWER_REFRESH_FILES | VIEWER_REFRESH_COMMITS |
+                                       VIEWER_REFRESH_BRANCHES);
+}
 
-        return 1;
+static void on_hard_reset_done(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status == 0) {
+        // Reset file selection since changes are discarded
+        viewer->selected_file = 0;
+        viewer->file_line_count = 0;
+        viewer->file_scroll_offset = 0;
     }
-
-    return 0;
+    on_reset_done(job, ctx);
 }
 
 int reset_commit_soft(NCursesDiffViewer* viewer, int commit_index) {
@@ -1534,26 +1823,10 @@ int reset_commit_soft(NCursesDiffViewer* viewer, int commit_index) {
     if (commit_index != 0)
         return 0;
 
-    // Do soft reset of HEAD~1
-    int result = system("git reset --soft HEAD~1 2>/dev/null >/dev/null");
-
-    if (result == 0) {
-        // Small delay to ensure git has processed the reset
-        usleep(100000); // 100ms delay
-
-        // Refresh everything
-        get_ncurses_changed_files(viewer);
-        get_commit_history(viewer);
-
-        // Reload current file if any files exist
-        if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-            load_file_with_staging_info(viewer, viewer->files[viewer->selected_file].filename);
-        }
-
-        return 1;
-    }
-
-    return 0;
+    // Queued behind any stage or commit still waiting, so HEAD~1 is the
+    // commit the user saw on top
+    const char* argv[] = {"git", "reset", "--soft", "HEAD~1", NULL};
+    return git_jobs_submit("reset", argv, NULL, 0, on_reset_done, viewer) != 0;
 }
 
 int reset_commit_hard(NCursesDiffViewer* viewer, int commit_index) {
@@ -1569,31 +1842,8 @@ int reset_commit_hard(NCursesDiffViewer* viewer, int commit_index) {
         return 0; // User cancelled
     }
 
-    // Do hard reset of HEAD~1
-    int result = system("git reset --hard HEAD~1 2>/dev/null >/dev/null");
-
-    if (result == 0) {
-        // Small delay to ensure git has processed the reset
-        usleep(100000); // 100ms delay
-
-        // Refresh everything
-        get_ncurses_changed_files(viewer);
-        get_commit_history(viewer);
-
-        // Reset file selection since changes are discarded
-        viewer->selected_file = 0;
-        viewer->file_line_count = 0;
-        viewer->file_scroll_offset = 0;
-
-        // Reload current file if any files exist
-        if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-            load_file_with_staging_info(viewer, viewer->files[viewer->selected_file].filename);
-        }
-
-        return 1;
-    }
-
-    return 0;
+    const char* argv[] = {"git", "reset", "--hard", "HEAD~1", NULL};
+    return git_jobs_submit("reset", argv, NULL, 0, on_hard_reset_done, viewer) != 0;
 }
 
 int amend_commit(NCursesDiffViewer* viewer) {
@@ -1604,18 +1854,15 @@ int amend_commit(NCursesDiffViewer* viewer) {
     char current_title[MAX_COMMIT_TITLE_LEN] = "";
     char current_message[2048] = "";
 
-    // Get the current commit message
-    FILE* fp = popen("git log -1 --pretty=format:%s 2>/dev/null", "r");
-    if (fp) {
-        fgets(current_title, sizeof(current_title), fp);
-        pclose(fp);
-    }
-
-    // Get the current commit body (if any)
-    fp = popen("git log -1 --pretty=format:%b 2>/dev/null", "r");
-    if (fp) {
-        fgets(current_message, sizeof(current_message), fp);
-        pclose(fp);
+    // Get the current commit message and body (if any)
+    GitObject head;
+    if (git_broker_read_object("HEAD", &head)) {
+        GitCommitInfo info;
+        if (git_parse_commit(head.data, head.size, &info)) {
+            git_commit_message_parts(&info, current_title, sizeof(current_title), current_message,
+                                     sizeof(current_message));
+        }
+        git_object_free(&head);
     }
 
     // Get new commit message from user (pre-filled with current message)
@@ -1629,64 +1876,10 @@ int amend_commit(NCursesDiffViewer* viewer) {
 
     if (get_commit_title_input(new_title, MAX_COMMIT_TITLE_LEN, new_message, sizeof(new_message))) {
         // Add any marked files first
-        for (int i = 0; i < viewer->file_count; i++) {
-            if (viewer->files[i].marked_for_commit) {
-                char cmd[1024];
-                snprintf(cmd, sizeof(cmd), "git add \"%s\" 2>/dev/null >/dev/null",
-                         viewer->files[i].filename);
-                system(cmd);
-            }
-        }
-
-        // Write amended commit message to temp file
-        char temp_msg_file[256];
-        snprintf(temp_msg_file, sizeof(temp_msg_file), "/tmp/amend_msg_%d", getpid());
-
-        FILE* msg_file = fopen(temp_msg_file, "w");
-        if (!msg_file)
+        if (!queue_stage_marked_files(viewer))
             return 0;
 
-        if (strlen(new_message) > 0) {
-            fprintf(msg_file, "%s\n\n%s", new_title, new_message);
-        } else {
-            fprintf(msg_file, "%s", new_title);
-        }
-        fclose(msg_file);
-
-        char amend_cmd[512];
-        snprintf(amend_cmd, sizeof(amend_cmd),
-                 "git commit --amend -F \"%s\" 2>/dev/null >/dev/null", temp_msg_file);
-        int result = system(amend_cmd);
-        unlink(temp_msg_file);
-
-        // this is a change i want
-        // this is a change i dont want
-
-        if (result == 0) {
-            // Small delay to ensure git has processed the amend
-            usleep(100000); // 100ms delay
-
-            // Refresh everything after ammending
-            get_ncurses_changed_files(viewer);
-            get_commit_history(viewer);
-            get_ncurses_git_branches(viewer);
-
-            // Reset selection if no files remain
-            if (viewer->file_count == 0) {
-                viewer->selected_file = 0;
-                viewer->file_line_count = 0;
-                viewer->file_scroll_offset = 0;
-            } else if (viewer->selected_file >= viewer->file_count) {
-                viewer->selected_file = viewer->file_count - 1;
-            }
-
-            // Reload current file if any files exist
-            if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-                load_file_with_staging_info(viewer, viewer->files[viewer->selected_file].filename);
-            }
-
-            return 1;
-        }
+        return queue_commit(viewer, 1, new_title, new_message);
     }
 
     return 0;
@@ -1973,18 +2166,10 @@ int get_github_credentials(char* username, int username_len, char* token, int to
     return 1;
 }
 
-int execute_git_with_auth(const char* base_cmd, const char* username, const char* token) {
-    if (!base_cmd || !username || !token)
-        return 1;
-
-    FILE* debug_file = fopen("/tmp/git_debug.log", "a");
-    if (debug_file) {
-        fprintf(debug_file, "\n=== Executing git with auth (SAFE VERSION) ===\n");
-        fprintf(debug_file, "Base command: %s\n", base_cmd);
-        fprintf(debug_file, "Username: %s\n", username);
-        fprintf(debug_file, "Token length: %zu\n", strlen(token));
-        fclose(debug_file);
-    }
+// Build an https URL for the origin remote that carries the credentials
+static int build_git_auth_url(const char* username, const char* token, char* auth_url,
+                              size_t auth_url_size) {
+    FILE* debug_file;
 
     // Get remote URL to determine auth format
     char remote_url[1024] = "";
@@ -1995,7 +2180,7 @@ int execute_git_with_auth(const char* base_cmd, const char* username, const char
             fprintf(debug_file, "ERROR: Could not get remote URL\n");
             fclose(debug_file);
         }
-        return 1;
+        return 0;
     }
 
     if (fgets(remote_url, sizeof(remote_url), fp) == NULL) {
@@ -2005,7 +2190,7 @@ int execute_git_with_auth(const char* base_cmd, const char* username, const char
             fprintf(debug_file, "ERROR: No remote URL found\n");
             fclose(debug_file);
         }
-        return 1;
+        return 0;
     }
     pclose(fp);
 
@@ -2019,13 +2204,9 @@ int execute_git_with_auth(const char* base_cmd, const char* username, const char
         fclose(debug_file);
     }
 
-    // Create authenticated command using environment variables - SAFE APPROACH
-    char auth_cmd[4096];
-    char auth_url[2048];
-
     if (strstr(remote_url, "https://github.com/")) {
         char* repo_part = remote_url + strlen("https://github.com/");
-        snprintf(auth_url, sizeof(auth_url), "https://%s:%s@github.com/%s", username, token,
+        snprintf(auth_url, auth_url_size, "https://%s:%s@github.com/%s", username, token,
                  repo_part);
     } else if (strstr(remote_url, "git@github.com:")) {
         char* repo_part = strchr(remote_url, ':') + 1;
@@ -2035,7 +2216,7 @@ int execute_git_with_auth(const char* base_cmd, const char* username, const char
         if (strstr(repo_clean, ".git")) {
             *(strstr(repo_clean, ".git")) = '\0';
         }
-        snprintf(auth_url, sizeof(auth_url), "https://%s:%s@github.com/%s", username, token,
+        snprintf(auth_url, auth_url_size, "https://%s:%s@github.com/%s", username, token,
                  repo_clean);
     } else {
         debug_file = fopen("/tmp/git_debug.log", "a");
@@ -2043,9 +2224,30 @@ int execute_git_with_auth(const char* base_cmd, const char* username, const char
             fprintf(debug_file, "ERROR: Unsupported remote URL format: %s\n", remote_url);
             fclose(debug_file);
         }
+        return 0;
+    }
+
+    return 1;
+}
+
+int execute_git_with_auth(const char* base_cmd, const char* username, const char* token) {
+    if (!base_cmd || !username || !token)
         return 1;
+
+    FILE* debug_file = fopen("/tmp/git_debug.log", "a");
+    if (debug_file) {
+        fprintf(debug_file, "\n=== Executing git with auth (SAFE VERSION) ===\n");
+        fprintf(debug_file, "Base command: %s\n", base_cmd);
+        fprintf(debug_file, "Username: %s\n", username);
+        fprintf(debug_file, "Token length: %zu\n", strlen(token));
+        fclose(debug_file);
     }
 
+    char auth_cmd[4096];
+    char auth_url[2048];
+    if (!build_git_auth_url(username, token, auth_url, sizeof(auth_url)))
+        return 1;
+
     // Create a simple git push command with authenticated URL
     snprintf(auth_cmd, sizeof(auth_cmd), "git push %s", auth_url);
 
@@ -2074,6 +2276,136 @@ int execute_git_with_auth(const char* base_cmd, const char* username, const char
     return result;
 }
 
+// Keep git from prompting on a terminal it does not own
+static const char* const git_no_prompt_env[] = {"GIT_ASKPASS=/bin/false", "GIT_TERMINAL_PROMPT=0",
+                                                "SSH_ASKPASS=/bin/false", NULL};
+
+static void finish_push(NCursesDiffViewer* viewer, int success) {
+    if (success) {
+        // Immediately transition to "Pushed!" animation
+        viewer->sync_status = SYNC_STATUS_PUSHED_APPEARING;
+        viewer->animation_frame = 0;
+        viewer->text_char_count = 0;
+
+        // Set branch-specific pushed status
+        viewer->branch_push_status = SYNC_STATUS_PUSHED_APPEARING;
+        viewer->branch_animation_frame = 0;
+        viewer->branch_text_char_count = 0;
+
+        // Refresh commit history to get proper push status
+        request_viewer_refresh(viewer, VIEWER_REFRESH_FILES | VIEWER_REFRESH_COMMITS |
+                                           VIEWER_REFRESH_BRANCHES);
+    } else {
+        // Push failed, show error
+        show_error_popup("Push failed. Check your network, credentials, or get a "
+                         "Personal Access Token from github.com/settings/tokens");
+        viewer->sync_status = SYNC_STATUS_IDLE;
+        viewer->pushing_branch_index = -1;
+        viewer->branch_push_status = SYNC_STATUS_IDLE;
+    }
+}
+
+static void on_auth_push_done(const GitJob* job, void* ctx) {
+    FILE* debug_file = fopen("/tmp/git_debug.log", "a");
+    if (debug_file) {
+        fprintf(debug_file, "Git command result: %d\n", job->exit_status);
+        fclose(debug_file);
+    }
+    finish_push(ctx, job->exit_status == 0);
+}
+
+// Ask for GitHub credentials on a freshly initialised screen
+static int prompt_push_credentials(char* username, int username_len, char* token,
+                                   int token_len) {
+    // Save current terminal state and fully clear screen
+    endwin();
+    clear();
+    refresh();
+
+    // Reinitialize ncurses for clean credential dialog
+    initscr();
+    noecho();
+    cbreak();
+    keypad(stdscr, TRUE);
+    start_color();
+
+    // Initialize color pairs for the dialog
+    init_pair(1, COLOR_WHITE, COLOR_BLACK);
+    init_pair(2, COLOR_GREEN, COLOR_BLACK);
+    init_pair(3, COLOR_YELLOW, COLOR_BLACK);
+    init_pair(4, COLOR_CYAN, COLOR_BLACK);
+    init_pair(5, COLOR_RED, COLOR_BLACK);
+    init_pair(6, COLOR_MAGENTA, COLOR_BLACK);
+
+    clear();
+    refresh();
+
+    int result = get_github_credentials(username, username_len, token, token_len);
+
+    // Force complete screen refresh after credential dialog
+    clear();
+    refresh();
+    nodelay(stdscr, TRUE);
+    return result;
+}
+
+static void on_push_done(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status == 0) {
+        finish_push(viewer, 1);
+        return;
+    }
+
+    // If push failed, immediately try with authentication
+    FILE* debug_file = fopen("/tmp/git_debug.log", "a");
+    if (debug_file) {
+        fprintf(debug_file, "\n=== PUSH FAILED - Starting credential flow ===\n");
+        fprintf(debug_file, "Initial push result: %d\n", job->exit_status);
+        fclose(debug_file);
+    }
+
+    char username[256] = "";
+    char token[512] = ""; // Larger buffer for long PATs
+    char auth_url[2048] = "";
+    int queued = 0;
+
+    if (prompt_push_credentials(username, sizeof(username), token, sizeof(token))) {
+        if (build_git_auth_url(username, token, auth_url, sizeof(auth_url))) {
+            const char* argv[] = {"git", "push", "--progress", auth_url, NULL};
+            queued = git_jobs_submit("push", argv, git_no_prompt_env, 0, on_auth_push_done,
+                                     viewer) != 0;
+        }
+    } else {
+        debug_file = fopen("/tmp/git_debug.log", "a");
+        if (debug_file) {
+            fprintf(debug_file, "Credential dialog cancelled by user\n");
+            fclose(debug_file);
+        }
+    }
+
+    // Clear credentials from memory for security
+    memset(username, 0, sizeof(username));
+    memset(token, 0, sizeof(token));
+    memset(auth_url, 0, sizeof(auth_url));
+
+    if (!queued)
+        finish_push(viewer, 0);
+}
+
+static void on_upstream_push_done(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status == 0) {
+        // Upstream set successfully, show success and refresh
+        viewer->sync_status = SYNC_STATUS_PUSHED_APPEARING;
+        viewer->animation_frame = 0;
+        viewer->text_char_count = 0;
+        request_viewer_refresh(viewer, VIEWER_REFRESH_COMMITS | VIEWER_REFRESH_BRANCHES);
+    } else {
+        show_error_popup("Failed to set upstream and push. Check your connection.");
+        viewer->sync_status = SYNC_STATUS_IDLE;
+    }
+}
+
 int push_commit(NCursesDiffViewer* viewer, int commit_index) {
     if (!viewer || commit_index < 0 || commit_index >= viewer->commit_count)
         return 0;
@@ -2091,28 +2423,20 @@ int push_commit(NCursesDiffViewer* viewer, int commit_index) {
         char upstream_selection[512];
         if (show_upstream_selection_dialog(current_branch, upstream_selection,
                                            sizeof(upstream_selection))) {
-            // User selected an upstream, set it up
-            char cmd[1024];
-            snprintf(cmd, sizeof(cmd), "git push --set-upstream %s >/dev/null 2>&1",
-                     upstream_selection);
-
-            int result = system(cmd);
-            if (result == 0) {
-                // Upstream set successfully, show success and refresh
-                viewer->sync_status = SYNC_STATUS_PUSHED_APPEARING;
-                viewer->animation_frame = 0;
-                viewer->text_char_count = 0;
-                get_commit_history(viewer);
-
-                // Only refresh the commit pane
-                werase(viewer->commit_list_win);
-                render_commit_list_window(viewer);
-                wrefresh(viewer->commit_list_win);
+            // "<remote> <branch>" becomes separate arguments
+            const char* argv[16] = {"git", "push", "--progress", "--set-upstream"};
+            int argc = 4;
+            for (char* word = strtok(upstream_selection, " \t"); word && argc < 15;
+                 word = strtok(NULL, " \t")) {
+                argv[argc++] = word;
+            }
+            argv[argc] = NULL;
 
+            if (git_jobs_submit("push", argv, git_no_prompt_env, 0, on_upstream_push_done,
+                                viewer)) {
                 return 1;
-            } else {
-                show_error_popup("Failed to set upstream and push. Check your connection.");
             }
+            show_error_popup("Failed to set upstream and push. Check your connection.");
         }
 
         viewer->sync_status = SYNC_STATUS_IDLE;
@@ -2147,147 +2471,42 @@ int push_commit(NCursesDiffViewer* viewer, int commit_index) {
     viewer->branch_animation_frame = 0;
     viewer->branch_text_char_count = 7; // Show full "Pushing" immediately
 
-    // Force immediate branch window refresh to show "Pushing" before the blocking
-    // git operation
-
-    werase(viewer->branch_list_win);
-    render_file_list_window(viewer);
-    render_file_content_window(viewer);
-    render_commit_list_window(viewer);
-    render_branch_list_window(viewer);
-    render_stash_list_window(viewer);
-    render_status_bar(viewer);
-
-    // Create a simple animated push with spinner updates
-    pid_t push_pid;
-    int result = 0;
-
-    // Try push first without authentication
-    char push_cmd[256];
-    if (is_diverged) {
-        strcpy(push_cmd, "git push --force-with-lease origin");
-    } else {
-        strcpy(push_cmd, "git push origin");
+    // Try push without credentials first - force git to fail without prompting.
+    // A failure falls through to the credential flow in on_push_done().
+    const char* force_argv[] = {"git", "push", "--progress", "--force-with-lease", "origin", NULL};
+    const char* plain_argv[] = {"git", "push", "--progress", "origin", NULL};
+    if (git_jobs_submit("push", is_diverged ? force_argv : plain_argv, git_no_prompt_env, 0,
+                        on_push_done, viewer)) {
+        return 1;
     }
 
-    // Try push without credentials first - force git to fail without prompting
-    // Use multiple methods to ensure git doesn't prompt for credentials
-    result = system(is_diverged ? "GIT_ASKPASS=/bin/false GIT_TERMINAL_PROMPT=0 "
-                                  "SSH_ASKPASS=/bin/false git push --force-with-lease "
-                                  "origin </dev/null >/dev/null 2>/dev/null"
-                                : "GIT_ASKPASS=/bin/false GIT_TERMINAL_PROMPT=0 "
-                                  "SSH_ASKPASS=/bin/false git push origin </dev/null "
-                                  ">/dev/null 2>/dev/null");
-
-    // If push failed, immediately try with authentication
-    if (result != 0) {
-        FILE* debug_file = fopen("/tmp/git_debug.log", "a");
-        if (debug_file) {
-            fprintf(debug_file, "\n=== PUSH FAILED - Starting credential flow ===\n");
-            fprintf(debug_file, "Initial push result: %d\n", result);
-            fclose(debug_file);
-        }
-
-        char username[256] = "";
-        char token[512] = ""; // Larger buffer for long PATs
-
-        // Save current terminal state and fully clear screen
-        endwin();
-        clear();
-        refresh();
-
-        // Reinitialize ncurses for clean credential dialog
-        initscr();
-        noecho();
-        cbreak();
-        keypad(stdscr, TRUE);
-        start_color();
-
-        // Initialize color pairs for the dialog
-        init_pair(1, COLOR_WHITE, COLOR_BLACK);
-        init_pair(2, COLOR_GREEN, COLOR_BLACK);
-        init_pair(3, COLOR_YELLOW, COLOR_BLACK);
-        init_pair(4, COLOR_CYAN, COLOR_BLACK);
-        init_pair(5, COLOR_RED, COLOR_BLACK);
-        init_pair(6, COLOR_MAGENTA, COLOR_BLACK);
-
-        clear();
-        refresh();
-
-        debug_file = fopen("/tmp/git_debug.log", "a");
-        if (debug_file) {
-            fprintf(debug_file, "Ncurses reinitialized, calling credential dialog\n");
-            fclose(debug_file);
-        }
-
-        if (get_github_credentials(username, sizeof(username), token, sizeof(token))) {
-            debug_file = fopen("/tmp/git_debug.log", "a");
-            if (debug_file) {
-                fprintf(debug_file, "Credentials obtained successfully, attempting "
-                                    "authenticated push\n");
-                fclose(debug_file);
-            }
+    finish_push(viewer, 0);
+    return 0;
+}
 
-            // Try authenticated push
-            result = execute_git_with_auth(push_cmd, username, token);
+static void on_pull_done(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
 
-            // Clear credentials from memory for security
-            memset(username, 0, sizeof(username));
-            memset(token, 0, sizeof(token));
-        } else {
-            debug_file = fopen("/tmp/git_debug.log", "a");
-            if (debug_file) {
-                fprintf(debug_file, "Credential dialog cancelled by user\n");
-                fclose(debug_file);
-            }
-            result = 1; // User cancelled
+    if (job->exit_status == 0) {
+        if (viewer->pulling_branch_index >= 0) {
+            // Reset branch animation completely
+            viewer->branch_pull_status = SYNC_STATUS_PULLED_APPEARING;
+            viewer->branch_animation_frame = 0;
+            viewer->branch_text_char_count = 0;
         }
 
-        // Force complete screen refresh after credential dialog
-        clear();
-        refresh();
-    }
-
-    // Update UI after push attempt
-    get_ncurses_changed_files(viewer);
-    get_commit_history(viewer);
-    get_ncurses_git_branches(viewer);
-
-    if (result == 0) {
-        // Immediately transition to "Pushed!" animation
-        viewer->sync_status = SYNC_STATUS_PUSHED_APPEARING;
+        // Refresh everything after pull
+        request_viewer_refresh(viewer, VIEWER_REFRESH_FILES | VIEWER_REFRESH_COMMITS |
+                                           VIEWER_REFRESH_BRANCHES);
+        viewer->sync_status = SYNC_STATUS_PULLED_APPEARING;
         viewer->animation_frame = 0;
         viewer->text_char_count = 0;
-
-        // Set branch-specific pushed status
-        viewer->branch_push_status = SYNC_STATUS_PUSHED_APPEARING;
-        viewer->branch_animation_frame = 0;
-        viewer->branch_text_char_count = 0;
-
-        // Refresh commit history to get proper push status
-        get_commit_history(viewer);
-        get_ncurses_git_branches(viewer); // Add this line to refresh branch status
-
-        // Refresh both commit and branch panes
-        werase(viewer->commit_list_win);
-        render_commit_list_window(viewer);
-        wrefresh(viewer->commit_list_win);
-
-        werase(viewer->branch_list_win);
-        render_branch_list_window(viewer);
-        wrefresh(viewer->branch_list_win);
-
-        return 1;
     } else {
-        // Push failed, show error
-        show_error_popup("Push failed. Check your network, credentials, or get a "
-                         "Personal Access Token from github.com/settings/tokens");
+        show_error_popup("Pull failed. Check your network connection.");
         viewer->sync_status = SYNC_STATUS_IDLE;
-        viewer->pushing_branch_index = -1;
-        viewer->branch_push_status = SYNC_STATUS_IDLE;
+        viewer->pulling_branch_index = -1;
+        viewer->branch_pull_status = SYNC_STATUS_IDLE;
     }
-
-    return 0;
 }
 
 int pull_commits(NCursesDiffViewer* viewer) {
@@ -2299,34 +2518,12 @@ int pull_commits(NCursesDiffViewer* viewer) {
     viewer->animation_frame = 0;
     viewer->text_char_count = 0;
 
-    // Render immediately to show the animation start
-    render_status_bar(viewer);
-
-    // Do the actual pull work
-    int result = system("git pull origin 2>/dev/null >/dev/null");
-
-    if (result == 0) {
-        // Refresh everything after pull
-        get_ncurses_changed_files(viewer);
-        get_commit_history(viewer);
-
-        // Reset selection if no files remain
-        if (viewer->file_count == 0) {
-            viewer->selected_file = 0;
-            viewer->file_line_count = 0;
-            viewer->file_scroll_offset = 0;
-        } else if (viewer->selected_file >= viewer->file_count) {
-            viewer->selected_file = viewer->file_count - 1;
-        }
-
-        // Reload current file if any
-        if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-            load_file_with_staging_info(viewer, viewer->files[viewer->selected_file].filename);
-        }
-
+    // The pull runs as a job; on_pull_done() refreshes once it finishes
+    const char* argv[] = {"git", "pull", "--progress", "origin", NULL};
+    if (git_jobs_submit("pull", argv, git_no_prompt_env, 0, on_pull_done, viewer))
         return 1;
-    }
 
+    viewer->sync_status = SYNC_STATUS_IDLE;
     return 0;
 }
 
@@ -2350,8 +2547,20 @@ void render_file_list_window(NCursesDiffViewer* viewer) {
         }
     }
 
-    for (int i = 0; i < max_files_visible; i++) {
-        int y = i + 1;
+    // Only the rows on screen are drawn, whatever the list size
+    if (viewer->selected_file < viewer->file_list_scroll_offset)
+        viewer->file_list_scroll_offset = viewer->selected_file;
+    if (max_files_visible > 0 &&
+        viewer->selected_file >= viewer->file_list_scroll_offset + max_files_visible)
+        viewer->file_list_scroll_offset = viewer->selected_file - max_files_visible + 1;
+    if (viewer->file_list_scroll_offset > viewer->file_count - max_files_visible)
+        viewer->file_list_scroll_offset = viewer->file_count - max_files_visible;
+    if (viewer->file_list_scroll_offset < 0)
+        viewer->file_list_scroll_offset = 0;
+
+    for (int row = 0; row < max_files_visible; row++) {
+        int y = row + 1;
+        int i = row + viewer->file_list_scroll_offset;
 
         // Skip if no more files
         if (i >= viewer->file_count)
@@ -2409,12 +2618,13 @@ void render_file_list_window(NCursesDiffViewer* viewer) {
         // Filename (truncated to fit panel with "..")
         int max_name_len = viewer->file_panel_width - 6; // Leave space for border
         char truncated_name[256];
+        if (max_name_len > (int)sizeof(truncated_name) - 1)
+            max_name_len = (int)sizeof(truncated_name) - 1;
         if ((int)strlen(viewer->files[i].filename) > max_name_len) {
-            strncpy(truncated_name, viewer->files[i].filename, max_name_len - 2);
-            truncated_name[max_name_len - 2] = '\0';
-            strcat(truncated_name, "..");
+            snprintf(truncated_name, sizeof(truncated_name), "%.*s..", max_name_len - 2,
+                     viewer->files[i].filename);
         } else {
-            strcpy(truncated_name, viewer->files[i].filename);
+            snprintf(truncated_name, sizeof(truncated_name), "%s", viewer->files[i].filename);
         }
 
         // show staged indicator and filename
@@ -2790,13 +3000,33 @@ void render_file_content_window(NCursesDiffViewer* viewer) {
         int y = split_line + 1 + staged_display_count;
         int color_pair = 0;
 
+        // Lines marked to unstage are dimmed like marked unstaged lines
+        int marked = !line->is_staged && (line->type == '+' || line->type == '-');
+
         // Determine color based on line type
-        if (line->type == '+') {
+        if (line->type == '@' || marked) {
+            color_pair = 3; // Cyan for headers
+        } else if (line->type == '+') {
             color_pair = 1; // Green for additions
         } else if (line->type == '-') {
             color_pair = 2; // Red for deletions
-        } else if (line->type == '@') {
-            color_pair = 3; // Cyan for headers
+        }
+
+        if (marked) {
+            if (is_cursor_line) {
+                wattron(viewer->file_content_win, A_REVERSE);
+            }
+            wattron(viewer->file_content_win, COLOR_PAIR(2));
+            mvwaddch(viewer->file_content_win, y, 1, '*');
+            wattroff(viewer->file_content_win, COLOR_PAIR(2));
+            if (is_cursor_line) {
+                wattroff(viewer->file_content_win, A_REVERSE);
+            }
+
+            int rows_used = render_wrapped_line(viewer->file_content_win, line->line + 1, y, 2,
+                                                width - 2, line_height, color_pair, is_cursor_line);
+            staged_display_count += rows_used;
+            continue;
         }
 
         // Render the line with wrapping
@@ -2827,6 +3057,8 @@ void render_status_bar(NCursesDiffViewer* viewer) {
     } else if (viewer->current_mode == NCURSES_MODE_BRANCH_LIST) {
         strcpy(keybindings, "View: Enter | Checkout: c | New: n | Rename: r | "
                             "Delete: d | Pull: p | Nav: j/k");
+    } else if (viewer->current_mode == NCURSES_MODE_FILE_VIEW && viewer->split_view_mode) {
+        strcpy(keybindings, "Mark: <space> | Apply: a | Clear: r | Pane: Tab | Back: Esc");
     } else if (viewer->current_mode == NCURSES_MODE_FILE_VIEW) {
         strcpy(keybindings, "Scroll: j/k | Page: Ctrl+U/D | Back: Esc");
     } else if (viewer->current_mode == NCURSES_MODE_COMMIT_VIEW) {
@@ -2979,6 +3211,20 @@ void render_status_bar(NCursesDiffViewer* viewer) {
         }
     }
 
+    // Latest output of the running git job, between the key bindings and sync status
+    const GitJob* job = git_jobs_running();
+    if (job && job->progress[0]) {
+        int right = viewer->terminal_width - (int)strlen(sync_text) - 3;
+        int width = right - ((int)strlen(keybindings) + 4);
+        if (width > 10) {
+            char progress[GIT_JOB_PROGRESS_LEN];
+            snprintf(progress, sizeof(progress), "%.*s", width, job->progress);
+            wattron(viewer->status_bar_win, COLOR_PAIR(4));
+            mvwprintw(viewer->status_bar_win, 0, right - (int)strlen(progress), "%s", progress);
+            wattroff(viewer->status_bar_win, COLOR_PAIR(4));
+        }
+    }
+
     wrefresh(viewer->status_bar_win);
 
     // Ensure cursor stays hidden and positioned off-screen
@@ -2993,8 +3239,9 @@ void update_sync_status(NCursesDiffViewer* viewer) {
     time_t current_time = time(NULL);
 
     // Check if it's time to sync (every 30 seconds)
+    // Fetching while other git jobs run would overwrite their status
     if (current_time - viewer->last_sync_time >= 30 && !viewer->critical_operation_in_progress &&
-        !viewer->fetch_in_progress) {
+        !viewer->fetch_in_progress && !git_jobs_active(NULL)) {
         viewer->last_sync_time = current_time;
 
         // Start background fetch instead of blocking
@@ -3002,9 +3249,6 @@ void update_sync_status(NCursesDiffViewer* viewer) {
         return;
     }
 
-    // Always check if background fetch is complete
-    check_background_fetch(viewer);
-
     // Handle all animation states
     if (viewer->sync_status != SYNC_STATUS_IDLE) {
         viewer->animation_frame++;
@@ -3052,9 +3296,8 @@ void update_sync_status(NCursesDiffViewer* viewer) {
                     viewer->animation_frame = 0;
                 }
             } else if (viewer->sync_status == SYNC_STATUS_PUSHING_VISIBLE) {
-                // Visible with spinner - keep spinning until push_commit changes status
-                // Don't auto-transition, let push_commit function handle the transition
-                // This allows the spinner to keep going during the blocking git push
+                // Visible with spinner - keep spinning until the push job finishes
+                // Don't auto-transition, the job callback handles the transition
             } else if (viewer->sync_status == SYNC_STATUS_PUSHING_DISAPPEARING) {
                 // Disappearing: remove one character every frame (0.05s)
                 int chars_to_remove = viewer->animation_frame;
@@ -3079,8 +3322,9 @@ void update_sync_status(NCursesDiffViewer* viewer) {
                     viewer->animation_frame = 0;
                 }
             } else if (viewer->sync_status == SYNC_STATUS_PULLING_VISIBLE) {
-                // Visible with spinner for 1.2 seconds (24 frames) - faster
-                if (viewer->animation_frame >= 24) {
+                // Visible with spinner for at least 1.2 seconds (24 frames), and
+                // until the pull job reports back
+                if (viewer->animation_frame >= 24 && !git_jobs_active("pull")) {
                     viewer->sync_status = SYNC_STATUS_PULLING_DISAPPEARING;
                     viewer->animation_frame = 0;
                     viewer->text_char_count = 7;
@@ -3256,43 +3500,19 @@ int commit_staged_changes_only(NCursesDiffViewer* viewer, const char* commit_tit
     if (!viewer || !commit_title || strlen(commit_title) == 0)
         return 0;
 
-    char temp_msg_file[256];
-    snprintf(temp_msg_file, sizeof(temp_msg_file), "/tmp/commit_msg_%d", getpid());
-
-    FILE* msg_file = fopen(temp_msg_file, "w");
-    if (!msg_file)
-        return 0;
+    return queue_commit(viewer, 0, commit_title, commit_message);
+}
 
-    if (commit_message && strlen(commit_message) > 0) {
-        fprintf(msg_file, "%s\n\n%s", commit_title, commit_message);
-    } else {
-        fprintf(msg_file, "%s", commit_title);
+static void on_checkout_done(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status != 0) {
+        show_error_popup("Checkout failed. Check for uncommitted changes.");
+        return;
     }
-    fclose(msg_file);
-
-    char commit_cmd[512];
-    snprintf(commit_cmd, sizeof(commit_cmd), "git commit -F \"%s\" 2>/dev/null >/dev/null",
-             temp_msg_file);
-    int result = system(commit_cmd);
-    unlink(temp_msg_file);
-
-    if (result == 0) {
-        usleep(100000);
-
-        get_ncurses_changed_files(viewer);
-        get_commit_history(viewer);
-        get_ncurses_git_branches(viewer);
 
-        if (viewer->file_count == 0) {
-            viewer->selected_file = 0;
-            viewer->file_line_count = 0;
-            viewer->file_scroll_offset = 0;
-        } else if (viewer->selected_file >= viewer->file_count) {
-            viewer->selected_file = viewer->file_count - 1;
-        }
-        return 1;
-    }
-    return 0;
+    // Refresh everything after branch switch
+    request_viewer_refresh(viewer, VIEWER_REFRESH_FILES | VIEWER_REFRESH_COMMITS |
+                                       VIEWER_REFRESH_BRANCHES);
 }
 
 int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
@@ -3469,7 +3689,7 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
                 if (viewer->active_pane == 0) {
                     stage_hunk_by_line(viewer, viewer->file_cursor_line);
                 } else {
-                    // Unstage from staged pane
+                    // Mark for unstaging from staged pane
                     unstage_line_from_git(viewer, viewer->staged_cursor_line);
                 }
             } else {
@@ -3495,7 +3715,7 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
             }
             break;
 
-        case 'a': // apply staged changes
+        case 'a': // Apply marked lines in both panes as one batch
             if (viewer->split_view_mode) {
                 apply_staged_changes(viewer);
                 clear();
@@ -3503,7 +3723,7 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
             }
             break;
 
-        case 'r': // Reset staged changes
+        case 'r': // Clear marks
             if (viewer->split_view_mode) {
                 reset_staged_changes(viewer);
             }
@@ -3735,6 +3955,7 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
 
         case KEY_DOWN:
         case 'j':
+            ensure_commit_loaded(viewer, viewer->selected_commit + 1);
             if (viewer->selected_commit < viewer->commit_count - 1) {
                 viewer->selected_commit++;
                 int max_commits_visible = viewer->commit_panel_height - 2;
@@ -4017,38 +4238,12 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
 
         case 'c': // c - Checkout selected branch
             if (viewer->branch_count > 0 && viewer->selected_branch < viewer->branch_count) {
-                viewer->critical_operation_in_progress = 1;
-                char cmd[512];
-                snprintf(cmd, sizeof(cmd), "git checkout \"%s\" >/dev/null 2>&1",
-                         viewer->branches[viewer->selected_branch].name);
-
-                if (system(cmd) == 0) {
-                    // Refresh everything after branch switch
-                    get_ncurses_changed_files(viewer);
-                    get_commit_history(viewer);
-                    get_ncurses_git_branches(
-                        viewer); // Refresh branch list to update current branch
-
-                    // Reset file selection if no files remain
-                    if (viewer->file_count == 0) {
-                        viewer->selected_file = 0;
-                        viewer->file_line_count = 0;
-                        viewer->file_scroll_offset = 0;
-                    } else if (viewer->selected_file >= viewer->file_count) {
-                        viewer->selected_file = viewer->file_count - 1;
-                    }
-
-                    // Reload current file if any files exist
-                    if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-                        load_file_with_staging_info(viewer,
-                                                    viewer->files[viewer->selected_file].filename);
-                    }
+                const char* argv[] = {"git", "checkout",
+                                      viewer->branches[viewer->selected_branch].name, NULL};
+                if (!git_jobs_submit("checkout", argv, NULL, GIT_JOB_COALESCE, on_checkout_done,
+                                     viewer)) {
+                    show_error_popup("Too many git operations queued");
                 }
-                viewer->critical_operation_in_progress = 0;
-
-                // Force complete screen refresh after checkout
-                clear();
-                refresh();
             }
             break;
 
@@ -4057,45 +4252,8 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
             viewer->critical_operation_in_progress = 1;
             char new_branch_name[256];
             if (get_branch_name_input(new_branch_name, sizeof(new_branch_name))) {
-                if (create_git_branch(new_branch_name)) {
-                    // Refresh everything after creating new branch
-                    get_ncurses_changed_files(viewer);
-                    get_commit_history(viewer);
-                    get_ncurses_git_branches(viewer);
-
-                    // Find and select the new branch (need to look for the cleaned name
-                    // with dashes)
-                    char clean_branch_name[256];
-                    strncpy(clean_branch_name, new_branch_name, sizeof(clean_branch_name) - 1);
-                    clean_branch_name[sizeof(clean_branch_name) - 1] = '\0';
-                    for (int j = 0; clean_branch_name[j] != '\0'; j++) {
-                        if (clean_branch_name[j] == ' ') {
-                            clean_branch_name[j] = '-';
-                        }
-                    }
-
-                    for (int i = 0; i < viewer->branch_count; i++) {
-                        if (strcmp(viewer->branches[i].name, clean_branch_name) == 0) {
-                            viewer->selected_branch = i;
-                            break;
-                        }
-                    }
-
-                    // Reset file selection if no files remain
-                    if (viewer->file_count == 0) {
-                        viewer->selected_file = 0;
-                        viewer->file_line_count = 0;
-                        viewer->file_scroll_offset = 0;
-                    } else if (viewer->selected_file >= viewer->file_count) {
-                        viewer->selected_file = viewer->file_count - 1;
-                    }
-
-                    // Reload current file if any files exist
-                    if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-                        load_file_with_staging_info(viewer,
-                                                    viewer->files[viewer->selected_file].filename);
-                    }
-                }
+                if (!create_git_branch(viewer, new_branch_name))
+                    show_error_popup("Too many git operations queued");
             }
 
             // Force immediate branch window update
@@ -4122,16 +4280,8 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
 
                 DeleteBranchOption option = show_delete_branch_dialog(branch_to_delete);
                 if (option != DELETE_CANCEL) {
-                    if (delete_git_branch(branch_to_delete, option)) {
-                        // Refresh branch list after deletion
-                        get_ncurses_git_branches(viewer);
-
-                        // Adjust selection if needed
-                        if (viewer->selected_branch >= viewer->branch_count &&
-                            viewer->branch_count > 0) {
-                            viewer->selected_branch = viewer->branch_count - 1;
-                        }
-                    }
+                    // The branch list is reloaded once the deletion has run
+                    delete_git_branch(viewer, branch_to_delete, option);
                 }
 
                 // Force immediate branch window update
@@ -4153,18 +4303,8 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
                 char new_name[256];
 
                 if (get_rename_branch_input(current_name, new_name, sizeof(new_name))) {
-                    if (rename_git_branch(current_name, new_name)) {
-                        // Refresh branch list after rename
-                        get_ncurses_git_branches(viewer);
-
-                        // Find and select the renamed branch
-                        for (int i = 0; i < viewer->branch_count; i++) {
-                            if (strcmp(viewer->branches[i].name, new_name) == 0) {
-                                viewer->selected_branch = i;
-                                break;
-                            }
-                        }
-                    }
+                    if (!rename_git_branch(viewer, current_name, new_name))
+                        show_error_popup("Too many git operations queued");
                 }
 
                 // Force immediate branch window update
@@ -4196,75 +4336,10 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
                     viewer->branch_animation_frame = 0;
                     viewer->branch_text_char_count = 7; // Show full "Pulling" immediately
 
-                    // Force immediate branch window refresh to show "Pulling" before the
-                    // blocking git operation
-                    werase(viewer->branch_list_win);
-                    render_branch_list_window(viewer);
-                    wrefresh(viewer->branch_list_win);
-
-                    // Create a simple animated pull with spinner updates
-                    pid_t pull_pid = fork();
-                    int result = 0;
-
-                    if (pull_pid == 0) {
-                        // Child process: do the actual pull
-                        exit(system("git pull 2>/dev/null >/dev/null"));
-                    }
-
-                    // Parent process: animate the spinner while pull is happening
-                    if (pull_pid > 0) {
-                        int status;
-                        int spinner_counter = 0;
-
-                        while (waitpid(pull_pid, &status, WNOHANG) == 0) {
-                            // Update spinner animation
-                            viewer->branch_animation_frame = spinner_counter;
-                            spinner_counter =
-                                (spinner_counter + 1) % 40; // Cycle every 40 iterations
-
-                            // Refresh the branch window to show spinning animation
-                            werase(viewer->branch_list_win);
-                            render_branch_list_window(viewer);
-                            wrefresh(viewer->branch_list_win);
-
-                            // Small delay for animation timing
-                            usleep(100000); // 100ms delay
-                        }
-
-                        // Get the exit status of the pull command
-                        if (WIFEXITED(status)) {
-                            result = WEXITSTATUS(status);
-                        } else {
-                            result = 1; // Error
-                        }
-                    } else {
-                        result = 1; // Fork failed
-                    }
-
-                    if (result == 0) {
-                        // Reset branch animation completely
-                        viewer->branch_pull_status = SYNC_STATUS_PULLED_APPEARING;
-                        viewer->branch_animation_frame = 0;
-                        viewer->branch_text_char_count = 0;
-
-                        get_ncurses_changed_files(viewer);
-                        get_commit_history(viewer);
-                        get_ncurses_git_branches(viewer);
-                        if (viewer->file_count == 0) {
-                            viewer->selected_file = 0;
-                            viewer->file_line_count = 0;
-                            viewer->file_scroll_offset = 0;
-                        } else if (viewer->selected_file >= viewer->file_count) {
-                            viewer->selected_file = viewer->file_count - 1;
-                        }
-                        if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-                            load_file_with_staging_info(
-                                viewer, viewer->files[viewer->selected_file].filename);
-                        }
-                        viewer->sync_status = SYNC_STATUS_PULLED_APPEARING;
-                        viewer->animation_frame = 0;
-                        viewer->text_char_count = 0;
-                    } else {
+                    // The pull runs as a job; on_pull_done() finishes the animation
+                    const char* argv[] = {"git", "pull", "--progress", NULL};
+                    if (!git_jobs_submit("pull", argv, git_no_prompt_env, 0, on_pull_done,
+                                         viewer)) {
                         show_error_popup("Pull failed. Check your network connection.");
                         viewer->sync_status = SYNC_STATUS_IDLE;
                         viewer->pulling_branch_index = -1;
@@ -4503,6 +4578,24 @@ int handle_ncurses_diff_input(NCursesDiffViewer* viewer, int key) {
     return 1; // Continue
 }
 
+static long viewer_clock_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// Sleep until a key arrives, a git job reports, or the frame timer expires
+static void wait_for_viewer_events(int timeout_ms) {
+    struct pollfd fds[1 + GIT_JOB_MAX_POLLFDS];
+    fds[0].fd = STDIN_FILENO;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    int count = 1 + git_jobs_pollfds(fds + 1, GIT_JOB_MAX_POLLFDS);
+
+    poll(fds, count, timeout_ms);
+    git_jobs_dispatch();
+}
+
 int run_ncurses_diff_viewer(void) {
     NCursesDiffViewer* viewer = malloc(sizeof(NCursesDiffViewer));
     if (!viewer) {
@@ -4516,6 +4609,7 @@ int run_ncurses_diff_viewer(void) {
         return 1;
     }
     signal(SIGWINCH, handle_sigwinch);
+    git_jobs_init();
 
     // Get changed files (can be 0, that's okay)
     get_ncurses_changed_files(viewer);
@@ -4566,6 +4660,7 @@ int run_ncurses_diff_viewer(void) {
     // Main display loop
     int running = 1;
     NCursesViewMode last_mode = viewer->current_mode;
+    long next_frame_ms = 0;
 
     while (running) {
 
@@ -4600,8 +4695,14 @@ int run_ncurses_diff_viewer(void) {
             refresh();
             last_mode = viewer->current_mode;
         }
-        // Update sync status and check for new files
-        update_sync_status(viewer);
+        // Advance animations once per frame, however often input wakes us
+        long now_ms = viewer_clock_ms();
+        if (now_ms >= next_frame_ms) {
+            update_sync_status(viewer);
+            next_frame_ms = now_ms + VIEWER_FRAME_MS;
+        }
+
+        apply_pending_refresh(viewer);
 
         // Update preview based on current selection
         update_preview_for_current_selection(viewer);
@@ -4627,10 +4728,11 @@ int run_ncurses_diff_viewer(void) {
         int c = getch();
         if (c != ERR) { // Only process if a key was actually pressed
             running = handle_ncurses_diff_input(viewer, c);
+            continue; // Drain queued keys before sleeping
         }
 
-        // Small delay to prevent excessive CPU usage and allow animations
-        usleep(20000); // 20ms delay
+        long wait_ms = next_frame_ms - viewer_clock_ms();
+        wait_for_viewer_events(wait_ms > 0 ? (int)wait_ms : 0);
     }
 
     cleanup_ncurses_diff_viewer(viewer);
@@ -4638,6 +4740,92 @@ int run_ncurses_diff_viewer(void) {
     return 0;
 }
 
+static NCursesBranches* append_branch(NCursesDiffViewer* viewer, const char* name,
+                                      int is_current) {
+    if (viewer->branch_count >= viewer->branch_capacity) {
+        int new_capacity = viewer->branch_capacity ? viewer->branch_capacity * 2 : 16;
+        NCursesBranches* new_branches =
+            realloc(viewer->branches, new_capacity * sizeof(NCursesBranches));
+        if (!new_branches)
+            return NULL;
+        viewer->branches = new_branches;
+        viewer->branch_capacity = new_capacity;
+    }
+
+    NCursesBranches* branch = &viewer->branches[viewer->branch_count++];
+    strncpy(branch->name, name, MAX_BRANCHNAME_LEN - 1);
+    branch->name[MAX_BRANCHNAME_LEN - 1] = '\0';
+    branch->status = is_current;
+    branch->commits_ahead = 0;
+    branch->commits_behind = 0;
+    return branch;
+}
+
+// List local branches straight from the refs and count ahead/behind for all
+// of them in one commit walk. Uses the configured upstream, falling back to
+// origin/<branch> like the git branch path below.
+static int get_ncurses_git_branches_native(NCursesDiffViewer* viewer) {
+    GitOdb* odb = git_odb_current();
+    if (!odb)
+        return 0;
+
+    GitRef* refs = NULL;
+    int ref_count = git_odb_list_refs(odb, &refs);
+    if (ref_count <= 0) {
+        free(refs);
+        return 0;
+    }
+
+    char current[MAX_BRANCHNAME_LEN] = "";
+    git_odb_head_branch(odb, current, sizeof(current));
+
+    GitAheadBehind* pairs = NULL;
+    int local_count = 0;
+    for (int i = 0; i < ref_count; i++) {
+        if (strncmp(refs[i].name, "refs/heads/", 11) == 0)
+            local_count++;
+    }
+    if (local_count > 0) {
+        pairs = calloc(local_count, sizeof(GitAheadBehind));
+        if (!pairs) {
+            free(refs);
+            return 0;
+        }
+    }
+
+    for (int i = 0; i < ref_count; i++) {
+        if (strncmp(refs[i].name, "refs/heads/", 11) != 0)
+            continue;
+
+        const char* name = refs[i].name + 11;
+        if (!append_branch(viewer, name, strcmp(name, current) == 0))
+            break;
+
+        GitAheadBehind* pair = &pairs[viewer->branch_count - 1];
+        snprintf(pair->local_oid, sizeof(pair->local_oid), "%s", refs[i].oid);
+
+        char upstream[512];
+        if (!git_odb_branch_upstream(odb, name, upstream, sizeof(upstream)))
+            snprintf(upstream, sizeof(upstream), "refs/remotes/origin/%s", name);
+        if (!git_odb_resolve(odb, upstream, pair->upstream_oid))
+            pair->upstream_oid[0] = '\0';
+    }
+    free(refs);
+
+    if (viewer->branch_count > 0 && !git_ahead_behind(odb, pairs, viewer->branch_count)) {
+        free(pairs);
+        viewer->branch_count = 0;
+        return 0;
+    }
+
+    for (int i = 0; i < viewer->branch_count; i++) {
+        viewer->branches[i].commits_ahead = pairs[i].ahead;
+        viewer->branches[i].commits_behind = pairs[i].behind;
+    }
+    free(pairs);
+    return 1;
+}
+
 int get_ncurses_git_branches(NCursesDiffViewer* viewer) {
     if (!viewer)
         return 0;
@@ -4646,6 +4834,9 @@ int get_ncurses_git_branches(NCursesDiffViewer* viewer) {
 
     // Note: We now do fetching in the background to avoid UI freezes
 
+    if (get_ncurses_git_branches_native(viewer))
+        return 1;
+
     // Use git branch (without -a) to only show local branches
     FILE* fp = popen("git branch 2>/dev/null", "r");
     if (!fp) {
@@ -4653,7 +4844,7 @@ int get_ncurses_git_branches(NCursesDiffViewer* viewer) {
     }
 
     char line[512];
-    while (fgets(line, sizeof(line), fp) && viewer->branch_count < MAX_BRANCHES) {
+    while (fgets(line, sizeof(line), fp)) {
         // Remove newline
         line[strcspn(line, "\n")] = 0;
 
@@ -4687,14 +4878,9 @@ int get_ncurses_git_branches(NCursesDiffViewer* viewer) {
             continue;
         }
 
-        // Copy branch name
-        strncpy(viewer->branches[viewer->branch_count].name, branch_name, MAX_BRANCHNAME_LEN - 1);
-        viewer->branches[viewer->branch_count].name[MAX_BRANCHNAME_LEN - 1] = '\0';
-        viewer->branches[viewer->branch_count].status = is_current;
-
-        // Initialize ahead/behind counts
-        viewer->branches[viewer->branch_count].commits_ahead = 0;
-        viewer->branches[viewer->branch_count].commits_behind = 0;
+        NCursesBranches* branch = append_branch(viewer, branch_name, is_current);
+        if (!branch)
+            break;
 
         // Get ahead/behind status using the exact method lazygit uses
         // First check if remote branch exists
@@ -4714,7 +4900,7 @@ int get_ncurses_git_branches(NCursesDiffViewer* viewer) {
             if (behind_fp) {
                 char behind_count[32];
                 if (fgets(behind_count, sizeof(behind_count), behind_fp) != NULL) {
-                    viewer->branches[viewer->branch_count].commits_behind = atoi(behind_count);
+                    branch->commits_behind = atoi(behind_count);
                 }
                 pclose(behind_fp);
             }
@@ -4728,13 +4914,11 @@ int get_ncurses_git_branches(NCursesDiffViewer* viewer) {
             if (ahead_fp) {
                 char ahead_count[32];
                 if (fgets(ahead_count, sizeof(ahead_count), ahead_fp) != NULL) {
-                    viewer->branches[viewer->branch_count].commits_ahead = atoi(ahead_count);
+                    branch->commits_ahead = atoi(ahead_count);
                 }
                 pclose(ahead_fp);
             }
         }
-
-        viewer->branch_count++;
     }
 
     pclose(fp);
@@ -4825,8 +5009,23 @@ cleanup:
     return result;
 }
 
-int create_git_branch(const char* branch_name) {
-    if (!branch_name || strlen(branch_name) == 0)
+static void on_branch_created(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status != 0) {
+        show_error_popup("Could not create branch");
+        return;
+    }
+
+    // Select the new branch once the list is reloaded; argv is
+    // git checkout -b <name>
+    snprintf(viewer->select_branch_after_refresh, sizeof(viewer->select_branch_after_refresh),
+             "%s", job->argv[3]);
+    request_viewer_refresh(viewer, VIEWER_REFRESH_FILES | VIEWER_REFRESH_COMMITS |
+                                       VIEWER_REFRESH_BRANCHES);
+}
+
+int create_git_branch(NCursesDiffViewer* viewer, const char* branch_name) {
+    if (!viewer || !branch_name || strlen(branch_name) == 0)
         return 0;
 
     // Clean branch name: replace spaces with dashes
@@ -4841,10 +5040,8 @@ int create_git_branch(const char* branch_name) {
         }
     }
 
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "git checkout -b \"%s\" >/dev/null 2>&1", clean_branch_name);
-
-    return (system(cmd) == 0);
+    const char* argv[] = {"git", "checkout", "-b", clean_branch_name, NULL};
+    return git_jobs_submit("branch", argv, NULL, 0, on_branch_created, viewer) != 0;
 }
 
 int get_rename_branch_input(const char* current_name, char* new_name, int max_len) {
@@ -4936,14 +5133,25 @@ cleanup_rename:
     return result;
 }
 
-int rename_git_branch(const char* old_name, const char* new_name) {
-    if (!old_name || !new_name || strlen(old_name) == 0 || strlen(new_name) == 0)
-        return 0;
+static void on_branch_renamed(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status != 0) {
+        show_error_popup("Could not rename branch");
+        return;
+    }
 
-    char cmd[512];
-    snprintf(cmd, sizeof(cmd), "git branch -m \"%s\" \"%s\" >/dev/null 2>&1", old_name, new_name);
+    // Follow the branch to its new name; argv is git branch -m <old> <new>
+    snprintf(viewer->select_branch_after_refresh, sizeof(viewer->select_branch_after_refresh),
+             "%s", job->argv[4]);
+    request_viewer_refresh(viewer, VIEWER_REFRESH_BRANCHES);
+}
 
-    return (system(cmd) == 0);
+int rename_git_branch(NCursesDiffViewer* viewer, const char* old_name, const char* new_name) {
+    if (!viewer || !old_name || !new_name || strlen(old_name) == 0 || strlen(new_name) == 0)
+        return 0;
+
+    const char* argv[] = {"git", "branch", "-m", old_name, new_name, NULL};
+    return git_jobs_submit("branch", argv, NULL, 0, on_branch_renamed, viewer) != 0;
 }
 
 int show_delete_branch_dialog(const char* branch_name) {
@@ -5053,8 +5261,10 @@ void show_error_popup(const char* error_message) {
     wattroff(popup_win, COLOR_PAIR(1));
     wrefresh(popup_win);
 
-    // Wait for user input
+    // Wait for user input; the main loop keeps stdscr non-blocking
+    nodelay(stdscr, FALSE);
     getch();
+    nodelay(stdscr, TRUE);
 
     delwin(popup_win);
     clear();
@@ -5241,8 +5451,29 @@ int branch_has_upstream(const char* branch_name) {
     return (system(cmd) == 0);
 }
 
-int delete_git_branch(const char* branch_name, DeleteBranchOption option) {
-    if (!branch_name || option == DELETE_CANCEL)
+static void on_branch_deleted(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status != 0)
+        show_error_popup("Could not delete branch");
+    request_viewer_refresh(viewer, VIEWER_REFRESH_BRANCHES);
+}
+
+static int queue_remote_branch_delete(NCursesDiffViewer* viewer, const char* branch_name) {
+    const char* argv[] = {"git", "push", "origin", "--delete", branch_name, NULL};
+    return git_jobs_submit("push", argv, git_no_prompt_env, 0, on_branch_deleted, viewer) != 0;
+}
+
+// The remote copy goes only once the local one is gone; argv is
+// git branch -D <name>
+static void on_local_branch_deleted(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status != 0 || !queue_remote_branch_delete(viewer, job->argv[3]))
+        on_branch_deleted(job, ctx);
+}
+
+int delete_git_branch(NCursesDiffViewer* viewer, const char* branch_name,
+                      DeleteBranchOption option) {
+    if (!viewer || !branch_name || option == DELETE_CANCEL)
         return 0;
 
     // Check for upstream before attempting remote deletion
@@ -5255,39 +5486,23 @@ int delete_git_branch(const char* branch_name, DeleteBranchOption option) {
         }
     }
 
-    char cmd[512];
-    int success = 1;
+    const char* local_argv[] = {"git", "branch", "-D", branch_name, NULL};
 
     switch (option) {
     case DELETE_LOCAL:
-        snprintf(cmd, sizeof(cmd), "git branch -D \"%s\" >/dev/null 2>&1", branch_name);
-        success = (system(cmd) == 0);
-        break;
+        return git_jobs_submit("branch", local_argv, NULL, 0, on_branch_deleted, viewer) != 0;
 
     case DELETE_REMOTE:
-        snprintf(cmd, sizeof(cmd), "git push origin --delete \"%s\" >/dev/null 2>&1", branch_name);
-        success = (system(cmd) == 0);
-        break;
+        return queue_remote_branch_delete(viewer, branch_name);
 
     case DELETE_BOTH:
-        // Delete local first
-        snprintf(cmd, sizeof(cmd), "git branch -D \"%s\" >/dev/null 2>&1", branch_name);
-        success = (system(cmd) == 0);
-
-        // Then delete remote
-        if (success) {
-            snprintf(cmd, sizeof(cmd), "git push origin --delete \"%s\" >/dev/null 2>&1",
-                     branch_name);
-            success = (system(cmd) == 0);
-        }
-        break;
+        return git_jobs_submit("branch", local_argv, NULL, 0, on_local_branch_deleted, viewer) !=
+               0;
 
     case DELETE_CANCEL:
     default:
         return 0;
     }
-
-    return success;
 }
 
 int get_ncurses_git_stashes(NCursesDiffViewer* viewer) {
@@ -5455,6 +5670,22 @@ int get_stash_name_input(char* stash_name, int max_len) {
     return strlen(stash_name) > 0 ? 1 : 0;
 }
 
+static void on_stash_done(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    if (job->exit_status != 0)
+        return;
+
+    // Reset file selection since changes are stashed
+    viewer->selected_file = 0;
+    viewer->file_line_count = 0;
+    viewer->file_scroll_offset = 0;
+    viewer->file_cursor_line = 0;
+
+    // Refresh everything after creating stash
+    request_viewer_refresh(viewer, VIEWER_REFRESH_FILES | VIEWER_REFRESH_STASHES |
+                                       VIEWER_REFRESH_COMMITS);
+}
+
 int create_ncurses_git_stash(NCursesDiffViewer* viewer) {
     if (!viewer)
         return 0;
@@ -5465,26 +5696,8 @@ int create_ncurses_git_stash(NCursesDiffViewer* viewer) {
         return 0; // User cancelled
     }
 
-    int result = create_git_stash_with_name(stash_name);
-
-    if (result) {
-        // Refresh everything after creating stash
-        get_ncurses_changed_files(viewer);
-        get_ncurses_git_stashes(viewer);
-        get_commit_history(viewer);
-
-        // Reset file selection since changes are stashed
-        viewer->selected_file = 0;
-        viewer->file_line_count = 0;
-        viewer->file_scroll_offset = 0;
-
-        // Reload current file if any files still exist
-        if (viewer->file_count > 0 && viewer->selected_file < viewer->file_count) {
-            load_file_with_staging_info(viewer, viewer->files[viewer->selected_file].filename);
-        }
-    }
-
-    return result;
+    const char* argv[] = {"git", "stash", "push", "-m", stash_name, NULL};
+    return git_jobs_submit("stash", argv, NULL, 0, on_stash_done, viewer) != 0;
 }
 
 void render_stash_list_window(NCursesDiffViewer* viewer) {
@@ -5665,8 +5878,22 @@ void render_branch_list_window(NCursesDiffViewer* viewer) {
     if (viewer->branch_count == 0) {
         mvwprintw(viewer->branch_list_win, 1, 2, "No branches available");
     } else {
-        for (int i = 0; i < max_branches_visible && i < viewer->branch_count; i++) {
-            int y = i + 1;
+        // Keep the selected branch inside the visible rows
+        if (viewer->selected_branch < viewer->branch_scroll_offset)
+            viewer->branch_scroll_offset = viewer->selected_branch;
+        if (max_branches_visible > 0 &&
+            viewer->selected_branch >= viewer->branch_scroll_offset + max_branches_visible)
+            viewer->branch_scroll_offset = viewer->selected_branch - max_branches_visible + 1;
+        if (viewer->branch_scroll_offset > viewer->branch_count - max_branches_visible)
+            viewer->branch_scroll_offset = viewer->branch_count - max_branches_visible;
+        if (viewer->branch_scroll_offset < 0)
+            viewer->branch_scroll_offset = 0;
+
+        for (int row = 0; row < max_branches_visible; row++) {
+            int i = row + viewer->branch_scroll_offset;
+            if (i >= viewer->branch_count)
+                break;
+            int y = row + 1;
 
             int is_selected_branch =
                 (i == viewer->selected_branch && viewer->current_mode == NCURSES_MODE_BRANCH_LIST);
@@ -6101,18 +6328,32 @@ int parse_branch_commits_to_lines(NCursesDiffViewer* viewer) {
     return viewer->file_line_count;
 }
 
+static void on_fetch_done(const GitJob* job, void* ctx) {
+    NCursesDiffViewer* viewer = ctx;
+    viewer->fetch_in_progress = 0;
+
+    if (job->exit_status != 0) {
+        viewer->sync_status = SYNC_STATUS_IDLE;
+        return;
+    }
+
+    request_viewer_refresh(viewer, VIEWER_REFRESH_FILES | VIEWER_REFRESH_COMMITS |
+                                       VIEWER_REFRESH_BRANCHES);
+
+    // Show completion status briefly
+    viewer->sync_status = SYNC_STATUS_SYNCED_APPEARING;
+    viewer->animation_frame = 0;
+    viewer->text_char_count = 0;
+}
+
 void start_background_fetch(NCursesDiffViewer* viewer) {
     if (!viewer || viewer->fetch_in_progress || viewer->critical_operation_in_progress) {
         return;
     }
 
-    viewer->fetch_pid = fork();
-    if (viewer->fetch_pid == 0) {
-        // Child process: do the fetch
-        system("git fetch --all --quiet >/dev/null 2>&1");
-        exit(0);
-    } else if (viewer->fetch_pid > 0) {
-        // Parent process: mark fetch as in progress
+    const char* argv[] = {"git", "fetch", "--all", "--quiet", NULL};
+    if (git_jobs_submit("fetch", argv, NULL, GIT_JOB_COALESCE | GIT_JOB_CANCEL_ON_EXIT,
+                        on_fetch_done, viewer)) {
         viewer->fetch_in_progress = 1;
         viewer->sync_status = SYNC_STATUS_SYNCING_APPEARING;
         viewer->animation_frame = 0;
@@ -6120,40 +6361,67 @@ void start_background_fetch(NCursesDiffViewer* viewer) {
     }
 }
 
-void check_background_fetch(NCursesDiffViewer* viewer) {
-    if (!viewer || !viewer->fetch_in_progress) {
+void request_viewer_refresh(NCursesDiffViewer* viewer, int flags) {
+    if (viewer)
+        viewer->pending_refresh |= flags;
+}
+
+// Reload whatever finished jobs invalidated. Runs once the queue is empty so
+// several back-to-back operations cost a single refresh.
+void apply_pending_refresh(NCursesDiffViewer* viewer) {
+    if (!viewer || !viewer->pending_refresh || git_jobs_active(NULL))
         return;
-    }
 
-    int status;
-    pid_t result = waitpid(viewer->fetch_pid, &status, WNOHANG);
+    int flags = viewer->pending_refresh;
+    viewer->pending_refresh = 0;
 
-    if (result == viewer->fetch_pid) {
-        // Fetch completed
-        viewer->fetch_in_progress = 0;
-        viewer->fetch_pid = -1;
+    // Preserve current positions during refresh
+    int preserved_file_scroll = viewer->file_scroll_offset;
+    int preserved_file_cursor = viewer->file_cursor_line;
+    int preserved_selected_file = viewer->selected_file;
 
-        // Preserve current positions during refresh
-        int preserved_file_scroll = viewer->file_scroll_offset;
-        int preserved_file_cursor = viewer->file_cursor_line;
-        int preserved_selected_file = viewer->selected_file;
+    if (flags & VIEWER_REFRESH_FILES) {
+        // Follow the selected file by path; entries before it may come or go
+        char* selected_path = NULL;
+        if (viewer->selected_file < viewer->file_count)
+            selected_path = strdup(viewer->files[viewer->selected_file].filename);
 
-        // Update only the necessary data without blocking UI
         get_ncurses_changed_files(viewer);
+        int found = find_changed_file(viewer, selected_path);
+        if (found >= 0)
+            preserved_selected_file = found;
+        free(selected_path);
+    }
+    if (flags & VIEWER_REFRESH_COMMITS)
         get_commit_history(viewer);
+    if (flags & VIEWER_REFRESH_BRANCHES) {
         get_ncurses_git_branches(viewer);
 
-        // Restore file selection if still valid
-        if (preserved_selected_file < viewer->file_count) {
-            viewer->selected_file = preserved_selected_file;
+        // A branch just created or renamed becomes the selected one
+        for (int i = 0; viewer->select_branch_after_refresh[0] && i < viewer->branch_count; i++) {
+            if (strcmp(viewer->branches[i].name, viewer->select_branch_after_refresh) == 0)
+                viewer->selected_branch = i;
+        }
+        viewer->select_branch_after_refresh[0] = '\0';
+    }
+    if (flags & VIEWER_REFRESH_STASHES)
+        get_ncurses_git_stashes(viewer);
+
+    if (flags & VIEWER_REFRESH_FILES) {
+        if (viewer->file_count == 0) {
+            viewer->selected_file = 0;
+            viewer->file_line_count = 0;
+            viewer->file_scroll_offset = 0;
+        } else {
+            viewer->selected_file = preserved_selected_file < viewer->file_count
+                                        ? preserved_selected_file
+                                        : viewer->file_count - 1;
 
             // Reload current file if in file mode and restore position
-            if ((viewer->current_mode == NCURSES_MODE_FILE_LIST ||
-                 viewer->current_mode == NCURSES_MODE_FILE_VIEW) &&
-                viewer->file_count > 0) {
+            if (viewer->current_mode == NCURSES_MODE_FILE_LIST ||
+                viewer->current_mode == NCURSES_MODE_FILE_VIEW) {
                 load_file_with_staging_info(viewer, viewer->files[viewer->selected_file].filename);
 
-                // Restore scroll position if still valid
                 if (preserved_file_cursor < viewer->file_line_count) {
                     viewer->file_cursor_line = preserved_file_cursor;
                 }
@@ -6162,36 +6430,38 @@ void check_background_fetch(NCursesDiffViewer* viewer) {
                 }
             }
         }
+    }
 
-        // If we're in branch mode and have commits loaded, refresh them
-        if (viewer->current_mode == NCURSES_MODE_BRANCH_LIST ||
-            viewer->current_mode == NCURSES_MODE_BRANCH_VIEW) {
-            if (viewer->branch_count > 0 && strlen(viewer->current_branch_for_commits) > 0) {
-                load_branch_commits(viewer, viewer->current_branch_for_commits);
-                if (viewer->current_mode == NCURSES_MODE_BRANCH_VIEW) {
-                    // Preserve cursor position in branch view too
-                    int prev_cursor = viewer->file_cursor_line;
-                    int prev_scroll = viewer->file_scroll_offset;
-                    parse_branch_commits_to_lines(viewer);
-                    if (prev_cursor < viewer->file_line_count) {
-                        viewer->file_cursor_line = prev_cursor;
-                    }
-                    if (prev_scroll < viewer->file_line_count) {
-                        viewer->file_scroll_offset = prev_scroll;
-                    }
+    if (viewer->selected_branch >= viewer->branch_count)
+        viewer->selected_branch = viewer->branch_count > 0 ? viewer->branch_count - 1 : 0;
+    if (viewer->selected_stash >= viewer->stash_count)
+        viewer->selected_stash = viewer->stash_count > 0 ? viewer->stash_count - 1 : 0;
+
+    // The commit being viewed may have been replaced (commit, amend, pull)
+    if (viewer->current_mode == NCURSES_MODE_COMMIT_VIEW && (flags & VIEWER_REFRESH_COMMITS) &&
+        viewer->selected_commit < viewer->commit_count) {
+        load_commit_for_viewing(viewer, viewer->commits[viewer->selected_commit].hash);
+    }
+
+    // If we're in branch mode and have commits loaded, refresh them
+    if ((flags & VIEWER_REFRESH_BRANCHES) &&
+        (viewer->current_mode == NCURSES_MODE_BRANCH_LIST ||
+         viewer->current_mode == NCURSES_MODE_BRANCH_VIEW)) {
+        if (viewer->branch_count > 0 && strlen(viewer->current_branch_for_commits) > 0) {
+            load_branch_commits(viewer, viewer->current_branch_for_commits);
+            if (viewer->current_mode == NCURSES_MODE_BRANCH_VIEW) {
+                // Preserve cursor position in branch view too
+                int prev_cursor = viewer->file_cursor_line;
+                int prev_scroll = viewer->file_scroll_offset;
+                parse_branch_commits_to_lines(viewer);
+                if (prev_cursor < viewer->file_line_count) {
+                    viewer->file_cursor_line = prev_cursor;
+                }
+                if (prev_scroll < viewer->file_line_count) {
+                    viewer->file_scroll_offset = prev_scroll;
                 }
             }
         }
-
-        // Show completion status briefly
-        viewer->sync_status = SYNC_STATUS_SYNCED_APPEARING;
-        viewer->animation_frame = 0;
-        viewer->text_char_count = 0;
-    } else if (result == -1) {
-        // Error occurred
-        viewer->fetch_in_progress = 0;
-        viewer->fetch_pid = -1;
-        viewer->sync_status = SYNC_STATUS_IDLE;
     }
 }
 
@@ -6636,11 +6906,9 @@ void move_cursor_smart_staged(NCursesDiffViewer* viewer, int direction) {
 
 void cleanup_ncurses_diff_viewer(NCursesDiffViewer* viewer) {
     if (viewer) {
-        // Clean up any background fetch process
-        if (viewer->fetch_in_progress && viewer->fetch_pid > 0) {
-            kill(viewer->fetch_pid, SIGTERM);
-            waitpid(viewer->fetch_pid, NULL, 0);
-        }
+        // Stop a background fetch, let pushes and commits finish
+        git_jobs_shutdown();
+        viewer->fetch_in_progress = 0;
 
         if (viewer->file_list_win) {
             delwin(viewer->file_list_win);
@@ -6663,11 +6931,33 @@ void cleanup_ncurses_diff_viewer(NCursesDiffViewer* viewer) {
 
         cleanup_fuzzy_search(viewer);
 
+        git_revwalk_free(viewer->commit_walk);
+        viewer->commit_walk = NULL;
+
+        free(viewer->commit_unpushed);
+        viewer->commit_unpushed = NULL;
+        viewer->commit_unpushed_count = 0;
+        viewer->commit_unpushed_capacity = 0;
+
         if (viewer->commits) {
             free(viewer->commits);
             viewer->commits = NULL;
         }
 
+        free(viewer->branches);
+        viewer->branches = NULL;
+        viewer->branch_count = 0;
+        viewer->branch_capacity = 0;
+
+        free(viewer->files);
+        free(viewer->file_names);
+        free(viewer->fuzzy_scored_files);
+        viewer->files = NULL;
+        viewer->file_names = NULL;
+        viewer->fuzzy_scored_files = NULL;
+        viewer->file_count = 0;
+        viewer->fuzzy_scored_capacity = 0;
+
         // Clean up grep search windows
         cleanup_grep_search(viewer);
     }
@@ -6790,14 +7080,8 @@ int calculate_fuzzy_score(const char* pattern, const char* filename) {
 }
 
 int compare_scored_files(const void* a, const void* b) {
-    const struct {
-        int file_index;
-        int score;
-    }* file_a = a;
-    const struct {
-        int file_index;
-        int score;
-    }* file_b = b;
+    const NCursesScoredFile* file_a = a;
+    const NCursesScoredFile* file_b = b;
     return file_b->score - file_a->score; // Descending order (higher scores first)
 }
 
@@ -6809,8 +7093,17 @@ void update_fuzzy_filter(NCursesDiffViewer* viewer) {
     viewer->fuzzy_selected_index = 0;
     viewer->fuzzy_scroll_offset = 0;
 
+    if (viewer->fuzzy_scored_capacity < viewer->file_count) {
+        NCursesScoredFile* scored = realloc(viewer->fuzzy_scored_files,
+                                            viewer->file_count * sizeof(NCursesScoredFile));
+        if (!scored)
+            return;
+        viewer->fuzzy_scored_files = scored;
+        viewer->fuzzy_scored_capacity = viewer->file_count;
+    }
+
     // Calculate scores for all files and collect matches
-    for (int i = 0; i < viewer->file_count && viewer->fuzzy_filtered_count < MAX_FILES; i++) {
+    for (int i = 0; i < viewer->file_count; i++) {
         int score = calculate_fuzzy_score(viewer->fuzzy_search_query, viewer->files[i].filename);
         if (score > 0) {
             viewer->fuzzy_scored_files[viewer->fuzzy_filtered_count].file_index = i;
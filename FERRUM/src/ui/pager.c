@@ -0,0 +1,623 @@
+#define _GNU_SOURCE
+#include "builtins.h"
+#include "common.h"
+#include "event_loop.h"
+#include "line_index.h"
+#include "line_reader.h"
+#include <errno.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <sys/mman.h>
+
+#define PAGER_TAB_WIDTH 8
+#define PAGER_POLL_MS 100             // How soon indexing progress shows
+#define PAGER_SEARCH_CHUNK (16 << 20) // Searched between looks for a key
+#define PAGER_PATTERN_MAX 256
+#define KEY_CTRL_C 3
+#define NOT_FOUND ((size_t)-1)
+
+typedef struct {
+  const char *name;
+  const char *text; // The file, mapped
+  size_t size;
+  LineIndex *index;
+  int rows; // Rows of text, not counting the status line
+  int columns;
+  size_t top;    // Offset of the first line shown
+  size_t bottom; // Offset of the first line not shown, found by drawing
+  size_t left;   // Columns scrolled off to the left
+  size_t count;  // Number typed before a command, 0 for none
+  size_t wanted_line; // Line to go to once it is indexed, 0 for none
+  int backward;       // Last search went backward
+  char pattern[PAGER_PATTERN_MAX];
+  char message[128]; // Shown on the status line until the next key
+  char *frame;       // Escape sequences for the frame being built
+  size_t frame_len;
+  size_t frame_cap;
+} Pager;
+
+// A file cut short while it is mapped raises SIGBUS when the part that is
+// gone is read; the pager gives up on the file instead of the shell dying
+static sigjmp_buf fault_jump;
+static volatile sig_atomic_t fault_guarded = 0;
+
+static void on_fault(int signo) {
+  if (fault_guarded)
+    siglongjmp(fault_jump, 1);
+  signal(signo, SIG_DFL);
+  raise(signo);
+}
+
+static void put(Pager *pager, const char *data, size_t len) {
+  if (pager->frame_len + len > pager->frame_cap) {
+    size_t size = pager->frame_cap ? pager->frame_cap : 4096;
+    while (size < pager->frame_len + len)
+      size *= 2;
+    char *grown = realloc(pager->frame, size);
+    if (!grown)
+      return;
+    pager->frame = grown;
+    pager->frame_cap = size;
+  }
+  memcpy(pager->frame + pager->frame_len, data, len);
+  pager->frame_len += len;
+}
+
+static void put_str(Pager *pager, const char *data) {
+  put(pager, data, strlen(data));
+}
+
+static void flush_frame(Pager *pager) {
+  const char *data = pager->frame;
+  size_t len = pager->frame_len;
+  while (len > 0) {
+    ssize_t written = write(STDOUT_FILENO, data, len);
+    if (written < 0 && errno != EINTR)
+      break;
+    if (written > 0) {
+      data += written;
+      len -= (size_t)written;
+    }
+  }
+  pager->frame_len = 0;
+}
+
+static void read_screen_size(Pager *pager) {
+  struct winsize ws;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_row < 2 ||
+      ws.ws_col == 0) {
+    ws.ws_row = 24;
+    ws.ws_col = 80;
+  }
+  pager->rows = ws.ws_row - 1;
+  pager->columns = ws.ws_col;
+}
+
+static size_t line_end(const Pager *pager, size_t offset) {
+  const char *newline =
+      memchr(pager->text + offset, '\n', pager->size - offset);
+  return newline ? (size_t)(newline - pager->text) : pager->size;
+}
+
+static size_t next_line(const Pager *pager, size_t offset) {
+  size_t end = line_end(pager, offset);
+  return end < pager->size ? end + 1 : pager->size;
+}
+
+// Start of the line that offset is in
+static size_t line_start(const Pager *pager, size_t offset) {
+  const char *newline = memrchr(pager->text, '\n', offset);
+  return newline ? (size_t)(newline - pager->text) + 1 : 0;
+}
+
+// Start of the line before the one starting at offset. The end of the
+// file counts as the start of a line after the last.
+static size_t previous_line(const Pager *pager, size_t offset) {
+  return offset > 0 ? line_start(pager, offset - 1) : 0;
+}
+
+// One line from start to end, scrolled and cut to the screen, with matches
+// of the pattern in reverse video and control characters shown as ^X
+static void draw_line(Pager *pager, size_t start, size_t end) {
+  const char *text = pager->text;
+  if (end > start && text[end - 1] == '\r')
+    end--;
+
+  size_t pattern_len = strlen(pager->pattern);
+  size_t limit = pager->left + (size_t)pager->columns;
+  size_t column = 0;
+  size_t match_end = 0;
+  int highlighted = 0;
+
+  for (size_t i = start; i < end; i++) {
+    unsigned char c = (unsigned char)text[i];
+    // A UTF-8 continuation byte goes wherever its first byte went
+    if ((c & 0xc0) == 0x80) {
+      if (column > pager->left && column <= limit)
+        put(pager, &text[i], 1);
+      continue;
+    }
+    if (column >= limit)
+      break;
+
+    if (pattern_len > 0 && i >= match_end && end - i >= pattern_len &&
+        c == (unsigned char)pager->pattern[0] &&
+        memcmp(text + i, pager->pattern, pattern_len) == 0)
+      match_end = i + pattern_len;
+    int lit = i < match_end;
+    if (lit != highlighted) {
+      put_str(pager, lit ? "\033[7m" : "\033[27m");
+      highlighted = lit;
+    }
+
+    char glyph[2];
+    size_t width = 1;
+    if (c == '\t') {
+      width = PAGER_TAB_WIDTH - column % PAGER_TAB_WIDTH;
+    } else if (c < 32 || c == 127) {
+      glyph[0] = '^';
+      glyph[1] = c == 127 ? '?' : (char)(c + 64);
+      width = 2;
+    } else {
+      glyph[0] = (char)c;
+    }
+    for (size_t w = 0; w < width && column < limit; w++, column++) {
+      if (column >= pager->left)
+        put(pager, c == '\t' ? " " : &glyph[w], 1);
+    }
+  }
+
+  if (highlighted)
+    put_str(pager, "\033[27m");
+  put_str(pager, "\033[K");
+}
+
+// Add to the status line, as much as fits
+static void append(char *status, size_t size, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+static void append(char *status, size_t size, const char *format, ...) {
+  size_t length = strlen(status);
+  va_list args;
+  va_start(args, format);
+  vsnprintf(status + length, size - length, format, args);
+  va_end(args);
+}
+
+static void draw_status(Pager *pager) {
+  char status[512];
+  snprintf(status, sizeof(status), "%s", pager->message);
+
+  if (!pager->message[0]) {
+    size_t lines;
+    size_t scanned;
+    int complete = line_index_progress(pager->index, &lines, &scanned);
+
+    append(status, sizeof(status), "%s", pager->name);
+    if (pager->top < scanned || (complete && pager->size > 0))
+      append(status, sizeof(status), "  line %zu",
+             line_index_line_at(pager->index, pager->top) + 1);
+    else
+      append(status, sizeof(status), "  line ?");
+    if (complete)
+      append(status, sizeof(status), " of %zu", lines);
+    else
+      append(status, sizeof(status), " of %zu+ (indexing %d%%)", lines,
+             (int)(scanned * 100 / pager->size));
+    append(status, sizeof(status), "  %d%%",
+           pager->size ? (int)(pager->bottom * 100 / pager->size) : 100);
+    if (pager->wanted_line)
+      append(status, sizeof(status), "  waiting for line %zu",
+             pager->wanted_line);
+  }
+
+  put_str(pager, "\033[7m");
+  put(pager, status, strnlen(status, (size_t)pager->columns));
+  put_str(pager, "\033[K\033[27m");
+}
+
+static void draw(Pager *pager) {
+  char move[32];
+  size_t offset = pager->top;
+
+  for (int row = 0; row < pager->rows; row++) {
+    put(pager, move, snprintf(move, sizeof(move), "\033[%d;1H", row + 1));
+    if (offset < pager->size) {
+      size_t end = line_end(pager, offset);
+      draw_line(pager, offset, end);
+      offset = end < pager->size ? end + 1 : pager->size;
+    } else {
+      put_str(pager, "~\033[K");
+    }
+  }
+  pager->bottom = offset;
+
+  put(pager, move,
+      snprintf(move, sizeof(move), "\033[%d;1H", pager->rows + 1));
+  draw_status(pager);
+  flush_frame(pager);
+}
+
+// The pager on screen, redrawn from the event loop when the terminal is
+// resized
+static Pager *showing = NULL;
+
+static void on_resize(void *data) {
+  (void)data;
+  if (!showing)
+    return;
+  read_screen_size(showing);
+  draw(showing);
+}
+
+static void watch_resize(void) {
+  static int watching = 0;
+  if (!watching)
+    watching = event_signal(SIGWINCH, on_resize, NULL);
+}
+
+static void scroll_down(Pager *pager, size_t count) {
+  while (count-- > 0 && pager->bottom < pager->size) {
+    pager->top = next_line(pager, pager->top);
+    pager->bottom = next_line(pager, pager->bottom);
+  }
+}
+
+static void scroll_up(Pager *pager, size_t count) {
+  while (count-- > 0 && pager->top > 0)
+    pager->top = previous_line(pager, pager->top);
+}
+
+static void go_to_end(Pager *pager) {
+  pager->top = pager->size;
+  scroll_up(pager, (size_t)pager->rows);
+}
+
+// Line counts from 1. One the index has not reached yet is gone to once it
+// has.
+static void go_to_line(Pager *pager, size_t line) {
+  size_t lines;
+  size_t scanned;
+  int complete = line_index_progress(pager->index, &lines, &scanned);
+
+  pager->wanted_line = 0;
+  if (line <= lines)
+    pager->top = line_index_offset(pager->index, line - 1);
+  else if (complete)
+    go_to_end(pager);
+  else
+    pager->wanted_line = line;
+}
+
+static void go_to_percent(Pager *pager, size_t percent) {
+  if (percent >= 100)
+    go_to_end(pager);
+  else
+    pager->top = line_start(pager, pager->size / 100 * percent +
+                                       pager->size % 100 * percent / 100);
+}
+
+// Any key stops a long search; the key itself is dropped
+static int search_cancelled(void) {
+  if (!key_pending())
+    return 0;
+  read_key();
+  return 1;
+}
+
+// First match starting at or after from
+static size_t find_forward(const Pager *pager, size_t from, int *cancelled) {
+  size_t pattern_len = strlen(pager->pattern);
+  for (size_t start = from; start < pager->size; start += PAGER_SEARCH_CHUNK) {
+    size_t end = pager->size - start > PAGER_SEARCH_CHUNK + pattern_len
+                     ? start + PAGER_SEARCH_CHUNK + pattern_len - 1
+                     : pager->size;
+    const char *match =
+        memmem(pager->text + start, end - start, pager->pattern, pattern_len);
+    if (match)
+      return (size_t)(match - pager->text);
+    if ((*cancelled = search_cancelled()))
+      break;
+  }
+  return NOT_FOUND;
+}
+
+// Last match starting before before
+static size_t find_backward(const Pager *pager, size_t before,
+                            int *cancelled) {
+  size_t pattern_len = strlen(pager->pattern);
+  for (size_t end = before; end > 0;) {
+    size_t start = end > PAGER_SEARCH_CHUNK ? end - PAGER_SEARCH_CHUNK : 0;
+    size_t stop = pager->size - end > pattern_len - 1 ? end + pattern_len - 1
+                                                      : pager->size;
+    const char *found = NULL;
+    const char *match = pager->text + start;
+    while ((match = memmem(match, (size_t)(pager->text + stop - match),
+                           pager->pattern, pattern_len)) != NULL &&
+           match < pager->text + end) {
+      found = match;
+      match++;
+    }
+    if (found)
+      return (size_t)(found - pager->text);
+    if ((*cancelled = search_cancelled()))
+      break;
+    end = start;
+  }
+  return NOT_FOUND;
+}
+
+static void search(Pager *pager, int backward) {
+  if (!pager->pattern[0])
+    return;
+
+  snprintf(pager->message, sizeof(pager->message), "Searching for %s...",
+           pager->pattern);
+  draw(pager);
+  pager->message[0] = '\0';
+
+  int cancelled = 0;
+  size_t match = backward ? find_backward(pager, pager->top, &cancelled)
+                          : find_forward(pager, next_line(pager, pager->top),
+                                         &cancelled);
+  if (match != NOT_FOUND)
+    pager->top = line_start(pager, match);
+  else
+    snprintf(pager->message, sizeof(pager->message), "%s",
+             cancelled ? "Search stopped" : "Pattern not found");
+}
+
+// Read a pattern on the status line. Returns 0 if it was abandoned.
+static int read_pattern(Pager *pager, char prompt) {
+  char pattern[PAGER_PATTERN_MAX];
+  size_t len = 0;
+  char move[32];
+
+  for (;;) {
+    put(pager, move,
+        snprintf(move, sizeof(move), "\033[%d;1H", pager->rows + 1));
+    put(pager, &prompt, 1);
+    put(pager, pattern, len);
+    put_str(pager, "\033[K\033[?25h");
+    flush_frame(pager);
+
+    int key = read_key();
+    put_str(pager, "\033[?25l");
+    if (key == KEY_ENTER) {
+      // An empty pattern repeats the last one
+      if (len > 0) {
+        memcpy(pager->pattern, pattern, len);
+        pager->pattern[len] = '\0';
+      }
+      return 1;
+    }
+    if (key == -1 || key == KEY_ESCAPE || key == KEY_CTRL_C)
+      return 0;
+    if ((key == KEY_BACKSPACE || key == 8) && len > 0)
+      len--;
+    else if (key >= 32 && key < 256 && key != 127 && len + 1 < sizeof(pattern))
+      pattern[len++] = (char)key;
+  }
+}
+
+// Handle one key. Returns 0 to leave the pager.
+static int handle_key(Pager *pager, int key) {
+  size_t count = pager->count;
+  pager->count = 0;
+  pager->message[0] = '\0';
+  size_t half = (size_t)(pager->rows > 1 ? pager->rows / 2 : 1);
+
+  if (key >= '0' && key <= '9') {
+    pager->count = count * 10 + (size_t)(key - '0');
+    return 1;
+  }
+
+  switch (key) {
+  case 'q':
+  case 'Q':
+  case KEY_CTRL_C:
+    return 0;
+  case 'j':
+  case KEY_DOWN:
+  case KEY_ENTER:
+    scroll_down(pager, count ? count : 1);
+    break;
+  case 'k':
+  case KEY_UP:
+    scroll_up(pager, count ? count : 1);
+    break;
+  case ' ':
+  case 'f':
+  case KEY_PAGE_DOWN:
+    scroll_down(pager, count ? count : (size_t)pager->rows);
+    break;
+  case 'b':
+  case KEY_PAGE_UP:
+    scroll_up(pager, count ? count : (size_t)pager->rows);
+    break;
+  case 'd':
+    scroll_down(pager, half);
+    break;
+  case 'u':
+    scroll_up(pager, half);
+    break;
+  case KEY_RIGHT:
+    pager->left += (size_t)pager->columns / 2;
+    break;
+  case KEY_LEFT:
+    pager->left -= pager->left < (size_t)pager->columns / 2
+                       ? pager->left
+                       : (size_t)pager->columns / 2;
+    break;
+  case 'g':
+  case '<':
+  case KEY_HOME:
+    if (count)
+      go_to_line(pager, count);
+    else
+      pager->top = 0;
+    break;
+  case 'G':
+  case '>':
+  case KEY_END:
+    if (count)
+      go_to_line(pager, count);
+    else
+      go_to_end(pager);
+    break;
+  case '%':
+    go_to_percent(pager, count);
+    break;
+  case '/':
+  case '?':
+    if (read_pattern(pager, (char)key)) {
+      pager->backward = key == '?';
+      search(pager, pager->backward);
+    }
+    break;
+  case 'n':
+    search(pager, pager->backward);
+    break;
+  case 'N':
+    search(pager, !pager->backward);
+    break;
+  }
+  return 1;
+}
+
+static void page_file(Pager *pager) {
+  size_t seen_lines = (size_t)-1;
+  size_t seen_scanned = (size_t)-1;
+
+  for (;;) {
+    // Progress is only looked for while the index is still growing; after
+    // that the pager sleeps until a key, resizes being redrawn as they come
+    size_t lines;
+    size_t scanned;
+    int complete = line_index_progress(pager->index, &lines, &scanned);
+    int changed = lines != seen_lines || scanned != seen_scanned;
+    seen_lines = lines;
+    seen_scanned = scanned;
+    if (changed && pager->wanted_line)
+      go_to_line(pager, pager->wanted_line);
+    if (changed)
+      draw(pager);
+
+    // Keys read_key already buffered would not wake event_wait
+    int ready = key_pending()
+                    ? 1
+                    : event_wait(STDIN_FILENO, complete ? -1 : PAGER_POLL_MS);
+    if (ready == -1)
+      break;
+    if (ready == 1) {
+      int key = read_key();
+      if (key == -1 || !handle_key(pager, key))
+        break;
+      draw(pager);
+    }
+  }
+}
+
+int lsh_page(char **args) {
+  if (args[1] == NULL) {
+    fprintf(stderr, "lsh: expected file argument to \"page\"\n");
+    return 1;
+  }
+  // Without a terminal to page on, the file is just passed along
+  if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))
+    return lsh_cat(args);
+
+  int fd = open(args[1], O_RDONLY | O_CLOEXEC);
+  struct stat st;
+  if (fd == -1 || fstat(fd, &st) == -1) {
+    fprintf(stderr, "lsh: page: %s: %s\n", args[1], strerror(errno));
+    if (fd != -1)
+      close(fd);
+    return 1;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    fprintf(stderr, "lsh: page: %s: not a regular file\n", args[1]);
+    close(fd);
+    return 1;
+  }
+
+  Pager *pager = calloc(1, sizeof(Pager));
+  if (!pager) {
+    fprintf(stderr, "lsh: allocation error\n");
+    close(fd);
+    return 1;
+  }
+  pager->name = args[1];
+  pager->size = (size_t)st.st_size;
+  pager->text = "";
+  if (pager->size > 0) {
+    void *map = mmap(NULL, pager->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+      fprintf(stderr, "lsh: page: %s: %s\n", args[1], strerror(errno));
+      free(pager);
+      close(fd);
+      return 1;
+    }
+    pager->text = map;
+  }
+
+  pager->index = line_index_start(fd, pager->text, pager->size);
+  if (!pager->index) {
+    fprintf(stderr, "lsh: page: cannot start indexing %s\n", args[1]);
+    if (pager->size > 0)
+      munmap((void *)pager->text, pager->size);
+    free(pager);
+    close(fd);
+    return 1;
+  }
+
+  struct termios saved;
+  int have_terminal = tcgetattr(STDIN_FILENO, &saved) == 0;
+  if (have_terminal) {
+    struct termios raw = saved;
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw);
+  }
+
+  struct sigaction fault = {0};
+  struct sigaction saved_fault;
+  fault.sa_handler = on_fault;
+  sigemptyset(&fault.sa_mask);
+  sigaction(SIGBUS, &fault, &saved_fault);
+
+  // Alternate screen, cursor hidden
+  put_str(pager, "\033[?1049h\033[?25l");
+  read_screen_size(pager);
+
+  watch_resize();
+  showing = pager;
+  event_loop_begin();
+
+  int truncated = sigsetjmp(fault_jump, 1);
+  if (!truncated) {
+    fault_guarded = 1;
+    page_file(pager);
+  }
+  fault_guarded = 0;
+  event_loop_end();
+  showing = NULL;
+
+  // A frame the fault broke off is dropped
+  pager->frame_len = 0;
+  put_str(pager, "\033[?25h\033[?1049l");
+  flush_frame(pager);
+  sigaction(SIGBUS, &saved_fault, NULL);
+  if (have_terminal)
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, &saved);
+  if (truncated)
+    fprintf(stderr, "lsh: page: %s was cut short while open\n", args[1]);
+
+  line_index_stop(pager->index);
+  if (pager->size > 0)
+    munmap((void *)pager->text, pager->size);
+  close(fd);
+  free(pager->frame);
+  free(pager);
+  return 1;
+}
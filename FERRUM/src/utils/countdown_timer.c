@@ -1,11 +1,11 @@
 
 #include "countdown_timer.h"
 #include "common.h"
+#include "event_loop.h"
 #include "shell.h"
 #include "themes.h"
 #include <ctype.h>
-#include <pthread.h>
-#include <signal.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -18,11 +18,10 @@ static struct {
   time_t end_time;            // When timer will expire (in seconds since epoch)
   char display_text[64];      // Current timer display text
   char session_name[128];     // Optional session name
-  pthread_t timer_thread;     // Timer thread ID
-  BOOL should_exit;           // Flag to signal thread exit
+  int expiry_timer;           // Event loop timer, -1 until first used
   BOOL is_temporarily_hidden; // Flag to hide timer while running external
                               // programs
-} timer_state = {FALSE, 0, "", "", 0, FALSE, FALSE};
+} timer_state = {FALSE, 0, "", "", -1, FALSE};
 
 static void update_timer_display(void) {
   if (!timer_state.is_active) {
@@ -59,29 +58,12 @@ static void update_timer_display(void) {
   }
 }
 
-static void *timer_thread_func(void *param) {
-  while (!timer_state.should_exit) {
-    // Update timer display
-    update_timer_display();
-
-    // Check if timer has expired
-    time_t now = time(NULL);
-    if (difftime(timer_state.end_time, now) <= 0) {
-      // Play a bell sound
-      printf("\a");
-      fflush(stdout);
-
-      // Update status bar with completion message
-      update_timer_display();
-
-      // Keep thread running to display completion message
-    }
-
-    // Sleep for 1 second
-    sleep(1);
-  }
-
-  return NULL;
+// Rings once when the time is up. The display text is worked out from
+// end_time whenever it is asked for, so nothing needs to tick until then.
+static void timer_expired(void *data) {
+  (void)data;
+  printf("\a");
+  fflush(stdout);
 }
 
 int start_countdown_timer(int seconds, const char *name) {
@@ -93,7 +75,6 @@ int start_countdown_timer(int seconds, const char *name) {
   // Set timer parameters
   timer_state.end_time = time(NULL) + seconds;
   timer_state.is_active = TRUE;
-  timer_state.should_exit = FALSE;
   timer_state.is_temporarily_hidden = FALSE;
 
   // Set optional session name
@@ -108,17 +89,14 @@ int start_countdown_timer(int seconds, const char *name) {
   // Initialize display text
   update_timer_display();
 
-  // Create timer thread
-  int ret =
-      pthread_create(&timer_state.timer_thread, NULL, timer_thread_func, NULL);
-  if (ret != 0) {
-    fprintf(stderr, "Failed to create timer thread: %s\n", strerror(ret));
+  if (timer_state.expiry_timer == -1)
+    timer_state.expiry_timer = event_timer(timer_expired, NULL);
+  if (timer_state.expiry_timer == -1) {
+    fprintf(stderr, "Failed to create timer: %s\n", strerror(errno));
     timer_state.is_active = FALSE;
     return 0;
   }
-
-  // Detach thread so it cleans up automatically
-  pthread_detach(timer_state.timer_thread);
+  event_timer_arm(timer_state.expiry_timer, seconds * 1000L, 0);
 
   return 1;
 }
@@ -128,20 +106,7 @@ void stop_countdown_timer() {
     return;
   }
 
-  // Signal thread to exit
-  timer_state.should_exit = TRUE;
-
-  // Wait for thread to terminate (with timeout)
-  // Use a more portable approach since pthread_timedjoin_np is GNU-specific
-
-  // Set a timeout of 2 seconds
-  struct timespec timeout;
-  timeout.tv_sec = 2;
-  timeout.tv_nsec = 0;
-
-  // Sleep for the timeout period - the thread will keep running
-  // and clean itself up since we detached it
-  nanosleep(&timeout, NULL);
+  event_timer_arm(timer_state.expiry_timer, 0, 0);
 
   // Reset timer state
   timer_state.is_active = FALSE;
@@ -155,6 +120,7 @@ const char *get_timer_display() {
   if (timer_state.is_temporarily_hidden || !timer_state.is_active) {
     return "";
   }
+  update_timer_display();
   return timer_state.display_text;
 }
 
@@ -232,6 +198,7 @@ int lsh_focus_timer(char **args) {
            "minute timer\n");
     printf("  focus_timer stop                         # Stop the current "
            "timer\n");
+    update_timer_display();
     printf("Current status: %s\n", timer_state.is_active
                                        ? timer_state.display_text
                                        : "No active timer");
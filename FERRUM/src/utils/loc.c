@@ -0,0 +1,453 @@
+#define _GNU_SOURCE
+#include "loc.h"
+#include "builtins.h"
+#include "common.h"
+#include "file_walker.h"
+#include <errno.h>
+
+typedef struct {
+  const char *name;
+  const char *line_comment; // NULL when the language has none
+  const char *block_open;   // NULL when the language has none
+  const char *block_close;
+} Language;
+
+typedef enum {
+  LANG_C,
+  LANG_CPP,
+  LANG_CSHARP,
+  LANG_GO,
+  LANG_RUST,
+  LANG_JAVA,
+  LANG_KOTLIN,
+  LANG_SCALA,
+  LANG_SWIFT,
+  LANG_JAVASCRIPT,
+  LANG_TYPESCRIPT,
+  LANG_PHP,
+  LANG_CSS,
+  LANG_SCSS,
+  LANG_PYTHON,
+  LANG_RUBY,
+  LANG_PERL,
+  LANG_R,
+  LANG_SHELL,
+  LANG_MAKEFILE,
+  LANG_CMAKE,
+  LANG_DOCKERFILE,
+  LANG_YAML,
+  LANG_TOML,
+  LANG_SQL,
+  LANG_LUA,
+  LANG_HASKELL,
+  LANG_HTML,
+  LANG_XML,
+  LANG_MARKDOWN,
+  LANG_JSON,
+  LANGUAGE_COUNT
+} LanguageId;
+
+static const Language languages[LANGUAGE_COUNT] = {
+    [LANG_C] = {"C", "//", "/*", "*/"},
+    [LANG_CPP] = {"C++", "//", "/*", "*/"},
+    [LANG_CSHARP] = {"C#", "//", "/*", "*/"},
+    [LANG_GO] = {"Go", "//", "/*", "*/"},
+    [LANG_RUST] = {"Rust", "//", "/*", "*/"},
+    [LANG_JAVA] = {"Java", "//", "/*", "*/"},
+    [LANG_KOTLIN] = {"Kotlin", "//", "/*", "*/"},
+    [LANG_SCALA] = {"Scala", "//", "/*", "*/"},
+    [LANG_SWIFT] = {"Swift", "//", "/*", "*/"},
+    [LANG_JAVASCRIPT] = {"JavaScript", "//", "/*", "*/"},
+    [LANG_TYPESCRIPT] = {"TypeScript", "//", "/*", "*/"},
+    [LANG_PHP] = {"PHP", "//", "/*", "*/"},
+    [LANG_CSS] = {"CSS", NULL, "/*", "*/"},
+    [LANG_SCSS] = {"SCSS", "//", "/*", "*/"},
+    [LANG_PYTHON] = {"Python", "#", NULL, NULL},
+    [LANG_RUBY] = {"Ruby", "#", "=begin", "=end"},
+    [LANG_PERL] = {"Perl", "#", NULL, NULL},
+    [LANG_R] = {"R", "#", NULL, NULL},
+    [LANG_SHELL] = {"Shell", "#", NULL, NULL},
+    [LANG_MAKEFILE] = {"Makefile", "#", NULL, NULL},
+    [LANG_CMAKE] = {"CMake", "#", "#[[", "]]"},
+    [LANG_DOCKERFILE] = {"Dockerfile", "#", NULL, NULL},
+    [LANG_YAML] = {"YAML", "#", NULL, NULL},
+    [LANG_TOML] = {"TOML", "#", NULL, NULL},
+    [LANG_SQL] = {"SQL", "--", "/*", "*/"},
+    [LANG_LUA] = {"Lua", "--", "--[[", "]]"},
+    [LANG_HASKELL] = {"Haskell", "--", "{-", "-}"},
+    [LANG_HTML] = {"HTML", NULL, "<!--", "-->"},
+    [LANG_XML] = {"XML", NULL, "<!--", "-->"},
+    [LANG_MARKDOWN] = {"Markdown", NULL, NULL, NULL},
+    [LANG_JSON] = {"JSON", NULL, NULL, NULL},
+};
+
+// Files known by their whole name, then by extension
+static const struct {
+  const char *name;
+  LanguageId language;
+} file_names[] = {
+    {"Makefile", LANG_MAKEFILE},     {"makefile", LANG_MAKEFILE},
+    {"GNUmakefile", LANG_MAKEFILE},  {"CMakeLists.txt", LANG_CMAKE},
+    {"Dockerfile", LANG_DOCKERFILE},
+};
+
+static const struct {
+  const char *extension;
+  LanguageId language;
+} extensions[] = {
+    {"c", LANG_C},           {"h", LANG_C},
+    {"cc", LANG_CPP},        {"cpp", LANG_CPP},
+    {"cxx", LANG_CPP},       {"hh", LANG_CPP},
+    {"hpp", LANG_CPP},       {"hxx", LANG_CPP},
+    {"cs", LANG_CSHARP},     {"go", LANG_GO},
+    {"rs", LANG_RUST},       {"java", LANG_JAVA},
+    {"kt", LANG_KOTLIN},     {"kts", LANG_KOTLIN},
+    {"scala", LANG_SCALA},   {"swift", LANG_SWIFT},
+    {"js", LANG_JAVASCRIPT}, {"jsx", LANG_JAVASCRIPT},
+    {"mjs", LANG_JAVASCRIPT}, {"cjs", LANG_JAVASCRIPT},
+    {"ts", LANG_TYPESCRIPT}, {"tsx", LANG_TYPESCRIPT},
+    {"php", LANG_PHP},       {"css", LANG_CSS},
+    {"scss", LANG_SCSS},     {"py", LANG_PYTHON},
+    {"rb", LANG_RUBY},       {"pl", LANG_PERL},
+    {"pm", LANG_PERL},       {"r", LANG_R},
+    {"sh", LANG_SHELL},      {"bash", LANG_SHELL},
+    {"zsh", LANG_SHELL},     {"mk", LANG_MAKEFILE},
+    {"cmake", LANG_CMAKE},   {"yml", LANG_YAML},
+    {"yaml", LANG_YAML},     {"toml", LANG_TOML},
+    {"sql", LANG_SQL},       {"lua", LANG_LUA},
+    {"hs", LANG_HASKELL},    {"html", LANG_HTML},
+    {"htm", LANG_HTML},      {"xml", LANG_XML},
+    {"md", LANG_MARKDOWN},   {"json", LANG_JSON},
+};
+
+#define ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+#define LOC_READ_SIZE (256 * 1024) // Bytes read from a file at a time
+
+typedef struct {
+  long lines;
+  long code_lines;
+  long blank_lines;
+  long comment_lines;
+  int in_comment_block;
+} LineCounts;
+
+// What one walker thread has counted so far, by language, and the buffer
+// it reads files into
+typedef struct {
+  long files[LANGUAGE_COUNT];
+  LineCounts counts[LANGUAGE_COUNT];
+  char *buffer;
+  size_t buffer_size;
+} LocState;
+
+static const Language *language_of(const char *path) {
+  const char *name = strrchr(path, '/');
+  name = name ? name + 1 : path;
+
+  for (size_t i = 0; i < ARRAY_LEN(file_names); i++) {
+    if (strcmp(name, file_names[i].name) == 0)
+      return &languages[file_names[i].language];
+  }
+
+  const char *dot = strrchr(name, '.');
+  if (!dot || dot == name)
+    return NULL;
+  for (size_t i = 0; i < ARRAY_LEN(extensions); i++) {
+    if (strcasecmp(dot + 1, extensions[i].extension) == 0)
+      return &languages[extensions[i].language];
+  }
+  return NULL;
+}
+
+static int starts_with(const char *text, size_t len, const char *prefix) {
+  size_t prefix_len = strlen(prefix);
+  return len >= prefix_len && memcmp(text, prefix, prefix_len) == 0;
+}
+
+static void count_line(LineCounts *counts, const Language *language,
+                       const char *line, size_t len) {
+  counts->lines++;
+  const char *end = line + len;
+  while (line < end && isspace((unsigned char)*line))
+    line++;
+  size_t rest = (size_t)(end - line);
+
+  if (rest == 0) {
+    counts->blank_lines++;
+  } else if (counts->in_comment_block) {
+    counts->comment_lines++;
+    const char *close = language->block_close;
+    if (memmem(line, rest, close, strlen(close))) {
+      counts->in_comment_block = 0;
+    }
+  } else if (language->block_open &&
+             starts_with(line, rest, language->block_open)) {
+    // Checked before line comments, which "--[[" in Lua also starts with
+    counts->comment_lines++;
+    size_t open_len = strlen(language->block_open);
+    const char *close = language->block_close;
+    counts->in_comment_block =
+        !memmem(line + open_len, rest - open_len, close, strlen(close));
+  } else if (language->line_comment &&
+             starts_with(line, rest, language->line_comment)) {
+    counts->comment_lines++;
+  } else {
+    counts->code_lines++;
+  }
+}
+
+// Count lines in text, which ends at the end of the file or just after a
+// newline. Lines are found with memchr, which the C library vectorizes, so
+// only the start of each line is looked at byte by byte.
+static void count_text(LineCounts *counts, const Language *language,
+                       const char *text, size_t size) {
+  const char *end = text + size;
+  while (text < end) {
+    const char *newline = memchr(text, '\n', (size_t)(end - text));
+    const char *line_end = newline ? newline : end;
+    count_line(counts, language, text, (size_t)(line_end - text));
+    text = line_end + 1;
+  }
+}
+
+// Files are read rather than mapped: one cut short while it is counted
+// (a rotated log, a build writing output) would raise SIGBUS in the shell
+static int count_file(LineCounts *counts, const Language *language,
+                      const char *path, LocState *state) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return 0;
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  // The unfinished last line of each read is kept for the next one
+  size_t kept = 0;
+  int ok = 1;
+  for (;;) {
+    if (kept == state->buffer_size) {
+      size_t size = state->buffer_size ? state->buffer_size * 2 : LOC_READ_SIZE;
+      char *buffer = realloc(state->buffer, size);
+      if (!buffer) {
+        ok = 0;
+        break;
+      }
+      state->buffer = buffer;
+      state->buffer_size = size;
+    }
+
+    ssize_t got = read(fd, state->buffer + kept, state->buffer_size - kept);
+    if (got == -1 && errno == EINTR)
+      continue;
+    if (got == -1)
+      ok = 0;
+    if (got <= 0)
+      break;
+
+    size_t filled = kept + (size_t)got;
+    const char *last = memrchr(state->buffer, '\n', filled);
+    if (!last) {
+      kept = filled;
+      continue;
+    }
+    size_t complete = (size_t)(last - state->buffer) + 1;
+    count_text(counts, language, state->buffer, complete);
+    kept = filled - complete;
+    memmove(state->buffer, state->buffer + complete, kept);
+  }
+  if (ok && kept > 0)
+    count_text(counts, language, state->buffer, kept);
+  close(fd);
+  return ok;
+}
+
+static void add_counts(LineCounts *total, const LineCounts *counts) {
+  total->lines += counts->lines;
+  total->code_lines += counts->code_lines;
+  total->blank_lines += counts->blank_lines;
+  total->comment_lines += counts->comment_lines;
+}
+
+// Files in languages that are not known are left out of the table
+static void count_source_file(const char *path, void *state) {
+  const Language *language = language_of(path);
+  if (!language)
+    return;
+
+  LocState *totals = state;
+  LineCounts counts = {0};
+  if (!count_file(&counts, language, path, totals))
+    return;
+
+  totals->files[language - languages]++;
+  add_counts(&totals->counts[language - languages], &counts);
+}
+
+static void free_states(LocState *states, int count) {
+  for (int i = 0; i < count; i++)
+    free(states[i].buffer);
+  free(states);
+}
+
+typedef struct {
+  const Language *language;
+  long files;
+  LineCounts counts;
+} LanguageRow;
+
+static int by_lines(const void *a, const void *b) {
+  const LanguageRow *left = a;
+  const LanguageRow *right = b;
+  if (left->counts.lines != right->counts.lines)
+    return left->counts.lines < right->counts.lines ? 1 : -1;
+  return strcmp(left->language->name, right->language->name);
+}
+
+TableData *loc_table(char **args) {
+  const char *root = args[1] ? args[1] : ".";
+
+  struct stat st;
+  if (stat(root, &st) != 0) {
+    fprintf(stderr, "lsh: loc: %s: %s\n", root, strerror(errno));
+    return NULL;
+  }
+
+  int thread_count = S_ISDIR(st.st_mode) ? walk_thread_count() : 1;
+  LocState *states = calloc((size_t)thread_count, sizeof(LocState));
+  if (!states) {
+    fprintf(stderr, "lsh: allocation error\n");
+    return NULL;
+  }
+
+  if (S_ISDIR(st.st_mode)) {
+    if (!walk_files(root, thread_count, count_source_file, states,
+                    sizeof(LocState))) {
+      fprintf(stderr, "lsh: loc: %s: %s\n", root, strerror(errno));
+      free_states(states, thread_count);
+      return NULL;
+    }
+  } else {
+    count_source_file(root, states);
+  }
+
+  // Merge what each thread counted
+  LanguageRow rows[LANGUAGE_COUNT];
+  int row_count = 0;
+  for (int i = 0; i < LANGUAGE_COUNT; i++) {
+    LanguageRow row = {&languages[i], 0, {0}};
+    for (int t = 0; t < thread_count; t++) {
+      row.files += states[t].files[i];
+      add_counts(&row.counts, &states[t].counts[i]);
+    }
+    if (row.files > 0)
+      rows[row_count++] = row;
+  }
+  free_states(states, thread_count);
+  qsort(rows, (size_t)row_count, sizeof(LanguageRow), by_lines);
+
+  char *headers[] = {"Language", "Files", "Lines",
+                     "Code",     "Comments", "Blanks"};
+  TableData *table = create_table(headers, 6);
+  if (!table) {
+    fprintf(stderr, "lsh: failed to create table\n");
+    return NULL;
+  }
+
+  for (int i = 0; i < row_count; i++) {
+    DataValue *row = calloc(6, sizeof(DataValue));
+    if (!row) {
+      fprintf(stderr, "lsh: allocation error\n");
+      break;
+    }
+    row[0].type = TYPE_STRING;
+    row[0].value.str_val = strdup(rows[i].language->name);
+    long values[] = {rows[i].files, rows[i].counts.lines,
+                     rows[i].counts.code_lines, rows[i].counts.comment_lines,
+                     rows[i].counts.blank_lines};
+    for (int j = 0; j < 5; j++) {
+      row[j + 1].type = TYPE_INT;
+      row[j + 1].value.int_val = (int)values[j];
+    }
+    add_table_row(table, row);
+  }
+  return table;
+}
+
+static void print_counts(StageStream *out, const char *name,
+                         const LineCounts *counts) {
+  stage_printf(out, "File: %s\n", name);
+  stage_printf(out, "Total lines: %ld\n", counts->lines);
+  stage_printf(out, "Code lines: %ld\n", counts->code_lines);
+  stage_printf(out, "Comment lines: %ld\n", counts->comment_lines);
+  stage_printf(out, "Blank lines: %ld\n", counts->blank_lines);
+}
+
+// The table as plain columns, for a pipeline stage that is not a filter
+static void write_table(StageStream *out, const TableData *table) {
+  for (int j = 0; j < table->header_count; j++) {
+    stage_printf(out, j == 0 ? "%-12s" : " %10s", table->headers[j]);
+  }
+  stage_write(out, "\n", 1);
+  for (int i = 0; i < table->row_count; i++) {
+    stage_printf(out, "%-12s", table->rows[i][0].value.str_val);
+    for (int j = 1; j < table->header_count; j++) {
+      stage_printf(out, " %10d", table->rows[i][j].value.int_val);
+    }
+    stage_write(out, "\n", 1);
+  }
+}
+
+int lsh_loc_stage(char **args, StageStream *in, StageStream *out) {
+  const char *line;
+  ssize_t len;
+  LineCounts counts = {0};
+
+  if (args[1] == NULL) {
+    if (in == NULL) {
+      fprintf(stderr, "lsh: expected file or directory argument to \"loc\"\n");
+      return 1;
+    }
+    // Count what was piped in as C
+    while ((len = stage_read_line(in, &line)) >= 0) {
+      count_line(&counts, &languages[LANG_C], line, (size_t)len);
+    }
+    print_counts(out, "(input)", &counts);
+    return 1;
+  }
+
+  struct stat st;
+  if (stat(args[1], &st) != 0) {
+    perror("lsh: loc");
+    return 1;
+  }
+
+  if (S_ISREG(st.st_mode)) {
+    // Count lines in a single file, as C unless its language is known
+    const Language *language = language_of(args[1]);
+    LocState state = {0};
+    int counted = count_file(&counts, language ? language : &languages[LANG_C],
+                             args[1], &state);
+    free(state.buffer);
+    if (!counted) {
+      perror("lsh: loc");
+      return 1;
+    }
+    print_counts(out, args[1], &counts);
+
+  } else if (S_ISDIR(st.st_mode)) {
+    TableData *table = loc_table(args);
+    if (!table) {
+      return 1;
+    }
+    if (stage_is_terminal(out)) {
+      print_table(table);
+    } else {
+      write_table(out, table);
+    }
+    free_table(table);
+  } else {
+    fprintf(stderr, "lsh: %s is not a file or directory\n", args[1]);
+  }
+
+  return 1;
+}
+
+int lsh_loc(char **args) { return stage_run(lsh_loc_stage, args); }